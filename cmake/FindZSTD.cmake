@@ -0,0 +1,50 @@
+# - Locate Zstandard
+#
+# This module defines:
+#
+#  ZSTD_INCLUDE_DIR
+#  ZSTD_LIBRARY
+#  ZSTD_FOUND
+#  ZSTD_VERSION_STRING
+#
+# If Zstandard is successfully detected, it also adds an IMPORTED library target: imported-zstd
+#
+# To find Zstandard, specify:
+#   find_package(ZSTD [version] [REQUIRED])
+#
+
+find_package(PkgConfig QUIET)
+if(PkgConfig_FOUND)
+	pkg_check_modules(_ZSTD_PKGCONFIG QUIET libzstd)
+endif()
+
+find_path(ZSTD_INCLUDE_DIR NAMES zstd.h HINTS ${_ZSTD_PKGCONFIG_INCLUDEDIR})
+find_library(ZSTD_LIBRARY NAMES zstd zstd_static libzstd HINTS ${_ZSTD_PKGCONFIG_LIBDIR})
+
+if(ZSTD_INCLUDE_DIR AND EXISTS "${ZSTD_INCLUDE_DIR}/zstd.h")
+	# Extract the version from zstd.h
+	file(STRINGS "${ZSTD_INCLUDE_DIR}/zstd.h" _ZSTD_VERSION_LINES REGEX "^#define[ \t]+ZSTD_VERSION_(MAJOR|MINOR|RELEASE)[ \t]+[0-9]+")
+	string(REGEX REPLACE ".*ZSTD_VERSION_MAJOR[ \t]+([0-9]+).*" "\\1" _ZSTD_VERSION_MAJOR "${_ZSTD_VERSION_LINES}")
+	string(REGEX REPLACE ".*ZSTD_VERSION_MINOR[ \t]+([0-9]+).*" "\\1" _ZSTD_VERSION_MINOR "${_ZSTD_VERSION_LINES}")
+	string(REGEX REPLACE ".*ZSTD_VERSION_RELEASE[ \t]+([0-9]+).*" "\\1" _ZSTD_VERSION_RELEASE "${_ZSTD_VERSION_LINES}")
+	set(ZSTD_VERSION_STRING "${_ZSTD_VERSION_MAJOR}.${_ZSTD_VERSION_MINOR}.${_ZSTD_VERSION_RELEASE}")
+endif()
+
+include(FindPackageHandleStandardArgs)
+
+find_package_handle_standard_args(
+	ZSTD
+	REQUIRED_VARS ZSTD_INCLUDE_DIR ZSTD_LIBRARY
+	VERSION_VAR ZSTD_VERSION_STRING
+)
+
+if(ZSTD_FOUND)
+	add_library(imported-zstd UNKNOWN IMPORTED)
+	set_target_properties(imported-zstd
+		PROPERTIES
+		IMPORTED_LOCATION ${ZSTD_LIBRARY}
+		INTERFACE_INCLUDE_DIRECTORIES ${ZSTD_INCLUDE_DIR}
+	)
+endif()
+
+mark_as_advanced(ZSTD_INCLUDE_DIR ZSTD_LIBRARY)
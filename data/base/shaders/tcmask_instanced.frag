@@ -0,0 +1,165 @@
+// Version directive is set by Warzone when loading the shader
+// (This shader supports GLSL 1.50 core and GLSL ES 3.00, as it is only used when instanced rendering is available.)
+
+//#pragma debug(on)
+
+uniform sampler2D Texture; // diffuse
+uniform sampler2D TextureTcmask; // tcmask
+uniform sampler2D TextureNormal; // normal map
+uniform sampler2D TextureSpecular; // specular map
+uniform int tcmask; // whether a tcmask texture exists for the model
+uniform int normalmap; // whether a normal map exists for the model
+uniform int specularmap; // whether a specular map exists for the model
+uniform int hasTangents; // whether tangents were calculated for model
+uniform float graphicsCycle; // a periodically cycling value for special effects
+
+uniform vec4 sceneColor;
+uniform vec4 ambient;
+uniform vec4 diffuse;
+uniform vec4 specular;
+
+uniform int fogEnabled; // whether fog is enabled
+uniform float fogEnd;
+uniform float fogStart;
+uniform vec4 fogColor;
+
+#if (!defined(GL_ES) && (__VERSION__ >= 130)) || (defined(GL_ES) && (__VERSION__ >= 300))
+in float vertexDistance;
+in vec3 normal, lightDir, halfVec;
+in vec2 texCoord;
+in vec4 colour, teamcolour; // per-instance colour and team colour of the model
+in vec2 instanceFlags; // x: whether ECM special effect is enabled, y: alphaTest
+in mat3 NormalMatrix3;
+#else
+varying float vertexDistance;
+varying vec3 normal, lightDir, halfVec;
+varying vec2 texCoord;
+varying vec4 colour, teamcolour; // per-instance colour and team colour of the model
+varying vec2 instanceFlags; // x: whether ECM special effect is enabled, y: alphaTest
+varying mat3 NormalMatrix3;
+#endif
+
+#if (!defined(GL_ES) && (__VERSION__ >= 130)) || (defined(GL_ES) && (__VERSION__ >= 300))
+out vec4 FragColor;
+#else
+// Uses gl_FragColor
+#endif
+
+void main()
+{
+	#if (!defined(GL_ES) && (__VERSION__ >= 130)) || (defined(GL_ES) && (__VERSION__ >= 300))
+	vec4 diffuseMap = texture(Texture, texCoord);
+	#else
+	vec4 diffuseMap = texture2D(Texture, texCoord);
+	#endif
+
+	if ((instanceFlags.y > 0.5) && (diffuseMap.a <= 0.5))
+	{
+		discard;
+	}
+
+	// Normal map implementations
+	vec3 N = normal;
+	if (normalmap != 0)
+	{
+		#if (!defined(GL_ES) && (__VERSION__ >= 130)) || (defined(GL_ES) && (__VERSION__ >= 300))
+		vec3 normalFromMap = texture(TextureNormal, texCoord).xyz;
+		#else
+		vec3 normalFromMap = texture2D(TextureNormal, texCoord).xyz;
+		#endif
+
+		// Complete replace normal with new value
+		N = normalFromMap.xzy * 2.0 - 1.0;
+
+		// To match wz's light
+		N.y = -N.y;
+
+		// For object-space normal map
+		if (hasTangents == 0)
+		{
+			N = NormalMatrix3 * N;
+		}
+	}
+	N = normalize(N);
+
+	// Сalculate and combine final lightning
+	vec4 light = sceneColor;
+	vec3 L = lightDir; //can be normalized for better quality
+	float lambertTerm = max(dot(N, L), 0.0);
+
+	if (lambertTerm > 0.0)
+	{
+		// Vanilla models shouldn't use diffuse light
+		float vanillaFactor = 0.0;
+
+		if (specularmap != 0)
+		{
+			#if (!defined(GL_ES) && (__VERSION__ >= 130)) || (defined(GL_ES) && (__VERSION__ >= 300))
+			float specularMapValue = texture(TextureSpecular, texCoord).r;
+			#else
+			float specularMapValue = texture2D(TextureSpecular, texCoord).r;
+			#endif
+			vec4 specularFromMap = vec4(specularMapValue, specularMapValue, specularMapValue, 1.0);
+
+			// Gaussian specular term computation
+			vec3 H = normalize(halfVec);
+			float angle = acos(dot(H, N));
+			float exponent = angle / 0.2;
+			exponent = -(exponent * exponent);
+			float gaussianTerm = exp(exponent);
+
+			light += specular * gaussianTerm * lambertTerm * specularFromMap;
+
+			// Neutralize factor for spec map
+			vanillaFactor = 1.0;
+		}
+
+		light += diffuse * lambertTerm * diffuseMap * vanillaFactor;
+	}
+	// NOTE: this doubled for non-spec map case to keep results similar to old shader
+	// We rely on specularmap to be either 1 or 0 to avoid adding another if
+	light += ambient * diffuseMap * (1.0 + (1.0 - float(specularmap)));
+
+	vec4 fragColour;
+	if (tcmask != 0)
+	{
+		// Get mask for team colors from texture
+		#if (!defined(GL_ES) && (__VERSION__ >= 130)) || (defined(GL_ES) && (__VERSION__ >= 300))
+		float maskAlpha = texture(TextureTcmask, texCoord).r;
+		#else
+		float maskAlpha = texture2D(TextureTcmask, texCoord).r;
+		#endif
+
+		// Apply color using grain merge with tcmask
+		fragColour = (light + (teamcolour - 0.5) * maskAlpha) * colour;
+	}
+	else
+	{
+		fragColour = light * colour;
+	}
+
+	if (instanceFlags.x > 0.5)
+	{
+		fragColour.a = 0.66 + 0.66 * graphicsCycle;
+	}
+	
+	if (fogEnabled > 0)
+	{
+		// Calculate linear fog
+		float fogFactor = (fogEnd - vertexDistance) / (fogEnd - fogStart);
+
+		if(fogFactor > 1.f)
+		{
+			discard;
+		}
+
+		// Return fragment color
+		fragColour = mix(fragColour, vec4(fogColor.xyz, fragColour.w), clamp(fogFactor, 0.0, 1.0));
+	}
+
+	#if (!defined(GL_ES) && (__VERSION__ >= 130)) || (defined(GL_ES) && (__VERSION__ >= 300))
+	FragColor = fragColour;
+	#else
+	gl_FragColor = fragColour;
+	#endif
+}
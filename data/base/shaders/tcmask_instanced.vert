@@ -0,0 +1,96 @@
+// Version directive is set by Warzone when loading the shader
+// (This shader supports GLSL 1.50 core and GLSL ES 3.00, as it is only used when instanced rendering is available.)
+
+//#pragma debug(on)
+
+uniform mat4 ProjectionMatrix;
+uniform int hasTangents; // whether tangents were calculated for model
+uniform vec4 lightPosition;
+
+#if (!defined(GL_ES) && (__VERSION__ >= 130)) || (defined(GL_ES) && (__VERSION__ >= 300))
+in vec4 vertex;
+in vec3 vertexNormal;
+in vec2 vertexTexCoord;
+in vec4 vertexTangent;
+// per-instance attributes
+in mat4 instanceModelViewMatrix;
+in mat4 instanceNormalMatrix;
+in vec4 instanceColour;
+in vec4 instanceTeamColour;
+in vec4 instanceParams; // x: stretch, y: ecmEffect, z: alphaTest
+#else
+attribute vec4 vertex;
+attribute vec3 vertexNormal;
+attribute vec2 vertexTexCoord;
+attribute vec4 vertexTangent;
+// per-instance attributes
+attribute mat4 instanceModelViewMatrix;
+attribute mat4 instanceNormalMatrix;
+attribute vec4 instanceColour;
+attribute vec4 instanceTeamColour;
+attribute vec4 instanceParams; // x: stretch, y: ecmEffect, z: alphaTest
+#endif
+
+#if (!defined(GL_ES) && (__VERSION__ >= 130)) || (defined(GL_ES) && (__VERSION__ >= 300))
+out float vertexDistance;
+out vec3 normal, lightDir, halfVec;
+out vec2 texCoord;
+out vec4 colour, teamcolour;
+out vec2 instanceFlags;
+out mat3 NormalMatrix3;
+#else
+varying float vertexDistance;
+varying vec3 normal, lightDir, halfVec;
+varying vec2 texCoord;
+varying vec4 colour, teamcolour;
+varying vec2 instanceFlags;
+varying mat3 NormalMatrix3;
+#endif
+
+void main()
+{
+	// Pass texture coordinates and per-instance values to fragment shader
+	texCoord = vertexTexCoord;
+	colour = instanceColour;
+	teamcolour = instanceTeamColour;
+	instanceFlags = instanceParams.yz;
+	NormalMatrix3 = mat3(instanceNormalMatrix[0].xyz, instanceNormalMatrix[1].xyz, instanceNormalMatrix[2].xyz);
+
+	// Lighting we pass to the fragment shader
+	vec3 eyeVec = normalize((instanceModelViewMatrix * vertex).xyz);
+	vec3 n = normalize((instanceNormalMatrix * vec4(vertexNormal, 0.0)).xyz);
+	lightDir = normalize(lightPosition.xyz);
+
+	if (hasTangents != 0)
+	{
+		// Building the matrix Eye Space -> Tangent Space with handness
+		vec3 t = normalize((instanceNormalMatrix * vertexTangent).xyz);
+		vec3 b = cross (n, t) * vertexTangent.w;
+		mat3 TangentSpaceMatrix = mat3(t, n, b);
+
+		// Transform calculated normals for vanilla models by tangent basis
+		n = n * TangentSpaceMatrix;
+
+		// Transform light and eye direction vectors by tangent basis
+		lightDir *= TangentSpaceMatrix;
+		eyeVec *= TangentSpaceMatrix;
+	}
+
+	normal = n;
+	halfVec = lightDir + eyeVec; //can be normalized for better quality
+
+	// Implement building stretching to accommodate terrain
+	vec4 position = vertex;
+	if (vertex.y <= 0.0) // use vertex here directly to help shader compiler optimization
+	{
+		position.y -= instanceParams.x;
+	}
+
+	// Translate every vertex according to the Model View and Projection Matrix
+	mat4 ModelViewProjectionMatrix = ProjectionMatrix * instanceModelViewMatrix;
+	vec4 gposition = ModelViewProjectionMatrix * position;
+	gl_Position = gposition;
+
+	// Remember vertex distance
+	vertexDistance = gposition.z;
+}
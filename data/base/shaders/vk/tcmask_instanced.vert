@@ -0,0 +1,96 @@
+#version 450
+//#pragma debug(on)
+
+layout(std140, set = 0, binding = 0) uniform globaluniforms
+{
+	mat4 ProjectionMatrix;
+	vec4 lightPosition;
+	vec4 sceneColor;
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	vec4 fogColor;
+	float fogEnd;
+	float fogStart;
+	float graphicsCycle;
+	int fogEnabled;
+};
+
+layout(std140, set = 1, binding = 0) uniform meshuniforms
+{
+	int tcmask;
+	int normalmap;
+	int specularmap;
+	int hasTangents;
+};
+
+layout(location = 0) in vec4 vertex;
+layout(location = 3) in vec3 vertexNormal;
+layout(location = 1) in vec2 vertexTexCoord;
+layout(location = 4) in vec4 vertexTangent;
+// per-instance attributes
+layout(location = 5) in mat4 ModelViewMatrix;
+layout(location = 9) in mat4 NormalMatrix;
+layout(location = 13) in vec4 instanceColour;
+layout(location = 14) in vec4 instanceTeamColour;
+layout(location = 15) in vec4 instanceParams; // x: stretch, y: ecmEffect, z: alphaTest
+
+layout(location = 0) out float vertexDistance;
+layout(location = 1) out vec3 normal;
+layout(location = 2) out vec3 lightDir;
+layout(location = 3) out vec3 halfVec;
+layout(location = 4) out vec2 texCoord;
+layout(location = 5) out vec4 colour;
+layout(location = 6) out vec4 teamcolour;
+layout(location = 7) out vec2 instanceFlags;
+layout(location = 8) out mat3 NormalMatrix3;
+
+void main()
+{
+	// Pass texture coordinates and per-instance values to fragment shader
+	texCoord = vertexTexCoord;
+	colour = instanceColour;
+	teamcolour = instanceTeamColour;
+	instanceFlags = instanceParams.yz;
+	NormalMatrix3 = mat3(NormalMatrix);
+
+	// Lighting we pass to the fragment shader
+	vec3 eyeVec = normalize((ModelViewMatrix * vertex).xyz);
+	vec3 n = normalize((NormalMatrix * vec4(vertexNormal, 0.0)).xyz);
+	lightDir = normalize(lightPosition.xyz);
+
+	if (hasTangents != 0)
+	{
+		// Building the matrix Eye Space -> Tangent Space with handness
+		vec3 t = normalize((NormalMatrix * vertexTangent).xyz);
+		vec3 b = cross (n, t) * vertexTangent.w;
+		mat3 TangentSpaceMatrix = mat3(t, n, b);
+
+		// Transform calculated normals for vanilla models by tangent basis
+		n = n * TangentSpaceMatrix;
+
+		// Transform light and eye direction vectors by tangent basis
+		lightDir *= TangentSpaceMatrix;
+		eyeVec *= TangentSpaceMatrix;
+	}
+
+	normal = n;
+	halfVec = lightDir + eyeVec; //can be normalized for better quality
+
+	// Implement building stretching to accommodate terrain
+	vec4 position = vertex;
+	if (vertex.y <= 0.0) // use vertex here directly to help shader compiler optimization
+	{
+		position.y -= instanceParams.x;
+	}
+
+	// Translate every vertex according to the Model View and Projection Matrix
+	mat4 ModelViewProjectionMatrix = ProjectionMatrix * ModelViewMatrix;
+	vec4 gposition = ModelViewProjectionMatrix * position;
+	gl_Position = gposition;
+
+	// Remember vertex distance
+	vertexDistance = gposition.z;
+	gl_Position.y *= -1.;
+	gl_Position.z = (gl_Position.z + gl_Position.w) / 2.0;
+}
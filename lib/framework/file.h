@@ -44,6 +44,10 @@ bool loadFileToBufferVector(const char *pFileName, std::vector<char>& outputBuff
 /** Load a file from disk, but returns quietly if no file found. */
 WZ_DECL_NONNULL(1, 2) bool loadFileToBufferNoError(const char *pFileName, char *pFileBuffer, UDWORD bufferSize, UDWORD *pSize);
 
+/** Hash of the file, remembered (also across runs) for as long as its size and modification time stay the same. */
 WZ_DECL_NONNULL(1) Sha256 findHashOfFile(char const *realFileName);
 
+/** Name of a file hashed earlier with findHashOfFile() which still has the given hash, or an empty string if there is none. */
+std::string findFileWithHash(Sha256 const &hash);
+
 #endif // _file_h
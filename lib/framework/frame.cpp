@@ -27,6 +27,7 @@
 #include "frame.h"
 #include "file.h"
 #include "wzapp.h"
+#include "wzjobs.h"
 
 #include <physfs.h>
 #include "physfs_ext.h"
@@ -34,7 +35,12 @@
 #include "frameresource.h"
 #include "input.h"
 
+#include <algorithm>
+#include <atomic>
 #include <limits>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
 
 /************************************************************************************
  *
@@ -52,6 +58,8 @@ static uint64_t curFrames = 0; // Number of frames elapsed since start
 static uint64_t lastFrames = 0;
 static uint32_t curTicks = 0; // Number of ticks since execution started
 static uint32_t lastTicks = 0;
+static int jobLoad = 0;
+static std::atomic<uint64_t> jobMicroseconds(0);  // Time spent in jobs since lastTicks, added to by every thread
 
 /* InitFrameStuff - needs to be called once before frame loop commences */
 static void InitFrameStuff()
@@ -61,6 +69,7 @@ static void InitFrameStuff()
 	lastFrames = 0;
 	curTicks = 0;
 	lastTicks = 0;
+	jobLoad = 0;
 }
 
 int frameRate()
@@ -68,6 +77,16 @@ int frameRate()
 	return frameCount;
 }
 
+int frameJobLoad()
+{
+	return jobLoad;
+}
+
+static void frameJobTime(const char *, int, uint64_t microseconds)
+{
+	jobMicroseconds += microseconds;
+}
+
 UDWORD	frameGetFrameNumber()
 {
 	return (UDWORD)curFrames;
@@ -98,6 +117,10 @@ bool frameInitialise()
 		return false;
 	}
 
+	// Start the worker threads
+	wzJobsSetTimingHook(frameJobTime);
+	wzJobsInitialise();
+
 	return true;
 }
 
@@ -114,6 +137,7 @@ void frameUpdate()
 	if (curTicks >= lastTicks + 1000)
 	{
 		frameCount = static_cast<int>(curFrames - lastFrames);
+		jobLoad = static_cast<int>(jobMicroseconds.exchange(0) / (10 * (curTicks - lastTicks) * (wzJobsWorkerCount() + 1)));
 		lastTicks = curTicks;
 		lastFrames = curFrames;
 	}
@@ -128,6 +152,9 @@ void frameShutDown()
 	// Shutdown the resource stuff
 	debug(LOG_NEVER, "No more resources!");
 	resShutDown();
+
+	// Stop the worker threads
+	wzJobsShutdown();
 }
 
 void setMouseWarp(bool value)
@@ -376,14 +403,182 @@ bool loadFileToBufferNoError(const char *pFileName, char *pFileBuffer, UDWORD bu
 	return loadFile2(pFileName, &pFileBuffer, pSize, false, false);
 }
 
+#define FILE_HASH_CACHE_DIR "cache"
+#define FILE_HASH_CACHE_PATH FILE_HASH_CACHE_DIR "/filehashes.txt"
+#define FILE_HASH_CACHE_MAX_ENTRIES 4096  ///< Beyond this, the least recently hashed files are forgotten.
+
+struct FileHashCacheEntry
+{
+	std::string fileName;  ///< Name in the PhysFS search path.
+	PHYSFS_sint64 size;
+	PHYSFS_sint64 modTime;
+	Sha256 hash;
+	uint64_t sequence;     ///< Order in which the files were hashed, oldest first.
+};
+static std::unordered_map<std::string, FileHashCacheEntry> fileHashCache;  ///< Indexed by real directory and file name.
+static bool fileHashCacheLoaded = false;
+static uint64_t fileHashCacheSequence = 0;
+
+static std::string fileHashCacheKey(char const *fileName)
+{
+	return WZ_PHYSFS_getRealDir_String(fileName) + PHYSFS_getDirSeparator() + fileName;
+}
+
+static bool fileHashCacheEntryValid(FileHashCacheEntry const &entry, std::string const &key)
+{
+	return PHYSFS_exists(entry.fileName.c_str()) && fileHashCacheKey(entry.fileName.c_str()) == key
+	       && WZ_PHYSFS_getLastModTime(entry.fileName.c_str()) == entry.modTime;
+}
+
+static std::string fileHashCacheLine(std::string const &key, FileHashCacheEntry const &entry)
+{
+	std::string const realDir = key.substr(0, key.size() - entry.fileName.size() - strlen(PHYSFS_getDirSeparator()));
+	std::ostringstream line;
+	line << entry.hash.toString() << ' ' << entry.size << ' ' << entry.modTime << ' ' << std::quoted(realDir) << ' ' << entry.fileName << '\n';
+	return line.str();
+}
+
+static PHYSFS_file *openFileHashCache(PHYSFS_file *(*open)(const char *))
+{
+	if (PHYSFS_getWriteDir() == nullptr)
+	{
+		return nullptr;
+	}
+	if (!WZ_PHYSFS_isDirectory(FILE_HASH_CACHE_DIR))
+	{
+		PHYSFS_mkdir(FILE_HASH_CACHE_DIR);
+	}
+	PHYSFS_file *fileHandle = open(FILE_HASH_CACHE_PATH);
+	if (fileHandle == nullptr)
+	{
+		debug(LOG_WZ, "Could not open %s: %s", FILE_HASH_CACHE_PATH, WZ_PHYSFS_getLastError());
+	}
+	return fileHandle;
+}
+
+/// Writes the cache out again with one line per file, keeping the most recently hashed files if there are too many.
+static void rewriteFileHashCache()
+{
+	std::vector<std::pair<uint64_t, std::string>> order;  // Sequence and key of each entry.
+	order.reserve(fileHashCache.size());
+	for (auto const &cached : fileHashCache)
+	{
+		order.emplace_back(cached.second.sequence, cached.first);
+	}
+	std::sort(order.begin(), order.end());
+
+	// Trim to below the limit, so that the next few hashes can be appended without rewriting again.
+	size_t const first = order.size() > FILE_HASH_CACHE_MAX_ENTRIES ? order.size() - FILE_HASH_CACHE_MAX_ENTRIES * 3 / 4 : 0;
+	for (size_t i = 0; i < first; ++i)
+	{
+		fileHashCache.erase(order[i].second);
+	}
+	std::string data;
+	for (size_t i = first; i < order.size(); ++i)
+	{
+		data += fileHashCacheLine(order[i].second, fileHashCache[order[i].second]);
+	}
+
+	PHYSFS_file *fileHandle = openFileHashCache(PHYSFS_openWrite);
+	if (fileHandle == nullptr)
+	{
+		return;
+	}
+	WZ_PHYSFS_writeBytes(fileHandle, data.data(), static_cast<PHYSFS_uint32>(data.size()));
+	PHYSFS_close(fileHandle);
+}
+
+static void appendFileHashCache(std::string const &key, FileHashCacheEntry const &entry)
+{
+	if (fileHashCache.size() > FILE_HASH_CACHE_MAX_ENTRIES)
+	{
+		rewriteFileHashCache();
+		return;
+	}
+	PHYSFS_file *fileHandle = openFileHashCache(PHYSFS_openAppend);
+	if (fileHandle == nullptr)
+	{
+		return;
+	}
+	std::string const line = fileHashCacheLine(key, entry);
+	WZ_PHYSFS_writeBytes(fileHandle, line.data(), static_cast<PHYSFS_uint32>(line.size()));
+	PHYSFS_close(fileHandle);
+}
+
+/// Reads the hashes remembered from earlier runs, one "hash size modtime realdir name" line per file.
+static void loadFileHashCache()
+{
+	fileHashCacheLoaded = true;
+	if (PHYSFS_getWriteDir() == nullptr || !PHYSFS_exists(FILE_HASH_CACHE_PATH))
+	{
+		return;
+	}
+	std::vector<char> data;
+	if (!loadFileToBufferVector(FILE_HASH_CACHE_PATH, data, false, false))
+	{
+		return;
+	}
+	std::istringstream lines(std::string(data.begin(), data.end()));
+	std::string line;
+	size_t lineCount = 0;
+	while (std::getline(lines, line))
+	{
+		++lineCount;
+		std::istringstream fields(line);
+		std::string hash, realDir;
+		FileHashCacheEntry entry;
+		if (!(fields >> hash >> entry.size >> entry.modTime >> std::quoted(realDir)) || hash.size() != Sha256::Bytes * 2)
+		{
+			continue;
+		}
+		fields >> std::ws;
+		std::getline(fields, entry.fileName);
+		entry.hash.fromString(hash);
+		entry.sequence = ++fileHashCacheSequence;
+		fileHashCache[realDir + PHYSFS_getDirSeparator() + entry.fileName] = entry;  // Later lines win.
+	}
+
+	// Files rehashed after changing leave their old lines behind, so drop those, and anything beyond the limit.
+	if (lineCount > fileHashCache.size() || fileHashCache.size() > FILE_HASH_CACHE_MAX_ENTRIES)
+	{
+		rewriteFileHashCache();
+	}
+}
+
 Sha256 findHashOfFile(char const *realFileName)
 {
+	if (!fileHashCacheLoaded)
+	{
+		loadFileHashCache();
+	}
+
+	std::string const key = fileHashCacheKey(realFileName);
+	PHYSFS_sint64 const modTime = WZ_PHYSFS_getLastModTime(realFileName);
+	auto cached = fileHashCache.find(key);
+
 	char *realFileData = nullptr;
 	uint32_t realFileSize = 0;
+	if (cached != fileHashCache.end() && cached->second.modTime == modTime && cached->second.fileName == realFileName)
+	{
+		PHYSFS_file *fileHandle = PHYSFS_openRead(realFileName);
+		PHYSFS_sint64 const size = fileHandle != nullptr ? PHYSFS_fileLength(fileHandle) : -1;
+		if (fileHandle != nullptr)
+		{
+			PHYSFS_close(fileHandle);
+		}
+		if (size == cached->second.size)
+		{
+			return cached->second.hash;  // Unchanged since we hashed it.
+		}
+	}
 	if (loadFile(realFileName, &realFileData, &realFileSize))
 	{
 		Sha256 realFileHash = sha256Sum(realFileData, realFileSize);
 		free(realFileData);
+
+		FileHashCacheEntry entry = {realFileName, realFileSize, modTime, realFileHash, ++fileHashCacheSequence};
+		fileHashCache[key] = entry;
+		appendFileHashCache(key, entry);
 		return realFileHash;
 	}
 	Sha256 zero;
@@ -391,6 +586,31 @@ Sha256 findHashOfFile(char const *realFileName)
 	return zero;
 }
 
+std::string findFileWithHash(Sha256 const &hash)
+{
+	if (!fileHashCacheLoaded)
+	{
+		loadFileHashCache();
+	}
+
+	std::vector<std::string> candidates;
+	for (auto const &cached : fileHashCache)
+	{
+		if (cached.second.hash == hash && fileHashCacheEntryValid(cached.second, cached.first))
+		{
+			candidates.push_back(cached.second.fileName);
+		}
+	}
+	for (std::string const &fileName : candidates)
+	{
+		if (findHashOfFile(fileName.c_str()) == hash)  // Checks the size too.
+		{
+			return fileName;
+		}
+	}
+	return {};
+}
+
 bool PHYSFS_printf(PHYSFS_file *file, const char *format, ...)
 {
 	char vaBuffer[PATH_MAX];
@@ -108,6 +108,9 @@ UDWORD frameGetFrameNumber();
 /** Return framerate of the last second. */
 int frameRate();
 
+/** Return how busy the job pool was during the last second, in percent of the time of its threads and the main thread. */
+int frameJobLoad();
+
 static inline WZ_DECL_CONST const char *bool2string(bool var)
 {
 	return (var ? "true" : "false");
@@ -0,0 +1,442 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "frame.h"
+#include "math_ext.h"
+#include "wzapp.h"
+#include "wzjobs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+
+static const int MAX_JOB_WORKERS = 16;
+
+struct WZ_JOB
+{
+	const char *name;
+	std::function<void ()> function;
+	bool detached = false;                   ///< nobody finishes the job, so it frees itself
+	WZ_SEMAPHORE *doneSemaphore = nullptr;   ///< posted once the job ran, unless detached
+};
+
+struct WZ_JOB_QUEUE
+{
+	const char *name;
+	WZ_MUTEX *mutex;                             ///< guards the rest
+	std::deque<std::function<void ()>> pending;
+	bool scheduled = false;                      ///< a job that runs the next pending function is on the pool
+	bool quit = false;
+	WZ_SEMAPHORE *idleSemaphore;                 ///< posted when it stops being scheduled after quit was set
+};
+
+/// Jobs waiting for a worker, one per worker and the last for threads outside the pool
+struct JobDeque
+{
+	WZ_MUTEX *mutex;
+	std::deque<WZ_JOB *> jobs;
+};
+
+static std::vector<WZ_THREAD *> jobWorkers;
+static std::vector<JobDeque> jobDeques;
+static WZ_SEMAPHORE *jobWorkSemaphore = nullptr;  ///< posted once for every job added
+static volatile bool jobWorkersQuit = false;
+static WZ_JOB_TIMING_HOOK jobTimingHook = nullptr;
+static thread_local int currentWorker = -1;
+
+static void reportJobTime(const char *name, std::chrono::steady_clock::time_point start)
+{
+	WZ_JOB_TIMING_HOOK hook = jobTimingHook;
+	if (hook != nullptr)
+	{
+		hook(name, currentWorker, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+}
+
+static void runJob(WZ_JOB *job)
+{
+	const auto start = std::chrono::steady_clock::now();
+	job->function();
+	reportJobTime(job->name, start);
+
+	if (job->detached)
+	{
+		delete job;
+		return;
+	}
+	wzSemaphorePost(job->doneSemaphore);  // The job may be freed from here on.
+}
+
+/// Take the newest of our own jobs, or else the oldest of someone else's.
+static WZ_JOB *takeJob()
+{
+	const size_t count = jobDeques.size();
+	const size_t own = currentWorker >= 0 ? currentWorker : count - 1;
+	for (size_t i = 0; i < count; ++i)
+	{
+		JobDeque &deque = jobDeques[(own + i) % count];
+		wzMutexLock(deque.mutex);
+		WZ_JOB *job = nullptr;
+		if (!deque.jobs.empty())
+		{
+			if (i == 0)
+			{
+				job = deque.jobs.back();
+				deque.jobs.pop_back();
+			}
+			else
+			{
+				job = deque.jobs.front();
+				deque.jobs.pop_front();
+			}
+		}
+		wzMutexUnlock(deque.mutex);
+		if (job != nullptr)
+		{
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+static void addJob(WZ_JOB *job)
+{
+	if (jobWorkers.empty())
+	{
+		runJob(job);  // No pool, so do it now.
+		return;
+	}
+	JobDeque &deque = jobDeques[currentWorker >= 0 ? currentWorker : jobDeques.size() - 1];
+	wzMutexLock(deque.mutex);
+	deque.jobs.push_back(job);
+	wzMutexUnlock(deque.mutex);
+	wzSemaphorePost(jobWorkSemaphore);
+}
+
+static void addDetachedJob(const char *name, std::function<void ()> function)
+{
+	WZ_JOB *job = new WZ_JOB();
+	job->name = name;
+	job->function = std::move(function);
+	job->detached = true;
+	addJob(job);
+}
+
+/** This runs in the job worker threads */
+static int jobWorkerFunc(void *data)
+{
+	currentWorker = static_cast<int>(reinterpret_cast<intptr_t>(data));
+	for (;;)
+	{
+		wzSemaphoreWait(jobWorkSemaphore);  // Go to sleep until needed.
+		if (jobWorkersQuit)
+		{
+			break;
+		}
+		while (WZ_JOB *job = takeJob())
+		{
+			runJob(job);
+		}
+	}
+	return 0;
+}
+
+void wzJobsInitialise()
+{
+	wzJobsShutdown();  // In case of being initialised twice.
+	jobWorkersQuit = false;
+	jobWorkSemaphore = wzSemaphoreCreate(0);
+
+	// At least one, for what has to run in the background even on a single core.
+	const int numWorkers = clip(wzGetCPUCount() - 1, 1, MAX_JOB_WORKERS);
+	jobDeques.resize(numWorkers + 1);
+	for (JobDeque &deque : jobDeques)
+	{
+		deque.mutex = wzMutexCreate();
+	}
+	for (int i = 0; i < numWorkers; ++i)
+	{
+		WZ_THREAD *thread = wzThreadCreate(jobWorkerFunc, reinterpret_cast<void *>(static_cast<intptr_t>(i)));
+		wzThreadStart(thread);
+		jobWorkers.push_back(thread);
+	}
+	debug(LOG_WZ, "Started %d job workers", numWorkers);
+}
+
+void wzJobsShutdown()
+{
+	if (jobWorkSemaphore == nullptr)
+	{
+		return;
+	}
+	jobWorkersQuit = true;
+	for (size_t i = 0; i < jobWorkers.size(); ++i)
+	{
+		wzSemaphorePost(jobWorkSemaphore);  // Wake up thread.
+	}
+	for (WZ_THREAD *thread : jobWorkers)
+	{
+		wzThreadJoin(thread);
+	}
+	// Nobody would run them any more, so do it here.
+	while (WZ_JOB *job = takeJob())
+	{
+		runJob(job);
+	}
+	jobWorkers.clear();
+	for (JobDeque &deque : jobDeques)
+	{
+		wzMutexDestroy(deque.mutex);
+	}
+	jobDeques.clear();
+	wzSemaphoreDestroy(jobWorkSemaphore);
+	jobWorkSemaphore = nullptr;
+}
+
+int wzJobsWorkerCount()
+{
+	return jobWorkers.size();
+}
+
+void wzJobsSetTimingHook(WZ_JOB_TIMING_HOOK hook)
+{
+	jobTimingHook = hook;
+}
+
+WZ_JOB *wzJobStart(const char *name, std::function<void ()> function)
+{
+	WZ_JOB *job = new WZ_JOB();
+	job->name = name;
+	job->function = std::move(function);
+	if (jobWorkers.empty())
+	{
+		const auto start = std::chrono::steady_clock::now();
+		job->function();  // No pool, so do it now.
+		reportJobTime(name, start);
+		return job;
+	}
+	job->doneSemaphore = wzSemaphoreCreate(0);
+	addJob(job);
+	return job;
+}
+
+void wzJobFinish(WZ_JOB *job)
+{
+	if (job->doneSemaphore != nullptr)
+	{
+		// Not started yet, so don't wait behind the other jobs.
+		bool runHere = false;
+		for (JobDeque &deque : jobDeques)
+		{
+			wzMutexLock(deque.mutex);
+			auto queued = std::find(deque.jobs.begin(), deque.jobs.end(), job);
+			if (queued != deque.jobs.end())
+			{
+				deque.jobs.erase(queued);
+				runHere = true;
+			}
+			wzMutexUnlock(deque.mutex);
+			if (runHere)
+			{
+				break;
+			}
+		}
+		if (runHere)
+		{
+			runJob(job);
+		}
+		wzSemaphoreWait(job->doneSemaphore);
+		wzSemaphoreDestroy(job->doneSemaphore);
+	}
+	delete job;
+}
+
+static void runJobQueueStep(WZ_JOB_QUEUE *queue)
+{
+	wzMutexLock(queue->mutex);
+	if (queue->pending.empty())
+	{
+		queue->scheduled = false;
+		const bool notify = queue->quit;
+		wzMutexUnlock(queue->mutex);
+		if (notify)
+		{
+			wzSemaphorePost(queue->idleSemaphore);
+		}
+		return;
+	}
+	std::function<void ()> function = std::move(queue->pending.front());
+	queue->pending.pop_front();
+	wzMutexUnlock(queue->mutex);
+
+	function();
+
+	// One at a time, so the other jobs get a turn in between.
+	addDetachedJob(queue->name, [queue]() {
+		runJobQueueStep(queue);
+	});
+}
+
+WZ_JOB_QUEUE *wzJobQueueCreate(const char *name)
+{
+	WZ_JOB_QUEUE *queue = new WZ_JOB_QUEUE();
+	queue->name = name;
+	queue->mutex = wzMutexCreate();
+	queue->idleSemaphore = wzSemaphoreCreate(0);
+	return queue;
+}
+
+void wzJobQueueAdd(WZ_JOB_QUEUE *queue, std::function<void ()> function)
+{
+	if (jobWorkers.empty())
+	{
+		const auto start = std::chrono::steady_clock::now();
+		function();  // No pool, so do it now.
+		reportJobTime(queue->name, start);
+		return;
+	}
+	wzMutexLock(queue->mutex);
+	queue->pending.push_back(std::move(function));
+	const bool schedule = !queue->scheduled;
+	queue->scheduled = true;
+	wzMutexUnlock(queue->mutex);
+
+	if (schedule)
+	{
+		addDetachedJob(queue->name, [queue]() {
+			runJobQueueStep(queue);
+		});
+	}
+}
+
+void wzJobQueueDestroy(WZ_JOB_QUEUE *queue)
+{
+	wzMutexLock(queue->mutex);
+	queue->quit = true;
+	queue->pending.clear();
+	const bool wait = queue->scheduled;
+	wzMutexUnlock(queue->mutex);
+
+	if (wait)
+	{
+		wzSemaphoreWait(queue->idleSemaphore);
+	}
+	wzMutexDestroy(queue->mutex);
+	wzSemaphoreDestroy(queue->idleSemaphore);
+	delete queue;
+}
+
+/// A wzParallelFor() in progress, kept alive by its helper jobs, which may start after it is over
+struct ParallelFor
+{
+	ParallelFor() : mutex(wzMutexCreate()), doneSemaphore(wzSemaphoreCreate(0)) {}
+	~ParallelFor()
+	{
+		wzMutexDestroy(mutex);
+		wzSemaphoreDestroy(doneSemaphore);
+	}
+
+	const char *name;
+	std::function<void (size_t)> const *function;  ///< only valid while some of the calls are left
+	size_t count;
+	size_t chunk;                  ///< calls taken at a time
+	WZ_MUTEX *mutex;               ///< guards next and finished
+	size_t next = 0;
+	size_t finished = 0;
+	WZ_SEMAPHORE *doneSemaphore;   ///< posted once by whoever finishes the last call
+};
+
+/// Take chunks of calls until there are none left.
+static void runParallelFor(ParallelFor &state)
+{
+	const auto start = std::chrono::steady_clock::now();
+	size_t numRun = 0;
+	for (;;)
+	{
+		wzMutexLock(state.mutex);
+		const size_t begin = state.next;
+		const size_t end = std::min(begin + state.chunk, state.count);
+		state.next = end;
+		wzMutexUnlock(state.mutex);
+		if (begin >= end)
+		{
+			break;
+		}
+
+		for (size_t i = begin; i < end; ++i)
+		{
+			(*state.function)(i);
+		}
+		numRun += end - begin;
+
+		wzMutexLock(state.mutex);
+		state.finished += end - begin;
+		const bool last = state.finished == state.count;
+		wzMutexUnlock(state.mutex);
+		if (last)
+		{
+			reportJobTime(state.name, start);
+			wzSemaphorePost(state.doneSemaphore);  // The caller may return from here on.
+			return;
+		}
+	}
+	if (numRun > 0)
+	{
+		reportJobTime(state.name, start);
+	}
+}
+
+void wzParallelFor(const char *name, size_t count, std::function<void (size_t)> const &function)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	if (jobWorkers.empty() || count == 1)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < count; ++i)
+		{
+			function(i);
+		}
+		reportJobTime(name, start);
+		return;
+	}
+
+	std::shared_ptr<ParallelFor> state = std::make_shared<ParallelFor>();
+	state->name = name;
+	state->function = &function;
+	state->count = count;
+	// Several chunks per thread, so nobody waits long for a slow one, but not so many that the mutex gets busy.
+	state->chunk = std::max<size_t>(1, count / (8 * (jobWorkers.size() + 1)));
+
+	const size_t numChunks = (count + state->chunk - 1) / state->chunk;
+	const size_t numHelpers = std::min(numChunks - 1, jobWorkers.size());
+	for (size_t i = 0; i < numHelpers; ++i)
+	{
+		addDetachedJob(name, [state]() {
+			runParallelFor(*state);
+		});
+	}
+
+	// this thread does its share of the work too, so it's done even if all workers are busy with something else
+	runParallelFor(*state);
+	wzSemaphoreWait(state->doneSemaphore);
+}
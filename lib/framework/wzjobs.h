@@ -0,0 +1,82 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** \file
+ *  One pool of worker threads, sized to the machine, for everything that runs in the background or gets split up.
+ *  Each worker has its own queue of jobs, taking the newest of its own first and the oldest of the others' when out of work.
+ *  Without wzJobsInitialise(), everything runs right away on the calling thread.
+ */
+
+#ifndef __INCLUDED_LIB_FRAMEWORK_WZJOBS_H__
+#define __INCLUDED_LIB_FRAMEWORK_WZJOBS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/// A function running on the pool, to be finished with wzJobFinish()
+struct WZ_JOB;
+/// Functions that run on the pool one at a time, in the order added
+struct WZ_JOB_QUEUE;
+
+/** Called after each job, or each thread's share of a wzParallelFor(), on the thread that ran it.
+ *  \param worker index of the worker thread, or -1 for a thread outside the pool
+ */
+typedef void (*WZ_JOB_TIMING_HOOK)(const char *name, int worker, uint64_t microseconds);
+
+void wzJobsInitialise();
+/// Wait for the workers to finish what they are doing, run whatever is left here and stop them.
+void wzJobsShutdown();
+/// Number of worker threads, 0 if the pool isn't running.
+int wzJobsWorkerCount();
+void wzJobsSetTimingHook(WZ_JOB_TIMING_HOOK hook);
+
+/// Run a function on the pool. The name must stay valid until the job is finished.
+WZ_JOB *wzJobStart(const char *name, std::function<void ()> function);
+/// Wait for a job, running it here if no worker has started it yet, and free it.
+void wzJobFinish(WZ_JOB *job);
+
+WZ_JOB_QUEUE *wzJobQueueCreate(const char *name);
+void wzJobQueueAdd(WZ_JOB_QUEUE *queue, std::function<void ()> function);
+/// Drop the functions that haven't started, wait for the one running, if any, and free the queue.
+void wzJobQueueDestroy(WZ_JOB_QUEUE *queue);
+
+/** Call function(i) for every i from 0 to count - 1, spread over the pool and this thread, returning once all are done.
+ *  The calls run in no particular order, and at the same time, so they must not touch anything another call writes.
+ */
+void wzParallelFor(const char *name, size_t count, std::function<void (size_t)> const &function);
+
+/** Like wzParallelFor(), with each call returning a Result, then merge(i, result) is called here for each i in order.
+ *  So the outcome is the same however the calls were spread over the threads, as the simulation needs.
+ */
+template <typename Result, typename Function, typename Merge>
+void wzParallelForOrdered(const char *name, size_t count, Function const &function, Merge const &merge)
+{
+	std::vector<Result> results(count);
+	wzParallelFor(name, count, [&results, &function](size_t i) {
+		results[i] = function(i);
+	});
+	for (size_t i = 0; i < count; ++i)
+	{
+		merge(i, std::move(results[i]));
+	}
+}
+
+#endif // __INCLUDED_LIB_FRAMEWORK_WZJOBS_H__
@@ -51,6 +51,12 @@ static uint32_t prevRealTime;
   **/
 static UDWORD	stopCount;
 
+/// Whether the game time ticks as fast as possible, see gameTimeSetFastForward.
+static bool fastForward = false;
+static unsigned fastForwardMaxRate = 0;           ///< Ticks per second of real time, or 0 for no limit.
+static uint32_t fastForwardBaseTime = 0;          ///< The real time fastForwardTicks is counted from.
+static uint64_t fastForwardTicks = 0;             ///< Ticks made since fastForwardBaseTime.
+
 static uint32_t gameQueueTime[MAX_PLAYERS];
 static uint32_t gameQueueCheckTime[MAX_PLAYERS];
 static uint32_t gameQueueCheckCrc[MAX_PLAYERS];
@@ -146,6 +152,22 @@ UDWORD getModularScaledRealTime(UDWORD timePeriod, UDWORD requiredRange)
 }
 
 /* Call this each loop to update the game timer */
+/// Whether the tick rate cap allows another fast-forward tick.
+static bool fastForwardMayTick(uint32_t currTime)
+{
+	if (fastForwardMaxRate == 0)
+	{
+		return true;
+	}
+	uint64_t due = (uint64_t)(currTime - fastForwardBaseTime) * fastForwardMaxRate / GAME_TICKS_PER_SEC;
+	if (due > fastForwardTicks + fastForwardMaxRate)
+	{
+		// More than a second behind, so don't try to catch up with a burst of ticks.
+		fastForwardTicks = due - fastForwardMaxRate;
+	}
+	return fastForwardTicks < due;
+}
+
 void gameTimeUpdate(bool mayUpdate)
 {
 	deltaGameTime = 0;
@@ -169,7 +191,17 @@ void gameTimeUpdate(bool mayUpdate)
 	}
 
 	// Calculate the new game time
-	int newDeltaGraphicsTime = quantiseFraction(modifier.n, modifier.d, currTime, prevRealTime);
+	int newDeltaGraphicsTime;
+	if (fastForward)
+	{
+		// Aim just past the game time, so we tick whenever the other players and the tick rate cap allow it.
+		newDeltaGraphicsTime = gameTime - graphicsTime + (fastForwardMayTick(currTime) ? 1 : 0);
+		mayUpdate = true;
+	}
+	else
+	{
+		newDeltaGraphicsTime = quantiseFraction(modifier.n, modifier.d, currTime, prevRealTime);
+	}
 	ASSERT(newDeltaGraphicsTime >= 0, "Something very wrong.");
 
 	uint32_t newGraphicsTime = graphicsTime + newDeltaGraphicsTime;
@@ -206,6 +238,14 @@ void gameTimeUpdate(bool mayUpdate)
 	// Adjust deltas.
 	if (newGraphicsTime > gameTime)
 	{
+		if (fastForward)
+		{
+			// Let the graphics time trail the game time by a tick, since nothing is drawn in between.
+			graphicsTime = gameTime;
+			prevRealTime = currTime;
+			++fastForwardTicks;
+		}
+
 		// Update the game time.
 		deltaGameTime = GAME_TICKS_PER_UPDATE;
 		gameTime += deltaGameTime;
@@ -275,6 +315,14 @@ Rational gameTimeGetMod()
 	return modifier;
 }
 
+void gameTimeSetFastForward(bool enabled, unsigned maxTicksPerSecond)
+{
+	fastForward = enabled;
+	fastForwardMaxRate = maxTicksPerSecond;
+	fastForwardBaseTime = wzGetTicks();
+	fastForwardTicks = 0;
+}
+
 bool gameTimeIsStopped(void)
 {
 	return stopCount != 0;
@@ -99,6 +99,13 @@ void gameTimeSetMod(Rational mod);
 /** Get the current time modifier. */
 Rational gameTimeGetMod();
 
+/**
+ * Tick the game time as fast as the caller can update the game state, instead of following the real time.
+ * If maxTicksPerSecond is non-zero, no more than that many ticks are made per second of real time.
+ * Only meant for headless games, since the graphics time just trails the game time.
+ */
+void gameTimeSetFastForward(bool enabled, unsigned maxTicksPerSecond);
+
 /**
  * Returns the game time, modulo the time period, scaled to 0..requiredRange.
  * For instance getModularScaledGameTime(4096,256) will return a number that cycles through the values
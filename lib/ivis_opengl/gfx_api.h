@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <map>
@@ -217,12 +218,19 @@ namespace gfx_api
 		{}
 	};
 
+	enum class vertex_input_rate
+	{
+		per_vertex,
+		per_instance,
+	};
+
 	struct vertex_buffer
 	{
 		const std::size_t stride;
 		const std::vector<vertex_buffer_input> attributes;
-		vertex_buffer(std::size_t _stride, std::vector<vertex_buffer_input>&& _attributes)
-		: stride(_stride), attributes(std::forward<std::vector<vertex_buffer_input>>(_attributes))
+		const vertex_input_rate rate;
+		vertex_buffer(std::size_t _stride, std::vector<vertex_buffer_input>&& _attributes, vertex_input_rate _rate = vertex_input_rate::per_vertex)
+		: stride(_stride), attributes(std::forward<std::vector<vertex_buffer_input>>(_attributes)), rate(_rate)
 		{}
 	};
 
@@ -297,6 +305,8 @@ namespace gfx_api
 		virtual void set_uniforms(const size_t& first, const std::vector<std::tuple<const void*, size_t>>& uniform_blocks) = 0;
 		virtual void draw(const std::size_t& offset, const std::size_t&, const primitive_type&) = 0;
 		virtual void draw_elements(const std::size_t& offset, const std::size_t&, const primitive_type&, const index_type&) = 0;
+		virtual void draw_elements_instanced(const std::size_t& offset, const std::size_t&, const primitive_type&, const index_type&, const std::size_t& instance_count) = 0;
+		virtual bool supports_instanced_rendering() const = 0;
 		virtual void set_polygon_offset(const float& offset, const float& slope) = 0;
 		virtual void set_depth_range(const float& min, const float& max) = 0;
 		virtual int32_t get_context_value(const context_value property) = 0;
@@ -347,6 +357,19 @@ namespace gfx_api
 		}
 	};
 
+	/**
+	 * Same as vertex_buffer_description, but the attributes advance once per instance
+	 * instead of once per vertex.
+	 */
+	template<std::size_t stride, typename... input_description>
+	struct instanced_vertex_buffer_description
+	{
+		static vertex_buffer get_desc()
+		{
+			return { stride, { input_description::get_desc()...}, vertex_input_rate::per_instance };
+		}
+	};
+
 	template<std::size_t texture_unit, sampler_type sampler>
 	struct texture_description
 	{
@@ -436,6 +459,11 @@ namespace gfx_api
 		{
 			context::get().draw_elements(offset, count, primitive, index);
 		}
+
+		void draw_elements_instanced(const std::size_t& count, const std::size_t& offset, const std::size_t& instance_count)
+		{
+			context::get().draw_elements_instanced(offset, count, primitive, index, instance_count);
+		}
 	private:
 		pipeline_state_object* pso;
 		pipeline_state_helper()
@@ -475,6 +503,12 @@ namespace gfx_api
 	constexpr std::size_t color = 2;
 	constexpr std::size_t normal = 3;
 	constexpr std::size_t tangent = 4;
+	// per-instance attributes (a mat4 occupies four consecutive locations)
+	constexpr std::size_t instance_modelview = 5;
+	constexpr std::size_t instance_normal = 9;
+	constexpr std::size_t instance_colour = 13;
+	constexpr std::size_t instance_teamcolour = 14;
+	constexpr std::size_t instance_params = 15;
 
 	using notexture = std::tuple<>;
 
@@ -628,6 +662,51 @@ namespace gfx_api
 	using Draw3DShapeNoLightPremul = Draw3DShape<REND_PREMULTIPLIED, SHADER_NOLIGHT>;
 	using Draw3DShapeNoLightAdditive = Draw3DShape<REND_ADDITIVE, SHADER_NOLIGHT>;
 
+	// Per-instance vertex data for the instanced opaque model path
+	// (replaces Draw3DShapePerInstanceUniforms; must match the layout of Draw3DShapeInstanced below)
+	struct Draw3DShapeInstanceData
+	{
+		glm::mat4 ModelViewMatrix;
+		glm::mat4 NormalMatrix;
+		PIELIGHT colour;
+		PIELIGHT teamcolour;
+		glm::vec4 params; // x: shaderStretch, y: ecmState, z: alphaTest, w: unused
+	};
+
+	template<REND_MODE render_mode, SHADER_MODE shader>
+	using Draw3DShapeInstanced = typename gfx_api::pipeline_state_helper<rasterizer_state<render_mode, DEPTH_CMP_LEQ_WRT_ON, 255, polygon_offset::disabled, stencil_mode::stencil_disabled, cull_mode::back>, primitive_type::triangles, index_type::u16,
+	std::tuple<
+	Draw3DShapeGlobalUniforms,
+	Draw3DShapePerMeshUniforms
+	>,
+	std::tuple<
+	vertex_buffer_description<12, vertex_attribute_description<position, gfx_api::vertex_attribute_type::float3, 0>>,
+	vertex_buffer_description<12, vertex_attribute_description<normal, gfx_api::vertex_attribute_type::float3, 0>>,
+	vertex_buffer_description<8, vertex_attribute_description<texcoord, gfx_api::vertex_attribute_type::float2, 0>>,
+	vertex_buffer_description<16, vertex_attribute_description<tangent, gfx_api::vertex_attribute_type::float4, 0>>,
+	instanced_vertex_buffer_description<sizeof(Draw3DShapeInstanceData),
+		vertex_attribute_description<instance_modelview + 0, gfx_api::vertex_attribute_type::float4, offsetof(Draw3DShapeInstanceData, ModelViewMatrix) + 0 * sizeof(glm::vec4)>,
+		vertex_attribute_description<instance_modelview + 1, gfx_api::vertex_attribute_type::float4, offsetof(Draw3DShapeInstanceData, ModelViewMatrix) + 1 * sizeof(glm::vec4)>,
+		vertex_attribute_description<instance_modelview + 2, gfx_api::vertex_attribute_type::float4, offsetof(Draw3DShapeInstanceData, ModelViewMatrix) + 2 * sizeof(glm::vec4)>,
+		vertex_attribute_description<instance_modelview + 3, gfx_api::vertex_attribute_type::float4, offsetof(Draw3DShapeInstanceData, ModelViewMatrix) + 3 * sizeof(glm::vec4)>,
+		vertex_attribute_description<instance_normal + 0, gfx_api::vertex_attribute_type::float4, offsetof(Draw3DShapeInstanceData, NormalMatrix) + 0 * sizeof(glm::vec4)>,
+		vertex_attribute_description<instance_normal + 1, gfx_api::vertex_attribute_type::float4, offsetof(Draw3DShapeInstanceData, NormalMatrix) + 1 * sizeof(glm::vec4)>,
+		vertex_attribute_description<instance_normal + 2, gfx_api::vertex_attribute_type::float4, offsetof(Draw3DShapeInstanceData, NormalMatrix) + 2 * sizeof(glm::vec4)>,
+		vertex_attribute_description<instance_normal + 3, gfx_api::vertex_attribute_type::float4, offsetof(Draw3DShapeInstanceData, NormalMatrix) + 3 * sizeof(glm::vec4)>,
+		vertex_attribute_description<instance_colour, gfx_api::vertex_attribute_type::u8x4_norm, offsetof(Draw3DShapeInstanceData, colour)>,
+		vertex_attribute_description<instance_teamcolour, gfx_api::vertex_attribute_type::u8x4_norm, offsetof(Draw3DShapeInstanceData, teamcolour)>,
+		vertex_attribute_description<instance_params, gfx_api::vertex_attribute_type::float4, offsetof(Draw3DShapeInstanceData, params)>
+	>
+	>,
+	std::tuple<
+	texture_description<0, sampler_type::anisotropic>, // diffuse
+	texture_description<1, sampler_type::bilinear>, // team color mask
+	texture_description<2, sampler_type::anisotropic>, // normal map
+	texture_description<3, sampler_type::anisotropic> // specular map
+	>, shader>;
+
+	using Draw3DShapeInstancedOpaque = Draw3DShapeInstanced<REND_OPAQUE, SHADER_COMPONENT_INSTANCED>;
+
 	template<>
 	struct constant_buffer_type<SHADER_GENERIC_COLOR>
 	{
@@ -307,6 +307,15 @@ static const std::map<SHADER_MODE, program_data> shader_to_file_table =
 			"ModelViewMatrix", "NormalMatrix", "colour", "teamcolour", "stretch", "ecmEffect", "alphaTest"
 		} }),
 
+	std::make_pair(SHADER_COMPONENT_INSTANCED, program_data{ "Instanced component program", "shaders/tcmask_instanced.vert", "shaders/tcmask_instanced.frag",
+		{
+			// per-frame global uniforms
+			"ProjectionMatrix", "lightPosition", "sceneColor", "ambient", "diffuse", "specular", "fogColor", "fogEnd", "fogStart", "graphicsCycle", "fogEnabled",
+			// per-mesh uniforms
+			"tcmask", "normalmap", "specularmap", "hasTangents"
+			// (per-instance values are vertex attributes)
+		} }),
+
 	std::make_pair(SHADER_BUTTON, program_data{ "Button program", "shaders/button.vert", "shaders/button.frag",
 		{
 			// per-frame global uniforms
@@ -915,6 +924,12 @@ void gl_pipeline_state_object::build_program(bool fragmentHighpFloatAvailable, b
 	glBindAttribLocation(program, 2, "vertexColor");
 	glBindAttribLocation(program, 3, "vertexNormal");
 	glBindAttribLocation(program, 4, "vertexTangent");
+	// per-instance attributes (only present in the instanced programs)
+	glBindAttribLocation(program, 5, "instanceModelViewMatrix"); // 5-8
+	glBindAttribLocation(program, 9, "instanceNormalMatrix"); // 9-12
+	glBindAttribLocation(program, 13, "instanceColour");
+	glBindAttribLocation(program, 14, "instanceTeamColour");
+	glBindAttribLocation(program, 15, "instanceParams");
 	ASSERT_OR_RETURN(, program, "Could not create shader program!");
 
 	char* vertexShaderContents = nullptr;
@@ -1442,6 +1457,12 @@ void gl_context::bind_vertex_buffers(const std::size_t& first, const std::vector
 		{
 			enableVertexAttribArray(static_cast<GLuint>(attribute.id));
 			glVertexAttribPointer(static_cast<GLuint>(attribute.id), get_size(attribute.type), get_type(attribute.type), get_normalisation(attribute.type), static_cast<GLsizei>(buffer_desc.stride), reinterpret_cast<void*>(attribute.offset + std::get<1>(vertex_buffers_offset[i])));
+			if (buffer_desc.rate == gfx_api::vertex_input_rate::per_instance)
+			{
+				// Attribute locations used for per-instance data are never used for per-vertex data,
+				// so the divisor does not need to be reset afterwards
+				glVertexAttribDivisor(static_cast<GLuint>(attribute.id), 1);
+			}
 		}
 	}
 }
@@ -1591,6 +1612,19 @@ void gl_context::draw_elements(const size_t& offset, const size_t &count, const
 	glDrawElements(to_gl(primitive), static_cast<GLsizei>(count), to_gl(index), reinterpret_cast<void*>(offset));
 }
 
+void gl_context::draw_elements_instanced(const size_t& offset, const size_t &count, const gfx_api::primitive_type &primitive, const gfx_api::index_type& index, const size_t& instance_count)
+{
+	ASSERT_OR_RETURN(, instancedRendering, "Instanced rendering is not supported by this context");
+	ASSERT(count <= static_cast<size_t>(std::numeric_limits<GLsizei>::max()), "count (%zu) exceeds GLsizei max", count);
+	ASSERT(instance_count <= static_cast<size_t>(std::numeric_limits<GLsizei>::max()), "instance_count (%zu) exceeds GLsizei max", instance_count);
+	glDrawElementsInstanced(to_gl(primitive), static_cast<GLsizei>(count), to_gl(index), reinterpret_cast<void*>(offset), static_cast<GLsizei>(instance_count));
+}
+
+bool gl_context::supports_instanced_rendering() const
+{
+	return instancedRendering;
+}
+
 void gl_context::set_polygon_offset(const float& offset, const float& slope)
 {
 	glPolygonOffset(offset, slope);
@@ -1943,6 +1977,39 @@ bool gl_context::_initialize(const gfx_api::backend_Impl_Factory& impl, int32_t
 	return true;
 }
 
+bool gl_context::initInstancedRendering(GLADloadproc func_GLGetProcAddress, GLint maxVertexAttribs)
+{
+	// The instanced programs use vertex attribute locations 0-15
+	if (maxVertexAttribs < 16)
+	{
+		return false;
+	}
+
+	if (gles)
+	{
+		// Core in OpenGL ES 3.0 (loaded by glad)
+		return GLAD_GL_ES_VERSION_3_0 && glDrawElementsInstanced && glVertexAttribDivisor;
+	}
+
+	// Core in OpenGL 3.3, which is newer than the desktop profile glad was generated for,
+	// so the entrypoints have to be fetched directly
+	GLint gl_majorversion = wz_GetGLIntegerv(GL_MAJOR_VERSION, 0);
+	GLint gl_minorversion = wz_GetGLIntegerv(GL_MINOR_VERSION, 0);
+	if ((gl_majorversion < 3) || ((gl_majorversion == 3) && (gl_minorversion < 3)))
+	{
+		return false;
+	}
+	if (!glDrawElementsInstanced)
+	{
+		glad_glDrawElementsInstanced = (PFNGLDRAWELEMENTSINSTANCEDPROC)func_GLGetProcAddress("glDrawElementsInstanced");
+	}
+	if (!glVertexAttribDivisor)
+	{
+		glad_glVertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORPROC)func_GLGetProcAddress("glVertexAttribDivisor");
+	}
+	return glDrawElementsInstanced && glVertexAttribDivisor;
+}
+
 bool gl_context::initGLContext()
 {
 	frameNum = 1;
@@ -2129,6 +2196,9 @@ bool gl_context::initGLContext()
 	}
 	enabledVertexAttribIndexes.resize(static_cast<size_t>(glmaxVertexAttribs), false);
 
+	instancedRendering = initInstancedRendering(func_GLGetProcAddress, glmaxVertexAttribs);
+	debug(LOG_3D, "  * Instanced rendering %s supported", instancedRendering ? "is" : "is NOT");
+
 	if (GLAD_GL_VERSION_3_0) // if context is OpenGL 3.0+
 	{
 		// Very simple VAO code - just bind a single global VAO (this gets things working, but is not optimal)
@@ -172,6 +172,7 @@ struct gl_context final : public gfx_api::context
 	bool gles = false;
 	bool fragmentHighpFloatAvailable = true;
 	bool fragmentHighpIntAvailable = true;
+	bool instancedRendering = false;
 
 	gl_context(bool _debug) : khr_debug(_debug) {}
 	~gl_context();
@@ -197,6 +198,8 @@ struct gl_context final : public gfx_api::context
 	virtual void set_uniforms(const size_t& first, const std::vector<std::tuple<const void*, size_t>>& uniform_blocks) override;
 	virtual void draw(const size_t& offset, const size_t &count, const gfx_api::primitive_type &primitive) override;
 	virtual void draw_elements(const size_t& offset, const size_t &count, const gfx_api::primitive_type &primitive, const gfx_api::index_type& index) override;
+	virtual void draw_elements_instanced(const size_t& offset, const size_t &count, const gfx_api::primitive_type &primitive, const gfx_api::index_type& index, const size_t& instance_count) override;
+	virtual bool supports_instanced_rendering() const override;
 	virtual void set_polygon_offset(const float& offset, const float& slope) override;
 	virtual void set_depth_range(const float& min, const float& max) override;
 	virtual int32_t get_context_value(const context_value property) override;
@@ -223,6 +226,7 @@ private:
 	virtual bool _initialize(const gfx_api::backend_Impl_Factory& impl, int32_t antialiasing, swap_interval_mode mode) override;
 private:
 	bool initGLContext();
+	bool initInstancedRendering(GLADloadproc func_GLGetProcAddress, GLint maxVertexAttribs);
 	void enableVertexAttribArray(GLuint index);
 	void disableVertexAttribArray(GLuint index);
 	std::string calculateFormattedRendererInfoString() const;
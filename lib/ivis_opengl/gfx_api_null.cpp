@@ -216,12 +216,27 @@ void null_context::set_uniforms(const size_t& first, const std::vector<std::tupl
 
 void null_context::draw(const size_t& offset, const size_t &count, const gfx_api::primitive_type &primitive)
 {
-	// no-op
+	// nothing is drawn, but keep track of how many draw calls the renderer issues
+	++drawCalls.calls;
+	++drawCalls.instances;
 }
 
 void null_context::draw_elements(const size_t& offset, const size_t &count, const gfx_api::primitive_type &primitive, const gfx_api::index_type& index)
 {
-	// no-op
+	++drawCalls.calls;
+	++drawCalls.instances;
+}
+
+void null_context::draw_elements_instanced(const size_t& offset, const size_t &count, const gfx_api::primitive_type &primitive, const gfx_api::index_type& index, const size_t& instance_count)
+{
+	++drawCalls.calls;
+	++drawCalls.instancedCalls;
+	drawCalls.instances += instance_count;
+}
+
+bool null_context::supports_instanced_rendering() const
+{
+	return true;
 }
 
 void null_context::set_polygon_offset(const float& offset, const float& slope)
@@ -303,6 +318,9 @@ std::map<std::string, std::string> null_context::getBackendGameInfo()
 {
 	std::map<std::string, std::string> backendGameInfo;
 	backendGameInfo["null_gfx_backend"] = true;
+	backendGameInfo["null_gfx_draw_calls"] = std::to_string(lastFrameDrawCalls.calls);
+	backendGameInfo["null_gfx_instanced_draw_calls"] = std::to_string(lastFrameDrawCalls.instancedCalls);
+	backendGameInfo["null_gfx_instances"] = std::to_string(lastFrameDrawCalls.instances);
 	return backendGameInfo;
 }
 
@@ -340,6 +358,9 @@ void null_context::flip(int clearMode)
 {
 	frameNum = std::max<size_t>(frameNum + 1, 1);
 
+	lastFrameDrawCalls = drawCalls;
+	drawCalls = DrawCallStats();
+
 	// Backend is expected to handle throttling / sleeping
 	backend_impl->swapWindow();
 
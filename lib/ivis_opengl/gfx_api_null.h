@@ -106,6 +106,8 @@ public:
 	virtual void set_uniforms(const size_t& first, const std::vector<std::tuple<const void*, size_t>>& uniform_blocks) override;
 	virtual void draw(const size_t& offset, const size_t &count, const gfx_api::primitive_type &primitive) override;
 	virtual void draw_elements(const size_t& offset, const size_t &count, const gfx_api::primitive_type &primitive, const gfx_api::index_type& index) override;
+	virtual void draw_elements_instanced(const size_t& offset, const size_t &count, const gfx_api::primitive_type &primitive, const gfx_api::index_type& index, const size_t& instance_count) override;
+	virtual bool supports_instanced_rendering() const override;
 	virtual void set_polygon_offset(const float& offset, const float& slope) override;
 	virtual void set_depth_range(const float& min, const float& max) override;
 	virtual int32_t get_context_value(const context_value property) override;
@@ -130,7 +132,18 @@ public:
 	virtual gfx_api::context::swap_interval_mode getSwapInterval() const override;
 private:
 	virtual bool _initialize(const gfx_api::backend_Impl_Factory& impl, int32_t antialiasing, swap_interval_mode mode) override;
+public:
+	/// Draw calls issued during a frame (nothing is rendered, but this shows how well the renderer batches)
+	struct DrawCallStats
+	{
+		size_t calls = 0;			///< total number of draw calls
+		size_t instancedCalls = 0;	///< draw calls that drew several instances at once
+		size_t instances = 0;		///< number of meshes / primitives drawn by those calls
+	};
+	const DrawCallStats& getLastFrameDrawCalls() const { return lastFrameDrawCalls; }
 private:
 
 	size_t frameNum = 0;
+	DrawCallStats drawCalls;
+	DrawCallStats lastFrameDrawCalls;
 };
@@ -792,6 +792,7 @@ struct shader_infos
 static const std::map<SHADER_MODE, shader_infos> spv_files
 {
 	std::make_pair(SHADER_COMPONENT, shader_infos{ "shaders/vk/tcmask.vert.spv", "shaders/vk/tcmask.frag.spv" }),
+	std::make_pair(SHADER_COMPONENT_INSTANCED, shader_infos{ "shaders/vk/tcmask_instanced.vert.spv", "shaders/vk/tcmask_instanced.frag.spv" }),
 	std::make_pair(SHADER_BUTTON, shader_infos{ "shaders/vk/button.vert.spv", "shaders/vk/button.frag.spv" }),
 	std::make_pair(SHADER_NOLIGHT, shader_infos{ "shaders/vk/nolight.vert.spv", "shaders/vk/nolight.frag.spv" }),
 	std::make_pair(SHADER_TERRAIN, shader_infos{ "shaders/vk/terrain.vert.spv", "shaders/vk/terrain.frag.spv" }),
@@ -1242,7 +1243,7 @@ VkPSO::VkPSO(vk::Device _dev,
 			vk::VertexInputBindingDescription()
 			.setBinding(buffer_id)
 			.setStride(static_cast<uint32_t>(buffer.stride))
-			.setInputRate(vk::VertexInputRate::eVertex)
+			.setInputRate((buffer.rate == gfx_api::vertex_input_rate::per_instance) ? vk::VertexInputRate::eInstance : vk::VertexInputRate::eVertex)
 		);
 		for (const auto& attribute : buffer.attributes)
 		{
@@ -1447,7 +1448,7 @@ size_t VkTexture::format_size(const vk::Format& format)
 }
 
 VkTexture::VkTexture(const VkRoot& root, const std::size_t& mipmap_count, const std::size_t& width, const std::size_t& height, const vk::Format& _internal_format, const std::string& filename)
-	: dev(root.dev), internal_format(_internal_format), mipmap_levels(mipmap_count), root(&root)
+	: dev(root.dev), internal_format(_internal_format), mipmap_levels(mipmap_count), mip_level_uploaded(mipmap_count, false), root(&root)
 {
 	ASSERT(width > 0 && height > 0, "0 width/height textures are unsupported");
 	ASSERT(width <= static_cast<size_t>(std::numeric_limits<uint32_t>::max()), "width (%zu) exceeds uint32_t max", width);
@@ -1500,6 +1501,7 @@ void VkTexture::bind() {}
 void VkTexture::upload(const std::size_t& mip_level, const std::size_t& offset_x, const std::size_t& offset_y, const std::size_t& width, const std::size_t& height, const gfx_api::pixel_format& buffer_format, const void* data)
 {
 	ASSERT(width > 0 && height > 0, "Attempt to upload texture with width or height of 0 (width: %zu, height: %zu)", width, height);
+	ASSERT_OR_RETURN(, mip_level < mipmap_levels, "mip_level (%zu) exceeds the texture's %zu levels", mip_level, mipmap_levels);
 
 	ASSERT(mip_level <= static_cast<size_t>(std::numeric_limits<uint32_t>::max()), "mip_level (%zu) exceeds uint32_t max", mip_level);
 	ASSERT(offset_x <= static_cast<size_t>(std::numeric_limits<uint32_t>::max()), "offset_x (%zu) exceeds uint32_t max", offset_x);
@@ -1544,17 +1546,21 @@ void VkTexture::upload(const std::size_t& mip_level, const std::size_t& offset_x
 
 	frameResources.stagingBufferAllocator.unmapMemory(stagingMemory);
 
+	// The first upload to a mip level may discard its (undefined) contents, later ones update part of it and must keep the rest
+	const bool keepContents = mip_level_uploaded[mip_level];
+	mip_level_uploaded[mip_level] = true;
+
 	const auto& cmdBuffer = buffering_mechanism::get_current_resources().cmdCopy;
 	const auto imageMemoryBarriers_BeforeCopy = std::array<vk::ImageMemoryBarrier, 1> {
 		vk::ImageMemoryBarrier()
 			.setImage(object)
 			.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, static_cast<uint32_t>(mip_level), 1, 0, 1))
-			.setOldLayout(vk::ImageLayout::eUndefined)
+			.setOldLayout(keepContents ? vk::ImageLayout::eShaderReadOnlyOptimal : vk::ImageLayout::eUndefined)
 			.setNewLayout(vk::ImageLayout::eTransferDstOptimal)
 			.setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
 	};
 	// TODO: Should this be eBottomOfPipe, eTopOfPipe, or something else? // FIXME
-	cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+	cmdBuffer.pipelineBarrier(keepContents ? vk::PipelineStageFlagBits::eFragmentShader : vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
 		vk::DependencyFlags(), nullptr, nullptr, imageMemoryBarriers_BeforeCopy, root->vkDynLoader);
 	const auto bufferImageCopyRegions = std::array<vk::BufferImageCopy, 1> {
 		vk::BufferImageCopy()
@@ -3079,6 +3085,20 @@ void VkRoot::draw_elements(const std::size_t& offset, const std::size_t& count,
 	buffering_mechanism::get_current_resources().cmdDraw.drawIndexed(static_cast<uint32_t>(count), 1, static_cast<uint32_t>(offset) >> 2, 0, 0, vkDynLoader);
 }
 
+void VkRoot::draw_elements_instanced(const std::size_t& offset, const std::size_t& count, const gfx_api::primitive_type&, const gfx_api::index_type&, const std::size_t& instance_count)
+{
+	ASSERT_OR_RETURN(, currentPSO != nullptr, "currentPSO == NULL");
+	ASSERT(offset <= static_cast<size_t>(std::numeric_limits<uint32_t>::max()), "offset (%zu) exceeds uint32_t max", offset);
+	ASSERT(count <= static_cast<size_t>(std::numeric_limits<uint32_t>::max()), "count (%zu) exceeds uint32_t max", count);
+	ASSERT(instance_count <= static_cast<size_t>(std::numeric_limits<uint32_t>::max()), "instance_count (%zu) exceeds uint32_t max", instance_count);
+	buffering_mechanism::get_current_resources().cmdDraw.drawIndexed(static_cast<uint32_t>(count), static_cast<uint32_t>(instance_count), static_cast<uint32_t>(offset) >> 2, 0, 0, vkDynLoader);
+}
+
+bool VkRoot::supports_instanced_rendering() const
+{
+	return true; // core Vulkan
+}
+
 void VkRoot::bind_vertex_buffers(const std::size_t& first, const std::vector<std::tuple<gfx_api::buffer*, std::size_t>>& vertex_buffers_offset)
 {
 	ASSERT_OR_RETURN(, currentPSO != nullptr, "currentPSO == NULL");
@@ -372,7 +372,7 @@ struct VkTexture final : public gfx_api::texture
 	VmaAllocation allocation = VK_NULL_HANDLE;
 	vk::Format internal_format;
 	size_t mipmap_levels;
-
+	std::vector<bool> mip_level_uploaded;	///< whether each mip level holds texels that later partial uploads must keep
 
 	static size_t format_size(const gfx_api::pixel_format& format);
 
@@ -496,6 +496,8 @@ public:
 
 	virtual void draw(const std::size_t& offset, const std::size_t& count, const gfx_api::primitive_type&) override;
 	virtual void draw_elements(const std::size_t& offset, const std::size_t& count, const gfx_api::primitive_type&, const gfx_api::index_type&) override;
+	virtual void draw_elements_instanced(const std::size_t& offset, const std::size_t& count, const gfx_api::primitive_type&, const gfx_api::index_type&, const std::size_t& instance_count) override;
+	virtual bool supports_instanced_rendering() const override;
 	virtual void bind_vertex_buffers(const std::size_t& first, const std::vector<std::tuple<gfx_api::buffer*, std::size_t>>& vertex_buffers_offset) override;
 	virtual void unbind_vertex_buffers(const std::size_t& first, const std::vector<std::tuple<gfx_api::buffer*, std::size_t>>& vertex_buffers_offset) override;
 	virtual void disable_all_vertex_buffers() override;
@@ -25,6 +25,7 @@
 #include <string.h>
 
 #include "lib/framework/frame.h"
+#include "lib/framework/wzjobs.h"
 #include "lib/ivis_opengl/ivisdef.h"
 #include "lib/ivis_opengl/imd.h"
 #include "lib/ivis_opengl/piefunc.h"
@@ -127,6 +128,8 @@ static std::vector<ShadowcastingShape> scshapes;
 static std::vector<SHAPE> tshapes;
 static std::vector<SHAPE> shapes;
 static gfx_api::buffer* pZeroedVertexBuffer = nullptr;
+static gfx_api::buffer* pInstanceBuffer = nullptr;
+static std::vector<gfx_api::Draw3DShapeInstanceData> instanceData;
 
 static gfx_api::buffer* getZeroedVertexBuffer(size_t size)
 {
@@ -490,6 +493,11 @@ namespace std {
 	};
 }
 
+/// How many frames an unused shadow volume stays in the cache
+static const uint64_t SHADOW_CACHE_MAX_AGE = 150;
+/// Steps per unit of the (normalised) light direction used as the cache key
+static const float SHADOW_LIGHT_QUANTIZATION = 256.f;
+
 struct ShadowCache {
 
 	struct CachedShadowData {
@@ -574,7 +582,7 @@ struct ShadowCache {
 			std::vector<ShadowDrawParametersToCachedDataMap::iterator> unusedBuffersForShape;
 			for (auto it_shadowDrawParams = it_shape->second.begin(); it_shadowDrawParams != it_shape->second.end(); ++it_shadowDrawParams)
 			{
-				if (it_shadowDrawParams->second.lastQueriedFrameCount != _currentFrame)
+				if (_currentFrame - it_shadowDrawParams->second.lastQueriedFrameCount > SHADOW_CACHE_MAX_AGE)
 				{
 					unusedBuffersForShape.push_back(it_shadowDrawParams);
 				}
@@ -602,119 +610,164 @@ private:
 	std::vector<Vector3f> vertexes;
 };
 
-enum DrawShadowResult {
-	DRAW_SUCCESS_CACHED,
-	DRAW_SUCCESS_UNCACHED
+/**
+ * Snap an object space light vector to a grid, so that the shadow volume of an object can be reused
+ * across frames despite the small float differences caused by the camera moving.
+ * The snapped light is used for both the cache key and the extrusion, so a cached volume is exactly
+ * what would have been computed for its key.
+ */
+static glm::vec4 quantizeShadowLight(const glm::vec4 &light)
+{
+	const glm::vec3 direction(light);
+	const float length = glm::length(direction);
+	if (length <= 0.f)
+	{
+		return glm::vec4(0.f);
+	}
+	const glm::vec3 scaled = direction / length * SHADOW_LIGHT_QUANTIZATION;
+	const glm::vec3 quantized = glm::vec3(std::round(scaled.x), std::round(scaled.y), std::round(scaled.z)) / SHADOW_LIGHT_QUANTIZATION;
+	return glm::vec4(quantized * std::round(length), 0.f);
+}
+
+/// Per-thread scratch space for silhouette extraction, to save allocations
+struct ShadowScratch
+{
+	std::vector<glm::vec3> points;
+	std::vector<float> normalX, normalY, normalZ;
+	std::vector<uint8_t> facing;
+	std::vector<EDGE> edgelist;
+	std::vector<EDGE> edgelistFlipped;
+	std::vector<EDGE> edgelistFiltered;
 };
 
-/// Draw the shadow for a shape
-/// Prequisite:
-///		Caller must call the following before all calls to pie_DrawShadow():
-///			const auto &program = pie_ActivateShader(SHADER_GENERIC_COLOR, pie_PerspectiveGet(), glm::vec4());
-///			glEnableVertexAttribArray(program.locVertex);
-///		and must call the following after all calls to pie_DrawShadow():
-///			glDisableVertexAttribArray(program.locVertex);
-///			pie_DeactivateShader();
-///		The only place this is currently called is pie_ShadowDrawLoop(), which handles this properly.
-static inline DrawShadowResult pie_DrawShadow(ShadowCache &shadowCache, iIMDShape *shape, int flag, int flag_data, const glm::vec4 &light, const glm::mat4 &modelViewMatrix)
+/**
+ * Find the silhouette of a shape as seen from the light: the edges of the faces turned towards the light
+ * which are not shared with another such face. The result is left in scratch.edgelistFiltered.
+ */
+static void pie_ShadowSilhouette(ShadowScratch &scratch, const iIMDShape *shape, int flag, int flag_data, const glm::vec4 &light)
 {
-	static std::vector<EDGE> edgelist;  // Static, to save allocations.
-	static std::vector<EDGE> edgelistFlipped;  // Static, to save allocations.
-	static std::vector<EDGE> edgelistFiltered;  // Static, to save allocations.
-	EDGE *drawlist = nullptr;
+	const std::vector<Vector3f> &vertices = *shape->pShadowPoints;
+	const std::vector<iIMDPoly> &polys = *shape->pShadowPolys;
+	const size_t numPolys = polys.size();
 
-	size_t edge_count;
-	DrawShadowResult result;
+	scratch.points.resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		scratch.points[i] = glm::vec3(vertices[i].x, scale_y(vertices[i].y, flag, flag_data), vertices[i].z);
+	}
 
-	// Find cached data (if available)
-	// Note: The modelViewMatrix is not used for calculating the sorted / filtered vertices, so it's not included
-	const ShadowCache::CachedShadowData *pCached = shadowCache.findCacheForShadowDraw(shape, flag, flag_data, light);
-	if (pCached == nullptr)
+	// Face normals as a structure of arrays, so the orientation test below is a straight loop the compiler can vectorise
+	scratch.normalX.resize(numPolys);
+	scratch.normalY.resize(numPolys);
+	scratch.normalZ.resize(numPolys);
+	for (size_t i = 0; i < numPolys; ++i)
 	{
-		const Vector3f *pVertices = shape->pShadowPoints->data();
-		if (flag & pie_STATIC_SHADOW && shape->shadowEdgeList)
-		{
-			drawlist = shape->shadowEdgeList;
-			edge_count = shape->nShadowEdges;
-		}
-		else
+		const glm::vec3 &p0 = scratch.points[polys[i].pindex[0]];
+		const glm::vec3 normal = glm::cross(scratch.points[polys[i].pindex[2]] - p0, scratch.points[polys[i].pindex[1]] - p0);
+		scratch.normalX[i] = normal.x;
+		scratch.normalY[i] = normal.y;
+		scratch.normalZ[i] = normal.z;
+	}
+	scratch.facing.resize(numPolys);
+	const float *nx = scratch.normalX.data(), *ny = scratch.normalY.data(), *nz = scratch.normalZ.data();
+	uint8_t *facing = scratch.facing.data();
+	const float lx = light.x, ly = light.y, lz = light.z;
+	for (size_t i = 0; i < numPolys; ++i)
+	{
+		facing[i] = nx[i] * lx + ny[i] * ly + nz[i] * lz > 0.0f;
+	}
+
+	scratch.edgelist.clear();
+	for (size_t i = 0; i < numPolys; ++i)
+	{
+		if (facing[i])
 		{
-			edgelist.clear();
-			glm::vec3 p[3];
-			for (const iIMDPoly &poly : *(shape->pShadowPolys))
+			for (int n = 0; n < 3; ++n)
 			{
-				for (int j = 0; j < 3; ++j)
-				{
-					uint32_t current = poly.pindex[j];
-					p[j] = glm::vec3(pVertices[current].x, scale_y(pVertices[current].y, flag, flag_data), pVertices[current].z);
-				}
-				if (glm::dot(glm::cross(p[2] - p[0], p[1] - p[0]), glm::vec3(light)) > 0.0f)
-				{
-					for (int n = 0; n < 3; ++n)
-					{
-						// Add the edges
-						edgelist.push_back({poly.pindex[n], poly.pindex[(n + 1)%3]});
-					}
-				}
+				// Add the edges
+				scratch.edgelist.push_back({polys[i].pindex[n], polys[i].pindex[(n + 1)%3]});
 			}
+		}
+	}
+
+	// Remove duplicate pairs from the edge list. For example, in the list ((1 2), (2 6), (6 2), (3, 4)), remove (2 6) and (6 2).
+	scratch.edgelistFlipped = scratch.edgelist;
+	std::for_each(scratch.edgelistFlipped.begin(), scratch.edgelistFlipped.end(), flipEdge);
+	std::sort(scratch.edgelist.begin(), scratch.edgelist.end(), edgeLessThan);
+	std::sort(scratch.edgelistFlipped.begin(), scratch.edgelistFlipped.end(), edgeLessThan);
+	scratch.edgelistFiltered.resize(scratch.edgelist.size());
+	scratch.edgelistFiltered.erase(std::set_difference(scratch.edgelist.begin(), scratch.edgelist.end(), scratch.edgelistFlipped.begin(), scratch.edgelistFlipped.end(), scratch.edgelistFiltered.begin(), edgeLessThan), scratch.edgelistFiltered.end());
+}
 
-			// Remove duplicate pairs from the edge list. For example, in the list ((1 2), (2 6), (6 2), (3, 4)), remove (2 6) and (6 2).
-			edgelistFlipped = edgelist;
-			std::for_each(edgelistFlipped.begin(), edgelistFlipped.end(), flipEdge);
-			std::sort(edgelist.begin(), edgelist.end(), edgeLessThan);
-			std::sort(edgelistFlipped.begin(), edgelistFlipped.end(), edgeLessThan);
-			edgelistFiltered.resize(edgelist.size());
-			edgelistFiltered.erase(std::set_difference(edgelist.begin(), edgelist.end(), edgelistFlipped.begin(), edgelistFlipped.end(), edgelistFiltered.begin(), edgeLessThan), edgelistFiltered.end());
+/// Extrude the silhouette edges away from the light into the triangles of the shadow volume
+static void pie_ShadowVolume(std::vector<Vector3f> &vertexes, const iIMDShape *shape, int flag, int flag_data, const glm::vec4 &light, const EDGE *drawlist, size_t edge_count)
+{
+	const Vector3f *pVertices = shape->pShadowPoints->data();
 
-			drawlist = &edgelistFiltered[0];
-			edge_count = edgelistFiltered.size();
-			//debug(LOG_WARNING, "we have %i edges", edge_count);
+	vertexes.clear();
+	vertexes.reserve(edge_count * 6);
+	for (size_t i = 0; i < edge_count; i++)
+	{
+		int a = drawlist[i].from, b = drawlist[i].to;
 
-			if (flag & pie_STATIC_SHADOW)
-			{
-				// then store it in the imd
-				shape->nShadowEdges = edge_count;
-				shape->shadowEdgeList = (EDGE *)realloc(shape->shadowEdgeList, sizeof(EDGE) * shape->nShadowEdges);
-				std::copy(drawlist, drawlist + edge_count, shape->shadowEdgeList);
-			}
-		}
+		glm::vec3 v1(pVertices[b].x, scale_y(pVertices[b].y, flag, flag_data), pVertices[b].z);
+		glm::vec3 v3(pVertices[a].x + light[0], scale_y(pVertices[a].y, flag, flag_data) + light[1], pVertices[a].z + light[2]);
 
-		std::vector<Vector3f> vertexes;
-		vertexes.reserve(edge_count * 6);
-		for (size_t i = 0; i < edge_count; i++)
-		{
-			int a = drawlist[i].from, b = drawlist[i].to;
+		vertexes.push_back(v1);
+		vertexes.push_back(glm::vec3(pVertices[b].x + light[0], scale_y(pVertices[b].y, flag, flag_data) + light[1], pVertices[b].z + light[2])); //v2
+		vertexes.push_back(v3);
 
-			glm::vec3 v1(pVertices[b].x, scale_y(pVertices[b].y, flag, flag_data), pVertices[b].z);
-			glm::vec3 v3(pVertices[a].x + light[0], scale_y(pVertices[a].y, flag, flag_data) + light[1], pVertices[a].z + light[2]);
+		vertexes.push_back(v3);
+		vertexes.push_back(glm::vec3(pVertices[a].x, scale_y(pVertices[a].y, flag, flag_data), pVertices[a].z)); //v4
+		vertexes.push_back(v1);
+	}
+}
 
-			vertexes.push_back(v1);
-			vertexes.push_back(glm::vec3(pVertices[b].x + light[0], scale_y(pVertices[b].y, flag, flag_data) + light[1], pVertices[b].z + light[2])); //v2
-			vertexes.push_back(v3);
+/// A shadow volume missing from the cache, to be built on the job pool
+struct ShadowJob
+{
+	iIMDShape *shape;
+	int flag;
+	int flag_data;
+	glm::vec4 light;
+	ShadowCache::CachedShadowData *cache;
+};
 
-			vertexes.push_back(v3);
-			vertexes.push_back(glm::vec3(pVertices[a].x, scale_y(pVertices[a].y, flag, flag_data), pVertices[a].z)); //v4
-			vertexes.push_back(v1);
-		}
+static std::vector<ShadowJob> shadowJobs;
+static ShadowScratch shadowScratch;  // for the render thread
 
-		ShadowCache::CachedShadowData& cache = shadowCache.createCacheForShadowDraw(shape, flag, flag_data, light);
-		cache.vertexes = std::move(vertexes);
-		result = DRAW_SUCCESS_UNCACHED;
-		pCached = &cache;
+/// Build a shadow volume. Thread-safe, as long as static shadow edges have been stored in the shape beforehand.
+static void buildShadowVolume(ShadowJob &job)
+{
+	static thread_local ShadowScratch scratch;  // one for each thread of the job pool
+	const EDGE *drawlist;
+	size_t edge_count;
+	if (job.flag & pie_STATIC_SHADOW)
+	{
+		drawlist = job.shape->shadowEdgeList;
+		edge_count = job.shape->nShadowEdges;
 	}
 	else
 	{
-		result = DRAW_SUCCESS_CACHED;
+		pie_ShadowSilhouette(scratch, job.shape, job.flag, job.flag_data, job.light);
+		drawlist = scratch.edgelistFiltered.data();
+		edge_count = scratch.edgelistFiltered.size();
 	}
+	pie_ShadowVolume(job.cache->vertexes, job.shape, job.flag, job.flag_data, job.light, drawlist, edge_count);
+}
 
-	// Aggregate the vertexes (pre-computed with the modelViewMatrix)
-	shadowCache.addPremultipliedVertexes(*pCached, modelViewMatrix);
-
-	return result;
+/// Build all queued shadow volumes, spread over the job pool and this thread
+static void runShadowJobs()
+{
+	wzParallelFor("shadow volumes", shadowJobs.size(), [](size_t i) {
+		buildShadowVolume(shadowJobs[i]);
+	});
+	shadowJobs.clear();
 }
 
 void pie_CleanUp()
 {
+	shadowJobs.clear();
 	tshapes.clear();
 	shapes.clear();
 	scshapes.clear();
@@ -723,6 +776,12 @@ void pie_CleanUp()
 		delete pZeroedVertexBuffer;
 		pZeroedVertexBuffer = nullptr;
 	}
+	if (pInstanceBuffer)
+	{
+		delete pInstanceBuffer;
+		pInstanceBuffer = nullptr;
+	}
+	instanceData.clear();
 }
 
 bool pie_Draw3DShape(iIMDShape *shape, int frame, int team, PIELIGHT colour, int pieFlag, int pieFlagData, const glm::mat4 &modelView)
@@ -741,7 +800,7 @@ bool pie_Draw3DShape(iIMDShape *shape, int frame, int team, PIELIGHT colour, int
 	{
 		SHAPE tshape;
 		tshape.shape = shape;
-		tshape.frame = frame;
+		tshape.frame = frame % std::max<int>(1, shape->numFrames);
 		tshape.colour = colour;
 		tshape.teamcolour = teamcolour;
 		tshape.flag = pieFlag;
@@ -799,19 +858,46 @@ bool pie_Draw3DShape(iIMDShape *shape, int frame, int team, PIELIGHT colour, int
 
 static void pie_ShadowDrawLoop(ShadowCache &shadowCache)
 {
+	static std::vector<const ShadowCache::CachedShadowData *> volumes;  // Static, to save allocations.
 	size_t cachedShadowDraws = 0;
 	size_t uncachedShadowDraws = 0;
-	for (unsigned i = 0; i < scshapes.size(); i++)
+
+	// Look up the shadow volumes, and queue the missing ones
+	// Note: The modelViewMatrix is not used for calculating the sorted / filtered vertices, so it's not included
+	volumes.resize(scshapes.size());
+	for (size_t i = 0; i < scshapes.size(); ++i)
 	{
-		DrawShadowResult result = pie_DrawShadow(shadowCache, scshapes[i].shape, scshapes[i].flag, scshapes[i].flag_data, scshapes[i].light, scshapes[i].matrix);
-		if (result == DRAW_SUCCESS_CACHED)
+		const ShadowcastingShape &scshape = scshapes[i];
+		const glm::vec4 light = quantizeShadowLight(scshape.light);
+		const ShadowCache::CachedShadowData *pCached = shadowCache.findCacheForShadowDraw(scshape.shape, scshape.flag, scshape.flag_data, light);
+		if (pCached == nullptr)
 		{
-			++cachedShadowDraws;
+			if ((scshape.flag & pie_STATIC_SHADOW) && !scshape.shape->shadowEdgeList)
+			{
+				// compute the silhouette once and store it in the imd (done here, as the workers only read it)
+				pie_ShadowSilhouette(shadowScratch, scshape.shape, scshape.flag, scshape.flag_data, light);
+				scshape.shape->nShadowEdges = shadowScratch.edgelistFiltered.size();
+				scshape.shape->shadowEdgeList = (EDGE *)realloc(scshape.shape->shadowEdgeList, sizeof(EDGE) * scshape.shape->nShadowEdges);
+				std::copy(shadowScratch.edgelistFiltered.begin(), shadowScratch.edgelistFiltered.end(), scshape.shape->shadowEdgeList);
+			}
+			ShadowCache::CachedShadowData &cache = shadowCache.createCacheForShadowDraw(scshape.shape, scshape.flag, scshape.flag_data, light);
+			shadowJobs.push_back(ShadowJob{scshape.shape, scshape.flag, scshape.flag_data, light, &cache});
+			pCached = &cache;
+			++uncachedShadowDraws;
 		}
 		else
 		{
-			++uncachedShadowDraws;
+			++cachedShadowDraws;
 		}
+		volumes[i] = pCached;
+	}
+
+	runShadowJobs();
+
+	// Aggregate the vertexes (pre-computed with the modelViewMatrix)
+	for (size_t i = 0; i < scshapes.size(); ++i)
+	{
+		shadowCache.addPremultipliedVertexes(*volumes[i], scshapes[i].matrix);
 	}
 
 	const auto &premultipliedVertexes = shadowCache.getPremultipliedVertexes();
@@ -862,10 +948,101 @@ struct less_than_shape
 {
 	inline bool operator() (const SHAPE& shape1, const SHAPE& shape2)
 	{
-		return (shape1.shape < shape2.shape);
+		if (shape1.shape != shape2.shape)
+		{
+			return (shape1.shape < shape2.shape);
+		}
+		return (shape1.frame < shape2.frame);
 	}
 };
 
+/// Draw the (sorted) opaque shapes, one instanced draw call per run of identical shape + animation frame
+static void pie_DrawOpaqueShapesInstanced()
+{
+	typedef gfx_api::Draw3DShapeInstancedOpaque PSO;
+
+	// All opaque shapes use the lit shader with fog
+	pie_SetFogStatus(true);
+
+	instanceData.clear();
+	instanceData.reserve(shapes.size());
+	for (SHAPE const &shape : shapes)
+	{
+		const int ecmState = (shape.flag & pie_ECM) ? 1 : 0;
+		const float alphaTest = (shape.flag & pie_PREMULTIPLIED) ? 0.f : 1.f;
+		instanceData.push_back(gfx_api::Draw3DShapeInstanceData {
+			shape.matrix,
+			glm::transpose(glm::inverse(shape.matrix)),
+			shape.colour, shape.teamcolour,
+			glm::vec4(shape.stretch, (float)ecmState, alphaTest, 0.f)
+		});
+	}
+	if (!pInstanceBuffer)
+	{
+		pInstanceBuffer = gfx_api::context::get().create_buffer_object(gfx_api::buffer::usage::vertex_buffer, gfx_api::context::buffer_storage_hint::stream_draw);
+	}
+	pInstanceBuffer->upload(instanceData.size() * sizeof(gfx_api::Draw3DShapeInstanceData), instanceData.data());
+
+	const auto &renderState = getCurrentRenderState();
+	const glm::vec4 fogColor = renderState.fogEnabled ? glm::vec4(
+		renderState.fogColour.vector[0] / 255.f,
+		renderState.fogColour.vector[1] / 255.f,
+		renderState.fogColour.vector[2] / 255.f,
+		renderState.fogColour.vector[3] / 255.f
+	) : glm::vec4(0.f);
+
+	gfx_api::Draw3DShapeGlobalUniforms globalUniforms {
+		pie_PerspectiveGet(),
+		glm::vec4(currentSunPosition, 0.f),
+		glm::vec4(lighting0[LIGHT_EMISSIVE][0], lighting0[LIGHT_EMISSIVE][1], lighting0[LIGHT_EMISSIVE][2], lighting0[LIGHT_EMISSIVE][3]),
+		glm::vec4(lighting0[LIGHT_AMBIENT][0], lighting0[LIGHT_AMBIENT][1], lighting0[LIGHT_AMBIENT][2], lighting0[LIGHT_AMBIENT][3]),
+		glm::vec4(lighting0[LIGHT_DIFFUSE][0], lighting0[LIGHT_DIFFUSE][1], lighting0[LIGHT_DIFFUSE][2], lighting0[LIGHT_DIFFUSE][3]),
+		glm::vec4(lighting0[LIGHT_SPECULAR][0], lighting0[LIGHT_SPECULAR][1], lighting0[LIGHT_SPECULAR][2], lighting0[LIGHT_SPECULAR][3]),
+		fogColor,
+		renderState.fogBegin, renderState.fogEnd, pie_GetShaderTime(), renderState.fogEnabled
+	};
+
+	PSO::get().bind();
+	PSO::get().set_uniforms_at(0, globalUniforms);
+
+	size_t first = 0;
+	while (first < shapes.size())
+	{
+		const iIMDShape *shape = shapes[first].shape;
+		const int frame = shapes[first].frame;
+		size_t last = first + 1;
+		while (last < shapes.size() && shapes[last].shape == shape && shapes[last].frame == frame)
+		{
+			++last;
+		}
+
+		auto* tcmask = shape->tcmaskpage != iV_TEX_INVALID ? &pie_Texture(shape->tcmaskpage) : nullptr;
+		auto* normalmap = shape->normalpage != iV_TEX_INVALID ? &pie_Texture(shape->normalpage) : nullptr;
+		auto* specularmap = shape->specularpage != iV_TEX_INVALID ? &pie_Texture(shape->specularpage) : nullptr;
+		gfx_api::buffer* pTangentBuffer = (shape->buffers[VBO_TANGENT] != nullptr) ? shape->buffers[VBO_TANGENT] : getZeroedVertexBuffer(shape->vertexCount * 4 * sizeof(gfx_api::gfxFloat));
+
+		gfx_api::Draw3DShapePerMeshUniforms meshUniforms {
+			tcmask ? 1 : 0, normalmap != nullptr, specularmap != nullptr, shape->buffers[VBO_TANGENT] != nullptr
+		};
+
+		if (first == 0 || shapes[first - 1].shape != shape)
+		{
+			gfx_api::context::get().bind_index_buffer(*shape->buffers[VBO_INDEX], gfx_api::index_type::u16);
+			PSO::get().set_uniforms_at(1, meshUniforms);
+			PSO::get().bind_textures(&pie_Texture(shape->texpage), tcmask, normalmap, specularmap);
+		}
+		gfx_api::context::get().bind_vertex_buffers(0, {
+			std::make_tuple(shape->buffers[VBO_VERTEX], 0), std::make_tuple(shape->buffers[VBO_NORMAL], 0),
+			std::make_tuple(shape->buffers[VBO_TEXCOORD], 0), std::make_tuple(pTangentBuffer, 0),
+			std::make_tuple(pInstanceBuffer, first * sizeof(gfx_api::Draw3DShapeInstanceData))
+		});
+		PSO::get().draw_elements_instanced(shape->polys.size() * 3, frame * shape->polys.size() * 3 * sizeof(uint16_t), last - first);
+		polyCount += shape->polys.size() * (last - first);
+
+		first = last;
+	}
+}
+
 static ShaderOnce perFrameUniformsShaderOnce;
 
 void pie_RemainingPasses(uint64_t currentGameFrame)
@@ -877,10 +1054,17 @@ void pie_RemainingPasses(uint64_t currentGameFrame)
 	std::sort(shapes.begin(), shapes.end(), less_than_shape());
 	gfx_api::context::get().debugStringMarker("Remaining passes - opaque models");
 	templatedState lastState;
-	for (SHAPE const &shape : shapes)
+	if (!shapes.empty() && gfx_api::context::get().supports_instanced_rendering())
 	{
-		pie_SetShaderStretchDepth(shape.stretch);
-		lastState = pie_Draw3DShape2(lastState, perFrameUniformsShaderOnce, shape.shape, shape.frame, shape.colour, shape.teamcolour, shape.flag, shape.flag_data, shape.matrix);
+		pie_DrawOpaqueShapesInstanced();
+	}
+	else
+	{
+		for (SHAPE const &shape : shapes)
+		{
+			pie_SetShaderStretchDepth(shape.stretch);
+			lastState = pie_Draw3DShape2(lastState, perFrameUniformsShaderOnce, shape.shape, shape.frame, shape.colour, shape.teamcolour, shape.flag, shape.flag_data, shape.matrix);
+		}
 	}
 	gfx_api::context::get().disable_all_vertex_buffers();
 	if (!shapes.empty())
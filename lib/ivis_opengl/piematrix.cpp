@@ -52,6 +52,9 @@ struct PerspectiveCache {
 // Since computing the perspective matrix is a semi-costly operation, store a cache here
 static PerspectiveCache perspectiveCache;
 
+// HACK: This seems to work by experimentation, not sure why.
+static const float hackScaleFactor = 1.0f / (3 * 330);
+
 /*!
  * 3D vector perspective projection
  * Projects 3D vector into 2D screen space
@@ -61,8 +64,6 @@ static PerspectiveCache perspectiveCache;
  */
 int32_t pie_RotateProject(const Vector3i *v3d, const glm::mat4& matrix, Vector2i *v2d)
 {
-	float hackScaleFactor = 1.0f / (3 * 330);  // HACK: This seems to work by experimentation, not sure why.
-
 	/*
 	 * v = curMatrix . v3d
 	 */
@@ -85,6 +86,32 @@ int32_t pie_RotateProject(const Vector3i *v3d, const glm::mat4& matrix, Vector2i
 	return static_cast<int32_t>(v.w);
 }
 
+/*!
+ * Projects \c count points the way pie_RotateProject() does, reading the coordinates from separate arrays
+ * so that the loop can be vectorised.
+ * \param x,y,z         coordinates of the points to project
+ * \param[out] depth    projected z components
+ * \param[out] pixels   resulting 2D vectors
+ */
+void pie_RotateProjectBatch(size_t count, const float *x, const float *y, const float *z, const glm::mat4& matrix, int32_t *depth, Vector2i *pixels)
+{
+	const glm::mat4 m = pie_PerspectiveGet() * matrix;
+	const int width = pie_GetVideoBufferWidth();
+	const int height = pie_GetVideoBufferHeight();
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float vx = m[0][0] * x[i] + m[1][0] * y[i] + m[2][0] * z[i] + m[3][0];
+		const float vy = m[0][1] * x[i] + m[1][1] * y[i] + m[2][1] * z[i] + m[3][1];
+		const float vw = m[0][3] * x[i] + m[1][3] * y[i] + m[2][3] * z[i] + m[3][3];
+		const bool tooClose = vw < 256 * hackScaleFactor;
+
+		pixels[i].x = tooClose ? LONG_WAY : static_cast<int>((.5 + .5 * (vx / vw)) * width);  // LONG_WAY is just along way off screen
+		pixels[i].y = tooClose ? LONG_WAY : static_cast<int>((.5 - .5 * (vy / vw)) * height);
+		depth[i] = static_cast<int32_t>(vw);
+	}
+}
+
 const glm::mat4& pie_PerspectiveGet()
 {
 	const float width = std::max(pie_GetVideoBufferWidth(), 1);  // Require width > 0 && height > 0, to avoid glScalef(1, 1, -1) crashing in some graphics drivers.
@@ -25,6 +25,7 @@
 #include <glm/fwd.hpp>
 
 int32_t pie_RotateProject(const Vector3i *src, const glm::mat4& matrix, Vector2i *dest);
+void pie_RotateProjectBatch(size_t count, const float *x, const float *y, const float *z, const glm::mat4& matrix, int32_t *depth, Vector2i *pixels);
 const glm::mat4& pie_PerspectiveGet();
 void pie_SetGeometricOffset(int x, int y);
 void pie_Begin3DScene();
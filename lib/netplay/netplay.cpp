@@ -233,6 +233,8 @@ static NETSTATS nStatsLastSec       = {{0, 0}, {0, 0}, {0, 0}};
 static NETSTATS nStatsSecondLastSec = {{0, 0}, {0, 0}, {0, 0}};
 static const NETSTATS nZeroStats    = {{0, 0}, {0, 0}, {0, 0}};
 static int nStatsLastUpdateTime = 0;
+static SocketCodecStats codecStatsLastSec[SOCKET_CODEC_COUNT];
+static SocketCodecStats codecStatsSecondLastSec[SOCKET_CODEC_COUNT];
 
 unsigned NET_PlayerConnectionStatus[CONNECTIONSTATUS_NORMAL][MAX_PLAYERS];
 
@@ -1345,6 +1347,8 @@ int NETshutdown()
 	nStats = nZeroStats;
 	nStatsLastSec = nZeroStats;
 	nStatsSecondLastSec = nZeroStats;
+	std::fill(std::begin(codecStatsLastSec), std::end(codecStatsLastSec), SocketCodecStats());
+	std::fill(std::begin(codecStatsSecondLastSec), std::end(codecStatsSecondLastSec), SocketCodecStats());
 
 	return 0;
 }
@@ -1430,6 +1434,22 @@ int NETclose()
 // ////////////////////////////////////////////////////////////////////////
 // Send and Recv functions
 
+static void NETupdateStatistics()
+{
+	int time = wzGetTicks();
+	if ((unsigned)(time - nStatsLastUpdateTime) >= (unsigned)GAME_TICKS_PER_SEC)
+	{
+		nStatsLastUpdateTime = time;
+		nStatsSecondLastSec = nStatsLastSec;
+		nStatsLastSec = nStats;
+		for (unsigned codec = 0; codec < SOCKET_CODEC_COUNT; ++codec)
+		{
+			codecStatsSecondLastSec[codec] = codecStatsLastSec[codec];
+			codecStatsLastSec[codec] = socketGetCodecStats(static_cast<SocketCodec>(codec));
+		}
+	}
+}
+
 // ////////////////////////////////////////////////////////////////////////
 // return bytes of data sent recently.
 size_t NETgetStatistic(NetStatisticType type, bool sent, bool isTotal)
@@ -1441,16 +1461,19 @@ size_t NETgetStatistic(NetStatisticType type, bool sent, bool isTotal)
 	case NetStatisticRawBytes:          statsType = &NETSTATS::rawBytes;          break;
 	case NetStatisticUncompressedBytes: statsType = &NETSTATS::uncompressedBytes; break;
 	case NetStatisticPackets:           statsType = &NETSTATS::packets;           break;
+	case NetStatisticCodecMicroseconds:
+		{
+			size_t total = 0;
+			for (unsigned codec = 0; codec < SOCKET_CODEC_COUNT; ++codec)
+			{
+				total += NETgetCodecStatistic(codec, type, sent, isTotal);
+			}
+			return total;
+		}
 	default: ASSERT(false, " "); return 0;
 	}
 
-	int time = wzGetTicks();
-	if ((unsigned)(time - nStatsLastUpdateTime) >= (unsigned)GAME_TICKS_PER_SEC)
-	{
-		nStatsLastUpdateTime = time;
-		nStatsSecondLastSec = nStatsLastSec;
-		nStatsLastSec = nStats;
-	}
+	NETupdateStatistics();
 
 	if (isTotal)
 	{
@@ -1459,10 +1482,43 @@ size_t NETgetStatistic(NetStatisticType type, bool sent, bool isTotal)
 	return nStatsLastSec.*statsType.*statisticType - nStatsSecondLastSec.*statsType.*statisticType;
 }
 
+// ////////////////////////////////////////////////////////////////////////
+// return bytes of data sent recently, and time spent (de)compressing it, for one codec.
+size_t NETgetCodecStatistic(unsigned codec, NetStatisticType type, bool sent, bool isTotal)
+{
+	ASSERT_OR_RETURN(0, codec < SOCKET_CODEC_COUNT, "Bad codec %u", codec);
+	uint64_t SocketCodecStats::*statsType;
+	switch (type)
+	{
+	case NetStatisticRawBytes:          statsType = sent ? &SocketCodecStats::rawBytesSent : &SocketCodecStats::rawBytesReceived;                   break;
+	case NetStatisticUncompressedBytes: statsType = sent ? &SocketCodecStats::uncompressedBytesSent : &SocketCodecStats::uncompressedBytesReceived; break;
+	case NetStatisticCodecMicroseconds: statsType = sent ? &SocketCodecStats::compressMicroseconds : &SocketCodecStats::decompressMicroseconds;     break;
+	default: ASSERT(false, "No per codec statistic %d", (int)type); return 0;
+	}
+
+	NETupdateStatistics();
+
+	if (isTotal)
+	{
+		return socketGetCodecStats(static_cast<SocketCodec>(codec)).*statsType;
+	}
+	return codecStatsLastSec[codec].*statsType - codecStatsSecondLastSec[codec].*statsType;
+}
+
+unsigned NETgetCodecCount()
+{
+	return SOCKET_CODEC_COUNT;
+}
+
+const char *NETgetCodecName(unsigned codec)
+{
+	return socketCodecName(static_cast<SocketCodec>(codec));
+}
+
 
 // ////////////////////////////////////////////////////////////////////////
 // Send a message to a player, option to guarantee message
-bool NETsend(NETQUEUE queue, NetMessage const *message)
+bool NETsend(NETQUEUE queue, NetMessageView message)
 {
 	uint8_t player = queue.index;
 	ssize_t result = 0;
@@ -1501,8 +1557,8 @@ bool NETsend(NETQUEUE queue, NetMessage const *message)
 			// We are the host, send directly to player.
 			if (sockets[player] != nullptr && player != queue.exclude)
 			{
-				uint8_t *rawData = message->rawDataDup();
-				ssize_t rawLen   = message->rawLen();
+				uint8_t *rawData = message.rawDataDup();
+				ssize_t rawLen   = message.rawLen();
 				size_t compressedRawLen;
 				result = writeAll(sockets[player], rawData, rawLen, &compressedRawLen);
 				delete[] rawData;  // Done with the data.
@@ -1532,8 +1588,8 @@ bool NETsend(NETQUEUE queue, NetMessage const *message)
 		// We are a client, send directly to player, who happens to be the host.
 		if (bsocket)
 		{
-			uint8_t *rawData = message->rawDataDup();
-			ssize_t rawLen   = message->rawLen();
+			uint8_t *rawData = message.rawDataDup();
+			ssize_t rawLen   = message.rawLen();
 			size_t compressedRawLen;
 			result = writeAll(bsocket, rawData, rawLen, &compressedRawLen);
 			delete[] rawData;  // Done with the data.
@@ -1568,7 +1624,7 @@ bool NETsend(NETQUEUE queue, NetMessage const *message)
 		NETbeginEncode(NETnetQueue(NET_HOST_ONLY), NET_SEND_TO_PLAYER);
 		NETuint8_t(&sender);
 		NETuint8_t(&player);
-		NETnetMessage(&message);
+		NETnetMessage(message);
 		NETend();
 	}
 
@@ -2085,7 +2141,7 @@ checkMessages:
 		*queue = NETnetQueue(current);
 		while (NETisMessageReady(*queue))
 		{
-			*type = NETgetMessage(*queue)->type;
+			*type = NETgetMessage(*queue).type;
 			if (!NETprocessSystemMessage(*queue, *type))
 			{
 				return true;  // We couldn't process the message, let the caller deal with it..
@@ -2108,7 +2164,7 @@ bool NETrecvGame(NETQUEUE *queue, uint8_t *type)
 				return false;  // Still waiting for messages from this player, and all players should process messages in the same order. Will have to freeze the game while waiting.
 			}
 
-			*type = NETgetMessage(*queue)->type;
+			*type = NETgetMessage(*queue).type;
 
 			if (*type == GAME_GAME_TIME)
 			{
@@ -2153,6 +2209,8 @@ int NETsendFile(WZFile &file, unsigned player)
 	NETuint32_t(&file.pos);  // start byte
 	NETuint32_t(&bytesToRead);  // bytes in this packet
 	NETbin(inBuff, bytesToRead);
+	uint32_t chunkCrc = crcSum(0, inBuff, bytesToRead);  // Older clients ignore this.
+	NETuint32_t(&chunkCrc);
 	NETend();
 
 	file.pos += bytesToRead;  // update position!
@@ -2307,7 +2365,9 @@ int NETrecvFile(NETQUEUE queue)
 	NETuint32_t(&bytesToRead);  // bytes in this packet
 	ASSERT_OR_RETURN(100, bytesToRead <= sizeof(buf), "Bad value.");
 	NETbin(buf, bytesToRead);
-	NETend();
+	uint32_t chunkCrc = 0;
+	NETuint32_t(&chunkCrc);
+	bool haveChunkCrc = NETend();  // Older hosts don't send the checksum.
 
 	debug(LOG_NET, "New file position is %u", pos);
 
@@ -2364,7 +2424,23 @@ int NETrecvFile(NETQUEUE queue)
 		return 100;
 	}
 
-	if (PHYSFS_tell(file->handle) != static_cast<PHYSFS_sint64>(pos))
+	if (pos == 0 && file->pos != 0)
+	{
+		// We asked to resume, but the host is starting over, since our partial file didn't match its file (or it's too old to resume).
+		debug(LOG_INFO, "Host did not resume download of %s at %" PRIu32", starting over", file->filename.c_str(), file->pos);
+		PHYSFS_close(file->handle);
+		file->handle = PHYSFS_openWrite(file->filename.c_str());
+		file->pos = 0;
+		if (file->handle == nullptr)
+		{
+			debug(LOG_ERROR, "Failed to open %s for writing: %s", file->filename.c_str(), WZ_PHYSFS_getLastError());
+			sendCancelFileDownload(file->hash);
+			NetPlay.wzFiles.erase(file);
+			return 100;
+		}
+	}
+
+	if (file->pos != pos)
 	{
 		// actual position in file does not equal the expected position in the file (sent by the host)
 		debug(LOG_ERROR, "Invalid file position in downloaded file; (desired: %" PRIu32")", pos);
@@ -2372,6 +2448,13 @@ int NETrecvFile(NETQUEUE queue)
 		return 100;
 	}
 
+	if (haveChunkCrc && crcSum(0, buf, bytesToRead) != chunkCrc)
+	{
+		debug(LOG_ERROR, "Corrupt chunk at %" PRIu32" in downloaded file %s", pos, file->filename.c_str());
+		terminateFileDownload(file); // 'file' is now an invalidated iterator.
+		return 100;
+	}
+
 	// Write packet to the file.
 	WZ_PHYSFS_writeBytes(file->handle, buf, bytesToRead);
 
@@ -2411,6 +2494,70 @@ int NETrecvFile(NETQUEUE queue)
 	return 100;		// file is nullbyte, so we are done.
 }
 
+bool NETfilePrefixCrc(PHYSFS_file *handle, uint32_t length, uint32_t *crc)
+{
+	uint8_t buf[16 * 1024];
+	*crc = 0;
+	if (PHYSFS_seek(handle, 0) == 0)
+	{
+		return false;
+	}
+	while (length > 0)
+	{
+		uint32_t chunk = std::min<uint32_t>(length, sizeof(buf));
+		if (WZ_PHYSFS_readBytes(handle, buf, chunk) != static_cast<PHYSFS_sint64>(chunk))
+		{
+			return false;
+		}
+		*crc = crcSum(*crc, buf, chunk);
+		length -= chunk;
+	}
+	return true;
+}
+
+bool NETrequestFile(Sha256 const &hash, std::string const &filename)
+{
+	// Anything already in the file is most likely what an interrupted download of the same file left behind, so offer it to the host.
+	uint32_t resumePos = 0;
+	uint32_t resumeCrc = 0;
+	if (PHYSFS_exists(filename.c_str()))
+	{
+		PHYSFS_file *partial = PHYSFS_openRead(filename.c_str());
+		PHYSFS_sint64 partialSize = partial != nullptr ? PHYSFS_fileLength(partial) : -1;
+		if (partialSize > 0 && partialSize < MAX_NET_TRANSFERRABLE_FILE_SIZE && NETfilePrefixCrc(partial, static_cast<uint32_t>(partialSize), &resumeCrc))
+		{
+			resumePos = static_cast<uint32_t>(partialSize);
+		}
+		if (partial != nullptr)
+		{
+			PHYSFS_close(partial);
+		}
+	}
+
+	PHYSFS_file *fileHandle = resumePos != 0 ? PHYSFS_openAppend(filename.c_str()) : PHYSFS_openWrite(filename.c_str());
+	if (fileHandle == nullptr)
+	{
+		debug(LOG_ERROR, "Failed to open %s for writing: %s", filename.c_str(), WZ_PHYSFS_getLastError());
+		return false;
+	}
+	if (resumePos != 0)
+	{
+		debug(LOG_INFO, "Asking to resume download of %s at %" PRIu32, filename.c_str(), resumePos);
+	}
+
+	NetPlay.wzFiles.emplace_back(fileHandle, filename, hash);
+	NetPlay.wzFiles.back().pos = resumePos;
+
+	// Request the map/mod from the host
+	Sha256 requestHash = hash;
+	NETbeginEncode(NETnetQueue(NET_HOST_ONLY), NET_FILE_REQUESTED);
+	NETbin(requestHash.bytes, requestHash.Bytes);
+	NETuint32_t(&resumePos);  // Older hosts ignore these, and send the whole file.
+	NETuint32_t(&resumeCrc);
+	NETend();
+	return true;
+}
+
 unsigned NETgetDownloadProgress(unsigned player)
 {
 	std::vector<WZFile> const &files = player == selectedPlayer ?
@@ -3070,7 +3217,7 @@ static void NETallowJoining()
 
 				NETinsertRawData(NETnetTmpQueue(i), buffer, size);
 
-				if (NETisMessageReady(NETnetTmpQueue(i)) && NETgetMessage(NETnetTmpQueue(i))->type == NET_JOIN)
+				if (NETisMessageReady(NETnetTmpQueue(i)) && NETgetMessage(NETnetTmpQueue(i)).type == NET_JOIN)
 				{
 					uint8_t j;
 					uint8_t index;
@@ -3085,6 +3232,8 @@ static void NETallowJoining()
 					NETstring(name, sizeof(name));
 					NETstring(ModList, sizeof(ModList));
 					NETstring(GamePassword, sizeof(GamePassword));
+					uint32_t peerCodecs = 0;  // Older versions don't send this, and only speak zlib.
+					NETuint32_t(&peerCodecs);
 					NETend();
 
 					tmp = NET_CreatePlayer(name);
@@ -3163,9 +3312,12 @@ static void NETallowJoining()
 						return;
 					}
 
+					uint32_t codecs = socketSupportedCodecs();
 					NETbeginEncode(NETnetQueue(index), NET_ACCEPTED);
 					NETuint8_t(&index);
+					NETuint32_t(&codecs);
 					NETend();
+					socketSetSendCodec(connected_bsocket[index], socketPreferredCodec(peerCodecs));
 
 					// First send info about players to newcomer.
 					NETSendAllPlayerInfoTo(index);
@@ -3706,6 +3858,8 @@ bool NETjoinGame(const char *host, uint32_t port, const char *playername)
 	NETstring(playername, 64);
 	NETstring(getModList().c_str(), modlist_string_size);
 	NETstring(NetPlay.gamePassword, sizeof(NetPlay.gamePassword));
+	uint32_t codecs = socketSupportedCodecs();  // Compression we can take, older hosts ignore this.
+	NETuint32_t(&codecs);
 	NETend();
 	if (bsocket == nullptr)
 	{
@@ -3741,10 +3895,12 @@ bool NETjoinGame(const char *host, uint32_t port, const char *playername)
 		{
 			// :)
 			uint8_t index;
+			uint32_t hostCodecs = 0;  // Older hosts don't send this, and only speak zlib.
 
 			NETbeginDecode(queue, NET_ACCEPTED);
 			// Retrieve the player ID the game host arranged for us
 			NETuint8_t(&index);
+			NETuint32_t(&hostCodecs);
 			NETend();
 			NETpop(queue);
 
@@ -3764,6 +3920,8 @@ bool NETjoinGame(const char *host, uint32_t port, const char *playername)
 			sstrcpy(NetPlay.players[index].name, playername);
 			NetPlay.players[index].heartbeat = true;
 
+			socketSetSendCodec(bsocket, socketPreferredCodec(hostCodecs));
+
 			return true;
 		}
 		else if (type == NET_REJECTED)
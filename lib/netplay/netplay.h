@@ -337,13 +337,15 @@ extern bool netGameserverPortOverride; // = false; (for cli override)
 // ////////////////////////////////////////////////////////////////////////
 // functions available to you.
 int NETinit(bool bFirstCall);
-WZ_DECL_NONNULL(2) bool NETsend(NETQUEUE queue, NetMessage const *message);   ///< send to player, or broadcast if player == NET_ALL_PLAYERS.
+bool NETsend(NETQUEUE queue, NetMessageView message);   ///< send to player, or broadcast if player == NET_ALL_PLAYERS.
 WZ_DECL_NONNULL(1, 2) bool NETrecvNet(NETQUEUE *queue, uint8_t *type);        ///< recv a message from the net queues if possible.
 WZ_DECL_NONNULL(1, 2) bool NETrecvGame(NETQUEUE *queue, uint8_t *type);       ///< recv a message from the game queues which is sceduled to execute by time, if possible.
 void NETflush();                                                              ///< Flushes any data stuck in compression buffers.
 
 int NETsendFile(WZFile &file, unsigned player);  ///< Send file chunk. Returns 100 when done.
 int NETrecvFile(NETQUEUE queue);                 ///< Receive file chunk. Returns 100 when done.
+bool NETrequestFile(Sha256 const &hash, std::string const &filename);  ///< Ask the host for a file, resuming from what an earlier download left in filename, if anything.
+bool NETfilePrefixCrc(PHYSFS_file *handle, uint32_t length, uint32_t *crc);  ///< Checksum of the first length bytes of the file, which is left positioned after them.
 unsigned NETgetDownloadProgress(unsigned player);     ///< Returns 100 when done.
 
 int NETclose();					// close current game
@@ -353,8 +355,11 @@ void NETaddRedirects();
 void NETremRedirects();
 void NETdiscoverUPnPDevices();
 
-enum NetStatisticType {NetStatisticRawBytes, NetStatisticUncompressedBytes, NetStatisticPackets};
+enum NetStatisticType {NetStatisticRawBytes, NetStatisticUncompressedBytes, NetStatisticPackets, NetStatisticCodecMicroseconds};
 size_t NETgetStatistic(NetStatisticType type, bool sent, bool isTotal = false);     // Return some statistic. Call regularly for good results.
+size_t NETgetCodecStatistic(unsigned codec, NetStatisticType type, bool sent, bool isTotal = false);  // Same, for the data compressed with one codec. No packet counts.
+unsigned NETgetCodecCount();
+const char *NETgetCodecName(unsigned codec);
 
 void NETplayerKicked(UDWORD index);			// Cleanup after player has been kicked
 
@@ -24,6 +24,7 @@
 #include "lib/framework/frame.h"
 #include "netqueue.h"
 
+#include <algorithm>
 #include <limits>
 #include <cstdint>
 
@@ -103,12 +104,12 @@ bool decode_uint32_t(uint8_t b, uint32_t &v, unsigned n)
 	return !isLastByte;
 }
 
-uint8_t *NetMessage::rawDataDup() const
+uint8_t *NetMessageView::rawDataDup() const
 {
 #if SIZE_MAX > UINT32_MAX
-	ASSERT(data.size() <= static_cast<size_t>(std::numeric_limits<uint32_t>::max()), "Trying to duplicate a very large packet (%zu bytes).", data.size());
+	ASSERT(size <= static_cast<size_t>(std::numeric_limits<uint32_t>::max()), "Trying to duplicate a very large packet (%zu bytes).", size);
 #endif
-	uint32_t dataSizeU32 = static_cast<uint32_t>(data.size());
+	uint32_t dataSizeU32 = static_cast<uint32_t>(size);
 	unsigned encodedLengthOfSize = encodedlength_uint32_t(dataSizeU32);
 
 	uint8_t *ret = new uint8_t[1 + encodedLengthOfSize + dataSizeU32];
@@ -120,58 +121,126 @@ uint8_t *NetMessage::rawDataDup() const
 		encode_uint32_t(ret[n + 1], len, n);
 	}
 
-	std::copy(data.begin(), data.begin() + dataSizeU32, ret + 1 + encodedLengthOfSize);
+	std::copy(data, data + dataSizeU32, ret + 1 + encodedLengthOfSize);
 	return ret;
 }
 
-size_t NetMessage::rawLen() const
+size_t NetMessageView::rawLen() const
 {
-	return 1 + static_cast<size_t>(encodedlength_uint32_t(static_cast<uint32_t>(data.size()))) + data.size();
+	return 1 + static_cast<size_t>(encodedlength_uint32_t(static_cast<uint32_t>(size))) + size;
+}
+
+/// Size of the chunks holding the message data. Bigger messages get a chunk of their own.
+static const size_t netQueueChunkSize = 64 * 1024;
+
+/// Reads the type and length of a message, returning the length of its header, or 0 if the header isn't complete yet.
+static unsigned readMessageHeader(const uint8_t *data, size_t size, uint8_t &type, uint32_t &len)
+{
+	if (size < 2)
+	{
+		return 0;
+	}
+	type = data[0];
+
+	len = 0;
+	bool moreBytes = true;
+	unsigned n;
+	for (n = 0; moreBytes && size > 1 + n; ++n)
+	{
+		moreBytes = decode_uint32_t(data[1 + n], len, n);
+	}
+	return moreBytes ? 0 : 1 + n;
 }
 
 NetQueue::NetQueue()
 	: canGetMessagesForNet(true)
 	, canGetMessages(true)
+	, dataPos(0)
+	, messagePos(0)
+{}
+
+uint8_t *NetQueue::allocMessageData(size_t size)
 {
-	dataPos = messages.end();
-	messagePos = messages.end();
+	if (size == 0)
+	{
+		return nullptr;
+	}
+	if (chunks.empty() || chunks.back().capacity - chunks.back().used < size)
+	{
+		// Start a new chunk, reusing an old one if it's big enough.
+		Chunk chunk;
+		if (!spareChunks.empty() && spareChunks.back().capacity >= size)
+		{
+			chunk = std::move(spareChunks.back());
+			spareChunks.pop_back();
+		}
+		else
+		{
+			chunk.capacity = std::max(size, netQueueChunkSize);
+			chunk.data.reset(new uint8_t[chunk.capacity]);
+		}
+		chunk.used = 0;
+		chunk.freed = 0;
+		chunks.push_back(std::move(chunk));
+	}
+	Chunk &chunk = chunks.back();
+	uint8_t *data = &chunk.data[chunk.used];
+	chunk.used += size;
+	return data;
 }
 
 void NetQueue::writeRawData(const uint8_t *netData, size_t netLen)
 {
-	size_t used = 0;
 	std::vector<uint8_t> &buffer = incompleteReceivedMessageData;  // Short alias.
+	uint8_t type;
+	uint32_t len;
 
-	// Insert the data.
-	buffer.insert(buffer.end(), netData, netData + netLen);
-
-	// Extract the messages.
-	while (buffer.size() - used > 1)
+	// Finish the message left over from last time, copying only as much as it needs.
+	while (!buffer.empty() && netLen > 0)
 	{
-		uint8_t type = buffer[used];
+		unsigned headerLen = readMessageHeader(buffer.data(), buffer.size(), type, len);
+		size_t wanted = headerLen != 0 ? headerLen + len - buffer.size() : 1;
+		size_t take = std::min(wanted, netLen);
+		buffer.insert(buffer.end(), netData, netData + take);
+		netData += take;
+		netLen -= take;
+
+		// The header may only just have been finished, and the message may be empty, so look again.
+		headerLen = readMessageHeader(buffer.data(), buffer.size(), type, len);
+		if (headerLen == 0)
+		{
+			continue;  // Don't have a whole header ready yet.
+		}
+		ASSERT(len < 40000000, "Trying to write a very large packet (%u bytes) to the queue.", len);
+		if (buffer.size() == headerLen + len)
+		{
+			pushMessage(NetMessageView(type, buffer.data() + headerLen, len));
+			buffer.clear();
+		}
+	}
 
-		uint32_t len = 0;
-		bool moreBytes = true;
-		unsigned n;
-		for (n = 0; moreBytes && buffer.size() - used > 1 + n; ++n)
+	// Extract the messages, straight from the network data.
+	size_t used = 0;
+	while (buffer.empty())
+	{
+		unsigned headerLen = readMessageHeader(netData + used, netLen - used, type, len);
+		if (headerLen == 0)
 		{
-			moreBytes = decode_uint32_t(buffer[used + 1 + n], len, n);
+			break;  // Don't have a whole header ready yet.
 		}
-		unsigned headerLen = 1 + n;
 
 		ASSERT(len < 40000000, "Trying to write a very large packet (%u bytes) to the queue.", len);
-		if (buffer.size() - used - headerLen < len)
+		if (netLen - used - headerLen < len)
 		{
 			break;  // Don't have a whole message ready yet.
 		}
 
-		messages.push_front(NetMessage(type));
-		messages.front().data.assign(buffer.begin() + used + headerLen, buffer.begin() + used + headerLen + len);
+		pushMessage(NetMessageView(type, netData + used + headerLen, len));
 		used += headerLen + len;
 	}
 
-	// Recycle old data.
-	buffer.erase(buffer.begin(), buffer.begin() + used);
+	// Keep the rest for next time.
+	buffer.insert(buffer.end(), netData + used, netData + netLen);
 }
 
 void NetQueue::setWillNeverGetMessagesForNet()
@@ -181,36 +250,26 @@ void NetQueue::setWillNeverGetMessagesForNet()
 
 unsigned NetQueue::numMessagesForNet() const
 {
-	unsigned count = 0;
-	if (canGetMessagesForNet)
-	{
-		for (List::iterator i = dataPos; i != messages.begin(); --i)
-		{
-			++count;
-		}
-	}
-
-	return count;
+	return canGetMessagesForNet ? static_cast<unsigned>(messages.size() - dataPos) : 0;
 }
 
-const NetMessage &NetQueue::getMessageForNet() const
+NetMessageView NetQueue::getMessageForNet() const
 {
 	ASSERT(canGetMessagesForNet, "Wrong NetQueue type for getMessageForNet.");
-	ASSERT(dataPos != messages.begin(), "No message to get!");
+	ASSERT(dataPos < messages.size(), "No message to get!");
 
 	// Return the message.
-	List::iterator i = dataPos;
-	--i;
-	return *i;
+	const StoredMessage &message = messages[dataPos];
+	return NetMessageView(message.type, message.data, message.size);
 }
 
 void NetQueue::popMessageForNet()
 {
 	ASSERT(canGetMessagesForNet, "Wrong NetQueue type for popMessageForNet.");
-	ASSERT(dataPos != messages.begin(), "No message to pop!");
+	ASSERT(dataPos < messages.size(), "No message to pop!");
 
 	// Pop the message.
-	--dataPos;
+	++dataPos;
 
 	// Recycle old data.
 	popOldMessages();
@@ -218,7 +277,17 @@ void NetQueue::popMessageForNet()
 
 void NetQueue::pushMessage(const NetMessage &message)
 {
-	messages.push_front(message);
+	pushMessage(message.view());
+}
+
+void NetQueue::pushMessage(NetMessageView message)
+{
+	StoredMessage stored;
+	stored.type = message.type;
+	stored.size = static_cast<uint32_t>(message.size);
+	stored.data = allocMessageData(message.size);
+	std::copy(message.data, message.data + message.size, stored.data);
+	messages.push_back(stored);
 }
 
 void NetQueue::setWillNeverGetMessages()
@@ -229,27 +298,26 @@ void NetQueue::setWillNeverGetMessages()
 bool NetQueue::haveMessage() const
 {
 	ASSERT(canGetMessages, "Wrong NetQueue type for haveMessage.");
-	return messagePos != messages.begin();
+	return messagePos < messages.size();
 }
 
-const NetMessage &NetQueue::getMessage() const
+NetMessageView NetQueue::getMessage() const
 {
 	ASSERT(canGetMessages, "Wrong NetQueue type for getMessage.");
-	ASSERT(messagePos != messages.begin(), "No message to get!");
+	ASSERT(messagePos < messages.size(), "No message to get!");
 
 	// Return the message.
-	List::iterator i = messagePos;
-	--i;
-	return *i;
+	const StoredMessage &message = messages[messagePos];
+	return NetMessageView(message.type, message.data, message.size);
 }
 
 void NetQueue::popMessage()
 {
 	ASSERT(canGetMessages, "Wrong NetQueue type for popMessage.");
-	ASSERT(messagePos != messages.begin(), "No message to pop!");
+	ASSERT(messagePos < messages.size(), "No message to pop!");
 
 	// Pop the message.
-	--messagePos;
+	++messagePos;
 
 	// Recycle old data.
 	popOldMessages();
@@ -259,27 +327,43 @@ void NetQueue::popOldMessages()
 {
 	if (!canGetMessagesForNet)
 	{
-		dataPos = messages.begin();
+		dataPos = messages.size();
 	}
 	if (!canGetMessages)
 	{
-		messagePos = messages.begin();
+		messagePos = messages.size();
 	}
 
-	List::iterator i = messages.end();
-	while (i != dataPos && i != messagePos)
-	{
-		--i;
-	}
+	size_t pop = std::min(dataPos, messagePos);
+	dataPos -= pop;
+	messagePos -= pop;
 
-	if (i == dataPos)
-	{
-		dataPos = messages.end();  // Old iterator will become invalid.
-	}
-	if (i == messagePos)
+	for (; pop > 0; --pop)
 	{
-		messagePos = messages.end();  // Old iterator will become invalid.
+		// Messages use their chunks in order, so the oldest message is always in the oldest chunk.
+		size_t size = messages.front().size;
+		messages.pop_front();
+		if (size == 0)
+		{
+			continue;
+		}
+		Chunk &chunk = chunks.front();
+		chunk.freed += size;
+		if (chunk.freed == chunk.used)
+		{
+			if (chunks.size() == 1)
+			{
+				chunk.used = 0;  // Last chunk, start filling it from the beginning again.
+				chunk.freed = 0;
+			}
+			else
+			{
+				if (chunk.capacity == netQueueChunkSize && spareChunks.size() < 4)
+				{
+					spareChunks.push_back(std::move(chunk));
+				}
+				chunks.pop_front();
+			}
+		}
 	}
-
-	messages.erase(i, messages.end());
 }
@@ -26,8 +26,8 @@
 
 #include "lib/framework/frame.h"
 #include <vector>
-#include <list>
 #include <deque>
+#include <memory>
 
 // At game level:
 // There should be a NetQueue representing each client.
@@ -40,13 +40,35 @@
 // There should be a NetQueuePair per socket.
 
 
+/// A NetMessageView is a NetMessage without its own copy of the data. It is only valid as long as the message it was taken from.
+class NetMessageView
+{
+public:
+	NetMessageView(uint8_t type_ = 0xFF, const uint8_t *data_ = nullptr, size_t size_ = 0) : type(type_), data(data_), size(size_) {}
+	uint8_t *rawDataDup() const;  ///< Returns data compatible with NetQueue::writeRawData(). Must be delete[]d.
+	size_t rawLen() const;        ///< Returns the length of the return value of rawDataDup().
+	uint8_t type;
+	const uint8_t *data;
+	size_t size;
+};
+
 /// A NetMessage consists of a type (uint8_t) and some data, the meaning of which depends on the type.
 class NetMessage
 {
 public:
 	NetMessage(uint8_t type_ = 0xFF) : type(type_) {}
-	uint8_t *rawDataDup() const;  ///< Returns data compatible with NetQueue::writeRawData(). Must be delete[]d.
-	size_t rawLen() const;        ///< Returns the length of the return value of rawDataDup().
+	NetMessageView view() const
+	{
+		return NetMessageView(type, data.empty() ? nullptr : &data[0], data.size());
+	}
+	uint8_t *rawDataDup() const  ///< Returns data compatible with NetQueue::writeRawData(). Must be delete[]d.
+	{
+		return view().rawDataDup();
+	}
+	size_t rawLen() const        ///< Returns the length of the return value of rawDataDup().
+	{
+		return view().rawLen();
+	}
 	uint8_t type;
 	std::vector<uint8_t> data;
 };
@@ -63,6 +85,10 @@ public:
 	{
 		message->data.push_back(v);
 	}
+	void bytes(const uint8_t *v, size_t size) const
+	{
+		message->data.insert(message->data.end(), v, v + size);
+	}
 	bool valid() const
 	{
 		return true;
@@ -70,27 +96,30 @@ public:
 	NetMessage *message;
 };
 /// MessageReader is used for deserialising, using the same interface as MessageWriter.
+/// Reads straight from the message data, so the message must outlive the reader.
 class MessageReader
 {
 public:
 	enum { Read, Write, Direction = Read };
 
-	MessageReader(const NetMessage *m = nullptr) : message(m), index(0) {}
-	MessageReader(const NetMessage &m) : message(&m), index(0) {}
+	MessageReader(const NetMessage *m = nullptr) : message(m ? m->view() : NetMessageView()), index(0) {}
+	MessageReader(const NetMessage &m) : message(m.view()), index(0) {}
+	MessageReader(NetMessageView m) : message(m), index(0) {}
 	void byte(uint8_t &v) const
 	{
-		v = index >= message->data.size() ? 0x00 : message->data[index];
+		v = index >= message.size ? 0x00 : message.data[index];
 		++index;
 	}
 	bool valid() const
 	{
-		return index <= message->data.size();
+		return index <= message.size;
 	}
-	const NetMessage *message;
+	NetMessageView message;
 	mutable size_t index;
 };
 
 /// A NetQueue is a queue of NetMessages. A NetQueue can convert the messages into a stream of bytes, which can be sent over the network, and converted back into a queue of NetMessages by the NetQueue at the other end.
+/// The message data is kept in a few large chunks, recycled in order as messages are popped, instead of a separate allocation per message.
 class NetQueue
 {
 public:
@@ -101,19 +130,35 @@ public:
 	// Network related, sending
 	void setWillNeverGetMessagesForNet();                              ///< Marks that we will not be sending this data over the network.
 	unsigned numMessagesForNet() const;                                ///< Checks that we didn't mark that we will not be sending this data over the network (returns 0), and returns the number of messages to be sent.
-	const NetMessage &getMessageForNet() const;                        ///< Extracts data from the NetQueue to send over the network.
+	NetMessageView getMessageForNet() const;                           ///< Extracts data from the NetQueue to send over the network. Valid until popped.
 	void popMessageForNet();                                           ///< Pops the extracted data, so that future getMessageForNet calls do not return that data.
 
 	// All game clients should check game messages from all queues, including their own, and only the net messages sent to them.
 	// Message related, storing.
 	void pushMessage(const NetMessage &message);                       ///< Adds a message to the queue.
+	void pushMessage(NetMessageView message);                          ///< Adds a message to the queue.
 	// Message related, extracting.
 	void setWillNeverGetMessages();                                    ///< Marks that we will not be reading any of the messages (only sending over the network).
 	bool haveMessage() const;                                          ///< Return true if we have a message ready to return.
-	const NetMessage &getMessage() const;                              ///< Returns a message.
+	NetMessageView getMessage() const;                                 ///< Returns a message, valid until popped.
 	void popMessage();                                                 ///< Pops the last returned message.
 
 private:
+	struct StoredMessage
+	{
+		uint8_t type;
+		uint32_t size;
+		uint8_t *data;                                                 ///< Points into one of the chunks.
+	};
+	struct Chunk
+	{
+		std::unique_ptr<uint8_t[]> data;
+		size_t capacity;
+		size_t used;                                                   ///< Bytes handed out to messages.
+		size_t freed;                                                  ///< Bytes of popped messages.
+	};
+
+	uint8_t *allocMessageData(size_t size);                            ///< Returns room for the data of a new message, after the data of all earlier messages.
 	void popOldMessages();                                             ///< Pops any messages that are no longer needed.
 
 	// Disable copy constructor and assignment operator.
@@ -123,10 +168,11 @@ private:
 	bool canGetMessagesForNet;                                         ///< True if we will send the messages over the network, false if we don't.
 	bool canGetMessages;                                               ///< True if we will get the messages, false if we don't use them ourselves.
 
-	typedef std::list<NetMessage> List;
-	List::iterator                dataPos;                             ///< Last message which was sent over the network.
-	List::iterator                messagePos;                          ///< Last message which was popped.
-	List                          messages;                            ///< List of messages. Messages are added to the front and read from the back.
+	size_t                        dataPos;                             ///< Number of messages at the front which were sent over the network.
+	size_t                        messagePos;                          ///< Number of messages at the front which were popped.
+	std::deque<StoredMessage>     messages;                            ///< Messages are added to the back and read from the front.
+	std::deque<Chunk>             chunks;                              ///< Message data, in the same order as messages.
+	std::vector<Chunk>            spareChunks;                         ///< Chunks whose messages have all been popped, ready to be reused.
 	std::vector<uint8_t>          incompleteReceivedMessageData;       ///< Data from network which has not yet formed an entire message.
 };
 
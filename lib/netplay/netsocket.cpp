@@ -29,12 +29,28 @@
 
 #include <vector>
 #include <algorithm>
-#include <map>
+#include <chrono>
+
+#if defined(WZ_OS_LINUX)
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+# define WZ_SOCKET_EPOLL
+#endif
+#if defined(WZ_OS_UNIX)
+# include <sys/uio.h>
+#endif
 
 #if !defined(ZLIB_CONST)
 #  define ZLIB_CONST
 #endif
 #include <zlib.h>
+#if defined(WZ_NETPLAY_ZSTD)
+# include <zstd.h>
+
+// Window our zstd streams are compressed with, 128 KiB. Also the most a peer may ask us to allocate for
+// decompressing, since the window is otherwise whatever the frame header says.
+# define NET_ZSTD_WINDOW_LOG 17
+#endif
 
 #if defined(__clang__)
 	#pragma clang diagnostic ignored "-Wshorten-64-to-32" // FIXME!!
@@ -48,6 +64,80 @@ enum
 	SOCK_COUNT,
 };
 
+/// Data waiting for the socket thread to send it. A ring buffer, so sending from the front doesn't move the rest.
+struct SocketWriteQueue
+{
+	bool empty() const
+	{
+		return used == 0;
+	}
+
+	void push(const uint8_t *src, size_t size)
+	{
+		if (used + size > data.size())
+		{
+			grow(used + size);
+		}
+		size_t end = (start + used) & (data.size() - 1);
+		size_t first = std::min(size, data.size() - end);
+		memcpy(&data[end], src, first);
+		memcpy(&data[0], src + first, size - first);
+		used += size;
+	}
+
+	void pop(size_t size)
+	{
+		ASSERT(size <= used, "Popping more than queued");
+		start = (start + size) & (data.size() - 1);
+		used -= size;
+		if (used == 0)
+		{
+			start = 0;  // Keep the next burst contiguous.
+		}
+	}
+
+	/// Returns the queued data as at most two spans, in order, and how many spans there are.
+	unsigned spans(const uint8_t *span[2], size_t spanSize[2]) const
+	{
+		span[0] = &data[start];
+		spanSize[0] = std::min(used, data.size() - start);
+		span[1] = &data[0];
+		spanSize[1] = used - spanSize[0];
+		return spanSize[1] != 0 ? 2 : 1;
+	}
+
+	void clear()
+	{
+		start = 0;
+		used = 0;
+	}
+
+private:
+	void grow(size_t minSize)
+	{
+		size_t newSize = std::max<size_t>(data.size(), 4096);
+		while (newSize < minSize)
+		{
+			newSize *= 2;
+		}
+		std::vector<uint8_t> newData(newSize);
+		if (used != 0)
+		{
+			const uint8_t *span[2];
+			size_t spanSize[2];
+			spans(span, spanSize);
+			memcpy(&newData[0], span[0], spanSize[0]);
+			memcpy(&newData[spanSize[0]], span[1], spanSize[1]);
+		}
+		data.swap(newData);
+		start = 0;
+	}
+
+	std::vector<uint8_t> data;  ///< Size is always zero or a power of two.
+	size_t start = 0;
+	size_t used = 0;
+};
+
 struct Socket
 {
 	/* Multiple socket handles only for listening sockets. This allows us
@@ -56,7 +146,7 @@ struct Socket
 	 *
 	 * All non-listening sockets will only use the first socket handle.
 	 */
-	Socket() : ready(false), writeError(false), deleteLater(false), isCompressed(false), readDisconnected(false), zDeflateInSize(0)
+	Socket() : ready(false), writeError(false), deleteLater(false), writePending(false), isCompressed(false), readDisconnected(false), zDeflateInSize(0)
 	{
 		memset(&zDeflate, 0, sizeof(zDeflate));
 		memset(&zInflate, 0, sizeof(zInflate));
@@ -67,6 +157,8 @@ struct Socket
 	bool ready;
 	bool writeError;
 	bool deleteLater;
+	bool writePending;          ///< True iff the socket thread has writeQueue to send, guarded by socketThreadMutex.
+	SocketWriteQueue writeQueue;
 	char textAddress[40];
 
 	bool isCompressed;
@@ -76,12 +168,23 @@ struct Socket
 	unsigned zDeflateInSize;
 	bool zInflateNeedInput;
 	std::vector<uint8_t> zDeflateOutBuf;
-	std::vector<uint8_t> zInflateInBuf;
+	std::vector<uint8_t> zInflateInBuf;  ///< Received data not yet decompressed is at zInflate.next_in, whichever the codec.
+	SocketCodec sendCodec = SOCKET_CODEC_ZLIB;
+	SocketCodec receiveCodec = SOCKET_CODEC_ZLIB;
+	bool receiveCodecSwitch = false;     ///< True iff the other end ended its compressed stream, so the next byte received names the next codec.
+#if defined(WZ_NETPLAY_ZSTD)
+	ZSTD_CCtx *zstdCompress = nullptr;
+	ZSTD_DCtx *zstdDecompress = nullptr;
+#endif
 };
 
 struct SocketSet
 {
 	std::vector<Socket *> fds;
+#if defined(WZ_SOCKET_EPOLL)
+	int epollFd = -1;              ///< Sockets of sets from allocSocketSet() stay registered here, instead of being passed to select() on each check.
+	std::vector<SOCKET> epollFds;  ///< The descriptors registered with epollFd, matching fds.
+#endif
 };
 
 
@@ -89,8 +192,11 @@ static WZ_MUTEX *socketThreadMutex;
 static WZ_SEMAPHORE *socketThreadSemaphore;
 static WZ_THREAD *socketThread = nullptr;
 static bool socketThreadQuit;
-typedef std::map<Socket *, std::vector<uint8_t>> SocketThreadWriteMap;
-static SocketThreadWriteMap socketThreadWrites;
+static std::vector<Socket *> socketThreadWrites;  ///< Sockets with writePending set.
+#if defined(WZ_SOCKET_EPOLL)
+static int socketThreadEpoll = -1;    ///< Sockets in socketThreadWrites wait here for EPOLLOUT, or -1 to use select().
+static int socketThreadWakeup = -1;   ///< eventfd, to wake up the socket thread for quitting.
+#endif
 
 
 static void socketCloseNow(Socket *sock);
@@ -350,7 +456,8 @@ const char *strSockError(int error)
  */
 static bool connectionIsOpen(Socket *sock)
 {
-	const SocketSet set = {std::vector<Socket *>(1, sock)};
+	SocketSet set;
+	set.fds.push_back(sock);
 
 	ASSERT_OR_RETURN((setSockErr(EBADF), false),
 	                 sock && sock->fd[SOCK_CONNECTION] != INVALID_SOCKET, "Invalid socket");
@@ -392,9 +499,173 @@ static bool connectionIsOpen(Socket *sock)
 	return true;
 }
 
-static int socketThreadFunction(void *)
+static void socketWriteDone(Socket *sock);
+
+/// Queue data for the socket thread to send; call with socketThreadMutex held.
+static void socketQueueWrite(Socket *sock, const uint8_t *data, size_t size)
 {
-	wzMutexLock(socketThreadMutex);
+	sock->writeQueue.push(data, size);
+	if (sock->writePending)
+	{
+		return;  // Already waiting to be written.
+	}
+	sock->writePending = true;
+	socketThreadWrites.push_back(sock);
+
+#if defined(WZ_SOCKET_EPOLL)
+	if (socketThreadEpoll != -1)
+	{
+		// Adding the socket wakes up the socket thread as soon as it can be written to.
+		struct epoll_event event;
+		event.events = EPOLLOUT;
+		event.data.ptr = sock;
+		if (epoll_ctl(socketThreadEpoll, EPOLL_CTL_ADD, sock->fd[SOCK_CONNECTION], &event) == SOCKET_ERROR)
+		{
+			debug(LOG_ERROR, "epoll_ctl failed: %s", strSockError(getSockErr()));
+			sock->writeError = true;
+			socketWriteDone(sock);  // The socket thread would never get to it.
+		}
+		return;
+	}
+#endif
+	if (socketThreadWrites.size() == 1)
+	{
+		wzSemaphorePost(socketThreadSemaphore);
+	}
+}
+
+/// Stop trying to write to the socket, and delete it if it was waiting for that; call with socketThreadMutex held.
+static void socketWriteDone(Socket *sock)
+{
+	sock->writePending = false;
+	sock->writeQueue.clear();
+	auto i = std::find(socketThreadWrites.begin(), socketThreadWrites.end(), sock);
+	ASSERT(i != socketThreadWrites.end(), "Pending socket not in socketThreadWrites");
+	if (i != socketThreadWrites.end())
+	{
+		*i = socketThreadWrites.back();
+		socketThreadWrites.pop_back();
+	}
+
+#if defined(WZ_SOCKET_EPOLL)
+	if (socketThreadEpoll != -1)
+	{
+		struct epoll_event event = {};  // Kernels before 2.6.9 want an event, even if it's ignored.
+		epoll_ctl(socketThreadEpoll, EPOLL_CTL_DEL, sock->fd[SOCK_CONNECTION], &event);
+	}
+#endif
+
+	if (sock->deleteLater)
+	{
+		socketCloseNow(sock);
+	}
+}
+
+/// Send as much of the write queue as the socket takes in one call; call with socketThreadMutex held.
+static void socketThreadSend(Socket *sock)
+{
+	const uint8_t *span[2];
+	size_t spanSize[2];
+	unsigned spanCount = sock->writeQueue.spans(span, spanSize);
+
+	// Both parts of the ring go out in a single call.
+	// FIXME SOMEHOW AAARGH This send() call can't block, but unless the socket is not set to blocking (setting the socket to nonblocking had better work, or else), does anyway (at least sometimes, when someone quits). Not reproducible except in public releases.
+#if   defined(WZ_OS_UNIX)
+	struct iovec iov[2];
+	for (unsigned i = 0; i < spanCount; ++i)
+	{
+		iov[i].iov_base = const_cast<uint8_t *>(span[i]);
+		iov[i].iov_len = spanSize[i];
+	}
+	struct msghdr msg = {};
+	msg.msg_iov = iov;
+	msg.msg_iovlen = spanCount;
+	ssize_t retSent = sendmsg(sock->fd[SOCK_CONNECTION], &msg, MSG_NOSIGNAL);  // Like writev(), but without raising SIGPIPE.
+#elif defined(WZ_OS_WIN)
+	WSABUF buffers[2];
+	for (unsigned i = 0; i < spanCount; ++i)
+	{
+		buffers[i].buf = reinterpret_cast<char *>(const_cast<uint8_t *>(span[i]));
+		buffers[i].len = static_cast<ULONG>(spanSize[i]);
+	}
+	DWORD bytesSent = 0;
+	ssize_t retSent = WSASend(sock->fd[SOCK_CONNECTION], buffers, spanCount, &bytesSent, 0, nullptr, nullptr) == 0 ? static_cast<ssize_t>(bytesSent) : SOCKET_ERROR;
+#endif
+	if (retSent != SOCKET_ERROR)
+	{
+		// Drop as much data as written.
+		sock->writeQueue.pop(retSent);
+		if (sock->writeQueue.empty())
+		{
+			socketWriteDone(sock);  // Nothing left to write, delete from pending list.
+		}
+		return;
+	}
+
+	switch (getSockErr())
+	{
+	case EAGAIN:
+#if defined(EWOULDBLOCK) && EAGAIN != EWOULDBLOCK
+	case EWOULDBLOCK:
+#endif
+		if (!connectionIsOpen(sock))
+		{
+			debug(LOG_NET, "Socket error");
+			sock->writeError = true;
+			socketWriteDone(sock);  // Socket broken, don't try writing to it again.
+			break;
+		}
+	case EINTR:
+		break;
+#if defined(EPIPE)
+	case EPIPE:
+#endif
+	default:
+		sock->writeError = true;
+		socketWriteDone(sock);  // Socket broken, don't try writing to it again.
+		break;
+	}
+}
+
+#if defined(WZ_SOCKET_EPOLL)
+/// Socket thread loop, sleeping in epoll_wait() until a socket with queued data can be written to.
+static void socketThreadEpollLoop()
+{
+	while (!socketThreadQuit)
+	{
+		struct epoll_event events[64];
+
+		wzMutexUnlock(socketThreadMutex);
+		int ret = epoll_wait(socketThreadEpoll, events, ARRAY_SIZE(events), -1);
+		wzMutexLock(socketThreadMutex);
+
+		if (ret == SOCKET_ERROR && getSockErr() != EINTR)
+		{
+			debug(LOG_ERROR, "epoll_wait failed: %s", strSockError(getSockErr()));
+		}
+		for (int i = 0; i < ret && !socketThreadQuit; ++i)
+		{
+			Socket *sock = static_cast<Socket *>(events[i].data.ptr);
+			if (sock == nullptr)
+			{
+				uint64_t count;
+				ssize_t ignored = read(socketThreadWakeup, &count, sizeof(count));  // Just clear the eventfd, socketThreadQuit says what to do.
+				(void)ignored;
+			}
+			// Only this thread removes sockets from the epoll set, and sockets with data to write aren't deleted by anyone else, so sock is still valid.
+			else if (sock->writePending)
+			{
+				socketThreadSend(sock);
+			}
+		}
+	}
+}
+#endif
+
+/// Socket thread loop for systems without epoll, polling the sockets with queued data every 50 ms.
+static void socketThreadSelectLoop()
+{
+	std::vector<Socket *> writable;
 	while (!socketThreadQuit)
 	{
 #if   defined(WZ_OS_UNIX)
@@ -404,15 +675,12 @@ static int socketThreadFunction(void *)
 #endif
 		fd_set fds;
 		FD_ZERO(&fds);
-		for (SocketThreadWriteMap::iterator i = socketThreadWrites.begin(); i != socketThreadWrites.end(); ++i)
+		for (Socket *sock : socketThreadWrites)
 		{
-			if (!i->second.empty())
-			{
-				SOCKET fd = i->first->fd[SOCK_CONNECTION];
-				maxfd = std::max(maxfd, fd);
-				ASSERT(!FD_ISSET(fd, &fds), "Duplicate file descriptor!");  // Shouldn't be possible, but blocking in send, after select says it won't block, shouldn't be possible either.
-				FD_SET(fd, &fds);
-			}
+			SOCKET fd = sock->fd[SOCK_CONNECTION];
+			maxfd = std::max(maxfd, fd);
+			ASSERT(!FD_ISSET(fd, &fds), "Duplicate file descriptor!");  // Shouldn't be possible, but blocking in send, after select says it won't block, shouldn't be possible either.
+			FD_SET(fd, &fds);
 		}
 		struct timeval tv = {0, 50 * 1000};
 
@@ -424,71 +692,19 @@ static int socketThreadFunction(void *)
 		// We can write to some sockets. (Ignore errors from select, we may have deleted the socket after unlocking the mutex, and before calling select.)
 		if (ret > 0)
 		{
-			for (SocketThreadWriteMap::iterator i = socketThreadWrites.begin(); i != socketThreadWrites.end();)
+			writable.clear();
+			for (Socket *sock : socketThreadWrites)
 			{
-				SocketThreadWriteMap::iterator w = i;
-				++i;
-
-				Socket *sock = w->first;
-				std::vector<uint8_t> &writeQueue = w->second;
-				ASSERT(!writeQueue.empty(), "writeQueue[sock] must not be empty.");
-
-				if (!FD_ISSET(sock->fd[SOCK_CONNECTION], &fds))
-				{
-					continue;  // This socket is not ready for writing, or we don't have anything to write.
-				}
-
-				// Write data.
-				// FIXME SOMEHOW AAARGH This send() call can't block, but unless the socket is not set to blocking (setting the socket to nonblocking had better work, or else), does anyway (at least sometimes, when someone quits). Not reproducible except in public releases.
-				ssize_t retSent = send(sock->fd[SOCK_CONNECTION], reinterpret_cast<char *>(&writeQueue[0]), writeQueue.size(), MSG_NOSIGNAL);
-				if (retSent != SOCKET_ERROR)
-				{
-					// Erase as much data as written.
-					writeQueue.erase(writeQueue.begin(), writeQueue.begin() + retSent);
-					if (writeQueue.empty())
-					{
-						socketThreadWrites.erase(w);  // Nothing left to write, delete from pending list.
-						if (sock->deleteLater)
-						{
-							socketCloseNow(sock);
-						}
-					}
-				}
-				else
+				if (FD_ISSET(sock->fd[SOCK_CONNECTION], &fds))
 				{
-					switch (getSockErr())
-					{
-					case EAGAIN:
-#if defined(EWOULDBLOCK) && EAGAIN != EWOULDBLOCK
-					case EWOULDBLOCK:
-#endif
-						if (!connectionIsOpen(sock))
-						{
-							debug(LOG_NET, "Socket error");
-							sock->writeError = true;
-							socketThreadWrites.erase(w);  // Socket broken, don't try writing to it again.
-							if (sock->deleteLater)
-							{
-								socketCloseNow(sock);
-							}
-							break;
-						}
-					case EINTR:
-						break;
-#if defined(EPIPE)
-					case EPIPE:
-#endif
-					default:
-						sock->writeError = true;
-						socketThreadWrites.erase(w);  // Socket broken, don't try writing to it again.
-						if (sock->deleteLater)
-						{
-							socketCloseNow(sock);
-						}
-						break;
-					}
+					writable.push_back(sock);
 				}
 			}
+			// Sending may remove sockets from socketThreadWrites, so don't iterate over it meanwhile.
+			for (Socket *sock : writable)
+			{
+				socketThreadSend(sock);
+			}
 		}
 
 		if (socketThreadWrites.empty())
@@ -499,11 +715,315 @@ static int socketThreadFunction(void *)
 			wzMutexLock(socketThreadMutex);
 		}
 	}
+}
+
+static int socketThreadFunction(void *)
+{
+	wzMutexLock(socketThreadMutex);
+#if defined(WZ_SOCKET_EPOLL)
+	if (socketThreadEpoll != -1)
+	{
+		socketThreadEpollLoop();
+	}
+	else
+#endif
+	{
+		socketThreadSelectLoop();
+	}
 	wzMutexUnlock(socketThreadMutex);
 
 	return 42;  // Return value arbitrary and unused.
 }
 
+static SocketCodecStats codecStats[SOCKET_CODEC_COUNT];  ///< Only touched by the main thread, which does all the (de)compression.
+
+static uint64_t codecMicroseconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+const char *socketCodecName(SocketCodec codec)
+{
+	switch (codec)
+	{
+	case SOCKET_CODEC_ZLIB: return "zlib";
+	case SOCKET_CODEC_ZSTD: return "zstd";
+	default:                return "unknown";
+	}
+}
+
+uint32_t socketSupportedCodecs()
+{
+	uint32_t codecs = 1u << SOCKET_CODEC_ZLIB;
+#if defined(WZ_NETPLAY_ZSTD)
+	codecs |= 1u << SOCKET_CODEC_ZSTD;
+#endif
+	return codecs;
+}
+
+SocketCodec socketPreferredCodec(uint32_t codecs)
+{
+	codecs &= socketSupportedCodecs();
+	if (codecs & (1u << SOCKET_CODEC_ZSTD))
+	{
+		return SOCKET_CODEC_ZSTD;  // Much less CPU time than zlib, for about the same ratio.
+	}
+	return SOCKET_CODEC_ZLIB;
+}
+
+SocketCodecStats const &socketGetCodecStats(SocketCodec codec)
+{
+	ASSERT(codec < SOCKET_CODEC_COUNT, "Bad codec %d", (int)codec);
+	return codecStats[std::min<unsigned>(codec, SOCKET_CODEC_COUNT - 1)];
+}
+
+enum CompressMode
+{
+	COMPRESS_CONTINUE,  ///< Buffer the data as the codec likes.
+	COMPRESS_FLUSH,     ///< Make the other end able to decompress everything so far.
+	COMPRESS_END,       ///< Flush, and end the stream, before switching codecs.
+};
+
+/// Compresses size bytes of buf with the socket's send codec, adding the output to sock->zDeflateOutBuf.
+static void socketCompress(Socket *sock, const void *buf, size_t size, CompressMode mode)
+{
+	const auto start = std::chrono::steady_clock::now();
+	SocketCodecStats &stats = codecStats[sock->sendCodec];
+	const size_t alreadyHad = sock->zDeflateOutBuf.size();
+
+#if defined(WZ_NETPLAY_ZSTD)
+	if (sock->sendCodec == SOCKET_CODEC_ZSTD)
+	{
+		ZSTD_inBuffer in = {buf, size, 0};
+		const ZSTD_EndDirective directive = mode == COMPRESS_CONTINUE ? ZSTD_e_continue : mode == COMPRESS_FLUSH ? ZSTD_e_flush : ZSTD_e_end;
+		size_t remaining = 0;
+		do
+		{
+			size_t alreadyHave = sock->zDeflateOutBuf.size();
+			sock->zDeflateOutBuf.resize(alreadyHave + std::max(size - in.pos, remaining) + 64);
+			ZSTD_outBuffer out = {&sock->zDeflateOutBuf[0], sock->zDeflateOutBuf.size(), alreadyHave};
+			remaining = ZSTD_compressStream2(sock->zstdCompress, &out, &in, directive);
+			ASSERT(!ZSTD_isError(remaining), "zstd compression failed: %s", ZSTD_getErrorName(remaining));
+
+			// Remove unused part of buffer.
+			sock->zDeflateOutBuf.resize(out.pos);
+			if (ZSTD_isError(remaining))
+			{
+				break;
+			}
+		}
+		while (in.pos < in.size || (directive != ZSTD_e_continue && remaining != 0));
+	}
+	else
+#endif
+	{
+	#if ZLIB_VERNUM < 0x1252
+		// zlib < 1.2.5.2 does not support `#define ZLIB_CONST`
+		// Unfortunately, some OSes (ex. OpenBSD) ship with zlib < 1.2.5.2
+		// Workaround: cast away the const of the input, and disable the resulting -Wcast-qual warning
+		#if defined(__clang__)
+		#  pragma clang diagnostic push
+		#  pragma clang diagnostic ignored "-Wcast-qual"
+		#elif defined(__GNUC__)
+		#  pragma GCC diagnostic push
+		#  pragma GCC diagnostic ignored "-Wcast-qual"
+		#endif
+
+		// cast away the const for earlier zlib versions
+		sock->zDeflate.next_in = (Bytef *)buf; // -Wcast-qual
+
+		#if defined(__clang__)
+		#  pragma clang diagnostic pop
+		#elif defined(__GNUC__)
+		#  pragma GCC diagnostic pop
+		#endif
+	#else
+		// zlib >= 1.2.5.2 supports ZLIB_CONST
+		sock->zDeflate.next_in = (const Bytef *)buf;
+	#endif
+
+		sock->zDeflate.avail_in = size;
+		const int flush = mode == COMPRESS_CONTINUE ? Z_NO_FLUSH : mode == COMPRESS_FLUSH ? Z_PARTIAL_FLUSH : Z_FINISH;
+		do
+		{
+			size_t alreadyHave = sock->zDeflateOutBuf.size();
+			sock->zDeflateOutBuf.resize(alreadyHave + size + (mode == COMPRESS_CONTINUE ? 20 : 1000));  // A bit more than size should be enough to always do everything in one go, and 1000 to flush the rest.
+			sock->zDeflate.next_out = (Bytef *)&sock->zDeflateOutBuf[alreadyHave];
+			sock->zDeflate.avail_out = sock->zDeflateOutBuf.size() - alreadyHave;
+
+			int ret = deflate(&sock->zDeflate, flush);
+			ASSERT(ret != Z_STREAM_ERROR, "zlib compression failed!");
+
+			// Remove unused part of buffer.
+			sock->zDeflateOutBuf.resize(sock->zDeflateOutBuf.size() - sock->zDeflate.avail_out);
+		}
+		while (sock->zDeflate.avail_out == 0);
+
+		ASSERT(sock->zDeflate.avail_in == 0, "zlib didn't compress everything!");
+	}
+
+	stats.uncompressedBytesSent += size;
+	stats.rawBytesSent += sock->zDeflateOutBuf.size() - alreadyHad;
+	stats.compressMicroseconds += codecMicroseconds(start);
+}
+
+/// Starts a fresh stream in the socket's send codec.
+static void socketResetCompressor(Socket *sock)
+{
+#if defined(WZ_NETPLAY_ZSTD)
+	if (sock->sendCodec == SOCKET_CODEC_ZSTD)
+	{
+		if (sock->zstdCompress == nullptr)
+		{
+			sock->zstdCompress = ZSTD_createCCtx();
+		}
+		ZSTD_CCtx_reset(sock->zstdCompress, ZSTD_reset_session_only);
+		ZSTD_CCtx_setParameter(sock->zstdCompress, ZSTD_c_compressionLevel, 1);  // Fast, still about as small as zlib level 6 for our messages.
+		ZSTD_CCtx_setParameter(sock->zstdCompress, ZSTD_c_windowLog, NET_ZSTD_WINDOW_LOG);
+		return;
+	}
+#endif
+	deflateReset(&sock->zDeflate);
+}
+
+/// Starts a fresh stream in the socket's receive codec, returning false if this build doesn't have the codec.
+static bool socketResetDecompressor(Socket *sock)
+{
+	switch (sock->receiveCodec)
+	{
+	case SOCKET_CODEC_ZLIB:
+		inflateReset(&sock->zInflate);
+		return true;
+#if defined(WZ_NETPLAY_ZSTD)
+	case SOCKET_CODEC_ZSTD:
+		if (sock->zstdDecompress == nullptr)
+		{
+			sock->zstdDecompress = ZSTD_createDCtx();
+			ZSTD_DCtx_setParameter(sock->zstdDecompress, ZSTD_d_windowLogMax, NET_ZSTD_WINDOW_LOG);  // Kept by ZSTD_reset_session_only.
+		}
+		ZSTD_DCtx_reset(sock->zstdDecompress, ZSTD_reset_session_only);
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+/**
+ * Decompresses pending input from sock->zInflate.next_in into buf, with the socket's receive codec.
+ * When the other end ended its stream to switch codecs, the next input byte names the codec of the
+ * next stream.
+ *
+ * @return the number of bytes decompressed, or -1 on bad data.
+ */
+static ssize_t socketDecompress(Socket *sock, void *buf, size_t max_size)
+{
+	const auto start = std::chrono::steady_clock::now();
+	size_t produced = 0;
+
+	for (;;)
+	{
+		if (sock->receiveCodecSwitch)
+		{
+			if (sock->zInflate.avail_in == 0)
+			{
+				break;  // Codec byte not here yet.
+			}
+			sock->receiveCodec = static_cast<SocketCodec>(*sock->zInflate.next_in);
+			++sock->zInflate.next_in;
+			--sock->zInflate.avail_in;
+			if (sock->receiveCodec >= SOCKET_CODEC_COUNT || !socketResetDecompressor(sock))
+			{
+				debug(LOG_ERROR, "Other end switched to unknown compression %u", (unsigned)sock->receiveCodec);
+				return -1;
+			}
+			sock->receiveCodecSwitch = false;
+			debug(LOG_NET, "Receiving %s compressed data on socket %p", socketCodecName(sock->receiveCodec), static_cast<void *>(sock));
+		}
+
+		const size_t inBefore = sock->zInflate.avail_in;
+		const size_t outBefore = produced;
+#if defined(WZ_NETPLAY_ZSTD)
+		if (sock->receiveCodec == SOCKET_CODEC_ZSTD)
+		{
+			ZSTD_inBuffer in = {sock->zInflate.next_in, sock->zInflate.avail_in, 0};
+			ZSTD_outBuffer out = {buf, max_size, produced};
+			size_t ret = ZSTD_decompressStream(sock->zstdDecompress, &out, &in);
+			if (ZSTD_isError(ret))
+			{
+				debug(LOG_ERROR, "Couldn't decompress data from socket. zstd error %s", ZSTD_getErrorName(ret));
+				return -1;  // Bad data!
+			}
+			sock->zInflate.next_in += in.pos;
+			sock->zInflate.avail_in -= in.pos;
+			produced = out.pos;
+			sock->receiveCodecSwitch = ret == 0;  // End of frame, only written before switching codecs.
+		}
+		else
+#endif
+		{
+			sock->zInflate.next_out = (Bytef *)buf + produced;
+			sock->zInflate.avail_out = max_size - produced;
+			int ret = inflate(&sock->zInflate, Z_NO_FLUSH);
+			ASSERT(ret != Z_STREAM_ERROR, "zlib inflate not working!");
+			char const *err = nullptr;
+			switch (ret)
+			{
+			case Z_NEED_DICT:  err = "Z_NEED_DICT";  break;
+			case Z_DATA_ERROR: err = "Z_DATA_ERROR"; break;
+			case Z_MEM_ERROR:  err = "Z_MEM_ERROR";  break;
+			}
+			if (err != nullptr)
+			{
+				debug(LOG_ERROR, "Couldn't decompress data from socket. zlib error %s", err);
+				return -1;  // Bad data!
+			}
+			produced = max_size - sock->zInflate.avail_out;
+			sock->receiveCodecSwitch = ret == Z_STREAM_END;
+		}
+
+		SocketCodecStats &stats = codecStats[sock->receiveCodec];
+		stats.rawBytesReceived += inBefore - sock->zInflate.avail_in;
+		stats.uncompressedBytesReceived += produced - outBefore;
+
+		if (produced == max_size || (sock->zInflate.avail_in == 0 && !sock->receiveCodecSwitch))
+		{
+			break;
+		}
+		if (sock->zInflate.avail_in == inBefore && produced == outBefore && !sock->receiveCodecSwitch)
+		{
+			break;  // No progress, shouldn't happen.
+		}
+	}
+
+	codecStats[sock->receiveCodec].decompressMicroseconds += codecMicroseconds(start);
+	return produced;
+}
+
+/// Hands the compressed data over to the socket thread, returning how much there was.
+static size_t socketQueueCompressed(Socket *sock)
+{
+	if (sock->zDeflateOutBuf.empty())
+	{
+		return 0;  // No data to flush out.
+	}
+
+	wzMutexLock(socketThreadMutex);
+	socketQueueWrite(sock, &sock->zDeflateOutBuf[0], sock->zDeflateOutBuf.size());
+	wzMutexUnlock(socketThreadMutex);
+
+	// Primitive network logging, uncomment to use.
+	//printf("Size %3u ->%3zu, buf =", sock->zDeflateInSize, sock->zDeflateOutBuf.size());
+	//for (unsigned n = 0; n < std::min<unsigned>(sock->zDeflateOutBuf.size(), 40); ++n) printf(" %02X", sock->zDeflateOutBuf[n]);
+	//printf("\n");
+
+	// Data sent, don't send again.
+	size_t rawBytes = sock->zDeflateOutBuf.size();
+	sock->zDeflateInSize = 0;
+	sock->zDeflateOutBuf.clear();
+	return rawBytes;
+}
+
 /**
  * Similar to read(2) with the exception that this function won't be
  * interrupted by signals (EINTR).
@@ -555,30 +1075,21 @@ ssize_t readNoInt(Socket *sock, void *buf, size_t max_size, size_t *rawByteCount
 			}
 		}
 
-		sock->zInflate.next_out = (Bytef *)buf;
-		sock->zInflate.avail_out = max_size;
-		int ret = inflate(&sock->zInflate, Z_NO_FLUSH);
-		ASSERT(ret != Z_STREAM_ERROR, "zlib inflate not working!");
-		char const *err = nullptr;
-		switch (ret)
+		ssize_t decompressed = socketDecompress(sock, buf, max_size);
+		if (decompressed < 0)
 		{
-		case Z_NEED_DICT:  err = "Z_NEED_DICT";  break;
-		case Z_DATA_ERROR: err = "Z_DATA_ERROR"; break;
-		case Z_MEM_ERROR:  err = "Z_MEM_ERROR";  break;
-		}
-		if (err != nullptr)
-		{
-			debug(LOG_ERROR, "Couldn't decompress data from socket. zlib error %s", err);
-			return -1;  // Bad data!
+			// Bad data! The stream can't be resynchronised, so the connection is lost.
+			setSockErr(ECONNRESET);
+			return SOCKET_ERROR;
 		}
 
-		if (sock->zInflate.avail_out != 0)
+		if ((size_t)decompressed < max_size)
 		{
 			sock->zInflateNeedInput = true;
-			ASSERT(sock->zInflate.avail_in == 0, "zlib not consuming all input!");
+			ASSERT(sock->zInflate.avail_in == 0, "Decompression not consuming all input!");
 		}
 
-		return max_size - sock->zInflate.avail_out;  // Got some data, return how much.
+		return decompressed;  // Got some data, return how much.
 	}
 
 	ssize_t received;
@@ -632,60 +1143,14 @@ ssize_t writeAll(Socket *sock, const void *buf, size_t size, size_t *rawByteCoun
 		if (!sock->isCompressed)
 		{
 			wzMutexLock(socketThreadMutex);
-			if (socketThreadWrites.empty())
-			{
-				wzSemaphorePost(socketThreadSemaphore);
-			}
-			std::vector<uint8_t> &writeQueue = socketThreadWrites[sock];
-			writeQueue.insert(writeQueue.end(), static_cast<char const *>(buf), static_cast<char const *>(buf) + size);
+			socketQueueWrite(sock, static_cast<uint8_t const *>(buf), size);
 			wzMutexUnlock(socketThreadMutex);
 			rawBytes = size;
 		}
 		else
 		{
-		#if ZLIB_VERNUM < 0x1252
-			// zlib < 1.2.5.2 does not support `#define ZLIB_CONST`
-			// Unfortunately, some OSes (ex. OpenBSD) ship with zlib < 1.2.5.2
-			// Workaround: cast away the const of the input, and disable the resulting -Wcast-qual warning
-			#if defined(__clang__)
-			#  pragma clang diagnostic push
-			#  pragma clang diagnostic ignored "-Wcast-qual"
-			#elif defined(__GNUC__)
-			#  pragma GCC diagnostic push
-			#  pragma GCC diagnostic ignored "-Wcast-qual"
-			#endif
-
-			// cast away the const for earlier zlib versions
-			sock->zDeflate.next_in = (Bytef *)buf; // -Wcast-qual
-
-			#if defined(__clang__)
-			#  pragma clang diagnostic pop
-			#elif defined(__GNUC__)
-			#  pragma GCC diagnostic pop
-			#endif
-		#else
-			// zlib >= 1.2.5.2 supports ZLIB_CONST
-			sock->zDeflate.next_in = (const Bytef *)buf;
-		#endif
-
-			sock->zDeflate.avail_in = size;
-			sock->zDeflateInSize += sock->zDeflate.avail_in;
-			do
-			{
-				size_t alreadyHave = sock->zDeflateOutBuf.size();
-				sock->zDeflateOutBuf.resize(alreadyHave + size + 20);  // A bit more than size should be enough to always do everything in one go.
-				sock->zDeflate.next_out = (Bytef *)&sock->zDeflateOutBuf[alreadyHave];
-				sock->zDeflate.avail_out = sock->zDeflateOutBuf.size() - alreadyHave;
-
-				int ret = deflate(&sock->zDeflate, Z_NO_FLUSH);
-				ASSERT(ret != Z_STREAM_ERROR, "zlib compression failed!");
-
-				// Remove unused part of buffer.
-				sock->zDeflateOutBuf.resize(sock->zDeflateOutBuf.size() - sock->zDeflate.avail_out);
-			}
-			while (sock->zDeflate.avail_out == 0);
-
-			ASSERT(sock->zDeflate.avail_in == 0, "zlib didn't compress everything!");
+			sock->zDeflateInSize += size;
+			socketCompress(sock, buf, size, COMPRESS_CONTINUE);
 		}
 	}
 
@@ -703,47 +1168,27 @@ void socketFlush(Socket *sock, size_t *rawByteCount)
 		return;  // Not compressed, so don't mess with zlib.
 	}
 
-	// Flush data out of zlib compression state.
-	do
-	{
-		sock->zDeflate.next_in = (Bytef *)nullptr;
-		sock->zDeflate.avail_in = 0;
-		size_t alreadyHave = sock->zDeflateOutBuf.size();
-		sock->zDeflateOutBuf.resize(alreadyHave + 1000);  // 100 bytes would probably be enough to flush the rest in one go.
-		sock->zDeflate.next_out = (Bytef *)&sock->zDeflateOutBuf[alreadyHave];
-		sock->zDeflate.avail_out = sock->zDeflateOutBuf.size() - alreadyHave;
-
-		int ret = deflate(&sock->zDeflate, Z_PARTIAL_FLUSH);
-		ASSERT(ret != Z_STREAM_ERROR, "zlib compression failed!");
-
-		// Remove unused part of buffer.
-		sock->zDeflateOutBuf.resize(sock->zDeflateOutBuf.size() - sock->zDeflate.avail_out);
-	}
-	while (sock->zDeflate.avail_out == 0);
-
-	if (sock->zDeflateOutBuf.empty())
-	{
-		return;  // No data to flush out.
-	}
+	// Flush data out of the compression state.
+	socketCompress(sock, nullptr, 0, COMPRESS_FLUSH);
+	rawBytes = socketQueueCompressed(sock);
+}
 
-	wzMutexLock(socketThreadMutex);
-	if (socketThreadWrites.empty())
+void socketSetSendCodec(Socket *sock, SocketCodec codec)
+{
+	ASSERT_OR_RETURN(, sock->isCompressed, "Socket not compressed");
+	ASSERT_OR_RETURN(, codec < SOCKET_CODEC_COUNT && (socketSupportedCodecs() & (1u << codec)) != 0, "Codec %d not supported", (int)codec);
+	if (codec == sock->sendCodec)
 	{
-		wzSemaphorePost(socketThreadSemaphore);
+		return;  // Nothing to do.
 	}
-	std::vector<uint8_t> &writeQueue = socketThreadWrites[sock];
-	writeQueue.insert(writeQueue.end(), sock->zDeflateOutBuf.begin(), sock->zDeflateOutBuf.end());
-	wzMutexUnlock(socketThreadMutex);
 
-	// Primitive network logging, uncomment to use.
-	//printf("Size %3u ->%3zu, buf =", sock->zDeflateInSize, sock->zDeflateOutBuf.size());
-	//for (unsigned n = 0; n < std::min<unsigned>(sock->zDeflateOutBuf.size(), 40); ++n) printf(" %02X", sock->zDeflateOutBuf[n]);
-	//printf("\n");
-
-	// Data sent, don't send again.
-	rawBytes = sock->zDeflateOutBuf.size();
-	sock->zDeflateInSize = 0;
-	sock->zDeflateOutBuf.clear();
+	// End the current stream, so the other end knows the codec byte that follows isn't compressed data.
+	socketCompress(sock, nullptr, 0, COMPRESS_END);
+	sock->zDeflateOutBuf.push_back(codec);
+	sock->sendCodec = codec;
+	socketResetCompressor(sock);
+	socketQueueCompressed(sock);
+	debug(LOG_NET, "Sending %s compressed data on socket %p", socketCodecName(codec), static_cast<void *>(sock));
 }
 
 void socketBeginCompression(Socket *sock)
@@ -781,17 +1226,35 @@ Socket::~Socket()
 	if (isCompressed)
 	{
 		deflateEnd(&zDeflate);
-		deflateEnd(&zInflate);
+		inflateEnd(&zInflate);
 	}
+#if defined(WZ_NETPLAY_ZSTD)
+	ZSTD_freeCCtx(zstdCompress);
+	ZSTD_freeDCtx(zstdDecompress);
+#endif
 }
 
 SocketSet *allocSocketSet()
 {
-	return new SocketSet;
+	SocketSet *set = new SocketSet;
+#if defined(WZ_SOCKET_EPOLL)
+	set->epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (set->epollFd == SOCKET_ERROR)
+	{
+		debug(LOG_WARNING, "Failed to create epoll set, using select instead: %s", strSockError(getSockErr()));
+	}
+#endif
+	return set;
 }
 
 void deleteSocketSet(SocketSet *set)
 {
+#if defined(WZ_SOCKET_EPOLL)
+	if (set->epollFd != -1)
+	{
+		close(set->epollFd);
+	}
+#endif
 	delete set;
 }
 
@@ -814,6 +1277,23 @@ void SocketSet_AddSocket(SocketSet *set, Socket *socket)
 
 	set->fds.push_back(socket);
 	debug(LOG_NET, "Socket added: set->fds[%lu] = %p", (unsigned long)i, static_cast<void *>(socket));
+
+#if defined(WZ_SOCKET_EPOLL)
+	if (set->epollFd != -1)
+	{
+		const SOCKET fd = socket->fd[SOCK_CONNECTION];
+		set->epollFds.push_back(fd);
+		struct epoll_event event;
+		event.events = EPOLLIN;
+		event.data.ptr = socket;
+		// EEXIST means a closed socket that was never removed left its descriptor number to this one, so take over the registration.
+		if (epoll_ctl(set->epollFd, EPOLL_CTL_ADD, fd, &event) == SOCKET_ERROR
+		    && (getSockErr() != EEXIST || epoll_ctl(set->epollFd, EPOLL_CTL_MOD, fd, &event) == SOCKET_ERROR))
+		{
+			debug(LOG_ERROR, "epoll_ctl failed for socket %p: %s", static_cast<void *>(socket), strSockError(getSockErr()));
+		}
+	}
+#endif
 }
 
 /**
@@ -826,6 +1306,20 @@ void SocketSet_DelSocket(SocketSet *set, Socket *socket)
 	{
 		debug(LOG_NET, "Socket %p erased (set->fds[%lu])", static_cast<void *>(socket), (unsigned long)i);
 		set->fds.erase(set->fds.begin() + i);
+
+#if defined(WZ_SOCKET_EPOLL)
+		if (set->epollFd != -1)
+		{
+			// The socket may be closed already, so use the descriptor it was added with, unless another socket of the set reuses it.
+			const SOCKET fd = set->epollFds[i];
+			set->epollFds.erase(set->epollFds.begin() + i);
+			if (std::find(set->epollFds.begin(), set->epollFds.end(), fd) == set->epollFds.end())
+			{
+				struct epoll_event event = {};
+				epoll_ctl(set->epollFd, EPOLL_CTL_DEL, fd, &event);  // Fails harmlessly if closing the socket removed it already.
+			}
+		}
+#endif
 	}
 }
 
@@ -922,6 +1416,43 @@ static void socketBlockSIGPIPE(const SOCKET fd, bool block_sigpipe)
 #endif
 }
 
+#if defined(WZ_SOCKET_EPOLL)
+/// checkSockets() for sets with an epoll set, which already knows the sockets to wait for.
+static int checkSocketsEpoll(const SocketSet *set, unsigned int timeout)
+{
+	std::vector<struct epoll_event> events(set->fds.size());
+	int ret;
+	do
+	{
+		ret = epoll_wait(set->epollFd, &events[0], events.size(), timeout);
+	}
+	while (ret == SOCKET_ERROR && getSockErr() == EINTR);
+
+	if (ret == SOCKET_ERROR)
+	{
+		debug(LOG_ERROR, "epoll_wait failed: %s", strSockError(getSockErr()));
+		return SOCKET_ERROR;
+	}
+
+	for (Socket *sock : set->fds)
+	{
+		sock->ready = false;
+	}
+	int ready = 0;
+	for (int i = 0; i < ret; ++i)
+	{
+		// Errors and hangups count as readable, like with select(), so that recv() reports them.
+		Socket *sock = static_cast<Socket *>(events[i].data.ptr);
+		if (std::find(set->fds.begin(), set->fds.end(), sock) != set->fds.end() && !sock->ready)
+		{
+			sock->ready = true;
+			++ready;
+		}
+	}
+	return ready;
+}
+#endif
+
 int checkSockets(const SocketSet *set, unsigned int timeout)
 {
 	if (set->fds.empty())
@@ -962,6 +1493,13 @@ int checkSockets(const SocketSet *set, unsigned int timeout)
 		return ret;
 	}
 
+#if defined(WZ_SOCKET_EPOLL)
+	if (set->epollFd != -1)
+	{
+		return checkSocketsEpoll(set, timeout);
+	}
+#endif
+
 	int ret;
 	fd_set fds;
 	do
@@ -1012,7 +1550,8 @@ ssize_t readAll(Socket *sock, void *buf, size_t size, unsigned int timeout)
 {
 	ASSERT(!sock->isCompressed, "readAll on compressed sockets not implemented.");
 
-	const SocketSet set = {std::vector<Socket *>(1, sock)};
+	SocketSet set;
+	set.fds.push_back(sock);
 
 	size_t received = 0;
 
@@ -1105,8 +1644,8 @@ static void socketCloseNow(Socket *sock)
 void socketClose(Socket *sock)
 {
 	wzMutexLock(socketThreadMutex);
-	//Instead of socketThreadWrites.erase(sock);, try sending the data before actually deleting.
-	if (socketThreadWrites.find(sock) != socketThreadWrites.end())
+	//Instead of dropping sock->writeQueue, try sending the data before actually deleting.
+	if (sock->writePending)
 	{
 		// Wait until the data is written, then delete the socket.
 		sock->deleteLater = true;
@@ -1665,6 +2204,22 @@ void deleteSocketAddress(SocketAddress *addr)
 	freeaddrinfo(addr);
 }
 
+#if defined(WZ_SOCKET_EPOLL)
+static void closeSocketThreadEpoll()
+{
+	if (socketThreadEpoll != -1)
+	{
+		close(socketThreadEpoll);
+		socketThreadEpoll = -1;
+	}
+	if (socketThreadWakeup != -1)
+	{
+		close(socketThreadWakeup);
+		socketThreadWakeup = -1;
+	}
+}
+#endif
+
 // ////////////////////////////////////////////////////////////////////////
 // setup stuff
 void SOCKETinit()
@@ -1697,6 +2252,19 @@ void SOCKETinit()
 		socketThreadQuit = false;
 		socketThreadMutex = wzMutexCreate();
 		socketThreadSemaphore = wzSemaphoreCreate(0);
+#if defined(WZ_SOCKET_EPOLL)
+		socketThreadEpoll = epoll_create1(EPOLL_CLOEXEC);
+		socketThreadWakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		struct epoll_event event;
+		event.events = EPOLLIN;
+		event.data.ptr = nullptr;
+		if (socketThreadEpoll == SOCKET_ERROR || socketThreadWakeup == SOCKET_ERROR
+		    || epoll_ctl(socketThreadEpoll, EPOLL_CTL_ADD, socketThreadWakeup, &event) == SOCKET_ERROR)
+		{
+			debug(LOG_WARNING, "Failed to set up epoll, using select instead: %s", strSockError(getSockErr()));
+			closeSocketThreadEpoll();
+		}
+#endif
 		socketThread = wzThreadCreate(socketThreadFunction, nullptr);
 		wzThreadStart(socketThread);
 	}
@@ -1708,15 +2276,34 @@ void SOCKETshutdown()
 	{
 		wzMutexLock(socketThreadMutex);
 		socketThreadQuit = true;
+		for (Socket *sock : socketThreadWrites)
+		{
+			sock->writePending = false;
+			sock->writeQueue.clear();
+		}
 		socketThreadWrites.clear();
 		wzMutexUnlock(socketThreadMutex);
 		wzSemaphorePost(socketThreadSemaphore);  // Wake up the thread, so it can quit.
+#if defined(WZ_SOCKET_EPOLL)
+		if (socketThreadWakeup != -1)
+		{
+			const uint64_t one = 1;
+			ssize_t ignored = write(socketThreadWakeup, &one, sizeof(one));
+			(void)ignored;
+		}
+#endif
 		wzThreadJoin(socketThread);
+#if defined(WZ_SOCKET_EPOLL)
+		closeSocketThreadEpoll();
+#endif
 		wzMutexDestroy(socketThreadMutex);
 		wzSemaphoreDestroy(socketThreadSemaphore);
 		socketThread = nullptr;
 	}
 
+	// Reset codec statistics, like netplay does with its own.
+	std::fill(std::begin(codecStats), std::end(codecStats), SocketCodecStats());
+
 #if defined(WZ_OS_WIN)
 	WSACleanup();
 
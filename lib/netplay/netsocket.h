@@ -80,6 +80,25 @@ typedef struct addrinfo SocketAddress;
 static const int SOCKET_ERROR = -1;
 #endif
 
+/// Compression used on a compressed Socket. The values are sent over the network, so don't renumber them.
+enum SocketCodec
+{
+	SOCKET_CODEC_ZLIB,  ///< What every version speaks, and what each compressed connection starts with.
+	SOCKET_CODEC_ZSTD,  ///< Only if built with zstd.
+	SOCKET_CODEC_COUNT
+};
+
+/// Totals for all sockets since startup.
+struct SocketCodecStats
+{
+	uint64_t uncompressedBytesSent = 0;
+	uint64_t rawBytesSent = 0;
+	uint64_t uncompressedBytesReceived = 0;
+	uint64_t rawBytesReceived = 0;
+	uint64_t compressMicroseconds = 0;
+	uint64_t decompressMicroseconds = 0;
+};
+
 
 // Init/shutdown.
 void SOCKETinit();
@@ -122,6 +141,11 @@ ssize_t writeAll(Socket *sock, const void *buf, size_t size, size_t *rawByteCoun
 WZ_DECL_NONNULL(1) void socketBeginCompression(Socket *sock); ///< Makes future data sent compressed, and future data received expected to be compressed.
 WZ_DECL_NONNULL(1) bool socketReadDisconnected(Socket *sock);  ///< If readNoInt returned 0, returns true if this is the result of a disconnect, or false if the input compressed data just hasn't produced any output bytes.
 WZ_DECL_NONNULL(1) void socketFlush(Socket *sock, size_t *rawByteCount = nullptr); ///< Actually sends the data written with writeAll. Only useful on compressed sockets. Note that flushing too often makes compression less effective. Raw count of bytes (after compression) returned in rawByteCount.
+WZ_DECL_NONNULL(1) void socketSetSendCodec(Socket *sock, SocketCodec codec);  ///< Compresses future data sent with codec. The other end follows along by itself, but must support the codec.
+uint32_t socketSupportedCodecs();                                       ///< Bit mask of (1 << SocketCodec) this build can compress and decompress.
+SocketCodec socketPreferredCodec(uint32_t codecs);                      ///< Picks the best codec in the mask that this build supports, zlib if none.
+const char *socketCodecName(SocketCodec codec);
+SocketCodecStats const &socketGetCodecStats(SocketCodec codec);        ///< Bytes and time spent (de)compressing with codec, summed over all sockets.
 
 // Socket sets.
 WZ_DECL_ALLOCATION SocketSet *allocSocketSet();                         ///< Constructs a SocketSet.
@@ -273,6 +273,16 @@ static void queue(const Q &q, NetMessage &v)
 	queue(q, v.data);
 }
 
+/// Only for encoding, copies a message straight out of a queue.
+static void queue(const MessageWriter &q, NetMessageView v)
+{
+	ASSERT(v.size <= static_cast<size_t>(std::numeric_limits<uint32_t>::max()), "v.size exceeds uint32_t max");
+	uint32_t len = static_cast<uint32_t>(v.size);
+	queue(q, v.type);
+	queue(q, len);
+	q.bytes(v.data, len);
+}
+
 template<class T>
 static void queueAuto(T &v)
 {
@@ -392,9 +402,9 @@ bool NETisMessageReady(NETQUEUE queue)
 	return receiveQueue(queue)->haveMessage();
 }
 
-NetMessage const *NETgetMessage(NETQUEUE queue)
+NetMessageView NETgetMessage(NETQUEUE queue)
 {
-	return &receiveQueue(queue)->getMessage();
+	return receiveQueue(queue)->getMessage();
 }
 
 /*
@@ -456,7 +466,8 @@ void NETbeginEncode(NETQUEUE queue, uint8_t type)
 	NETsetPacketDir(PACKET_ENCODE);
 
 	queueInfo = queue;
-	message = type;
+	message.type = type;
+	message.data.clear();  // Keeps the capacity for the next message.
 	writer = MessageWriter(message);
 }
 
@@ -465,10 +476,9 @@ void NETbeginDecode(NETQUEUE queue, uint8_t type)
 	NETsetPacketDir(PACKET_DECODE);
 
 	queueInfo = queue;
-	message = receiveQueue(queueInfo)->getMessage();
-	reader = MessageReader(message);
+	reader = MessageReader(receiveQueue(queueInfo)->getMessage());  // Reads the message in place, it stays in the queue until NETpop().
 
-	assert(type == message.type);
+	assert(type == reader.message.type);
 }
 
 bool NETend()
@@ -496,7 +506,7 @@ bool NETend()
 
 		if (queueInfo.queueType == QUEUE_NET || queueInfo.queueType == QUEUE_BROADCAST || queueInfo.queueType == QUEUE_TMP)
 		{
-			NETsend(queueInfo, &queue->getMessageForNet());
+			NETsend(queueInfo, queue->getMessageForNet());
 			queue->popMessageForNet();
 			ASSERT(queue->numMessagesForNet() == 0, "Queue not empty.");
 		}
@@ -578,7 +588,7 @@ void NETflushGameQueues()
 		NETuint32_t(&num);
 		for (uint32_t n = 0; n < num; ++n)
 		{
-			queueAuto(const_cast<NetMessage &>(queue->getMessageForNet()));  // const_cast is safe since we are encoding, not decoding.
+			NETnetMessage(queue->getMessageForNet());
 			queue->popMessageForNet();
 		}
 		NETend();
@@ -794,3 +804,9 @@ void NETnetMessage(NetMessage const **msg)
 		return;
 	}
 }
+
+void NETnetMessage(NetMessageView msg)
+{
+	ASSERT_OR_RETURN(, NETgetPacketDir() == PACKET_ENCODE, "Can't decode into a NetMessageView.");
+	queue(writer, msg);
+}
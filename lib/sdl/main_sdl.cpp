@@ -684,6 +684,11 @@ void wzYieldCurrentThread()
 	SDL_Delay(40);
 }
 
+int wzGetCPUCount()
+{
+	return SDL_GetCPUCount();
+}
+
 WZ_MUTEX *wzMutexCreate()
 {
 	return (WZ_MUTEX *)SDL_CreateMutex();
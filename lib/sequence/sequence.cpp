@@ -59,6 +59,8 @@
 #include "lib/ivis_opengl/gfx_api.h"
 #include "sequence.h"
 #include "timer.h"
+#include "yuv.h"
+#include "lib/framework/wzapp.h"
 #include "lib/framework/math_ext.h"
 #include "lib/ivis_opengl/piestate.h"
 #include "lib/ivis_opengl/pieblitfunc.h"
@@ -80,6 +82,9 @@
 
 #include "lib/framework/physfs_ext.h"
 
+#include <deque>
+#include <vector>
+
 // stick this in sequence.h perhaps?
 struct AudioData
 {
@@ -122,13 +127,12 @@ static int vorbis_p = 0;
 
 static bool stateflag = false;
 static bool videoplaying = false;
-static bool videobuf_ready = false;		// single frame video buffer ready for processing
+static bool videobuf_ready = false;		// a decoded video frame is waiting to be shown
 static bool audiobuf_ready = false;		// single 'frame' audio buffer ready for processing
 
 // file handle
 static PHYSFS_file *fpInfile = nullptr;
 
-static uint32_t *RGBAframe = nullptr;					// texture buffer
 static ogg_int16_t *audiobuf = nullptr;			// audio buffer
 
 // For timing
@@ -142,7 +146,6 @@ static double timer_expire;
 static bool timer_started = false;
 
 static ogg_int64_t audiobuf_granulepos = 0;	// time position of last sample
-static ogg_int64_t videobuf_granulepos = -1;	// time position of last video frame
 
 // frame & dropped frame counter
 static int frames = 0;
@@ -157,6 +160,39 @@ static gfx_api::gfxFloat Scrnvidpos[3];
 static SCANLINE_MODE use_scanlines;
 static bool scanlinesDisabled = false;
 
+/// Number of converted frames that can wait for their presentation time
+#define VIDEO_FRAME_QUEUE	3
+/// Number of compressed packets handed to the decoder thread ahead of time
+#define VIDEO_PACKET_QUEUE	8
+
+/// A theora packet, copied out of the ogg stream so that the decoder thread owns its data
+struct VideoPacket
+{
+	std::vector<unsigned char> data;
+	ogg_packet op;
+};
+
+/// A decoded and converted frame waiting to be shown
+struct VideoFrame
+{
+	int slot;		///< index into videoFrameBuffers
+	double time;	///< presentation time in seconds
+};
+
+// Theora decoding and the YUV conversion run on videoThread. The queues below are guarded by videoMutex,
+// videodata.td belongs to the decoder thread while it runs.
+static WZ_THREAD *videoThread = nullptr;
+static WZ_MUTEX *videoMutex = nullptr;
+static WZ_SEMAPHORE *videoPacketSemaphore = nullptr;	///< posted once per queued packet
+static WZ_SEMAPHORE *videoFreeSemaphore = nullptr;		///< posted once per free frame slot
+static volatile bool videoThreadQuit = false;
+static std::deque<VideoPacket> videoPackets;
+static int videoPacketsPending = 0;						///< packets queued or being decoded
+static std::deque<VideoFrame> videoFrames;				///< converted frames in presentation order
+static std::deque<int> videoFreeSlots;
+static std::vector<uint32_t> videoFrameBuffers[VIDEO_FRAME_QUEUE];
+static SCANLINE_MODE videoScanMode = SCANLINES_OFF;	///< scanline mode of the current playback
+
 // Helper; just grab some more compressed bitstream and sync it for page extraction
 static int buffer_data(PHYSFS_file *in, ogg_sync_state *oy)
 {
@@ -262,126 +298,168 @@ static double getRelativeTime(void)
 const size_t texture_width = 1024;
 const size_t texture_height = 1024;
 
-/** Allocates memory to hold the decoded video frame
- */
-static void Allocate_videoFrame(void)
+/** This runs in the video decoder thread */
+static int videoDecodeThreadFunc(void *)
 {
-	int size = videodata.ti.frame_width * videodata.ti.frame_height * 4;
-	if (!seq_getScanlinesDisabled() && seq_getScanlineMode())
+	const int video_width = videodata.ti.frame_width;
+	const int video_height = videodata.ti.frame_height;
+
+	for (;;)
 	{
-		size *= 2;
+		wzSemaphoreWait(videoPacketSemaphore);  // Go to sleep until there is a packet.
+		if (videoThreadQuit)
+		{
+			break;
+		}
+
+		wzMutexLock(videoMutex);
+		VideoPacket packet = std::move(videoPackets.front());
+		videoPackets.pop_front();
+		wzMutexUnlock(videoMutex);
+
+		/* theora is one in, one out... */
+		packet.op.packet = packet.data.data();
+		theora_decode_packetin(&videodata.td, &packet.op);
+		const double time = theora_granule_time(&videodata.td, videodata.td.granulepos);
+
+		wzSemaphoreWait(videoFreeSemaphore);  // Wait until the main thread has shown a frame.
+		if (videoThreadQuit)
+		{
+			break;
+		}
+
+		wzMutexLock(videoMutex);
+		const int slot = videoFreeSlots.front();
+		videoFreeSlots.pop_front();
+		wzMutexUnlock(videoMutex);
+
+		yuv_buffer yuv;
+		theora_decode_YUVout(&videodata.td, &yuv);
+		yuv420ToRGBA(yuv.y, yuv.y_stride, yuv.u, yuv.v, yuv.uv_stride, video_width, video_height, videoFrameBuffers[slot].data(), videoScanMode);
+
+		wzMutexLock(videoMutex);
+		videoFrames.push_back(VideoFrame{slot, time});
+		--videoPacketsPending;
+		wzMutexUnlock(videoMutex);
 	}
+	return 0;
+}
 
-	RGBAframe = (uint32_t *)malloc(size);
-	memset(RGBAframe, 0, size);
+/** Allocates the frame queue and starts the decoder thread */
+static void startVideoDecoder()
+{
+	// when using scanlines we need to double the height
+	const size_t size = static_cast<size_t>(videodata.ti.frame_width) * videodata.ti.frame_height * (videoScanMode ? 2 : 1);
+
+	videoThreadQuit = false;
+	videoPacketsPending = 0;
+	videoMutex = wzMutexCreate();
+	videoPacketSemaphore = wzSemaphoreCreate(0);
+	videoFreeSemaphore = wzSemaphoreCreate(VIDEO_FRAME_QUEUE);
+	for (int slot = 0; slot < VIDEO_FRAME_QUEUE; ++slot)
+	{
+		videoFrameBuffers[slot].assign(size, 0);
+		videoFreeSlots.push_back(slot);
+	}
+	videoThread = wzThreadCreate(videoDecodeThreadFunc, nullptr);
+	wzThreadStart(videoThread);
 }
 
-static void deallocateVideoFrame(void)
+static void stopVideoDecoder()
 {
-	if (RGBAframe)
+	if (!videoThread)
 	{
-		free(RGBAframe);
+		return;
+	}
+	videoThreadQuit = true;
+	wzSemaphorePost(videoPacketSemaphore);  // Wake up the thread, whichever queue it is waiting on.
+	wzSemaphorePost(videoFreeSemaphore);
+	wzThreadJoin(videoThread);
+	videoThread = nullptr;
+
+	wzMutexDestroy(videoMutex);
+	videoMutex = nullptr;
+	wzSemaphoreDestroy(videoPacketSemaphore);
+	videoPacketSemaphore = nullptr;
+	wzSemaphoreDestroy(videoFreeSemaphore);
+	videoFreeSemaphore = nullptr;
+
+	videoPackets.clear();
+	videoFrames.clear();
+	videoFreeSlots.clear();
+	videoPacketsPending = 0;
+	for (std::vector<uint32_t> &buffer : videoFrameBuffers)
+	{
+		buffer.clear();
+		buffer.shrink_to_fit();
 	}
 }
 
-#ifndef __BIG_ENDIAN__
-const int Rshift = 0;
-const int Gshift = 8;
-const int Bshift = 16;
-const int Ashift = 24;
-// RGBmask is used only after right-shifting, so ignore the leftmost bit of each byte
-const int RGBmask = 0x007f7f7f;
-const int Amask = 0xff000000;
-#else
-const int Rshift = 24;
-const int Gshift = 16;
-const int Bshift = 8;
-const int Ashift = 0;
-const int RGBmask = 0x7f7f7f00;
-const int Amask = 0x000000ff;
-#endif
-#define Vclip( x )	( (x > 0) ? ((x < 255) ? x : 255) : 0 )
-// main routine to display video on screen.
-static void video_write(bool update)
+/// Hand the decoder thread the next theora packets, up to VIDEO_PACKET_QUEUE in flight
+static void queueVideoPackets()
 {
-	unsigned int x = 0, y = 0;
-	const int video_width = videodata.ti.frame_width;
-	const int video_height = videodata.ti.frame_height;
-	SCANLINE_MODE scanMode = seq_getScanlinesDisabled() ? SCANLINES_OFF : seq_getScanlineMode();
-	// when using scanlines we need to double the height
-	const int height_factor = (scanMode ? 2 : 1);
-	yuv_buffer yuv;
+	ogg_packet op;
 
-	if (update)
+	wzMutexLock(videoMutex);
+	while (videoPacketsPending < VIDEO_PACKET_QUEUE && ogg_stream_packetout(&videodata.to, &op) > 0)
 	{
-		int rgb_offset = 0;
-		int y_offset = 0;
-		int uv_offset = 0;
-		const int half_width = video_width / 2;
+		VideoPacket packet;
+		packet.data.assign(op.packet, op.packet + op.bytes);
+		packet.op = op;
+		videoPackets.push_back(std::move(packet));
+		++videoPacketsPending;
+		wzSemaphorePost(videoPacketSemaphore);
+	}
+	wzMutexUnlock(videoMutex);
+}
 
-		theora_decode_YUVout(&videodata.td, &yuv);
+/**
+ * Take the frame to show at time \c now, or return -1 if none is due yet.
+ * When running slow, due frames with a due successor are skipped, but a frame is shown at least once a second.
+ */
+static int takeVideoFrame(double now)
+{
+	int slot = -1;
 
-		// fill the RGBA buffer
-		for (y = 0; y < video_height; y++)
+	wzMutexLock(videoMutex);
+	if (!videoFrames.empty() && videoFrames.front().time <= now)
+	{
+		while (videoFrames.size() > 1 && videoFrames[1].time <= now && now - last_time < 1.0)
 		{
-			y_offset = y * yuv.y_stride;
-			uv_offset = (y >> 1) * yuv.uv_stride;
-
-			for (x = 0; x < half_width; x++)
-			{
-				int Y = yuv.y[y_offset++] - 16;
-				const int U = yuv.u[uv_offset] - 128;
-				const int V = yuv.v[uv_offset++] - 128;
-
-				int A = 298 * Y;
-				const int C = 409 * V;
-
-				int R = Vclip((A + C + 128) >> 8);
-				int G = Vclip((A - 100 * U - (C >> 1) + 128) >> 8);
-				int B = Vclip((A + 516 * U + 128) >> 8);
-
-				uint32_t rgba = (R << Rshift) | (G << Gshift) | (B << Bshift) | (0xFF << Ashift);
-
-				RGBAframe[rgb_offset] = rgba;
-				if (scanMode == SCANLINES_50)
-				{
-					// halve the rgb values for a dimmed scanline
-					RGBAframe[rgb_offset + video_width] = (rgba >> 1 & RGBmask) | Amask;
-				}
-				else if (scanMode == SCANLINES_BLACK)
-				{
-					RGBAframe[rgb_offset + video_width] = Amask;
-				}
-				rgb_offset++;
-
-				// second pixel, U and V (and thus C) are the same as before.
-				Y = yuv.y[y_offset++] - 16;
-				A = 298 * Y;
+			// running slow, so we skip this frame
+			videoFreeSlots.push_back(videoFrames.front().slot);
+			videoFrames.pop_front();
+			wzSemaphorePost(videoFreeSemaphore);
+			dropped++;
+		}
+		slot = videoFrames.front().slot;
+		videobuf_time = videoFrames.front().time;
+		videoFrames.pop_front();
+	}
+	wzMutexUnlock(videoMutex);
+	return slot;
+}
 
-				R = Vclip((A + C + 128) >> 8);
-				G = Vclip((A - 100 * U - (C >> 1) + 128) >> 8);
-				B = Vclip((A + 516 * U + 128) >> 8);
+/// Give a frame slot back to the decoder thread once its texture upload is done
+static void releaseVideoFrame(int slot)
+{
+	wzMutexLock(videoMutex);
+	videoFreeSlots.push_back(slot);
+	wzMutexUnlock(videoMutex);
+	wzSemaphorePost(videoFreeSemaphore);
+}
 
-				rgba = (R << Rshift) | (G << Gshift) | (B << Bshift) | (0xFF << Ashift);
-				RGBAframe[rgb_offset] = rgba;
-				if (scanMode == SCANLINES_50)
-				{
-					// halve the rgb values for a dimmed scanline
-					RGBAframe[rgb_offset + video_width] = (rgba >> 1 & RGBmask) | Amask;
-				}
-				else if (scanMode == SCANLINES_BLACK)
-				{
-					RGBAframe[rgb_offset + video_width] = Amask;
-				}
-				rgb_offset++;
-			}
-			if (scanMode)
-			{
-				rgb_offset += video_width;
-			}
-		}
+// main routine to display video on screen, uploading frame first if it is not null.
+static void video_write(const uint32_t *frame)
+{
+	if (frame)
+	{
+		const int video_width = videodata.ti.frame_width;
+		const int video_height = videodata.ti.frame_height;
+		// when using scanlines we need to double the height
+		const int height_factor = (videoScanMode ? 2 : 1);
 
-		videoGfx->updateTexture(RGBAframe, static_cast<size_t>(video_width), static_cast<size_t>(video_height) * static_cast<size_t>(height_factor));
+		videoGfx->updateTexture(frame, static_cast<size_t>(video_width), static_cast<size_t>(video_height) * static_cast<size_t>(height_factor));
 	}
 
 	const auto& modelViewProjectionMatrix = glm::ortho(0.f, static_cast<float>(pie_GetVideoBufferWidth()), static_cast<float>(pie_GetVideoBufferHeight()), 0.f) *
@@ -462,7 +540,6 @@ static void seq_InitOgg(void)
 
 	/* single frame video buffering */
 	videobuf_ready = false;
-	videobuf_granulepos = -1;
 	videobuf_time = 0;
 	frames = 0;
 	dropped = 0;
@@ -702,12 +779,12 @@ bool seq_Play(const char *filename)
 			seq_setScanlinesDisabled(true);
 		}
 
-		Allocate_videoFrame();
+		videoScanMode = seq_getScanlinesDisabled() ? SCANLINES_OFF : seq_getScanlineMode();
 		videoGfx->makeTexture(texture_width, texture_height, gfx_api::pixel_format::FORMAT_RGBA8_UNORM_PACK8, blackframe);
 		free(blackframe);
 
 		// when using scanlines we need to double the height
-		const uint32_t height_factor = ((!seq_getScanlinesDisabled() && seq_getScanlineMode()) ? 2 : 1);
+		const uint32_t height_factor = (videoScanMode ? 2 : 1);
 		const gfx_api::gfxFloat vtwidth = (float)videodata.ti.frame_width / (float)texture_width;
 		const gfx_api::gfxFloat vtheight = (float)videodata.ti.frame_height * height_factor / (float)texture_height;
 		gfx_api::gfxFloat texcoords[NUM_VERTICES * 2] = { 0.0f, 0.0f, vtwidth, 0.0f, 0.0f, vtheight, vtwidth, vtheight };
@@ -719,6 +796,10 @@ bool seq_Play(const char *filename)
 		we have a start frame for both.  This is not necessarily a valid
 		assumption in Ogg A/V streams! It will always be true of the
 		example_encoder (and most streams) though. */
+	if (theora_p)
+	{
+		startVideoDecoder();
+	}
 	sampletimeOffset = getTimeNow();
 	videoplaying = true;
 	return true;
@@ -814,54 +895,39 @@ bool seq_Update()
 		}
 	}
 
-	while (theora_p && !videobuf_ready)
+	bool videoDecoding = false;
+	if (theora_p)
 	{
-		/* theora is one in, one out... */
-		if (ogg_stream_packetout(&videodata.to, &op) > 0)
-		{
-			double now_time = 0;
-			double delay = 0;
-
-			theora_decode_packetin(&videodata.td, &op);
-			videobuf_granulepos = videodata.td.granulepos;
-			videobuf_time = theora_granule_time(&videodata.td, videobuf_granulepos);
-
-			now_time = getRelativeTime();
-			delay = videobuf_time - getRelativeTime();
+		/* decoding runs on the decoder thread; keep it fed and see whether a frame is ready */
+		queueVideoPackets();
 
-			if ((delay >= 0.0f) || (now_time - last_time >= 1.0f))
-			{
-				videobuf_ready = true;
-				seq_SetFrameNumber(seq_GetFrameNumber() + 1);
-			}
-			else
-			{
-				// running slow, so we skip this frame
-				dropped++;
-			}
-		}
-		else
+		wzMutexLock(videoMutex);
+		videobuf_ready = !videoFrames.empty();
+		if (videobuf_ready)
 		{
-			break;
+			videobuf_time = videoFrames.front().time;
 		}
+		videoDecoding = videoPacketsPending > 0;
+		wzMutexUnlock(videoMutex);
 	}
 
 	alGetSourcei(audiodata.source, AL_SOURCE_STATE, &sourcestate);
 
 	if (PHYSFS_eof(fpInfile)
 		&& !videobuf_ready
+		&& !videoDecoding
 		&& ((!audiobuf_ready && (audiodata.audiobuf_fill == 0)) || audio_Disabled())
 		&& sourcestate != AL_PLAYING)
 	{
-		video_write(false);
+		video_write(nullptr);
 		seq_Shutdown();
 		debug(LOG_VIDEO, "video finished");
 		return false;
 	}
 
-	if (!videobuf_ready || !audiobuf_ready)
+	if (!videobuf_ready || !audiobuf_ready || (theora_p && !videoDecoding))
 	{
-		/* no data yet for somebody.  Grab another page */
+		/* no data yet for somebody, or the decoder thread ran dry.  Grab another page */
 		ret = buffer_data(fpInfile, &videodata.oy);
 		while (ogg_sync_pageout(&videodata.oy, &videodata.og) > 0)
 		{
@@ -880,15 +946,18 @@ bool seq_Update()
 	}
 
 	/* are we at or past time for this video frame? */
-	if (stateflag && videobuf_ready && (videobuf_time <= getRelativeTime()))
+	const int slot = (stateflag && videobuf_ready) ? takeVideoFrame(getRelativeTime()) : -1;
+	if (slot >= 0)
 	{
-		video_write(true);
+		video_write(videoFrameBuffers[slot].data());
+		releaseVideoFrame(slot);
+		seq_SetFrameNumber(seq_GetFrameNumber() + 1);
 		last_time = getRelativeTime();
 		videobuf_ready = false;
 	}
 	else if (stateflag)
 	{
-		video_write(false);
+		video_write(nullptr);
 	}
 
 	/* if our buffers either don't exist or are ready to go,
@@ -938,11 +1007,11 @@ void seq_Shutdown()
 
 	if (theora_p)
 	{
+		stopVideoDecoder();
 		ogg_stream_clear(&videodata.to);
 		theora_clear(&videodata.td);
 		theora_comment_clear(&videodata.tc);
 		theora_info_clear(&videodata.ti);
-		deallocateVideoFrame();
 	}
 
 	ogg_sync_clear(&videodata.oy);
@@ -0,0 +1,277 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2008-2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/**
+ * @file yuv.cpp
+ * YUV 4:2:0 to RGBA conversion for video playback.
+ *
+ * Uses the BT.601 studio-swing integer coefficients:
+ *   R = (298 * (Y - 16) + 409 * (V - 128) + 128) >> 8
+ *   G = (298 * (Y - 16) - 100 * (U - 128) - 208 * (V - 128) + 128) >> 8
+ *   B = (298 * (Y - 16) + 516 * (U - 128) + 128) >> 8
+ * clamped to [0, 255]. The SIMD paths compute exactly the same sums in 32 bits,
+ * so they match the scalar loop bit for bit.
+ */
+
+#include "yuv.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define WZ_YUV_SSE2
+# include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+# define WZ_YUV_NEON
+# include <arm_neon.h>
+#endif
+
+#ifndef __BIG_ENDIAN__
+static const int Rshift = 0;
+static const int Gshift = 8;
+static const int Bshift = 16;
+static const int Ashift = 24;
+// RGBmask is used only after right-shifting, so ignore the leftmost bit of each byte
+static const uint32_t RGBmask = 0x007f7f7f;
+static const uint32_t Amask = 0xff000000;
+#else
+static const int Rshift = 24;
+static const int Gshift = 16;
+static const int Bshift = 8;
+static const int Ashift = 0;
+static const uint32_t RGBmask = 0x7f7f7f00;
+static const uint32_t Amask = 0x000000ff;
+#endif
+
+static inline int clampByte(int x)
+{
+	return x > 0 ? (x < 255 ? x : 255) : 0;
+}
+
+/// Convert pixels [start, width) of one row with the reference formula.
+static inline void convertRowScalar(const uint8_t *y, const uint8_t *u, const uint8_t *v, int start, int width, uint32_t *out)
+{
+	for (int x = start; x < width; x++)
+	{
+		const int Y = 298 * (y[x] - 16) + 128;
+		const int U = u[x >> 1] - 128;
+		const int V = v[x >> 1] - 128;
+
+		const int R = clampByte((Y + 409 * V) >> 8);
+		const int G = clampByte((Y - 100 * U - 208 * V) >> 8);
+		const int B = clampByte((Y + 516 * U) >> 8);
+
+		out[x] = (R << Rshift) | (G << Gshift) | (B << Bshift) | (0xFFu << Ashift);
+	}
+}
+
+/// Fill the scanline row following \c row.
+static inline void writeScanline(uint32_t *row, int width, SCANLINE_MODE scanMode)
+{
+	uint32_t *scanline = row + width;
+	if (scanMode == SCANLINES_50)
+	{
+		// halve the rgb values for a dimmed scanline
+		for (int x = 0; x < width; x++)
+		{
+			scanline[x] = ((row[x] >> 1) & RGBmask) | Amask;
+		}
+	}
+	else
+	{
+		for (int x = 0; x < width; x++)
+		{
+			scanline[x] = Amask;
+		}
+	}
+}
+
+#if defined(WZ_YUV_SSE2)
+/// Two 16-bit coefficients packed so that _mm_madd_epi16 multiplies the low one with the first operand of each pair.
+static inline __m128i coefficientPair(int first, int second)
+{
+	return _mm_set1_epi32(static_cast<int>(static_cast<uint16_t>(first) | (static_cast<uint32_t>(static_cast<uint16_t>(second)) << 16)));
+}
+
+/// Eight pixels of one channel: (yCoef * Y + 128 + uCoef * U + vCoef * V) >> 8 as saturated 16-bit values.
+static inline __m128i channel8(__m128i yLo, __m128i yHi, __m128i uvLo, __m128i uvHi, __m128i yCoef, __m128i uvCoef)
+{
+	const __m128i lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yLo, yCoef), _mm_madd_epi16(uvLo, uvCoef)), 8);
+	const __m128i hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yHi, yCoef), _mm_madd_epi16(uvHi, uvCoef)), 8);
+	return _mm_packs_epi32(lo, hi);
+}
+
+/// Convert the first multiple of 16 pixels of one row, returns the number of pixels done.
+static int convertRowSIMD(const uint8_t *y, const uint8_t *u, const uint8_t *v, int width, uint32_t *out)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i alpha = _mm_set1_epi8(static_cast<char>(0xff));
+	const __m128i bias16 = _mm_set1_epi16(16);
+	const __m128i bias128 = _mm_set1_epi16(128);
+	const __m128i yCoef = coefficientPair(298, 128);	// (Y, 1) pairs, so the madd also adds the rounding term
+	const __m128i rCoef = coefficientPair(0, 409);		// (U, V) pairs
+	const __m128i gCoef = coefficientPair(-100, -208);
+	const __m128i bCoef = coefficientPair(516, 0);
+
+	int x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		const __m128i y8 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(y + x));
+		__m128i u8 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(u + x / 2));
+		__m128i v8 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(v + x / 2));
+		// every chroma sample covers two pixels
+		u8 = _mm_unpacklo_epi8(u8, u8);
+		v8 = _mm_unpacklo_epi8(v8, v8);
+
+		__m128i rgb[3][2];
+		for (int half = 0; half < 2; half++)
+		{
+			const __m128i Y = _mm_sub_epi16(half ? _mm_unpackhi_epi8(y8, zero) : _mm_unpacklo_epi8(y8, zero), bias16);
+			const __m128i U = _mm_sub_epi16(half ? _mm_unpackhi_epi8(u8, zero) : _mm_unpacklo_epi8(u8, zero), bias128);
+			const __m128i V = _mm_sub_epi16(half ? _mm_unpackhi_epi8(v8, zero) : _mm_unpacklo_epi8(v8, zero), bias128);
+
+			const __m128i yLo = _mm_unpacklo_epi16(Y, ones);
+			const __m128i yHi = _mm_unpackhi_epi16(Y, ones);
+			const __m128i uvLo = _mm_unpacklo_epi16(U, V);
+			const __m128i uvHi = _mm_unpackhi_epi16(U, V);
+
+			rgb[0][half] = channel8(yLo, yHi, uvLo, uvHi, yCoef, rCoef);
+			rgb[1][half] = channel8(yLo, yHi, uvLo, uvHi, yCoef, gCoef);
+			rgb[2][half] = channel8(yLo, yHi, uvLo, uvHi, yCoef, bCoef);
+		}
+		const __m128i R = _mm_packus_epi16(rgb[0][0], rgb[0][1]);
+		const __m128i G = _mm_packus_epi16(rgb[1][0], rgb[1][1]);
+		const __m128i B = _mm_packus_epi16(rgb[2][0], rgb[2][1]);
+
+		// interleave into R, G, B, A byte order
+		const __m128i rgLo = _mm_unpacklo_epi8(R, G);
+		const __m128i rgHi = _mm_unpackhi_epi8(R, G);
+		const __m128i baLo = _mm_unpacklo_epi8(B, alpha);
+		const __m128i baHi = _mm_unpackhi_epi8(B, alpha);
+		__m128i *dst = reinterpret_cast<__m128i *>(out + x);
+		_mm_storeu_si128(dst + 0, _mm_unpacklo_epi16(rgLo, baLo));
+		_mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(rgLo, baLo));
+		_mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(rgHi, baHi));
+		_mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(rgHi, baHi));
+	}
+	return x;
+}
+#elif defined(WZ_YUV_NEON)
+/// Eight pixels: writes the R, G and B bytes of 8 pixels.
+static inline void convert8(int16x8_t Y, int16x8_t U, int16x8_t V, uint8x8_t &R, uint8x8_t &G, uint8x8_t &B)
+{
+	const int32x4_t rounding = vdupq_n_s32(128);
+	const int32x4_t yLo = vmlal_n_s16(rounding, vget_low_s16(Y), 298);
+	const int32x4_t yHi = vmlal_n_s16(rounding, vget_high_s16(Y), 298);
+
+	const int32x4_t rLo = vmlal_n_s16(yLo, vget_low_s16(V), 409);
+	const int32x4_t rHi = vmlal_n_s16(yHi, vget_high_s16(V), 409);
+	const int32x4_t gLo = vmlal_n_s16(vmlal_n_s16(yLo, vget_low_s16(U), -100), vget_low_s16(V), -208);
+	const int32x4_t gHi = vmlal_n_s16(vmlal_n_s16(yHi, vget_high_s16(U), -100), vget_high_s16(V), -208);
+	const int32x4_t bLo = vmlal_n_s16(yLo, vget_low_s16(U), 516);
+	const int32x4_t bHi = vmlal_n_s16(yHi, vget_high_s16(U), 516);
+
+	// the sums stay within 16 bits after the shift, so only the final narrowing needs to saturate
+	R = vqmovun_s16(vcombine_s16(vshrn_n_s32(rLo, 8), vshrn_n_s32(rHi, 8)));
+	G = vqmovun_s16(vcombine_s16(vshrn_n_s32(gLo, 8), vshrn_n_s32(gHi, 8)));
+	B = vqmovun_s16(vcombine_s16(vshrn_n_s32(bLo, 8), vshrn_n_s32(bHi, 8)));
+}
+
+/// Convert the first multiple of 16 pixels of one row, returns the number of pixels done.
+static int convertRowSIMD(const uint8_t *y, const uint8_t *u, const uint8_t *v, int width, uint32_t *out)
+{
+	const uint8x8_t bias16 = vdup_n_u8(16);
+	const uint8x8_t bias128 = vdup_n_u8(128);
+
+	int x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		const uint8x16_t y8 = vld1q_u8(y + x);
+		const uint8x8_t u8 = vld1_u8(u + x / 2);
+		const uint8x8_t v8 = vld1_u8(v + x / 2);
+		// every chroma sample covers two pixels
+		const uint8x8x2_t uu = vzip_u8(u8, u8);
+		const uint8x8x2_t vv = vzip_u8(v8, v8);
+
+		for (int half = 0; half < 2; half++)
+		{
+			const int16x8_t Y = vreinterpretq_s16_u16(vsubl_u8(half ? vget_high_u8(y8) : vget_low_u8(y8), bias16));
+			const int16x8_t U = vreinterpretq_s16_u16(vsubl_u8(uu.val[half], bias128));
+			const int16x8_t V = vreinterpretq_s16_u16(vsubl_u8(vv.val[half], bias128));
+
+			uint8x8x4_t pixels;
+			convert8(Y, U, V, pixels.val[0], pixels.val[1], pixels.val[2]);
+			pixels.val[3] = vdup_n_u8(0xff);
+			vst4_u8(reinterpret_cast<uint8_t *>(out + x + half * 8), pixels);
+		}
+	}
+	return x;
+}
+#endif
+
+static void yuv420ToRGBAImpl(const uint8_t *y, int yStride, const uint8_t *u, const uint8_t *v, int uvStride,
+                             int width, int height, uint32_t *rgba, SCANLINE_MODE scanMode, bool simd)
+{
+	// when using scanlines every row is followed by a scanline row
+	const int rowPitch = scanMode != SCANLINES_OFF ? width * 2 : width;
+
+	for (int row = 0; row < height; row++)
+	{
+		const uint8_t *yRow = y + row * yStride;
+		const uint8_t *uRow = u + (row >> 1) * uvStride;
+		const uint8_t *vRow = v + (row >> 1) * uvStride;
+		uint32_t *out = rgba + row * rowPitch;
+
+		int done = 0;
+#if defined(WZ_YUV_SSE2) || defined(WZ_YUV_NEON)
+		if (simd)
+		{
+			done = convertRowSIMD(yRow, uRow, vRow, width, out);
+		}
+#else
+		(void)simd;
+#endif
+		convertRowScalar(yRow, uRow, vRow, done, width, out);
+
+		if (scanMode != SCANLINES_OFF)
+		{
+			writeScanline(out, width, scanMode);
+		}
+	}
+}
+
+void yuv420ToRGBA(const uint8_t *y, int yStride, const uint8_t *u, const uint8_t *v, int uvStride,
+                  int width, int height, uint32_t *rgba, SCANLINE_MODE scanMode)
+{
+	yuv420ToRGBAImpl(y, yStride, u, v, uvStride, width, height, rgba, scanMode, true);
+}
+
+void yuv420ToRGBAScalar(const uint8_t *y, int yStride, const uint8_t *u, const uint8_t *v, int uvStride,
+                        int width, int height, uint32_t *rgba, SCANLINE_MODE scanMode)
+{
+	yuv420ToRGBAImpl(y, yStride, u, v, uvStride, width, height, rgba, scanMode, false);
+}
+
+const char *yuv420ToRGBAImplementation()
+{
+#if defined(WZ_YUV_SSE2)
+	return "SSE2";
+#elif defined(WZ_YUV_NEON)
+	return "NEON";
+#else
+	return "scalar";
+#endif
+}
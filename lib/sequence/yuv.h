@@ -0,0 +1,43 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2008-2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef __INCLUDED_LIB_SEQUENCE_YUV_H__
+#define __INCLUDED_LIB_SEQUENCE_YUV_H__
+
+#include "sequence.h"
+
+/**
+ * Convert a YUV 4:2:0 image to RGBA, one byte per channel in R, G, B, A memory order.
+ *
+ * Each output row is \c width pixels. With \c SCANLINES_50 or \c SCANLINES_BLACK every converted
+ * row is followed by a dimmed or black scanline row, so \c rgba must hold width * height * 2 pixels.
+ * Uses SSE2 or NEON when the compiler targets them, and the scalar loop otherwise; all paths give
+ * bit-identical output.
+ */
+void yuv420ToRGBA(const uint8_t *y, int yStride, const uint8_t *u, const uint8_t *v, int uvStride,
+                  int width, int height, uint32_t *rgba, SCANLINE_MODE scanMode);
+
+/// Plain C version of yuv420ToRGBA(), kept callable as the reference for benchmarks.
+void yuv420ToRGBAScalar(const uint8_t *y, int yStride, const uint8_t *u, const uint8_t *v, int uvStride,
+                        int width, int height, uint32_t *rgba, SCANLINE_MODE scanMode);
+
+/// Name of the code path yuv420ToRGBA() was compiled with ("SSE2", "NEON" or "scalar").
+const char *yuv420ToRGBAImplementation();
+
+#endif // __INCLUDED_LIB_SEQUENCE_YUV_H__
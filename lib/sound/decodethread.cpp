@@ -0,0 +1,331 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2005-2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "lib/framework/frame.h"
+#include "lib/framework/wzapp.h"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "decodethread.h"
+
+struct SoundStreamQueue
+{
+	struct OggVorbisDecoderState *decoder;
+	size_t bufferSize;
+	unsigned int depth;
+	std::deque<soundDataBuffer *> ready;	///< decoded buffers in playback order
+	bool endOfStream = false;				///< the decoder has no more data
+};
+
+struct SoundDecodeJob
+{
+	PHYSFS_file *fileHandle;
+	soundDataBuffer *result = nullptr;
+	bool done = false;
+	WZ_SEMAPHORE *doneSemaphore = nullptr;	///< posted by the decode thread once it finished the job
+};
+
+static WZ_THREAD *decodeThread = nullptr;
+static WZ_MUTEX *decodeMutex = nullptr;			///< guards the queues and jobs below
+static WZ_MUTEX *streamDecodeMutex = nullptr;	///< held while decoding for a stream, so the stream can't be destroyed meanwhile
+static WZ_SEMAPHORE *decodeWorkSemaphore = nullptr;
+static volatile bool decodeThreadQuit = false;
+static std::vector<SoundStreamQueue *> streamQueues;
+static std::deque<SoundDecodeJob *> decodeJobs;
+
+static soundDataBuffer *decodeFile(PHYSFS_file *fileHandle)
+{
+	struct OggVorbisDecoderState *decoder = sound_CreateOggVorbisDecoder(fileHandle, true);
+	soundDataBuffer *buffer = nullptr;
+
+	if (decoder == nullptr)
+	{
+		debug(LOG_WARNING, "Failed to open audio file for decoding");
+	}
+	else
+	{
+		buffer = sound_DecodeOggVorbis(decoder, 0);
+		sound_DestroyOggVorbisDecoder(decoder);
+	}
+	PHYSFS_close(fileHandle);
+	return buffer;
+}
+
+/// Store a freshly decoded stream buffer; call with decodeMutex held.
+static void pushStreamBuffer(SoundStreamQueue *queue, soundDataBuffer *buffer)
+{
+	if (buffer && buffer->size > 0)
+	{
+		queue->ready.push_back(buffer);
+	}
+	else
+	{
+		// If no data has been decoded we're probably at the end of our stream.
+		free(buffer);
+		queue->endOfStream = true;
+	}
+}
+
+/** Decode one buffer for the stream with the fewest buffers ready, or failing that one queued file.
+ *  Streams go first, since they run dry while whole samples merely load late.
+ *  \return false when there was nothing to do
+ */
+static bool decodeOne()
+{
+	// Always streamDecodeMutex before decodeMutex, never the other way around.
+	wzMutexLock(streamDecodeMutex);
+	wzMutexLock(decodeMutex);
+	SoundStreamQueue *stream = nullptr;
+	for (SoundStreamQueue *queue : streamQueues)
+	{
+		if (!queue->endOfStream && queue->ready.size() < queue->depth && (stream == nullptr || queue->ready.size() < stream->ready.size()))
+		{
+			stream = queue;
+		}
+	}
+	if (stream)
+	{
+		wzMutexUnlock(decodeMutex);
+		soundDataBuffer *buffer = sound_DecodeOggVorbis(stream->decoder, stream->bufferSize);
+		wzMutexLock(decodeMutex);
+		pushStreamBuffer(stream, buffer);
+		wzMutexUnlock(decodeMutex);
+		wzMutexUnlock(streamDecodeMutex);
+		return true;
+	}
+
+	if (!decodeJobs.empty())
+	{
+		SoundDecodeJob *job = decodeJobs.front();
+		decodeJobs.pop_front();
+		wzMutexUnlock(decodeMutex);
+		wzMutexUnlock(streamDecodeMutex);
+		soundDataBuffer *buffer = decodeFile(job->fileHandle);
+		wzMutexLock(decodeMutex);
+		job->result = buffer;
+		job->done = true;
+		wzMutexUnlock(decodeMutex);
+		wzSemaphorePost(job->doneSemaphore);
+		return true;
+	}
+	wzMutexUnlock(decodeMutex);
+	wzMutexUnlock(streamDecodeMutex);
+	return false;
+}
+
+/** This runs in the sound decode thread */
+static int decodeThreadFunc(void *)
+{
+	for (;;)
+	{
+		wzSemaphoreWait(decodeWorkSemaphore);  // Go to sleep until needed.
+		if (decodeThreadQuit)
+		{
+			break;
+		}
+		while (!decodeThreadQuit && decodeOne()) {}
+	}
+	return 0;
+}
+
+void sound_StartDecodeThread()
+{
+	sound_StopDecodeThread();  // In case the sound library is initialised twice.
+	decodeThreadQuit = false;
+	decodeMutex = wzMutexCreate();
+	streamDecodeMutex = wzMutexCreate();
+	decodeWorkSemaphore = wzSemaphoreCreate(0);
+	decodeThread = wzThreadCreate(decodeThreadFunc, nullptr);
+	wzThreadStart(decodeThread);
+}
+
+void sound_StopDecodeThread()
+{
+	if (decodeThread == nullptr)
+	{
+		return;
+	}
+	decodeThreadQuit = true;
+	wzSemaphorePost(decodeWorkSemaphore);  // Wake up thread.
+	wzThreadJoin(decodeThread);
+	decodeThread = nullptr;
+
+	// Whoever still holds a stream queue or job finishes it on its own thread from now on.
+	wzMutexDestroy(decodeMutex);
+	decodeMutex = nullptr;
+	wzMutexDestroy(streamDecodeMutex);
+	streamDecodeMutex = nullptr;
+	wzSemaphoreDestroy(decodeWorkSemaphore);
+	decodeWorkSemaphore = nullptr;
+	streamQueues.clear();
+	decodeJobs.clear();
+}
+
+SoundStreamQueue *sound_CreateStreamQueue(struct OggVorbisDecoderState *decoder, size_t bufferSize, unsigned int depth)
+{
+	SoundStreamQueue *queue = new SoundStreamQueue();
+	queue->decoder = decoder;
+	queue->bufferSize = bufferSize;
+	queue->depth = depth;
+
+	if (decodeThread)
+	{
+		wzMutexLock(decodeMutex);
+		streamQueues.push_back(queue);
+		wzMutexUnlock(decodeMutex);
+		wzSemaphorePost(decodeWorkSemaphore);
+	}
+	return queue;
+}
+
+soundDataBuffer *sound_TakeStreamBuffer(SoundStreamQueue *queue, bool *finished)
+{
+	soundDataBuffer *buffer = nullptr;
+
+	if (decodeThread == nullptr)
+	{
+		// No decode thread, decode in place as before.
+		if (queue->ready.empty() && !queue->endOfStream)
+		{
+			pushStreamBuffer(queue, sound_DecodeOggVorbis(queue->decoder, queue->bufferSize));
+		}
+		if (!queue->ready.empty())
+		{
+			buffer = queue->ready.front();
+			queue->ready.pop_front();
+		}
+		*finished = buffer == nullptr && queue->endOfStream;
+		return buffer;
+	}
+
+	wzMutexLock(decodeMutex);
+	if (!queue->ready.empty())
+	{
+		buffer = queue->ready.front();
+		queue->ready.pop_front();
+	}
+	*finished = buffer == nullptr && queue->endOfStream;
+	wzMutexUnlock(decodeMutex);
+
+	if (buffer)
+	{
+		wzSemaphorePost(decodeWorkSemaphore);  // Room for another buffer.
+	}
+	return buffer;
+}
+
+void sound_DestroyStreamQueue(SoundStreamQueue *queue)
+{
+	if (decodeThread)
+	{
+		wzMutexLock(decodeMutex);
+		streamQueues.erase(std::remove(streamQueues.begin(), streamQueues.end(), queue), streamQueues.end());
+		wzMutexUnlock(decodeMutex);
+
+		// Wait for a decode that might still be using the stream's decoder.
+		wzMutexLock(streamDecodeMutex);
+		wzMutexUnlock(streamDecodeMutex);
+	}
+
+	for (soundDataBuffer *buffer : queue->ready)
+	{
+		free(buffer);
+	}
+	delete queue;
+}
+
+SoundDecodeJob *sound_DecodeFileAsync(PHYSFS_file *fileHandle)
+{
+	SoundDecodeJob *job = new SoundDecodeJob();
+	job->fileHandle = fileHandle;
+
+	if (decodeThread)
+	{
+		job->doneSemaphore = wzSemaphoreCreate(0);
+		wzMutexLock(decodeMutex);
+		decodeJobs.push_back(job);
+		wzMutexUnlock(decodeMutex);
+		wzSemaphorePost(decodeWorkSemaphore);
+	}
+	else
+	{
+		job->result = decodeFile(fileHandle);
+		job->done = true;
+	}
+	return job;
+}
+
+bool sound_DecodeJobDone(SoundDecodeJob *job)
+{
+	if (decodeThread == nullptr)
+	{
+		return true;
+	}
+	wzMutexLock(decodeMutex);
+	const bool done = job->done;
+	wzMutexUnlock(decodeMutex);
+	return done;
+}
+
+soundDataBuffer *sound_FinishDecodeJob(SoundDecodeJob *job)
+{
+	bool decodeHere = false;
+	bool waitForThread = false;
+
+	if (decodeThread)
+	{
+		wzMutexLock(decodeMutex);
+		auto queued = std::find(decodeJobs.begin(), decodeJobs.end(), job);
+		if (queued != decodeJobs.end())
+		{
+			// Not started yet, so don't wait behind the other jobs.
+			decodeJobs.erase(queued);
+			decodeHere = true;
+		}
+		else
+		{
+			waitForThread = !job->done;
+		}
+		wzMutexUnlock(decodeMutex);
+	}
+	else
+	{
+		// Dropped by sound_StopDecodeThread() before the thread got to it.
+		decodeHere = !job->done;
+	}
+
+	if (decodeHere)
+	{
+		job->result = decodeFile(job->fileHandle);
+	}
+	else if (waitForThread)
+	{
+		wzSemaphoreWait(job->doneSemaphore);
+	}
+
+	soundDataBuffer *result = job->result;
+	if (job->doneSemaphore)
+	{
+		wzSemaphoreDestroy(job->doneSemaphore);
+	}
+	delete job;
+	return result;
+}
@@ -0,0 +1,62 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2005-2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** \file
+ *  Background OggVorbis decoding, so that neither streams nor sample loading decode on the main thread.
+ *  No OpenAL calls are made here, the decoded buffers are handed back to the caller.
+ */
+
+#ifndef _LIBSOUND_DECODETHREAD_H_
+#define _LIBSOUND_DECODETHREAD_H_
+
+#include "oggvorbis.h"
+
+/// Decoded buffers kept ready ahead of playback by a stream
+struct SoundStreamQueue;
+/// Whole sample being decoded in the background
+struct SoundDecodeJob;
+
+void sound_StartDecodeThread();
+void sound_StopDecodeThread();
+
+/** Start prefetching decoded data for a stream.
+ *  \param decoder the stream's decoder, which belongs to the decode thread until sound_DestroyStreamQueue()
+ *  \param bufferSize size of each decoded buffer
+ *  \param depth number of decoded buffers to keep ready
+ */
+SoundStreamQueue *sound_CreateStreamQueue(struct OggVorbisDecoderState *decoder, size_t bufferSize, unsigned int depth);
+/** Take the next decoded buffer of a stream without blocking.
+ *  \param finished set to true when the stream has been decoded completely and no buffers are left
+ *  \return a buffer to free() after use, or NULL when none is ready yet
+ */
+soundDataBuffer *sound_TakeStreamBuffer(SoundStreamQueue *queue, bool *finished);
+/// Stop prefetching, waiting for a decode in progress; the decoder is left for the caller to destroy.
+void sound_DestroyStreamQueue(SoundStreamQueue *queue);
+
+/** Queue a whole file for decoding.
+ *  \param fileHandle the file to decode, which the decode thread closes when done
+ */
+SoundDecodeJob *sound_DecodeFileAsync(PHYSFS_file *fileHandle);
+/// Check whether sound_FinishDecodeJob() would return without waiting.
+bool sound_DecodeJobDone(SoundDecodeJob *job);
+/** Get the result of a decode job, decoding it right away if it hasn't started yet.
+ *  \return the decoded data to free() after use, or NULL on failure; \c job is freed either way
+ */
+soundDataBuffer *sound_FinishDecodeJob(SoundDecodeJob *job);
+
+#endif // _LIBSOUND_DECODETHREAD_H_
@@ -38,11 +38,14 @@
 #include <string.h>
 #include <math.h>
 #include <limits>
+#include <algorithm>
+#include <vector>
 
 #include "tracklib.h"
 #include "audio.h"
 #include "cdaudio.h"
 #include "oggvorbis.h"
+#include "decodethread.h"
 #include "openal_error.h"
 #include "mixer.h"
 #include "openal_info.h"
@@ -55,8 +58,11 @@ struct AUDIO_STREAM
 {
 	ALuint                  source = -1;        // OpenAL name of the sound source
 	struct OggVorbisDecoderState *decoder = nullptr;
+	SoundStreamQueue       *queue = nullptr;       // buffers decoded ahead by the decode thread
 	PHYSFS_file *fileHandle = nullptr;
 	float                   volume = 0.f;
+	bool                    stopRequested = false; // set by sound_StopStream(), to tell a stop from running dry
+	bool                    decodeFinished = false;
 
 	// Callbacks
 	std::function<void (const void *)> onFinished;
@@ -78,6 +84,12 @@ static SAMPLE_LIST *active_samples = nullptr;
 
 static AUDIO_STREAM *active_streams = nullptr;
 
+/// Tracks whose samples are still being decoded by the decode thread
+static std::vector<TRACK *> decodingTracks;
+
+/// Minimum number of decoded buffers a stream keeps ready, so it survives the decode thread loading a long sample
+static const unsigned int minStreamPrefetch = 4;
+
 static ALfloat		sfx_volume = 1.0;
 static ALfloat		sfx3d_volume = 1.0;
 
@@ -241,6 +253,7 @@ bool sound_InitLibrary(HRTFMode hrtf)
 	debug(LOG_SOUND, "%s", buf);
 
 	openal_initialized = true;
+	sound_StartDecodeThread();
 
 #if defined(ALC_SOFT_HRTF)
 	if(alcIsExtensionPresent(device, "ALC_SOFT_HRTF"))
@@ -364,6 +377,7 @@ bool sound_SetHRTFMode(HRTFMode mode)
 }
 
 static void sound_UpdateStreams(void);
+static void sound_FinishTrackDecode(TRACK *psTrack);
 
 void sound_ShutdownLibrary(void)
 {
@@ -383,6 +397,13 @@ void sound_ShutdownLibrary(void)
 	}
 	sound_UpdateStreams();
 
+	// Give tracks still being decoded their buffers while there is a context to create them in
+	while (!decodingTracks.empty())
+	{
+		sound_FinishTrackDecode(decodingTracks.back());
+	}
+	sound_StopDecodeThread();
+
 	alcGetError(device);	// clear error codes
 
 	/* On Linux since this caused some versions of OpenAL to hang on exit. - Per */
@@ -465,6 +486,19 @@ void sound_Update()
 	// Update all streaming audio
 	sound_UpdateStreams();
 
+	// Pick up samples the decode thread has finished
+	for (size_t i = 0; i < decodingTracks.size();)
+	{
+		if (sound_DecodeJobDone(decodingTracks[i]->psDecodeJob))
+		{
+			sound_FinishTrackDecode(decodingTracks[i]);  // removes it from decodingTracks
+		}
+		else
+		{
+			++i;
+		}
+	}
+
 	while (node != nullptr)
 	{
 		ALenum state, err;
@@ -590,51 +624,25 @@ bool sound_QueueSamplePlaying(void)
 	return false;
 }
 
-/** Decodes an opened OggVorbis file into an OpenAL buffer
+/** Puts the decoded sample of a track into an OpenAL buffer
  *  \param psTrack pointer to object which will contain the final buffer
- *  \param PHYSFS_fileHandle file handle given by PhysicsFS to the opened file
- *  \return on success the psTrack pointer, otherwise it will be free'd and a NULL pointer is returned instead
+ *  \param soundBuffer the decoded data, or NULL if decoding failed; free'd by this function
  */
-static inline TRACK *sound_DecodeOggVorbisTrack(TRACK *psTrack, PHYSFS_file *PHYSFS_fileHandle)
+static void sound_UploadTrack(TRACK *psTrack, soundDataBuffer *soundBuffer)
 {
 	ALenum		format;
 	ALuint		buffer;
-	struct OggVorbisDecoderState *decoder;
-	soundDataBuffer	*soundBuffer;
-
-	if (!openal_initialized)
-	{
-		return nullptr;
-	}
-
-	decoder = sound_CreateOggVorbisDecoder(PHYSFS_fileHandle, true);
-	if (decoder == nullptr)
-	{
-		debug(LOG_WARNING, "Failed to open audio file for decoding");
-		free(psTrack);
-		return nullptr;
-	}
-
-	soundBuffer = sound_DecodeOggVorbis(decoder, 0);
-	sound_DestroyOggVorbisDecoder(decoder);
 
 	if (soundBuffer == nullptr)
 	{
-		free(psTrack);
-		return nullptr;
+		// The track stays without a buffer, and thus silent
+		debug(LOG_ERROR, "Failed to decode audio file %s", psTrack->fileName ? psTrack->fileName : "(unknown)");
+		return;
 	}
 
 	if (soundBuffer->size == 0)
 	{
-		debug(LOG_WARNING, "sound_DecodeOggVorbisTrack: OggVorbis track is entirely empty after decoding");
-// NOTE: I'm not entirely sure if a track that's empty after decoding should be
-//       considered an error condition. Therefore I'll only error out on DEBUG
-//       builds. (Returning NULL here __will__ result in a program termination.)
-#ifdef DEBUG
-		free(soundBuffer);
-		free(psTrack);
-		return NULL;
-#endif
+		debug(LOG_WARNING, "sound_UploadTrack: OggVorbis track is entirely empty after decoding");
 	}
 
 	// Determine PCM data format
@@ -651,8 +659,23 @@ static inline TRACK *sound_DecodeOggVorbisTrack(TRACK *psTrack, PHYSFS_file *PHY
 
 	// save buffer name in track
 	psTrack->iBufferName = buffer;
+}
+
+/** Gives a track its OpenAL buffer, waiting for (or doing) the decode if needed.
+ *  Does nothing for tracks that aren't being decoded.
+ */
+static void sound_FinishTrackDecode(TRACK *psTrack)
+{
+	if (psTrack->psDecodeJob == nullptr)
+	{
+		return;
+	}
+
+	soundDataBuffer *soundBuffer = sound_FinishDecodeJob(psTrack->psDecodeJob);
+	psTrack->psDecodeJob = nullptr;
+	decodingTracks.erase(std::remove(decodingTracks.begin(), decodingTracks.end(), psTrack), decodingTracks.end());
 
-	return psTrack;
+	sound_UploadTrack(psTrack, soundBuffer);
 }
 
 //*
@@ -711,15 +734,24 @@ TRACK *sound_LoadTrackFromFile(const char *fileName)
 	}
 	pTrack->fileName = track_name;
 
-	// Now use sound_ReadTrackFromBuffer to decode the file's contents
-	pTrack = sound_DecodeOggVorbisTrack(pTrack, fileHandle);
+	if (!openal_initialized)
+	{
+		PHYSFS_close(fileHandle);
+		free(pTrack);
+		return nullptr;
+	}
+
+	// Decode the file's contents in the background, the decode job closes the file. The track gets its
+	// buffer in sound_Update() once that is done, or when it's played first, whichever comes first.
+	pTrack->psDecodeJob = sound_DecodeFileAsync(fileHandle);
+	decodingTracks.push_back(pTrack);
 
-	PHYSFS_close(fileHandle);
 	return pTrack;
 }
 
 void sound_FreeTrack(TRACK *psTrack)
 {
+	sound_FinishTrackDecode(psTrack);
 	alDeleteBuffers(1, &psTrack->iBufferName);
 	sound_GetError();
 }
@@ -794,6 +826,9 @@ bool sound_Play2DSample(TRACK *psTrack, AUDIO_SAMPLE *psSample, bool bQueued)
 		return false;
 	}
 
+	// The sample may still be loading
+	sound_FinishTrackDecode(psTrack);
+
 	// Clear error codes
 	alGetError();
 
@@ -865,6 +900,9 @@ bool sound_Play3DSample(TRACK *psTrack, AUDIO_SAMPLE *psSample)
 	{
 		return false;
 	}
+	// The sample may still be loading
+	sound_FinishTrackDecode(psTrack);
+
 	// Clear error codes
 	alGetError();
 
@@ -1085,6 +1123,9 @@ AUDIO_STREAM *sound_PlayStreamWithBuf(PHYSFS_file *fileHandle, float volume, con
 
 	sound_GetError();
 
+	// From here on the decode thread keeps decoded data ready
+	stream->queue = sound_CreateStreamQueue(stream->decoder, stream->bufferSize, std::max(buffer_count, minStreamPrefetch));
+
 	// Set callback info
 	stream->onFinished = onFinished;
 	stream->user_data = user_data;
@@ -1134,6 +1175,7 @@ void sound_StopStream(AUDIO_STREAM *stream)
 {
 	assert(stream != nullptr);
 
+	stream->stopRequested = true;
 	alGetError();	// clear error codes
 	// Tell OpenAL to stop playing on the given source
 	alSourceStop(stream->source);
@@ -1226,13 +1268,20 @@ double sound_GetStreamTotalTime(AUDIO_STREAM *stream)
 static bool sound_UpdateStream(AUDIO_STREAM *stream)
 {
 	ALint state, buffer_count;
+	bool ranDry = false;
 
 	alGetSourcei(stream->source, AL_SOURCE_STATE, &state);
 	sound_GetError();
 
 	if (state != AL_PLAYING && state != AL_PAUSED)
 	{
-		return false;
+		// A source that played all its queued buffers stops. Unless that was the end of the
+		// stream, the decode thread merely fell behind and the stream should carry on.
+		if (state != AL_STOPPED || stream->stopRequested || stream->decodeFinished)
+		{
+			return false;
+		}
+		ranDry = true;
 	}
 
 	// Retrieve the amount of buffers which were processed and need refilling
@@ -1240,20 +1289,26 @@ static bool sound_UpdateStream(AUDIO_STREAM *stream)
 	sound_GetError();
 
 	// Refill and reattach all buffers
+	bool refilled = false;
 	for (; buffer_count != 0; --buffer_count)
 	{
-		soundDataBuffer *soundBuffer;
+		bool finished = false;
 		ALuint buffer;
 
+		// Take some data the decode thread prepared for our buffer
+		soundDataBuffer *soundBuffer = sound_TakeStreamBuffer(stream->queue, &finished);
+		if (soundBuffer == nullptr && !finished)
+		{
+			// Nothing decoded yet, keep the buffer until the next update
+			break;
+		}
+
 		// Retrieve the buffer to work on
 		alSourceUnqueueBuffers(stream->source, 1, &buffer);
 		sound_GetError();
 
-		// Decode some data to stuff in our buffer
-		soundBuffer = sound_DecodeOggVorbis(stream->decoder, stream->bufferSize);
-
 		// If we actually decoded some data
-		if (soundBuffer && soundBuffer->size > 0)
+		if (soundBuffer)
 		{
 			// Determine PCM data format
 			ALenum format = (soundBuffer->channelCount == 1) ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
@@ -1266,11 +1321,12 @@ static bool sound_UpdateStream(AUDIO_STREAM *stream)
 			// Reattach the buffer to the source
 			alSourceQueueBuffers(stream->source, 1, &buffer);
 			sound_GetError();
+			refilled = true;
 		}
 		else
 		{
-			// If no data has been decoded we're probably at the end of our
-			// stream. So cleanup this buffer.
+			// We're at the end of our stream. So cleanup this buffer.
+			stream->decodeFinished = true;
 
 			// Then remove OpenAL's buffer
 			alDeleteBuffers(1, &buffer);
@@ -1281,6 +1337,13 @@ static bool sound_UpdateStream(AUDIO_STREAM *stream)
 		free(soundBuffer);
 	}
 
+	if (ranDry && refilled)
+	{
+		debug(LOG_SOUND, "Stream ran dry, restarting it");
+		alSourcePlay(stream->source);
+		sound_GetError();
+	}
+
 	return true;
 }
 
@@ -1362,7 +1425,11 @@ static void sound_DestroyStream(AUDIO_STREAM *stream)
 	alDeleteSources(1, &stream->source);
 	sound_GetError();
 
-	// Destroy the sound decoder
+	// Stop decoding ahead, then destroy the sound decoder
+	if (stream->queue)
+	{
+		sound_DestroyStreamQueue(stream->queue);
+	}
 	sound_DestroyOggVorbisDecoder(stream->decoder);
 
 	// Now close the file
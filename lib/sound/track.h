@@ -74,6 +74,7 @@ struct TRACK
 	UDWORD          iNumPlaying;
 	ALuint          iBufferName;            // OpenAL name of the buffer
 	const char     *fileName;
+	struct SoundDecodeJob *psDecodeJob;     // sample still being decoded in the background, or NULL
 };
 
 /* functions
@@ -25,6 +25,10 @@
  */
 
 #include "lib/framework/frame.h"
+#include "lib/framework/wzjobs.h"
+
+#include <algorithm>
+#include <unordered_map>
 
 #include "action.h"
 #include "cmddroid.h"
@@ -80,6 +84,31 @@ PlayerMask alliancebits[MAX_PLAYER_SLOTS];
 /// A bitfield for the satellite uplink
 PlayerMask satuplinkbits;
 
+/// A target a structure could shoot at, from aiStructureTargetCandidates().
+struct AiTargetCandidate
+{
+	BASE_OBJECT *psTarget;
+	int weight;   ///< targetAttackWeight()
+	int distSq;
+};
+
+/// A target search done by aiEvaluateTargets(), for the droid or structure to pick up during its update.
+struct AiTargetEvaluation
+{
+	BASE_OBJECT *psObj;
+	int weapon_slot;
+	int bestMod;                                ///< Droids: result of aiBestNearestTargetScan().
+	BASE_OBJECT *bestTarget;                    ///< Droids: target found by aiBestNearestTargetScan(), before checking for walls.
+	std::vector<AiTargetCandidate> candidates;  ///< Structures: result of aiStructureTargetCandidates().
+	GridList gridList;                          ///< Kept between ticks to reuse the memory.
+};
+static std::vector<AiTargetEvaluation> aiEvaluations;
+static size_t numAiEvaluations = 0;   ///< Entries of aiEvaluations in use this tick.
+static uint32_t aiEvaluationTime = 0; ///< gameTime the evaluations were done at, they are only used during that tick.
+static std::unordered_map<uint64_t, size_t> aiEvaluationIndex;  ///< Index into aiEvaluations by object id and weapon slot.
+
+static SDWORD targetAttackWeight(BASE_OBJECT *psTarget, BASE_OBJECT *psAttacker, SDWORD weapon_slot);
+
 static int aiDroidRange(DROID *psDroid, int weapon_slot)
 {
 	int32_t longRange;
@@ -136,6 +165,23 @@ static bool aiObjHasRange(BASE_OBJECT *psObj, BASE_OBJECT *psTarget, int weapon_
 	return false;
 }
 
+static void evaluateTarget(AiTargetEvaluation &evaluation);
+
+/// The evaluation aiEvaluateTargets() did this tick for the weapon, if any.
+static AiTargetEvaluation *aiFindEvaluation(BASE_OBJECT const *psObj, int weapon_slot)
+{
+	if (aiEvaluationTime != gameTime || numAiEvaluations == 0)
+	{
+		return nullptr;
+	}
+	auto i = aiEvaluationIndex.find((uint64_t)psObj->id * MAX_WEAPONS + weapon_slot);
+	if (i == aiEvaluationIndex.end() || aiEvaluations[i->second].psObj != psObj)
+	{
+		return nullptr;
+	}
+	return &aiEvaluations[i->second];
+}
+
 /* Initialise the AI system */
 bool aiInitialise()
 {
@@ -160,6 +206,10 @@ bool aiInitialise()
 /* Shutdown the AI system */
 bool aiShutdown()
 {
+	aiEvaluations.clear();
+	aiEvaluationIndex.clear();
+	numAiEvaluations = 0;
+
 	return true;
 }
 
@@ -540,19 +590,19 @@ static SDWORD targetAttackWeight(BASE_OBJECT *psTarget, BASE_OBJECT *psAttacker,
 }
 
 
-// Find the best nearest target for a droid.
-// If extraRange is higher than zero, then this is the range it accepts for movement to target.
+// Search the area around a droid for the best target, without checking for walls in the way.
+// Only reads the game state, so this may run on the job pool.
 // Returns integer representing target priority, -1 if failed
-int aiBestNearestTarget(DROID *psDroid, BASE_OBJECT **ppsObj, int weapon_slot, int extraRange)
+static int aiBestNearestTargetScan(DROID *psDroid, BASE_OBJECT **ppsBest, int weapon_slot, int extraRange, GridList &gridList)
 {
 	int failure = -1;
 	int bestMod = 0;
 	BASE_OBJECT                     *psTarget = nullptr, *bestTarget = nullptr, *tempTarget;
 	bool				electronic = false;
-	STRUCTURE			*targetStructure;
-	WEAPON_EFFECT			weaponEffect;
 	TARGET_ORIGIN tmpOrigin = ORIGIN_UNKNOWN;
 
+	*ppsBest = nullptr;
+
 	//don't bother looking if empty vtol droid
 	if (vtolEmpty(psDroid))
 	{
@@ -574,15 +624,12 @@ int aiBestNearestTarget(DROID *psDroid, BASE_OBJECT **ppsObj, int weapon_slot, i
 		bestMod = targetAttackWeight(bestTarget, (BASE_OBJECT *)psDroid, weapon_slot);
 	}
 
-	weaponEffect = (asWeaponStats + psDroid->asWeaps[weapon_slot].nStat)->weaponEffect;
-
 	electronic = electronicDroid(psDroid);
 
 	// Range was previously 9*TILE_UNITS. Increasing this doesn't seem to help much, though. Not sure why.
 	int droidRange = std::min(aiDroidRange(psDroid, weapon_slot) + extraRange, objSensorRange(psDroid) + 6 * TILE_UNITS);
 
-	static GridList gridList;  // static to avoid allocations.
-	gridList = gridStartIterate(psDroid->pos.x, psDroid->pos.y, droidRange);
+	gridStartIterate(gridList, psDroid->pos.x, psDroid->pos.y, droidRange);
 	for (GridIterator gi = gridList.begin(); gi != gridList.end(); ++gi)
 	{
 		BASE_OBJECT *friendlyObj = nullptr;
@@ -703,10 +750,36 @@ int aiBestNearestTarget(DROID *psDroid, BASE_OBJECT **ppsObj, int weapon_slot, i
 		}
 	}
 
+	*ppsBest = bestTarget;
+	return bestTarget != nullptr ? bestMod : failure;
+}
+
+// Find the best nearest target for a droid.
+// If extraRange is higher than zero, then this is the range it accepts for movement to target.
+// Returns integer representing target priority, -1 if failed
+int aiBestNearestTarget(DROID *psDroid, BASE_OBJECT **ppsObj, int weapon_slot, int extraRange)
+{
+	int bestMod;
+	BASE_OBJECT *bestTarget = nullptr;
+
+	// Use the search aiEvaluateTargets() did at the start of the tick, unless its target died since.
+	AiTargetEvaluation *evaluation = extraRange == 0 ? aiFindEvaluation(psDroid, weapon_slot) : nullptr;
+	if (evaluation != nullptr && (evaluation->bestTarget == nullptr || !evaluation->bestTarget->died))
+	{
+		bestTarget = evaluation->bestTarget;
+		bestMod = evaluation->bestMod;
+	}
+	else
+	{
+		static GridList gridList;  // static to avoid allocations.
+		bestMod = aiBestNearestTargetScan(psDroid, &bestTarget, weapon_slot, extraRange, gridList);
+	}
+
 	if (bestTarget)
 	{
 		ASSERT(!bestTarget->died, "AI gave us a target that is already dead.");
-		targetStructure = visGetBlockingWall(psDroid, bestTarget);
+		STRUCTURE *targetStructure = visGetBlockingWall(psDroid, bestTarget);
+		WEAPON_EFFECT weaponEffect = (asWeaponStats + psDroid->asWeaps[weapon_slot].nStat)->weaponEffect;
 
 		// See if target is blocked by a wall; only affects direct weapons
 		// Ignore friendly walls here
@@ -725,7 +798,48 @@ int aiBestNearestTarget(DROID *psDroid, BASE_OBJECT **ppsObj, int weapon_slot, i
 		return bestMod;
 	}
 
-	return failure;
+	return -1;
+}
+
+/// Find the visible enemies in range of a structure's weapon, best first. Which of these are in the line of fire is left to the caller.
+/// Only reads the game state, so this may run on the job pool.
+static void aiStructureTargetCandidates(STRUCTURE *psStruct, int weapon_slot, GridList &gridList, std::vector<AiTargetCandidate> &candidates)
+{
+	candidates.clear();
+	if (psStruct->numWeaps == 0 || psStruct->asWeaps[0].nStat == 0)
+	{
+		return;  // Can't attack without a weapon, see aiStructHasRange().
+	}
+
+	WEAPON_STATS *psWStats = psStruct->asWeaps[weapon_slot].nStat + asWeaponStats;
+	int longRange = proj_GetLongRange(psWStats, psStruct->player);
+	int srange = longRange;
+
+	if (!proj_Direct(psWStats) && srange > objSensorRange(psStruct))
+	{
+		// search radius of indirect weapons limited by their sight, unless they use
+		// external sensors to provide fire designation
+		srange = objSensorRange(psStruct);
+	}
+
+	gridStartIterate(gridList, psStruct->pos.x, psStruct->pos.y, srange);
+	for (GridIterator gi = gridList.begin(); gi != gridList.end(); ++gi)
+	{
+		BASE_OBJECT *psCurr = *gi;
+		/* Check that it is a valid target */
+		if (psCurr->type != OBJ_FEATURE && !psCurr->died
+		    && !aiCheckAlliances(psCurr->player, psStruct->player)
+		    && validTarget(psStruct, psCurr, weapon_slot) && psCurr->visible[psStruct->player] == UBYTE_MAX
+		    && objPosDiffSq(psStruct, psCurr) < longRange * longRange)
+		{
+			candidates.push_back({psCurr, targetAttackWeight(psCurr, psStruct, weapon_slot), objPosDiffSq(psCurr->pos, psStruct->pos)});
+		}
+	}
+
+	// Best weight first, then nearest first, then in search order, as aiChooseTarget() used to pick them.
+	std::stable_sort(candidates.begin(), candidates.end(), [](AiTargetCandidate const &a, AiTargetCandidate const &b) {
+		return a.weight > b.weight || (a.weight == b.weight && a.distSq < b.distSq);
+	});
 }
 
 // Are there a lot of bullets heading towards the droid?
@@ -872,7 +986,6 @@ bool aiChooseTarget(BASE_OBJECT *psObj, BASE_OBJECT **ppsTarget, int weapon_slot
 		ASSERT_OR_RETURN(false, psObj->asWeaps[weapon_slot].nStat > 0, "Invalid weapon turret");
 
 		WEAPON_STATS *psWStats = psObj->asWeaps[weapon_slot].nStat + asWeaponStats;
-		int longRange = proj_GetLongRange(psWStats, psObj->player);
 
 		// see if there is a target from the command droids
 		psTarget = nullptr;
@@ -915,40 +1028,27 @@ bool aiChooseTarget(BASE_OBJECT *psObj, BASE_OBJECT **ppsTarget, int weapon_slot
 
 		if (psTarget == nullptr && !bCommanderBlock)
 		{
-			int targetValue = -1;
-			int tarDist = INT32_MAX;
-			int srange = longRange;
-
-			if (!proj_Direct(psWStats) && srange > objSensorRange(psObj))
+			static std::vector<AiTargetCandidate> liveCandidates;  // static to avoid allocations.
+			std::vector<AiTargetCandidate> *candidates = &liveCandidates;
+			AiTargetEvaluation *evaluation = aiFindEvaluation(psObj, weapon_slot);
+			if (evaluation != nullptr)
+			{
+				candidates = &evaluation->candidates;
+			}
+			else
 			{
-				// search radius of indirect weapons limited by their sight, unless they use
-				// external sensors to provide fire designation
-				srange = objSensorRange(psObj);
+				static GridList gridList;  // static to avoid allocations.
+				aiStructureTargetCandidates((STRUCTURE *)psObj, weapon_slot, gridList, liveCandidates);
 			}
 
-			static GridList gridList;  // static to avoid allocations.
-			gridList = gridStartIterate(psObj->pos.x, psObj->pos.y, srange);
-			for (GridIterator gi = gridList.begin(); gi != gridList.end(); ++gi)
+			// Take the best one we can actually hit.
+			for (AiTargetCandidate const &candidate : *candidates)
 			{
-				BASE_OBJECT *psCurr = *gi;
-				/* Check that it is a valid target */
-				if (psCurr->type != OBJ_FEATURE && !psCurr->died
-				    && !aiCheckAlliances(psCurr->player, psObj->player)
-				    && validTarget(psObj, psCurr, weapon_slot) && psCurr->visible[psObj->player] == UBYTE_MAX
-				    && aiStructHasRange((STRUCTURE *)psObj, psCurr, weapon_slot))
+				if (!candidate.psTarget->died && lineOfFire(psObj, candidate.psTarget, weapon_slot, true))
 				{
-					int newTargetValue = targetAttackWeight(psCurr, psObj, weapon_slot);
-					// See if in sensor range and visible
-					int distSq = objPosDiffSq(psCurr->pos, psObj->pos);
-					if (newTargetValue < targetValue || (newTargetValue == targetValue && distSq >= tarDist))
-					{
-						continue;
-					}
-
 					tmpOrigin = ORIGIN_VISUAL;
-					psTarget = psCurr;
-					tarDist = distSq;
-					targetValue = newTargetValue;
+					psTarget = candidate.psTarget;
+					break;
 				}
 			}
 		}
@@ -1081,11 +1181,14 @@ static bool updateAttackTarget(BASE_OBJECT *psAttacker, SDWORD weapon_slot)
 	return false;
 }
 
-/* Do the AI for a droid */
-void aiUpdateDroid(DROID *psDroid)
+/* Decide whether a droid should look for a target, or look for a better one than it has, this tick */
+static void aiDroidTargetSearch(DROID *psDroid, bool *pLookForTarget, bool *pUpdateTargets)
 {
 	bool		lookForTarget, updateTarget;
 
+	*pLookForTarget = false;
+	*pUpdateTargets = false;
+
 	ASSERT(psDroid != nullptr, "Invalid droid pointer");
 	if (!psDroid || isDead((BASE_OBJECT *)psDroid))
 	{
@@ -1174,8 +1277,21 @@ void aiUpdateDroid(DROID *psDroid)
 	}
 
 	/* For commanders and non-assigned non-commanders: look for a better target once in a while */
-	if (!lookForTarget && updateTarget && psDroid->numWeaps > 0 && !hasCommander(psDroid)
-	    && (psDroid->id + gameTime) / TARGET_UPD_SKIP_FRAMES != (psDroid->id + gameTime - deltaGameTime) / TARGET_UPD_SKIP_FRAMES)
+	*pUpdateTargets = !lookForTarget && updateTarget && psDroid->numWeaps > 0 && !hasCommander(psDroid)
+	                  && (psDroid->id + gameTime) / TARGET_UPD_SKIP_FRAMES != (psDroid->id + gameTime - deltaGameTime) / TARGET_UPD_SKIP_FRAMES;
+
+	/* Null target - see if there is an enemy to attack */
+	*pLookForTarget = lookForTarget && !updateTarget;
+}
+
+/* Do the AI for a droid */
+void aiUpdateDroid(DROID *psDroid)
+{
+	bool		lookForTarget, updateTargets;
+
+	aiDroidTargetSearch(psDroid, &lookForTarget, &updateTargets);
+
+	if (updateTargets)
 	{
 		for (unsigned i = 0; i < psDroid->numWeaps; ++i)
 		{
@@ -1183,9 +1299,7 @@ void aiUpdateDroid(DROID *psDroid)
 		}
 	}
 
-	/* Null target - see if there is an enemy to attack */
-
-	if (lookForTarget && !updateTarget)
+	if (lookForTarget)
 	{
 		BASE_OBJECT *psTarget;
 		if (psDroid->droidType == DROID_SENSOR)
@@ -1215,6 +1329,90 @@ void aiUpdateDroid(DROID *psDroid)
 	}
 }
 
+/** Do the read only part of a target search, for aiBestNearestTarget() or aiChooseTarget() to pick up.
+ *  This runs on the job pool, and in the game thread.
+ */
+static void evaluateTarget(AiTargetEvaluation &evaluation)
+{
+	if (evaluation.psObj->type == OBJ_DROID)
+	{
+		evaluation.bestMod = aiBestNearestTargetScan((DROID *)evaluation.psObj, &evaluation.bestTarget, evaluation.weapon_slot, 0, evaluation.gridList);
+	}
+	else
+	{
+		aiStructureTargetCandidates((STRUCTURE *)evaluation.psObj, evaluation.weapon_slot, evaluation.gridList, evaluation.candidates);
+	}
+}
+
+static void aiAddEvaluation(BASE_OBJECT *psObj, int weapon_slot)
+{
+	if (numAiEvaluations == aiEvaluations.size())
+	{
+		aiEvaluations.emplace_back();
+	}
+	AiTargetEvaluation &evaluation = aiEvaluations[numAiEvaluations];
+	evaluation.psObj = psObj;
+	evaluation.weapon_slot = weapon_slot;
+	evaluation.bestMod = -1;
+	evaluation.bestTarget = nullptr;
+	evaluation.candidates.clear();
+	aiEvaluationIndex[(uint64_t)psObj->id * MAX_WEAPONS + weapon_slot] = numAiEvaluations;
+	++numAiEvaluations;
+}
+
+/* Search for targets for all droids and structures that will want one this tick, in parallel.
+ * Nothing is changed here, the droid and structure updates pick up the results and act on them in order. */
+void aiEvaluateTargets()
+{
+	numAiEvaluations = 0;
+	aiEvaluationIndex.clear();
+	aiEvaluationTime = gameTime;
+
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		for (DROID *psDroid = apsDroidLists[player]; psDroid != nullptr; psDroid = psDroid->psNext)
+		{
+			bool lookForTarget, updateTargets;
+			aiDroidTargetSearch(psDroid, &lookForTarget, &updateTargets);
+			if (updateTargets)
+			{
+				for (unsigned i = 0; i < psDroid->numWeaps; ++i)
+				{
+					aiAddEvaluation(psDroid, i);
+				}
+			}
+			else if (lookForTarget)
+			{
+				aiAddEvaluation(psDroid, 0);
+			}
+		}
+		for (STRUCTURE *psStruct = apsStructLists[player]; psStruct != nullptr; psStruct = psStruct->psNext)
+		{
+			if (psStruct->status != SS_BUILT || psStruct->died)
+			{
+				continue;
+			}
+			// Same weapons as structureUpdate() looks for targets for.
+			for (unsigned i = 0; i < psStruct->numWeaps; ++i)
+			{
+				if (psStruct->asWeaps[i].nStat > 0 && asWeaponStats[psStruct->asWeaps[i].nStat].weaponSubClass != WSC_LAS_SAT)
+				{
+					aiAddEvaluation(psStruct, i);
+				}
+			}
+		}
+	}
+
+	const size_t count = numAiEvaluations;
+	if (count == 0)
+	{
+		return;
+	}
+	wzParallelFor("ai targets", count, [](size_t i) {
+		evaluateTarget(aiEvaluations[i]);
+	});
+}
+
 /* Check if any of our weapons can hit the target... */
 bool checkAnyWeaponsTarget(BASE_OBJECT *psObject, BASE_OBJECT *psTarget)
 {
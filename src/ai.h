@@ -63,6 +63,9 @@ bool aiShutdown();
 /* Do the AI for a droid */
 void aiUpdateDroid(DROID *psDroid);
 
+/// Search for targets for all droids and structures in parallel, for their updates later this tick to pick up.
+void aiEvaluateTargets();
+
 // Find the nearest best target for a droid
 // returns integer representing quality of choice, -1 if failed
 int aiBestNearestTarget(DROID *psDroid, BASE_OBJECT **ppsObj, int weapon_slot, int extraRange = 0);
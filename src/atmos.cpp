@@ -35,6 +35,7 @@
 #include "miscimd.h"
 #include "lib/gamelib/gtime.h"
 #include <cmath>
+#include <vector>
 
 #ifndef GLM_ENABLE_EXPERIMENTAL
 	#define GLM_ENABLE_EXPERIMENTAL
@@ -58,189 +59,189 @@ enum AP_TYPE
 	AP_SNOW
 };
 
-enum AP_STATUS
+/** The active weather particles only, as a structure of arrays, so that moving them is a linear pass over floats */
+struct ATMOS_PARTICLES
 {
-	APS_INACTIVE,
-	APS_ACTIVE
-};
+	std::vector<float> x, y, z;		///< Position in world coordinates
+	std::vector<float> vx, vy, vz;	///< Velocity per second
+	std::vector<UBYTE> type;		///< AP_TYPE
 
-static ATPART	*asAtmosParts = nullptr;
-static UDWORD	freeParticle;
-static WT_CLASS	weather = WT_NONE;
+	size_t size() const
+	{
+		return x.size();
+	}
 
-/* Setup all the particles */
-void atmosInitSystem()
-{
-	if (!asAtmosParts && weather != WT_NONE)
+	void clear()
 	{
-		// calloc sets all to APS_INACTIVE initially
-		asAtmosParts = (ATPART *)calloc(MAX_ATMOS_PARTICLES, sizeof(*asAtmosParts));
+		resize(0);
 	}
-	/* Start at the beginning */
-	freeParticle = 0;
-}
 
-/*	Makes a particle wrap around - if it goes off the grid, then it returns
-	on the other side - provided it's still on world... Which it should be */
-static void testParticleWrap(ATPART *psPart)
-{
-	/* Gone off left side */
-	if (psPart->position.x < playerPos.p.x - world_coord(visibleTiles.x) / 2)
+	void resize(size_t count)
 	{
-		psPart->position.x += world_coord(visibleTiles.x);
+		x.resize(count); y.resize(count); z.resize(count);
+		vx.resize(count); vy.resize(count); vz.resize(count);
+		type.resize(count);
 	}
 
-	/* Gone off right side */
-	else if (psPart->position.x > (playerPos.p.x + world_coord(visibleTiles.x) / 2))
+	void add(const Vector3f &pos, const Vector3f &vel, AP_TYPE apType)
 	{
-		psPart->position.x -= world_coord(visibleTiles.x);
+		x.push_back(pos.x); y.push_back(pos.y); z.push_back(pos.z);
+		vx.push_back(vel.x); vy.push_back(vel.y); vz.push_back(vel.z);
+		type.push_back((UBYTE)apType);
 	}
 
-	/* Gone off top */
-	if (psPart->position.z < playerPos.p.z - world_coord(visibleTiles.y) / 2)
+	/// Copies particle from into slot to, used when compacting the arrays.
+	void move(size_t to, size_t from)
+	{
+		x[to] = x[from]; y[to] = y[from]; z[to] = z[from];
+		vx[to] = vx[from]; vy[to] = vy[from]; vz[to] = vz[from];
+		type[to] = type[from];
+	}
+};
+
+static ATMOS_PARTICLES	atmosParts;
+static WT_CLASS	weather = WT_NONE;
+
+/* Setup all the particles */
+void atmosInitSystem()
+{
+	atmosParts.clear();
+}
+
+/* Moves all active particles - frame rate controlled. Kept free of calls and branches other than selects so it vectorises. */
+static void atmosMoveParticles(size_t count)
+{
+	const float step = graphicsTimeAdjustedIncrement(1.f);
+	float *WZ_DECL_RESTRICT x = atmosParts.x.data();
+	float *WZ_DECL_RESTRICT y = atmosParts.y.data();
+	float *WZ_DECL_RESTRICT z = atmosParts.z.data();
+	const float *WZ_DECL_RESTRICT vx = atmosParts.vx.data();
+	const float *WZ_DECL_RESTRICT vy = atmosParts.vy.data();
+	const float *WZ_DECL_RESTRICT vz = atmosParts.vz.data();
+
+	for (size_t i = 0; i < count; ++i)
 	{
-		psPart->position.z += world_coord(visibleTiles.y);
+		x[i] += vx[i] * step;
+		y[i] += vy[i] * step;
+		z[i] += vz[i] * step;
 	}
+}
 
-	/* Gone off bottom */
-	else if (psPart->position.z > (playerPos.p.z + world_coord(visibleTiles.y) / 2))
+/*	Makes the particles wrap around - if they go off the grid, then they return
+	on the other side - provided they're still on world... Which they should be */
+static void atmosWrapParticles(size_t count)
+{
+	const float spanX = static_cast<float>(world_coord(visibleTiles.x));
+	const float spanZ = static_cast<float>(world_coord(visibleTiles.y));
+	const float minX = static_cast<float>(playerPos.p.x - world_coord(visibleTiles.x) / 2);
+	const float maxX = static_cast<float>(playerPos.p.x + world_coord(visibleTiles.x) / 2);
+	const float minZ = static_cast<float>(playerPos.p.z - world_coord(visibleTiles.y) / 2);
+	const float maxZ = static_cast<float>(playerPos.p.z + world_coord(visibleTiles.y) / 2);
+	float *WZ_DECL_RESTRICT x = atmosParts.x.data();
+	float *WZ_DECL_RESTRICT z = atmosParts.z.data();
+
+	for (size_t i = 0; i < count; ++i)
 	{
-		psPart->position.z -= world_coord(visibleTiles.y);
+		const float px = x[i];
+		x[i] = px < minX ? px + spanX : (px > maxX ? px - spanX : px);
+		const float pz = z[i];
+		z[i] = pz < minZ ? pz + spanZ : (pz > maxZ ? pz - spanZ : pz);
 	}
 }
 
-/* Moves one of the particles */
-static void processParticle(ATPART *psPart)
+/* Checks whether the (already moved) particle i is still alive, spawning a splash if rain hit water */
+static bool atmosParticleAlive(size_t i)
 {
-	SDWORD	groundHeight;
-	Vector3i pos;
-	UDWORD	x, y;
-	MAPTILE	*psTile;
+	const float x = atmosParts.x[i];
+	const float y = atmosParts.y[i];
+	const float z = atmosParts.z[i];
+
+	/* If it's gone off the WORLD... */
+	if (x < 0 || z < 0 ||
+	    x > ((mapWidth - 1)*TILE_UNITS) ||
+	    z > ((mapHeight - 1)*TILE_UNITS))
+	{
+		/* The kill it */
+		return false;
+	}
 
-	/* Only move if the game isn't paused */
-	if (!gamePaused())
+	/* What height is the ground under it? Only do if low enough...*/
+	if (y < TILE_MAX_HEIGHT)
 	{
-		/* Move the particle - frame rate controlled */
-		psPart->position.x += graphicsTimeAdjustedIncrement(psPart->velocity.x);
-		psPart->position.y += graphicsTimeAdjustedIncrement(psPart->velocity.y);
-		psPart->position.z += graphicsTimeAdjustedIncrement(psPart->velocity.z);
-
-		/* Wrap it around if it's gone off grid... */
-		testParticleWrap(psPart);
-
-		/* If it's gone off the WORLD... */
-		if (psPart->position.x < 0 || psPart->position.z < 0 ||
-		    psPart->position.x > ((mapWidth - 1)*TILE_UNITS) ||
-		    psPart->position.z > ((mapHeight - 1)*TILE_UNITS))
-		{
-			/* The kill it */
-			psPart->status = APS_INACTIVE;
-			return;
-		}
+		/* Get ground height */
+		SDWORD groundHeight = map_Height(static_cast<int>(x), static_cast<int>(z));
 
-		/* What height is the ground under it? Only do if low enough...*/
-		if (psPart->position.y < TILE_MAX_HEIGHT)
+		/* Are we below ground? */
+		if ((int)y < groundHeight || y < 0.f)
 		{
-			/* Get ground height */
-			groundHeight = map_Height(static_cast<int>(psPart->position.x), static_cast<int>(psPart->position.z));
-
-			/* Are we below ground? */
-			if ((int)psPart->position.y < groundHeight
-			    || psPart->position.y < 0.f)
+			/* Kill it and return */
+			if (atmosParts.type[i] == AP_RAIN)
 			{
-				/* Kill it and return */
-				psPart->status = APS_INACTIVE;
-				if (psPart->type == AP_RAIN)
+				MAPTILE *psTile = mapTile(map_coord(static_cast<int32_t>(x)), map_coord(static_cast<int32_t>(z)));
+				if (terrainType(psTile) == TER_WATER && TEST_TILE_VISIBLE(selectedPlayer, psTile))
 				{
-					x = map_coord(static_cast<int32_t>(psPart->position.x));
-					y = map_coord(static_cast<int32_t>(psPart->position.z));
-					psTile = mapTile(x, y);
-					if (terrainType(psTile) == TER_WATER && TEST_TILE_VISIBLE(selectedPlayer, psTile))
-					{
-						pos.x = static_cast<int>(psPart->position.x);
-						pos.z = static_cast<int>(psPart->position.z);
-						pos.y = groundHeight;
-						effectSetSize(60);
-						addEffect(&pos, EFFECT_EXPLOSION, EXPLOSION_TYPE_SPECIFIED, true, getImdFromIndex(MI_SPLASH), 0);
-					}
+					Vector3i pos(static_cast<int>(x), groundHeight, static_cast<int>(z));
+					effectSetSize(60);
+					addEffect(&pos, EFFECT_EXPLOSION, EXPLOSION_TYPE_SPECIFIED, true, getImdFromIndex(MI_SPLASH), 0);
 				}
-				return;
 			}
+			return false;
 		}
-		if (psPart->type == AP_SNOW)
+	}
+	if (atmosParts.type[i] == AP_SNOW)
+	{
+		if (rand() % 30 == 1)
 		{
-			if (rand() % 30 == 1)
-			{
-				psPart->velocity.z = (float)SNOW_SPEED_DRIFT;
-			}
-			if (rand() % 30 == 1)
-			{
-				psPart->velocity.x = (float)SNOW_SPEED_DRIFT;
-			}
+			atmosParts.vz[i] = (float)SNOW_SPEED_DRIFT;
+		}
+		if (rand() % 30 == 1)
+		{
+			atmosParts.vx[i] = (float)SNOW_SPEED_DRIFT;
 		}
 	}
+	return true;
 }
 
-/* Adds a particle to the system if it can */
-static void atmosAddParticle(const Vector3f &pos, AP_TYPE type)
+/* Moves the particles, and drops the dead ones from the active set */
+static void processParticles()
 {
-	UDWORD	activeCount;
-	UDWORD	i;
+	const size_t count = atmosParts.size();
 
-	for (i = freeParticle, activeCount = 0; asAtmosParts[i].status == APS_ACTIVE && activeCount < MAX_ATMOS_PARTICLES; i++)
+	atmosMoveParticles(count);
+	atmosWrapParticles(count);
+
+	size_t kept = 0;
+	for (size_t i = 0; i < count; ++i)
 	{
-		activeCount++;
-		/* Check for wrap around */
-		if (i >= (MAX_ATMOS_PARTICLES - 1))
+		if (atmosParticleAlive(i))
 		{
-			/* Go back to the first one */
-			i = 0;
+			if (kept != i)
+			{
+				atmosParts.move(kept, i);
+			}
+			++kept;
 		}
 	}
+	atmosParts.resize(kept);
+}
 
-	/* Check the list isn't just full of essential effects */
-	if (activeCount >= MAX_ATMOS_PARTICLES - 1)
+/* Adds a particle to the system if it can */
+static void atmosAddParticle(const Vector3f &pos, AP_TYPE type)
+{
+	if (atmosParts.size() >= MAX_ATMOS_PARTICLES)
 	{
 		/* All of the particles active!?!? */
 		return;
 	}
-	else
-	{
-		freeParticle = i;
-	}
-
-	/* Record it's type */
-	asAtmosParts[freeParticle].type = (UBYTE)type;
-
-	/* Make it active */
-	asAtmosParts[freeParticle].status = APS_ACTIVE;
-
-	/* Setup the imd */
-	switch (type)
-	{
-	case AP_SNOW:
-		asAtmosParts[freeParticle].imd = getImdFromIndex(MI_SNOW);
-		asAtmosParts[freeParticle].size = 80;
-		break;
-	case AP_RAIN:
-		asAtmosParts[freeParticle].imd = getImdFromIndex(MI_RAIN);
-		asAtmosParts[freeParticle].size = 50;
-		break;
-	default:
-		break;
-	}
-
-	/* Setup position */
-	asAtmosParts[freeParticle].position = pos;
 
 	/* Setup its velocity */
 	if (type == AP_RAIN)
 	{
-		asAtmosParts[freeParticle].velocity = Vector3f(RAIN_SPEED_DRIFT, RAIN_SPEED_FALL, RAIN_SPEED_DRIFT);
+		atmosParts.add(pos, Vector3f(RAIN_SPEED_DRIFT, RAIN_SPEED_FALL, RAIN_SPEED_DRIFT), type);
 	}
 	else
 	{
-		asAtmosParts[freeParticle].velocity = Vector3f(SNOW_SPEED_DRIFT, SNOW_SPEED_FALL, SNOW_SPEED_DRIFT);
+		atmosParts.add(pos, Vector3f(SNOW_SPEED_DRIFT, SNOW_SPEED_FALL, SNOW_SPEED_DRIFT), type);
 	}
 }
 
@@ -254,14 +255,7 @@ void atmosUpdateSystem()
 	// we don't want to do any of this while paused.
 	if (!gamePaused() && weather != WT_NONE)
 	{
-		for (i = 0; i < MAX_ATMOS_PARTICLES; i++)
-		{
-			/* See if it's active */
-			if (asAtmosParts[i].status == APS_ACTIVE)
-			{
-				processParticle(&asAtmosParts[i]);
-			}
-		}
+		processParticles();
 
 		// The original code added a fixed number of particles per tick. To take into account game speed
 		// we have to accumulate a fractional number of particles to add them at a slower or faster rate.
@@ -307,27 +301,37 @@ void atmosUpdateSystem()
 	}
 }
 
-void atmosDrawParticles(const glm::mat4 &viewMatrix)
+/* Camera facing, scaled model matrix shared by all particles of a type */
+static glm::mat4 atmosParticleBillboard(UDWORD size)
 {
-	UDWORD	i;
+	return glm::rotate(UNDEG(-playerPos.r.y), glm::vec3(0.f, 1.f, 0.f)) *
+		glm::rotate(UNDEG(-playerPos.r.x), glm::vec3(0.f, 1.f, 0.f)) *
+		glm::scale(glm::vec3(size / 100.f));
+}
 
+void atmosDrawParticles(const glm::mat4 &viewMatrix)
+{
 	if (weather == WT_NONE)
 	{
 		return;
 	}
 
-	/* Traverse the list */
-	for (i = 0; i < MAX_ATMOS_PARTICLES; i++)
+	/* Everything but the translation is the same for all particles of a type, so work that out once */
+	iIMDShape *imds[2] = {getImdFromIndex(MI_RAIN), getImdFromIndex(MI_SNOW)};
+	const glm::mat4 billboards[2] = {atmosParticleBillboard(50), atmosParticleBillboard(80)};
+
+	const size_t count = atmosParts.size();
+	for (size_t i = 0; i < count; ++i)
 	{
-		/* Don't bother unless it's active */
-		if (asAtmosParts[i].status == APS_ACTIVE)
+		/* Is it visible on the screen? */
+		if (!clipXYZ(static_cast<int>(atmosParts.x[i]), static_cast<int>(atmosParts.z[i]), static_cast<int>(atmosParts.y[i]), viewMatrix))
 		{
-			/* Is it visible on the screen? */
-			if (clipXYZ(static_cast<int>(asAtmosParts[i].position.x), static_cast<int>(asAtmosParts[i].position.z), static_cast<int>(asAtmosParts[i].position.y), viewMatrix))
-			{
-				renderParticle(&asAtmosParts[i], viewMatrix);
-			}
+			continue;
 		}
+		const glm::vec3 dv(atmosParts.x[i] - playerPos.p.x, atmosParts.y[i], -(atmosParts.z[i] - playerPos.p.z));
+		const UBYTE type = atmosParts.type[i];
+		// Only queued here; as opaque shapes they are drawn in one instanced call per particle type by pie_RemainingPasses()
+		pie_Draw3DShape(imds[type], 0, 0, WZCOL_WHITE, 0, 0, viewMatrix * glm::translate(dv) * billboards[type]);
 	}
 }
 
@@ -356,10 +360,12 @@ void atmosSetWeatherType(WT_CLASS type)
 		weather = type;
 		atmosInitSystem();
 	}
-	if (type == WT_NONE && asAtmosParts)
+	if (type == WT_NONE)
 	{
-		free(asAtmosParts);
-		asAtmosParts = nullptr;
+		atmosParts.clear();
+		atmosParts.x.shrink_to_fit(); atmosParts.y.shrink_to_fit(); atmosParts.z.shrink_to_fit();
+		atmosParts.vx.shrink_to_fit(); atmosParts.vy.shrink_to_fit(); atmosParts.vz.shrink_to_fit();
+		atmosParts.type.shrink_to_fit();
 	}
 }
 
@@ -103,6 +103,7 @@ enum OBJECT_FLAG
 	OBJECT_FLAG_TARGETED,
 	OBJECT_FLAG_DIRTY,
 	OBJECT_FLAG_UNSELECTABLE,
+	OBJECT_FLAG_VISIBILITY_PENDING,  ///< In the visTilesUpdateLater() queue.
 	OBJECT_FLAG_COUNT
 };
 
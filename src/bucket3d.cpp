@@ -59,17 +59,35 @@ struct BUCKET_TAG
 
 static std::vector<BUCKET_TAG> bucketArray;
 
-static SDWORD bucketCalculateZ(RENDER_TYPE objectType, void *pObject, const glm::mat4 &viewMatrix)
+/// Sort key telling bucketCullCandidates() to use the projected depth
+static const int32_t BUCKET_CALCULATED_Z = INT32_MIN;
+
+/// Objects added this frame, kept in contiguous arrays so that they can be culled together
+struct BUCKET_CANDIDATES
+{
+	std::vector<float>      x, y, z;    ///< camera relative position
+	std::vector<int32_t>    radius;     ///< world radius, or -1 to skip the screen test
+	std::vector<int32_t>    zBias;      ///< subtracted from the projected depth
+	std::vector<BUCKET_TAG> tags;       ///< actualZ holds the sort key
+};
+
+static BUCKET_CANDIDATES candidates;
+static std::vector<int32_t> candidateDepth;
+static std::vector<Vector2i> candidatePixel;
+
+/** Find what culling needs to know about an object.
+ *  \param[out] position camera relative position to project
+ *  \param[out] radius   world radius, or -1 to skip the screen test
+ *  \param[out] zBias    subtracted from the projected depth
+ *  \return false if the object isn't drawn at all
+ */
+static bool bucketGetBounds(RENDER_TYPE objectType, void *pObject, Vector3i &position, int32_t &radius, int32_t &zBias)
 {
-	SDWORD				z = 0, radius;
-	Vector2i				pixel(0, 0);
-	Vector3i				position(0, 0, 0);
-	UDWORD				droidSize;
-	DROID				*psDroid;
-	BODY_STATS			*psBStats;
 	SIMPLE_OBJECT		*psSimpObj;
 	const iIMDShape		*pImd;
-	Spacetime               spacetime;
+
+	radius = -1;
+	zBias = 0;
 
 	switch (objectType)
 	{
@@ -82,136 +100,63 @@ static SDWORD bucketCalculateZ(RENDER_TYPE objectType, void *pObject, const glm:
 		position.z = -(position.z - playerPos.p.z);
 
 		/* 16 below is HACK!!! */
-		z = pie_RotateProject(&position, viewMatrix, &pixel) - 16;
-		if (z > 0)
-		{
-			//particle use the image radius
-			radius = ((ATPART *)pObject)->imd->radius;
-			radius *= SCALE_DEPTH;
-			radius /= z;
-			if ((pixel.x + radius < CLIP_LEFT) || (pixel.x - radius > CLIP_RIGHT)
-			    || (pixel.y + radius < CLIP_TOP) || (pixel.y - radius > CLIP_BOTTOM))
-			{
-				z = -1;
-			}
-		}
-		break;
+		zBias = 16;
+		//particle use the image radius
+		radius = ((ATPART *)pObject)->imd->radius;
+		return true;
 	case RENDER_PROJECTILE:
 		if (((PROJECTILE *)pObject)->psWStats->weaponSubClass == WSC_FLAME ||
 		    ((PROJECTILE *)pObject)->psWStats->weaponSubClass == WSC_COMMAND ||
 		    ((PROJECTILE *)pObject)->psWStats->weaponSubClass == WSC_EMP)
 		{
 			/* We don't do projectiles from these guys, cos there's an effect instead */
-			z = -1;
+			return false;
 		}
-		else
-		{
-
-			//the weapon stats holds the reference to which graphic to use
-			pImd = ((PROJECTILE *)pObject)->psWStats->pInFlightGraphic;
 
-			psSimpObj = (SIMPLE_OBJECT *) pObject;
-			position.x = psSimpObj->pos.x - playerPos.p.x;
-			position.z = -(psSimpObj->pos.y - playerPos.p.z);
-
-			position.y = psSimpObj->pos.z;
+		//the weapon stats holds the reference to which graphic to use
+		pImd = ((PROJECTILE *)pObject)->psWStats->pInFlightGraphic;
 
-			z = pie_RotateProject(&position, viewMatrix, &pixel);
+		psSimpObj = (SIMPLE_OBJECT *) pObject;
+		position.x = psSimpObj->pos.x - playerPos.p.x;
+		position.z = -(psSimpObj->pos.y - playerPos.p.z);
+		position.y = psSimpObj->pos.z;
 
-			if (z > 0)
-			{
-				//particle use the image radius
-				radius = pImd->radius;
-				radius *= SCALE_DEPTH;
-				radius /= z;
-				if ((pixel.x + radius < CLIP_LEFT) || (pixel.x - radius > CLIP_RIGHT)
-				    || (pixel.y + radius < CLIP_TOP) || (pixel.y - radius > CLIP_BOTTOM))
-				{
-					z = -1;
-				}
-			}
-		}
-		break;
+		radius = pImd->radius;
+		return true;
 	case RENDER_STRUCTURE://not depth sorted
 		psSimpObj = (SIMPLE_OBJECT *) pObject;
 		position.x = psSimpObj->pos.x - playerPos.p.x;
 		position.z = -(psSimpObj->pos.y - playerPos.p.z);
 
-		if ((objectType == RENDER_STRUCTURE) &&
-		    ((((STRUCTURE *)pObject)->pStructureType->type == REF_DEFENSE) ||
-		     (((STRUCTURE *)pObject)->pStructureType->type == REF_WALL) ||
-		     (((STRUCTURE *)pObject)->pStructureType->type == REF_WALLCORNER)))
+		if ((((STRUCTURE *)pObject)->pStructureType->type == REF_DEFENSE) ||
+		    (((STRUCTURE *)pObject)->pStructureType->type == REF_WALL) ||
+		    (((STRUCTURE *)pObject)->pStructureType->type == REF_WALLCORNER))
 		{
-			position.y = psSimpObj->pos.z + 64;
-			radius = ((STRUCTURE *)pObject)->sDisplay.imd->radius; //walls guntowers and tank traps clip tightly
+			position.y = psSimpObj->pos.z + 64; //walls guntowers and tank traps clip tightly
 		}
 		else
 		{
 			position.y = psSimpObj->pos.z;
-			radius = (((STRUCTURE *)pObject)->sDisplay.imd->radius);
-		}
-
-		z = pie_RotateProject(&position, viewMatrix, &pixel);
-
-		if (z > 0)
-		{
-			//particle use the image radius
-			radius *= SCALE_DEPTH;
-			radius /= z;
-			if ((pixel.x + radius < CLIP_LEFT) || (pixel.x - radius > CLIP_RIGHT)
-			    || (pixel.y + radius < CLIP_TOP) || (pixel.y - radius > CLIP_BOTTOM))
-			{
-				z = -1;
-			}
 		}
-		break;
+		radius = ((STRUCTURE *)pObject)->sDisplay.imd->radius;
+		return true;
 	case RENDER_FEATURE://not depth sorted
 		psSimpObj = (SIMPLE_OBJECT *) pObject;
 		position.x = psSimpObj->pos.x - playerPos.p.x;
 		position.z = -(psSimpObj->pos.y - playerPos.p.z);
-
 		position.y = psSimpObj->pos.z + 2;
 
-		z = pie_RotateProject(&position, viewMatrix, &pixel);
-
-		if (z > 0)
-		{
-			//particle use the image radius
-			radius = ((FEATURE *)pObject)->sDisplay.imd->radius;
-			radius *= SCALE_DEPTH;
-			radius /= z;
-			if ((pixel.x + radius < CLIP_LEFT) || (pixel.x - radius > CLIP_RIGHT)
-			    || (pixel.y + radius < CLIP_TOP) || (pixel.y - radius > CLIP_BOTTOM))
-			{
-				z = -1;
-			}
-		}
-		break;
+		radius = ((FEATURE *)pObject)->sDisplay.imd->radius;
+		return true;
 	case RENDER_DROID:
-		psDroid = (DROID *) pObject;
-
 		psSimpObj = (SIMPLE_OBJECT *) pObject;
 		position.x = psSimpObj->pos.x - playerPos.p.x;
 		position.z = -(psSimpObj->pos.y - playerPos.p.z);
 		position.y = psSimpObj->pos.z;
 
-		psBStats = asBodyStats + psDroid->asBits[COMP_BODY];
-		droidSize = psBStats->pIMD->radius;
-		z = pie_RotateProject(&position, viewMatrix, &pixel) - (droidSize * 2);
-
-		if (z > 0)
-		{
-			//particle use the image radius
-			radius = droidSize;
-			radius *= SCALE_DEPTH;
-			radius /= z;
-			if ((pixel.x + radius < CLIP_LEFT) || (pixel.x - radius > CLIP_RIGHT)
-			    || (pixel.y + radius < CLIP_TOP) || (pixel.y - radius > CLIP_BOTTOM))
-			{
-				z = -1;
-			}
-		}
-		break;
+		radius = (asBodyStats + ((DROID *)pObject)->asBits[COMP_BODY])->pIMD->radius;
+		zBias = radius * 2;
+		return true;
 	case RENDER_PROXMSG:
 		if (((PROXIMITY_DISPLAY *)pObject)->type == POS_PROXDATA)
 		{
@@ -234,97 +179,39 @@ static SDWORD bucketCalculateZ(RENDER_TYPE objectType, void *pObject, const glm:
 			position.z = -(ptr->psMessage->psObj->pos.y - playerPos.p.z);
 			position.y = ptr->psMessage->psObj->pos.z;
 		}
-		z = pie_RotateProject(&position, viewMatrix, &pixel);
 
-		if (z > 0)
-		{
-			//particle use the image radius
-			pImd = getImdFromIndex(MI_BLIP_ENEMY);//use MI_BLIP_ENEMY as all are same radius
-			radius = pImd->radius;
-			radius *= SCALE_DEPTH;
-			radius /= z;
-			if ((pixel.x + radius < CLIP_LEFT) || (pixel.x - radius > CLIP_RIGHT)
-			    || (pixel.y + radius < CLIP_TOP) || (pixel.y - radius > CLIP_BOTTOM))
-			{
-				z = -1;
-			}
-		}
-		break;
+		radius = getImdFromIndex(MI_BLIP_ENEMY)->radius; //use MI_BLIP_ENEMY as all are same radius
+		return true;
 	case RENDER_EFFECT:
 		position.x = static_cast<int>(((EFFECT *)pObject)->position.x - playerPos.p.x);
 		position.z = static_cast<int>(-(((EFFECT *)pObject)->position.z - playerPos.p.z));
 		position.y = static_cast<int>(((EFFECT *)pObject)->position.y);
 
 		/* 16 below is HACK!!! */
-		z = pie_RotateProject(&position, viewMatrix, &pixel) - 16;
-
-		if (z > 0)
+		zBias = 16;
+		pImd = ((EFFECT *)pObject)->imd;
+		if (pImd != nullptr)
 		{
-			//particle use the image radius
-			pImd = ((EFFECT *)pObject)->imd;
-			if (pImd != nullptr)
-			{
-				radius = pImd->radius;
-				radius *= SCALE_DEPTH;
-				radius /= z;
-				if ((pixel.x + radius < CLIP_LEFT) || (pixel.x - radius > CLIP_RIGHT)
-				    || (pixel.y + radius < CLIP_TOP) || (pixel.y - radius > CLIP_BOTTOM))
-				{
-					z = -1;
-				}
-			}
+			radius = pImd->radius;
 		}
-
-		break;
-
+		return true;
 	case RENDER_DELIVPOINT:
 		position.x = ((FLAG_POSITION *)pObject)->coords.x - playerPos.p.x;
 		position.z = -(((FLAG_POSITION *)pObject)->
 		               coords.y - playerPos.p.z);
 		position.y = ((FLAG_POSITION *)pObject)->coords.z;
 
-		z = pie_RotateProject(&position, viewMatrix, &pixel);
-
-		if (z > 0)
-		{
-			//particle use the image radius
-			radius = pAssemblyPointIMDs[((FLAG_POSITION *)pObject)->factoryType][((FLAG_POSITION *)pObject)->factoryInc]->radius;
-			radius *= SCALE_DEPTH;
-			radius /= z;
-			if ((pixel.x + radius < CLIP_LEFT) || (pixel.x - radius > CLIP_RIGHT)
-			    || (pixel.y + radius < CLIP_TOP) || (pixel.y - radius > CLIP_BOTTOM))
-			{
-				z = -1;
-			}
-		}
-
-		break;
-
-	default:
-		break;
+		radius = pAssemblyPointIMDs[((FLAG_POSITION *)pObject)->factoryType][((FLAG_POSITION *)pObject)->factoryInc]->radius;
+		return true;
 	}
 
-	return z;
+	return false;
 }
 
-/* add an object to the current render list */
-void bucketAddTypeToList(RENDER_TYPE objectType, void *pObject, const glm::mat4 &viewMatrix)
+/// Sort key of an object, or BUCKET_CALCULATED_Z to sort it by depth
+static int32_t bucketGetSortKey(RENDER_TYPE objectType, void *pObject)
 {
 	const iIMDShape *pie;
-	BUCKET_TAG	newTag;
-	int32_t		z = bucketCalculateZ(objectType, pObject, viewMatrix);
-
-	if (z < 0)
-	{
-		/* Object will not be render - has been clipped! */
-		if (objectType == RENDER_DROID || objectType == RENDER_STRUCTURE)
-		{
-			/* Won't draw selection boxes */
-			((BASE_OBJECT *)pObject)->sDisplay.frameNumber = 0;
-		}
-
-		return;
-	}
 
 	switch (objectType)
 	{
@@ -336,55 +223,114 @@ void bucketAddTypeToList(RENDER_TYPE objectType, void *pObject, const glm::mat4
 		case EFFECT_SMOKE:
 		case EFFECT_FIREWORK:
 			// Use calculated Z
-			break;
+			return BUCKET_CALCULATED_Z;
 
 		case EFFECT_WAYPOINT:
 			pie = ((EFFECT *)pObject)->imd;
-			z = INT32_MAX - pie->texpage;
-			break;
+			return INT32_MAX - pie->texpage;
 
 		default:
-			z = INT32_MAX - 42;
-			break;
+			return INT32_MAX - 42;
 		}
-		break;
 	case RENDER_DROID:
 		pie = BODY_IMD(((DROID *)pObject), 0);
-		z = INT32_MAX - pie->texpage;
-		break;
+		return INT32_MAX - pie->texpage;
 	case RENDER_STRUCTURE:
 		pie = ((STRUCTURE *)pObject)->sDisplay.imd;
-		z = INT32_MAX - pie->texpage;
-		break;
+		return INT32_MAX - pie->texpage;
 	case RENDER_FEATURE:
 		pie = ((FEATURE *)pObject)->sDisplay.imd;
-		z = INT32_MAX - pie->texpage;
-		break;
+		return INT32_MAX - pie->texpage;
 	case RENDER_DELIVPOINT:
 		pie = pAssemblyPointIMDs[((FLAG_POSITION *)pObject)->
 		                         factoryType][((FLAG_POSITION *)pObject)->factoryInc];
-		z = INT32_MAX - pie->texpage;
-		break;
+		return INT32_MAX - pie->texpage;
 	case RENDER_PARTICLE:
-		z = 0;
-		break;
+		return 0;
 	default:
 		// Use calculated Z
-		break;
+		return BUCKET_CALCULATED_Z;
 	}
+}
 
-	//put the object data into the tag
+/* add an object to the current render list */
+void bucketAddTypeToList(RENDER_TYPE objectType, void *pObject)
+{
+	Vector3i position(0, 0, 0);
+	int32_t radius, zBias;
+
+	if (!bucketGetBounds(objectType, pObject, position, radius, zBias))
+	{
+		return;
+	}
+
+	candidates.x.push_back(static_cast<float>(position.x));
+	candidates.y.push_back(static_cast<float>(position.y));
+	candidates.z.push_back(static_cast<float>(position.z));
+	candidates.radius.push_back(radius);
+	candidates.zBias.push_back(zBias);
+
+	BUCKET_TAG newTag;
 	newTag.objectType = objectType;
 	newTag.pObject = pObject;
-	newTag.actualZ = z;
+	newTag.actualZ = bucketGetSortKey(objectType, pObject);
+	candidates.tags.push_back(newTag);
+}
+
+/// Project all candidates at once, and move those on screen into bucketArray.
+static void bucketCullCandidates(const glm::mat4 &viewMatrix)
+{
+	const size_t count = candidates.tags.size();
+
+	candidateDepth.resize(count);
+	candidatePixel.resize(count);
+	pie_RotateProjectBatch(count, candidates.x.data(), candidates.y.data(), candidates.z.data(), viewMatrix, candidateDepth.data(), candidatePixel.data());
+
+	bucketArray.reserve(bucketArray.size() + count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		int32_t z = candidateDepth[i] - candidates.zBias[i];
+		if (z > 0 && candidates.radius[i] >= 0)
+		{
+			const Vector2i &pixel = candidatePixel[i];
+			const int32_t radius = candidates.radius[i] * SCALE_DEPTH / z;
+			if ((pixel.x + radius < CLIP_LEFT) || (pixel.x - radius > CLIP_RIGHT)
+			    || (pixel.y + radius < CLIP_TOP) || (pixel.y - radius > CLIP_BOTTOM))
+			{
+				z = -1;
+			}
+		}
+
+		BUCKET_TAG tag = candidates.tags[i];
+		if (z < 0)
+		{
+			/* Object will not be render - has been clipped! */
+			if (tag.objectType == RENDER_DROID || tag.objectType == RENDER_STRUCTURE)
+			{
+				/* Won't draw selection boxes */
+				((BASE_OBJECT *)tag.pObject)->sDisplay.frameNumber = 0;
+			}
+			continue;
+		}
+		if (tag.actualZ == BUCKET_CALCULATED_Z)
+		{
+			tag.actualZ = z;
+		}
+		bucketArray.push_back(tag);
+	}
 
-	//add tag to bucketArray
-	bucketArray.push_back(newTag);
+	candidates.x.clear();
+	candidates.y.clear();
+	candidates.z.clear();
+	candidates.radius.clear();
+	candidates.zBias.clear();
+	candidates.tags.clear();
 }
 
 /* render Objects in list */
 void bucketRenderCurrentList(const glm::mat4 &viewMatrix)
 {
+	bucketCullCandidates(viewMatrix);
 	std::sort(bucketArray.begin(), bucketArray.end());
 
 	for (std::vector<BUCKET_TAG>::const_iterator thisTag = bucketArray.begin(); thisTag != bucketArray.end(); ++thisTag)
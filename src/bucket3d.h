@@ -35,10 +35,10 @@ enum RENDER_TYPE
 
 //function prototypes
 
-/* add an object to the current render list */
-void bucketAddTypeToList(RENDER_TYPE objectType, void *object, const glm::mat4 &viewMatrix);
+/* add an object to the current render list, it is culled along with the rest when rendering the list */
+void bucketAddTypeToList(RENDER_TYPE objectType, void *object);
 
-/* render Objects in list */
+/* cull, depth sort and render Objects in list; viewMatrix is the one the objects are seen with */
 void bucketRenderCurrentList(const glm::mat4 &viewMatrix);
 
 #endif // __INCLUDED_SRC_BUCKET3D_H__
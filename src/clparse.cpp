@@ -82,6 +82,8 @@ static std::string wz_saveandquit;
 static std::string wz_test;
 static std::string wz_autoratingUrl;
 static bool wz_cli_headless = false;
+static bool wz_cli_fastforward = false;
+static unsigned wz_cli_maxtickrate = 0;
 
 #if defined(WZ_OS_WIN)
 
@@ -327,6 +329,8 @@ typedef enum
 	CLI_AUTOHOST,
 	CLI_AUTORATING,
 	CLI_AUTOHEADLESS,
+	CLI_FASTFORWARD,
+	CLI_MAXTICKRATE,
 #if defined(WZ_OS_WIN)
 	CLI_WIN_ENABLE_CONSOLE,
 #endif
@@ -381,6 +385,8 @@ static const struct poptOption *getOptionsTable()
 		},
 		{ "autogame", POPT_ARG_NONE, CLI_AUTOGAME,   N_("Run games automatically for testing"), nullptr },
 		{ "headless", POPT_ARG_NONE, CLI_AUTOHEADLESS,   N_("Headless mode (only supported when also specifying --autogame, --autohost, --skirmish)"), nullptr },
+		{ "fastforward", POPT_ARG_NONE, CLI_FASTFORWARD,   N_("Run the game as fast as possible without rendering (only supported with --headless)"), nullptr },
+		{ "maxtickrate", POPT_ARG_STRING, CLI_MAXTICKRATE,   N_("Limit --fastforward to this many game ticks per second"), N_("ticks") },
 		{ "saveandquit", POPT_ARG_STRING, CLI_SAVEANDQUIT, N_("Immediately save game and quit"), N_("save name") },
 		{ "skirmish", POPT_ARG_STRING, CLI_SKIRMISH,   N_("Start skirmish game with given settings file"), N_("test") },
 		{ "continue", POPT_ARG_NONE, CLI_CONTINUE,   N_("Continue the last saved game"), nullptr },
@@ -843,6 +849,21 @@ bool ParseCommandLine(int argc, const char * const *argv)
 			setHeadlessGameMode(true);
 			break;
 
+		case CLI_FASTFORWARD:
+			wz_cli_fastforward = true;
+			setHeadlessFastForward(true, wz_cli_maxtickrate);
+			break;
+
+		case CLI_MAXTICKRATE:
+			token = poptGetOptArg(poptCon);
+			if (token == nullptr || atoi(token) <= 0)
+			{
+				qFatal("Bad tick rate");
+			}
+			wz_cli_maxtickrate = atoi(token);
+			setHeadlessFastForward(wz_cli_fastforward, wz_cli_maxtickrate);
+			break;
+
 		case CLI_GAMEPORT:
 			token = poptGetOptArg(poptCon);
 			if (token == nullptr)
@@ -48,6 +48,7 @@
 #include "nethelpers.h"
 #include "lib/framework/wzapp.h"
 #include "display3d.h" // for building animation speed
+#include "effects.h"
 #include "display.h"
 #include "keybind.h" // for MAP_ZOOM_RATE_STEP
 #include "loadsave.h" // for autosaveEnabled
@@ -337,6 +338,7 @@ bool loadConfig()
 	setShakeStatus(iniGetBool("shake", false).value());
 	setCameraAccel(iniGetBool("cameraAccel", true).value());
 	setDrawShadows(iniGetBool("shadows", true).value());
+	effectSetBudget(iniGetInteger("effectsBudget", EFFECT_BUDGET_DEFAULT).value());
 	war_setSoundEnabled(iniGetBool("sound", true).value());
 	setInvertMouseStatus(iniGetBool("mouseflip", true).value());
 	setRightClickOrders(iniGetBool("RightClickOrders", false).value());
@@ -555,6 +557,7 @@ bool saveConfig()
 	iniSetInteger("showFPS", (int)showFPS);
 	iniSetInteger("showUNITCOUNT", (int)showUNITCOUNT);
 	iniSetInteger("shadows", (int)(getDrawShadows()));	// shadows
+	iniSetInteger("effectsBudget", (int)effectGetBudget());
 	iniSetInteger("sound", (int)war_getSoundEnabled());
 	iniSetInteger("FMVmode", (int)(war_GetFMVmode()));		// sequences
 	iniSetInteger("scanlines", (int)war_getScanlineMode());
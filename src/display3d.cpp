@@ -878,7 +878,7 @@ void draw3DScene()
 	}
 	if (showFPS)
 	{
-		std::string fps = astringf("FPS: %d", frameRate());
+		std::string fps = astringf("FPS: %d, jobs: %d%%", frameRate(), frameJobLoad());
 		txtShowFPS.setText(fps, font_regular);
 		const unsigned width = txtShowFPS.width() + 10;
 		const unsigned height = 9; //txtShowFPS.height();
@@ -1522,7 +1522,7 @@ static void display3DProjectiles(const glm::mat4 &viewMatrix)
 			    psObj->psWStats->weaponSubClass == WSC_ENERGY ||
 			    psObj->psWStats->weaponSubClass == WSC_EMP)
 			{
-				bucketAddTypeToList(RENDER_PROJECTILE, psObj, viewMatrix);
+				bucketAddTypeToList(RENDER_PROJECTILE, psObj);
 			}
 			else
 			{
@@ -666,7 +666,7 @@ void droidUpdate(DROID *psDroid)
 
 	if (psDroid->flags.test(OBJECT_FLAG_DIRTY))
 	{
-		visTilesUpdate(psDroid);
+		visTilesUpdateLater(psDroid);
 		droidBodyUpgrade(psDroid);
 		psDroid->flags.set(OBJECT_FLAG_DIRTY, false);
 	}
@@ -99,6 +99,9 @@ void	adjustTileHeight(MAPTILE *psTile, SDWORD adjust)
 	if (newHeight >= TILE_MIN_HEIGHT && newHeight <= TILE_MAX_HEIGHT)
 	{
 		psTile->height = newHeight;
+		++mapChangeCount;
+		const int tileIndex = psTile - psMapTiles;
+		mapHeightChanged(tileIndex % mapWidth, tileIndex / mapWidth);
 	}
 }
 
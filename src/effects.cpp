@@ -66,10 +66,13 @@
 #include "lighting.h"
 #include "console.h"
 #include "loop.h"
+#include "wrappers.h"
 
 #include "multiplay.h"
 #include "component.h"
 
+#include <deque>
+
 #ifndef GLM_ENABLE_EXPERIMENTAL
 	#define GLM_ENABLE_EXPERIMENTAL
 #endif
@@ -155,7 +158,29 @@
 #define SHOCKWAVE_SPEED	(GAME_TICKS_PER_SEC)
 #define	MAX_SHOCKWAVE_SIZE				500
 
-static std::list<EFFECT *> activeList;
+/** Slot-stable storage for all effects of one group. Effects are never moved once allocated, so
+ *  pointers handed to the render buckets stay valid for the frame; dead slots are recycled via freeSlots. */
+struct EffectPool
+{
+	std::deque<EFFECT> slots;        ///< Storage, only ever grows so that EFFECT pointers stay valid.
+	std::vector<uint32_t> serials;   ///< Allocation serial of each slot, 0 if the slot is free.
+	std::vector<uint32_t> freeSlots; ///< Slots that can be reused by the next effect of this group.
+	std::vector<uint32_t> live;      ///< Slots in use, in spawn order.
+};
+
+/** Reference to a low priority effect, queued in spawn order so the oldest one can be culled first. */
+struct EffectCullEntry
+{
+	uint32_t     serial;
+	EFFECT_GROUP group;
+	uint32_t     slot;
+};
+
+static EffectPool effectPools[EFFECT_FREED];
+static std::deque<EffectCullEntry> cullQueue;
+static uint32_t effectSerial = 0;
+static unsigned numActiveEffects = 0;
+static unsigned effectBudget = EFFECT_BUDGET_DEFAULT;
 
 /* Tick counts for updates on a particular interval */
 static	UDWORD	lastUpdateStructures[EFFECT_STRUCTURE_DIVISION];
@@ -180,7 +205,21 @@ static bool updateDestruction(EFFECT *psEffect);
 static bool updateFire(EFFECT *psEffect);
 static bool updateSatLaser(EFFECT *psEffect);
 static bool updateFirework(EFFECT *psEffect);
-static bool updateEffect(EFFECT *psEffect);	// MASTER function
+
+/* Update function for each group, indexed by EFFECT_GROUP */
+static bool (*const effectUpdateFunctions[EFFECT_FREED])(EFFECT *) =
+{
+	updateExplosion,	// EFFECT_EXPLOSION
+	updateConstruction,	// EFFECT_CONSTRUCTION
+	updatePolySmoke,	// EFFECT_SMOKE
+	updateGraviton,		// EFFECT_GRAVITON
+	updateWaypoint,		// EFFECT_WAYPOINT
+	updateBlood,		// EFFECT_BLOOD
+	updateDestruction,	// EFFECT_DESTRUCTION
+	updateSatLaser,		// EFFECT_SAT_LASER
+	updateFire,			// EFFECT_FIRE
+	updateFirework,		// EFFECT_FIREWORK
+};
 
 // ----------------------------------------------------------------------------------------
 // ---- The render functions - every group type of effect has a distinct one
@@ -215,11 +254,102 @@ static UDWORD effectGetNumFrames(EFFECT *psEffect);
 
 void shutdownEffectsSystem()
 {
-	for (auto eff : activeList)
+	for (EffectPool &pool : effectPools)
 	{
-		delete eff;
+		pool.slots.clear();
+		pool.serials.clear();
+		pool.freeSlots.clear();
+		pool.live.clear();
 	}
-	activeList.clear();
+	cullQueue.clear();
+	numActiveEffects = 0;
+}
+
+/** Takes a slot from the pool of the given group, and returns the (reset) effect in it */
+static EFFECT *effectAlloc(EFFECT_GROUP group, uint32_t *slotOut)
+{
+	EffectPool &pool = effectPools[group];
+	uint32_t slot;
+	if (!pool.freeSlots.empty())
+	{
+		slot = pool.freeSlots.back();
+		pool.freeSlots.pop_back();
+		pool.slots[slot] = EFFECT();
+	}
+	else
+	{
+		slot = static_cast<uint32_t>(pool.slots.size());
+		pool.slots.emplace_back();
+		pool.serials.push_back(0);
+	}
+	pool.serials[slot] = ++effectSerial;
+	pool.live.push_back(slot);
+	++numActiveEffects;
+
+	EFFECT *psEffect = &pool.slots[slot];
+	psEffect->group = group;
+	if (slotOut)
+	{
+		*slotOut = slot;
+	}
+	return psEffect;
+}
+
+/** Marks the effect in the slot as dead. The slot is recycled once processEffects drops it from the live list. */
+static void effectRelease(EffectPool &pool, uint32_t slot)
+{
+	pool.slots[slot].group = EFFECT_FREED;
+	pool.serials[slot] = 0;
+	--numActiveEffects;
+}
+
+/** Effects which may be culled when over budget - purely cosmetic ones that don't drive other effects */
+static bool effectIsLowPriority(const EFFECT *psEffect)
+{
+	if (TEST_ESSENTIAL(psEffect))
+	{
+		return false;
+	}
+	switch (psEffect->group)
+	{
+	case EFFECT_WAYPOINT:
+	case EFFECT_DESTRUCTION:
+	case EFFECT_SAT_LASER:
+	case EFFECT_FIRE:
+		return false;
+	default:
+		return true;
+	}
+}
+
+/** Culls the oldest low priority effects until we're within the effect budget */
+static void effectCullToBudget()
+{
+	while (!cullQueue.empty())
+	{
+		const EffectCullEntry &entry = cullQueue.front();
+		EffectPool &pool = effectPools[entry.group];
+		bool stale = pool.serials[entry.slot] != entry.serial;
+		if (!stale)
+		{
+			if (effectBudget == 0 || numActiveEffects <= effectBudget)
+			{
+				break;
+			}
+			effectRelease(pool, entry.slot);
+		}
+		cullQueue.pop_front();
+	}
+}
+
+void effectSetBudget(int budget)
+{
+	effectBudget = clip(budget, 0, EFFECT_BUDGET_MAX);
+}
+
+unsigned effectGetBudget()
+{
+	return effectBudget;
 }
 
 /*!
@@ -303,11 +433,12 @@ void addEffect(const Vector3i *pos, EFFECT_GROUP group, EFFECT_TYPE type, bool s
 
 void addEffect(const Vector3i *pos, EFFECT_GROUP group, EFFECT_TYPE type, bool specified, iIMDShape *imd, int lit, unsigned effectTime)
 {
-	if (gamePaused())
+	if (gamePaused() || headlessFastForward())
 	{
 		return;
 	}
-	EFFECT *psEffect = new EFFECT();
+	uint32_t slot;
+	EFFECT *psEffect = effectAlloc(group, &slot);
 	/* Reset control bits */
 	psEffect->control = 0;
 
@@ -316,8 +447,7 @@ void addEffect(const Vector3i *pos, EFFECT_GROUP group, EFFECT_TYPE type, bool s
 	psEffect->position.y = pos->y;
 	psEffect->position.z = pos->z;
 
-	/* Now, note group and type */
-	psEffect->group = group;
+	/* Now, note type - the group is set by the pool */
 	psEffect->type = type;
 
 	// and if the effect needs the player's color for certain things
@@ -400,106 +530,60 @@ void addEffect(const Vector3i *pos, EFFECT_GROUP group, EFFECT_TYPE type, bool s
 
 	ASSERT(psEffect->imd != nullptr || group == EFFECT_DESTRUCTION || group == EFFECT_FIRE || group == EFFECT_SAT_LASER, "null effect imd");
 
-	activeList.push_back(psEffect);
+	if (effectIsLowPriority(psEffect))
+	{
+		cullQueue.push_back({effectSerial, group, slot});
+	}
 }
 
 
-/* Calls all the update functions for each different currently active effect */
+/* Calls the update function of each group for all of its currently active effects */
 void processEffects(const glm::mat4 &viewMatrix)
 {
-	for (auto it = activeList.begin(); it != activeList.end(); )
+	/* Keep within budget before anything gets added to the render buckets */
+	effectCullToBudget();
+
+	const bool paused = gamePaused();
+	for (unsigned group = 0; group < EFFECT_FREED; ++group)
 	{
-		EFFECT *psEffect = *it;
+		EffectPool &pool = effectPools[group];
+		bool (*const updateFunc)(EFFECT *) = effectUpdateFunctions[group];
+		// Only explosions keep animating while paused
+		const bool update = !paused || group == EFFECT_EXPLOSION;
 
-		if (psEffect->birthTime <= graphicsTime)  // Don't process, if it doesn't exist yet
+		// Effects added while updating are appended to the live list, so it may grow during this loop
+		size_t kept = 0;
+		for (size_t i = 0; i < pool.live.size(); ++i)
 		{
-			if (!updateEffect(psEffect))
+			const uint32_t slot = pool.live[i];
+			EFFECT *psEffect = &pool.slots[slot];
+
+			if (psEffect->group != EFFECT_FREED && psEffect->birthTime <= graphicsTime)  // Don't process, if it doesn't exist yet
 			{
-				delete psEffect;
-				it = activeList.erase(it);
-				continue;
+				if (update && !updateFunc(psEffect))
+				{
+					effectRelease(pool, slot);
+				}
+				else if (clipXY(static_cast<SDWORD>(psEffect->position.x), static_cast<SDWORD>(psEffect->position.z)))
+				{
+					bucketAddTypeToList(RENDER_EFFECT, psEffect);
+				}
 			}
-			if (psEffect->group != EFFECT_FREED && clipXY(static_cast<SDWORD>(psEffect->position.x), static_cast<SDWORD>(psEffect->position.z)))
+
+			if (psEffect->group == EFFECT_FREED)
 			{
-				bucketAddTypeToList(RENDER_EFFECT, psEffect, viewMatrix);
+				pool.freeSlots.push_back(slot);
+				continue;
 			}
+			pool.live[kept++] = slot;
 		}
-		++it;
+		pool.live.resize(kept);
 	}
 
 	/* Add any structure effects */
 	effectStructureUpdates();
 }
 
-/* The general update function for all effects - calls a specific one for each. Returns false if effect should be deleted. */
-static bool updateEffect(EFFECT *psEffect)
-{
-	/* What type of effect are we dealing with? */
-	switch (psEffect->group)
-	{
-	case EFFECT_EXPLOSION:
-		return updateExplosion(psEffect);
-	case EFFECT_WAYPOINT:
-		if (!gamePaused())
-		{
-			return updateWaypoint(psEffect);
-		}
-		return true;
-	case EFFECT_CONSTRUCTION:
-		if (!gamePaused())
-		{
-			return updateConstruction(psEffect);
-		}
-		return true;
-	case EFFECT_SMOKE:
-		if (!gamePaused())
-		{
-			return updatePolySmoke(psEffect);
-		}
-		return true;
-	case EFFECT_GRAVITON:
-		if (!gamePaused())
-		{
-			return updateGraviton(psEffect);
-		}
-		return true;
-	case EFFECT_BLOOD:
-		if (!gamePaused())
-		{
-			return updateBlood(psEffect);
-		}
-		return true;
-	case EFFECT_DESTRUCTION:
-		if (!gamePaused())
-		{
-			return updateDestruction(psEffect);
-		}
-		return true;
-	case EFFECT_FIRE:
-		if (!gamePaused())
-		{
-			return updateFire(psEffect);
-		}
-		return true;
-	case EFFECT_SAT_LASER:
-		if (!gamePaused())
-		{
-			return updateSatLaser(psEffect);
-		}
-		return true;
-	case EFFECT_FIREWORK:
-		if (!gamePaused())
-		{
-			return updateFirework(psEffect);
-		}
-		return true;
-	case EFFECT_FREED:
-		break;
-	}
-	debug(LOG_ERROR, "Weirdy class of effect passed to updateEffect");
-	abort();
-}
-
 // ----------------------------------------------------------------------------------------
 // ALL THE UPDATE FUNCTIONS
 // ----------------------------------------------------------------------------------------
@@ -2223,37 +2307,44 @@ bool writeFXData(const char *fileName)
 {
 	int i = 0;
 	nlohmann::json mRoot = nlohmann::json::object();
-	for (auto iter = activeList.cbegin(); iter != activeList.end(); ++iter, i++)
-	{
-		EFFECT *it = *iter;
-
-		nlohmann::json effectObj = nlohmann::json::object();
-		effectObj["control"] = it->control;
-		effectObj["group"] = it->group;
-		effectObj["type"] = it->type;
-		effectObj["frameNumber"] = it->frameNumber;
-		effectObj["size"] = it->size;
-		effectObj["baseScale"] = it->baseScale;
-		effectObj["specific"] = it->specific;
-		effectObj["position"] = it->position;
-		effectObj["velocity"] = it->velocity;
-		effectObj["rotation"] = it->rotation;
-		effectObj["spin"] = it->spin;
-		effectObj["birthTime"] = it->birthTime;
-		effectObj["lastFrame"] = it->lastFrame;
-		effectObj["frameDelay"] = it->frameDelay;
-		effectObj["lifeSpan"] = it->lifeSpan;
-		effectObj["radius"] = it->radius;
-
-		if (it->imd)
+	for (const EffectPool &pool : effectPools)
+	{
+		for (uint32_t slot : pool.live)
 		{
-			effectObj["imd_name"] = modelName(it->imd);
-		}
+			const EFFECT *it = &pool.slots[slot];
+			if (it->group == EFFECT_FREED)
+			{
+				continue;
+			}
 
-		auto effectKey = "effect_" + WzString::number(i);
-		mRoot[effectKey.toUtf8()] = std::move(effectObj);
+			nlohmann::json effectObj = nlohmann::json::object();
+			effectObj["control"] = it->control;
+			effectObj["group"] = it->group;
+			effectObj["type"] = it->type;
+			effectObj["frameNumber"] = it->frameNumber;
+			effectObj["size"] = it->size;
+			effectObj["baseScale"] = it->baseScale;
+			effectObj["specific"] = it->specific;
+			effectObj["position"] = it->position;
+			effectObj["velocity"] = it->velocity;
+			effectObj["rotation"] = it->rotation;
+			effectObj["spin"] = it->spin;
+			effectObj["birthTime"] = it->birthTime;
+			effectObj["lastFrame"] = it->lastFrame;
+			effectObj["frameDelay"] = it->frameDelay;
+			effectObj["lifeSpan"] = it->lifeSpan;
+			effectObj["radius"] = it->radius;
+
+			if (it->imd)
+			{
+				effectObj["imd_name"] = modelName(it->imd);
+			}
 
-		// Move on to reading the next effect
+			auto effectKey = "effect_" + WzString::number(i++);
+			mRoot[effectKey.toUtf8()] = std::move(effectObj);
+
+			// Move on to reading the next effect
+		}
 	}
 
 	std::ostringstream stream;
@@ -2278,10 +2369,17 @@ bool readFXData(const char *fileName)
 	for (int i = 0; i < list.size(); ++i)
 	{
 		ini.beginGroup(list[i]);
-		EFFECT *curEffect = new EFFECT();
+		EFFECT_GROUP group = (EFFECT_GROUP)ini.value("group").toInt();
+		if (group < 0 || group >= EFFECT_FREED)
+		{
+			debug(LOG_ERROR, "Invalid effect group %d", (int)group);
+			ini.endGroup();
+			continue;
+		}
+		uint32_t slot;
+		EFFECT *curEffect = effectAlloc(group, &slot);
 
 		curEffect->control      = ini.value("control").toInt();
-		curEffect->group        = (EFFECT_GROUP)ini.value("group").toInt();
 		curEffect->type         = (EFFECT_TYPE)ini.value("type").toInt();
 		curEffect->frameNumber  = ini.value("frameNumber").toInt();
 		curEffect->size         = ini.value("size").toInt();
@@ -2323,10 +2421,13 @@ bool readFXData(const char *fileName)
 			}
 		}
 
+		if (effectIsLowPriority(curEffect))
+		{
+			cullQueue.push_back({effectSerial, group, slot});
+		}
+
 		// Move on to reading the next effect
 		ini.endGroup();
-
-		activeList.push_back(curEffect);
 	}
 
 	/* Hopefully everything's just fine by now */
@@ -139,14 +139,16 @@ struct EFFECT
 	uint16_t          lifeSpan;    // what is it's life expectancy?
 	uint16_t          radius;      // Used for area effects
 	iIMDShape         *imd;        // pointer to the imd the effect uses.
-	EFFECT *prev, *next; // Previous and next element in linked list
 
 	EFFECT() : player(MAX_PLAYERS), control(0), group(EFFECT_FREED), type(EXPLOSION_TYPE_SMALL), frameNumber(0), size(0),
 	           baseScale(0), specific(0), position(0.f, 0.f, 0.f), velocity(0.f, 0.f, 0.f), rotation(0, 0, 0), spin(0, 0, 0), birthTime(0), lastFrame(0), frameDelay(0), lifeSpan(0), radius(0),
-	           imd(nullptr), prev(nullptr), next(nullptr) {}
+	           imd(nullptr) {}
 };
 
-/* Maximum number of effects in the world - need to investigate what this should be */
+/* Maximum number of effects in the world - the oldest low priority effects are culled beyond this. 0 means no limit. */
+#define EFFECT_BUDGET_DEFAULT	(4096)
+#define EFFECT_BUDGET_MAX		(65536)
+
 /* EXTERNAL REFERENCES */
 void	effectGiveAuxVar(UDWORD var);		// naughty
 void	effectGiveAuxVarSec(UDWORD var);	// and so's this
@@ -169,4 +171,7 @@ void	effectSetSize(UDWORD size);
 void	effectSetLandLightSpec(LAND_LIGHT_SPEC spec);
 void	SetEffectForPlayer(uint8_t player);
 
+void	effectSetBudget(int budget);	// clipped to 0 .. EFFECT_BUDGET_MAX
+unsigned	effectGetBudget();
+
 #endif // __INCLUDED_SRC_EFFECTS_H__
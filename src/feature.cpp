@@ -276,6 +276,7 @@ FEATURE *buildFeature(FEATURE_STATS *psStats, UDWORD x, UDWORD y, bool FromSave)
 				}
 
 				psTile->psObject = (BASE_OBJECT *)psFeature;
+				++mapChangeCount;
 
 				// if it's a tall feature then flag it in the map.
 				if (psFeature->sDisplay.imd->max.y > TALLOBJECT_YMAX)
@@ -292,6 +293,8 @@ FEATURE *buildFeature(FEATURE_STATS *psStats, UDWORD x, UDWORD y, bool FromSave)
 			if ((!psStats->tileDraw) && (FromSave == false))
 			{
 				psTile->height = height;
+				++mapChangeCount;
+				mapHeightChanged(b.map.x + width, b.map.y + breadth);
 			}
 		}
 	}
@@ -374,6 +377,7 @@ bool removeFeature(FEATURE *psDel)
 				if (psTile->psObject == psDel)
 				{
 					psTile->psObject = nullptr;
+					++mapChangeCount;
 					auxClearBlocking(b.map.x + width, b.map.y + breadth, FEATURE_BLOCKED | AIR_BLOCKED);
 				}
 			}
@@ -509,6 +513,7 @@ bool destroyFeature(FEATURE *psDel, unsigned impactTime)
 					{
 						/* This remains a blocking tile */
 						psTile->psObject = nullptr;
+						++mapChangeCount;
 						auxClearBlocking(b.map.x + width, b.map.y + breadth, AIR_BLOCKED);  // Shouldn't remain blocking for air units, however.
 						psTile->texture = TileNumber_texture(psTile->texture) | BLOCKING_RUBBLE_TILE;
 					}
@@ -25,6 +25,7 @@
  */
 
 #include <future>
+#include <memory>
 #include <unordered_map>
 
 #include "lib/framework/frame.h"
@@ -32,6 +33,7 @@
 #include "lib/netplay/netplay.h"
 
 #include "lib/framework/wzapp.h"
+#include "lib/framework/wzjobs.h"
 
 #include "objects.h"
 #include "map.h"
@@ -40,9 +42,6 @@
 
 #include "fpath.h"
 
-// If the path finding system is shutdown or not
-static volatile bool fpathQuit = false;
-
 /* Beware: Enabling this will cause significant slow-down. */
 #undef DEBUG_MAP
 
@@ -56,66 +55,22 @@ struct PATHRESULT
 
 
 // threading stuff
-static WZ_THREAD        *fpathThread = nullptr;
+static WZ_JOB_QUEUE     *fpathQueue = nullptr;  ///< Runs the path finding jobs on the job workers, one at a time as A* isn't thread-safe.
 static WZ_MUTEX         *fpathMutex = nullptr;
-static WZ_SEMAPHORE     *fpathSemaphore = nullptr;
+static size_t           numPathJobs = 0;        ///< Jobs queued up and not done yet, guarded by fpathMutex.
 using packagedPathJob = wz::packaged_task<PATHRESULT()>;
-static std::list<packagedPathJob>    pathJobs;
 static std::unordered_map<uint32_t, wz::future<PATHRESULT>> pathResults;
 
-static bool             waitingForResult = false;
-static uint32_t         waitingForResultId;
-static WZ_SEMAPHORE     *waitingForResultSemaphore = nullptr;
-
 static PATHRESULT fpathExecute(PATHJOB psJob);
 
 
-/** This runs in a separate thread */
-static int fpathThreadFunc(void *)
-{
-	wzMutexLock(fpathMutex);
-
-	while (!fpathQuit)
-	{
-		if (pathJobs.empty())
-		{
-			ASSERT(!waitingForResult, "Waiting for a result (id %u) that doesn't exist.", waitingForResultId);
-			wzMutexUnlock(fpathMutex);
-			wzSemaphoreWait(fpathSemaphore);  // Go to sleep until needed.
-			wzMutexLock(fpathMutex);
-			continue;
-		}
-
-		// Copy the first job from the queue.
-		packagedPathJob job = std::move(pathJobs.front());
-		pathJobs.pop_front();
-
-		wzMutexUnlock(fpathMutex);
-		job();
-		wzMutexLock(fpathMutex);
-
-		waitingForResult = false;
-		objTrace(waitingForResultId, "These are the droids you are looking for.");
-		wzSemaphorePost(waitingForResultSemaphore);
-	}
-	wzMutexUnlock(fpathMutex);
-	return 0;
-}
-
-
 // initialise the findpath module
 bool fpathInitialise()
 {
-	// The path system is up
-	fpathQuit = false;
-
-	if (!fpathThread)
+	if (!fpathQueue)
 	{
 		fpathMutex = wzMutexCreate();
-		fpathSemaphore = wzSemaphoreCreate(0);
-		waitingForResultSemaphore = wzSemaphoreCreate(0);
-		fpathThread = wzThreadCreate(fpathThreadFunc, nullptr);
-		wzThreadStart(fpathThread);
+		fpathQueue = wzJobQueueCreate("path finding");
 	}
 
 	return true;
@@ -124,21 +79,15 @@ bool fpathInitialise()
 
 void fpathShutdown()
 {
-	if (fpathThread)
+	if (fpathQueue)
 	{
-		// Signal the path finding thread to quit
-		fpathQuit = true;
-		wzSemaphorePost(fpathSemaphore);  // Wake up thread.
-
-		wzThreadJoin(fpathThread);
-		fpathThread = nullptr;
+		wzJobQueueDestroy(fpathQueue);  // Drops the jobs that haven't started.
+		fpathQueue = nullptr;
 		wzMutexDestroy(fpathMutex);
 		fpathMutex = nullptr;
-		wzSemaphoreDestroy(fpathSemaphore);
-		fpathSemaphore = nullptr;
-		wzSemaphoreDestroy(waitingForResultSemaphore);
-		waitingForResultSemaphore = nullptr;
+		numPathJobs = 0;
 	}
+	pathResults.clear();  // The dropped jobs will never fulfil their futures.
 	fpathHardTableReset();
 }
 
@@ -339,7 +288,11 @@ static FPATH_RETVAL fpathRoute(MOVE_CONTROL *psMove, unsigned id, int startX, in
 		objTrace(id, "Checking if we have a path yet");
 
 		auto const &I = pathResults.find(id);
-		ASSERT(I != pathResults.end(), "Missing path result promise");
+		if (I == pathResults.end())
+		{
+			ASSERT(false, "Missing path result promise");
+			goto queuePathfinding;  // Lost the job somehow, so look for a path again.
+		}
 		PATHRESULT result = I->second.get();
 		ASSERT(result.retval != FPR_OK || result.sMove.asPath.size() > 0, "Ok result but no path in list");
 
@@ -388,21 +341,21 @@ queuePathfinding:
 	// job or result for each droid in the system at any time.
 	fpathRemoveDroidData(id);
 
-	packagedPathJob task([job]() { return fpathExecute(job); });
-	pathResults[id] = task.get_future();
+	std::shared_ptr<packagedPathJob> task = std::make_shared<packagedPathJob>([job]() { return fpathExecute(job); });
+	pathResults[id] = task->get_future();
 
 	// Add to end of list
 	wzMutexLock(fpathMutex);
-	bool isFirstJob = pathJobs.empty();
-	pathJobs.push_back(std::move(task));
+	const size_t jobsEarlier = numPathJobs++;
 	wzMutexUnlock(fpathMutex);
+	wzJobQueueAdd(fpathQueue, [task]() {
+		(*task)();
+		wzMutexLock(fpathMutex);
+		--numPathJobs;
+		wzMutexUnlock(fpathMutex);
+	});
 
-	if (isFirstJob)
-	{
-		wzSemaphorePost(fpathSemaphore);  // Wake up processing thread.
-	}
-
-	objTrace(id, "Queued up a path-finding request to (%d, %d), at least %d items earlier in queue", tX, tY, isFirstJob);
+	objTrace(id, "Queued up a path-finding request to (%d, %d), %zu items earlier in queue", tX, tY, jobsEarlier);
 	syncDebug("fpathRoute(..., %d, %d, %d, %d, %d, %d, %d, %d, %d) = FPR_WAIT", id, startX, startY, tX, tY, propulsionType, droidType, moveType, owner);
 	return FPR_WAIT;	// wait while polling result queue
 }
@@ -505,7 +458,7 @@ static size_t fpathJobQueueLength()
 	size_t count = 0;
 
 	wzMutexLock(fpathMutex);
-	count = pathJobs.size();  // O(N) function call for std::list. .empty() is faster, but this function isn't used except in tests.
+	count = numPathJobs;
 	wzMutexUnlock(fpathMutex);
 	return count;
 }
@@ -517,7 +470,7 @@ static size_t fpathResultQueueLength()
 	size_t count = 0;
 
 	wzMutexLock(fpathMutex);
-	count = pathResults.size();  // O(N) function call for std::list. .empty() is faster, but this function isn't used except in tests.
+	count = pathResults.size();
 	wzMutexUnlock(fpathMutex);
 	return count;
 }
@@ -539,10 +492,9 @@ void fpathTest(int x, int y, int x2, int y2)
 	(void)fpathJobQueueLength();
 
 	/* Check initial state */
-	assert(fpathThread != nullptr);
+	assert(fpathQueue != nullptr);
 	assert(fpathMutex != nullptr);
-	assert(fpathSemaphore != nullptr);
-	assert(pathJobs.empty());
+	assert(fpathJobQueueLength() == 0);
 	assert(pathResults.empty());
 	fpathRemoveDroidData(0);	// should not crash
 
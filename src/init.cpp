@@ -71,6 +71,7 @@
 #include "mechanics.h"
 #include "miscimd.h"
 #include "mission.h"
+#include "move.h"
 #include "modding.h"
 #include "multiint.h"
 #include "multigifts.h"
@@ -1042,6 +1043,7 @@ bool stageOneShutDown()
 	}
 
 	proj_Shutdown();
+	visShutdown();
 
 	releaseMission();
 
@@ -1050,6 +1052,8 @@ bool stageOneShutDown()
 		return false;
 	}
 
+	moveShutdown();
+
 	if (!objShutdown())
 	{
 		return false;
@@ -54,6 +54,7 @@
 #include "multimenu.h"
 #include "atmos.h"
 #include "advvis.h"
+#include "visibility.h"
 
 #include "intorder.h"
 #include "lib/widget/listwidget.h"
@@ -288,14 +289,11 @@ void kf_ToggleSensorDisplay()
 /* Halves all the heights of the map tiles */
 void	kf_HalveHeights()
 {
-	MAPTILE	*psTile;
-
 	for (int i = 0; i < mapWidth; ++i)
 	{
 		for (int j = 0; j < mapHeight; ++j)
 		{
-			psTile = mapTile(i, j);
-			psTile->height /= 2;
+			setTileHeight(i, j, mapTile(i, j)->height / 2);
 		}
 	}
 }
@@ -663,7 +661,27 @@ void	kf_FrameRate()
 		                          NETgetStatistic(NetStatisticUncompressedBytes, false),
 		                          NETgetStatistic(NetStatisticPackets, true),
 		                          NETgetStatistic(NetStatisticPackets, false));
+		for (unsigned codec = 0; codec < NETgetCodecCount(); ++codec)
+		{
+			size_t rawSent = NETgetCodecStatistic(codec, NetStatisticRawBytes, true, true);
+			size_t rawReceived = NETgetCodecStatistic(codec, NetStatisticRawBytes, false, true);
+			if (rawSent == 0 && rawReceived == 0)
+			{
+				continue;  // Not used in this game.
+			}
+			CONPRINTF("NETWORK %s:  Ratio: s-%.2f r-%.2f  CPU us/sec: s-%zu r-%zu",
+			                          NETgetCodecName(codec),
+			                          rawSent != 0 ? (double)NETgetCodecStatistic(codec, NetStatisticUncompressedBytes, true, true) / rawSent : 0.0,
+			                          rawReceived != 0 ? (double)NETgetCodecStatistic(codec, NetStatisticUncompressedBytes, false, true) / rawReceived : 0.0,
+			                          NETgetCodecStatistic(codec, NetStatisticCodecMicroseconds, true),
+			                          NETgetCodecStatistic(codec, NetStatisticCodecMicroseconds, false));
+		}
 	}
+	VisibilityStats const &vis = visGetStats();
+	CONPRINTF("VISIBILITY:  Wavecasts: %" PRIu64 "  Tile writes: %" PRIu64 "  Tiles unchanged: %" PRIu64 "  Deferred: %" PRIu64 " (%" PRIu64 " collapsed)",
+	                          vis.wavecasts, vis.tileWrites, vis.tilesUnchanged, vis.requests, vis.requestsCollapsed);
+	CONPRINTF("LINE OF FIRE:  Checks: %" PRIu64 "  Cache hits: %" PRIu64 " (%.1f%%)",
+	                          vis.fireLineChecks, vis.fireLineCacheHits, vis.fireLineChecks ? 100.0 * vis.fireLineCacheHits / vis.fireLineChecks : 0.0);
 	gameStats = !gameStats;
 	CONPRINTF("Built: %s %s", getCompileDate(), __TIME__);
 }
@@ -76,6 +76,8 @@
 #include "edit3d.h"
 #include "fpath.h"
 #include "cmddroid.h"
+#include "ai.h"
+#include "move.h"
 #include "keybind.h"
 #include "wrappers.h"
 #include "random.h"
@@ -130,6 +132,47 @@ LOOP_MISSION_STATE		loopMissionState = LMS_NORMAL;
 // this is set by scrStartMission to say what type of new level is to be started
 LEVEL_TYPE nextMissionType = LEVEL_TYPE::LDS_NONE;
 
+/// How long the fast-forward loop runs game state updates before returning to the main loop, in milliseconds.
+#define FAST_FORWARD_SLICE	100
+
+/// Deal with the mission state. Returns GAMECODE_CONTINUE unless the game loop has to end.
+static GAMECODE updateLoopMissionState()
+{
+	switch (loopMissionState)
+	{
+	case LMS_CLEAROBJECTS:
+		missionDestroyObjects();
+		setScriptPause(true);
+		loopMissionState = LMS_SETUPMISSION;
+		break;
+
+	case LMS_NORMAL:
+		// default
+		break;
+	case LMS_SETUPMISSION:
+		setScriptPause(false);
+		if (!setUpMission(nextMissionType))
+		{
+			return GAMECODE_QUITGAME;
+		}
+		break;
+	case LMS_SAVECONTINUE:
+		// just wait for this to be changed when the new mission starts
+		break;
+	case LMS_NEWLEVEL:
+		nextMissionType = LEVEL_TYPE::LDS_NONE;
+		return GAMECODE_NEWLEVEL;
+		break;
+	case LMS_LOADGAME:
+		return GAMECODE_LOADGAME;
+		break;
+	default:
+		ASSERT(false, "unknown loopMissionState");
+		break;
+	}
+	return GAMECODE_CONTINUE;
+}
+
 static GAMECODE renderLoop()
 {
 	if (bMultiPlayer && !NetPlay.isHostAlive && NetPlay.bComms && !NetPlay.isHost)
@@ -336,37 +379,10 @@ static GAMECODE renderLoop()
 	pie_GetResetCounts(&loopPieCount, &loopPolyCount);
 
 	// deal with the mission state
-	switch (loopMissionState)
+	GAMECODE missionCode = updateLoopMissionState();
+	if (missionCode != GAMECODE_CONTINUE)
 	{
-	case LMS_CLEAROBJECTS:
-		missionDestroyObjects();
-		setScriptPause(true);
-		loopMissionState = LMS_SETUPMISSION;
-		break;
-
-	case LMS_NORMAL:
-		// default
-		break;
-	case LMS_SETUPMISSION:
-		setScriptPause(false);
-		if (!setUpMission(nextMissionType))
-		{
-			return GAMECODE_QUITGAME;
-		}
-		break;
-	case LMS_SAVECONTINUE:
-		// just wait for this to be changed when the new mission starts
-		break;
-	case LMS_NEWLEVEL:
-		nextMissionType = LEVEL_TYPE::LDS_NONE;
-		return GAMECODE_NEWLEVEL;
-		break;
-	case LMS_LOADGAME:
-		return GAMECODE_LOADGAME;
-		break;
-	default:
-		ASSERT(false, "unknown loopMissionState");
-		break;
+		return missionCode;
 	}
 
 	int clearMode = 0;
@@ -545,6 +561,12 @@ static void gameStateUpdate()
 	// update the command droids
 	cmdDroidUpdate();
 
+	// find targets for everything that needs one, before anything moves or fires
+	aiEvaluateTargets();
+
+	// and what the moving droids will have to steer around
+	moveFindObstacles();
+
 	for (unsigned i = 0; i < MAX_PLAYERS; i++)
 	{
 		//update the current power available for a player
@@ -582,6 +604,9 @@ static void gameStateUpdate()
 		}
 	}
 
+	// Do the visibility updates of the droids and structures which moved or changed, all at once.
+	visUpdatePendingTiles();
+
 	missionTimerUpdate();
 
 	proj_UpdateAll();
@@ -603,9 +628,59 @@ static void gameStateUpdate()
 	countUpdate(true);
 }
 
+/* The game loop for headless fast-forward: game state updates back to back, with none of the presentation */
+static GAMECODE fastForwardLoop()
+{
+	countUpdate(false);
+
+	const uint32_t sliceStart = wzGetTicks();
+	bool ticked = false;
+	while (wzGetTicks() - sliceStart < FAST_FORWARD_SLICE && loopMissionState == LMS_NORMAL)
+	{
+		recvMessage();
+
+		gameTimeUpdate(true);
+		if (deltaGameTime == 0)
+		{
+			break;  // Waiting for other players, or for the tick rate cap.
+		}
+
+		ASSERT(!paused && !gameUpdatePaused(), "Nonsensical pause values.");
+
+		syncDebug("Begin game state update, gameTime = %d", gameTime);
+		gameStateUpdate();
+		syncDebug("End game state update, gameTime = %d", gameTime);
+		ticked = true;
+	}
+
+	if (!paused && !gameUpdatePaused() && bMultiPlayer)
+	{
+		multiPlayerLoop();
+	}
+	NETflush();
+
+	if (autogame_enabled())
+	{
+		// Output occasional stats to stdout
+		stdOutGameSummary();
+	}
+
+	if (!ticked)
+	{
+		wzDelay(1);  // Don't spin while there is nothing to do.
+	}
+
+	return updateLoopMissionState();
+}
+
 /* The main game loop */
 GAMECODE gameLoop()
 {
+	if (headlessFastForward())
+	{
+		return fastForwardLoop();
+	}
+
 	static uint32_t lastFlushTime = 0;
 
 	static int renderBudget = 0;  // Scaled time spent rendering minus scaled time spent updating.
@@ -1545,6 +1545,8 @@ int realmain(int argc, char *argv[])
 	// Save new (commandline) settings
 	saveConfig();
 
+	gameTimeSetFastForward(headlessFastForward(), headlessFastForwardMaxTickRate());
+
 	// Print out some initial information if in headless mode
 	if (headlessGameMode())
 	{
@@ -1555,6 +1557,17 @@ int realmain(int argc, char *argv[])
 		{
 			fprintf(stdout, " * NOTE: VSYNC IS DISABLED - CPU USAGE MAY BE UNBOUNDED\n");
 		}
+		if (headlessFastForward())
+		{
+			if (headlessFastForwardMaxTickRate() > 0)
+			{
+				fprintf(stdout, " * Fast-forward: at most %u ticks per second\n", headlessFastForwardMaxTickRate());
+			}
+			else
+			{
+				fprintf(stdout, " * Fast-forward: unlimited tick rate\n");
+			}
+		}
 		fprintf(stdout, "--------------------------------------------------------------------------------------\n");
 		fflush(stdout);
 	}
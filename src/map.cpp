@@ -24,6 +24,8 @@
  *
  */
 #include <time.h>
+#include <unordered_map>
+#include <vector>
 
 #include "lib/framework/frame.h"
 #include "lib/framework/endian_hack.h"
@@ -51,21 +53,37 @@
 #include "fpath.h"
 #include "levels.h"
 #include "lib/framework/wzapp.h"
+#include "lib/framework/wzjobs.h"
 
 #define GAME_TICKS_FOR_DANGER (GAME_TICKS_PER_SEC * 2)
 
-static WZ_THREAD *dangerThread = nullptr;
-static WZ_SEMAPHORE *dangerSemaphore = nullptr;
-static WZ_SEMAPHORE *dangerDoneSemaphore = nullptr;
-struct floodtile
+static bool dangerEnabled = false;           ///< Whether the danger maps are kept up to date at all
+static WZ_JOB *dangerJob = nullptr;          ///< Flood fill of dangerFillPlayer's danger map running on the job pool
+static std::vector<int> dangerJobBucket;     ///< Open list of the flood fill in dangerJob
+static std::vector<int> dangerBucket;        ///< Open list of flood fills on the main thread
+static UDWORD lastDangerUpdate = 0;
+static int lastDangerPlayer = -1;  ///< Player whose danger map got the latest full flood fill
+static int dangerFillPlayer = -1;  ///< Player whose danger map dangerJob is filling, or -1
+
+/// How many enemy objects can shoot at each tile, for one player
+struct ThreatMap
 {
-	uint8_t x;
-	uint8_t y;
+	std::vector<uint16_t> ground, air;
+	std::vector<int> changed;  ///< Tiles whose counts went from or to 0 since the aux bits were updated, maybe listed twice
+	bool refill = false;       ///< A tile the player could get through became threatened, so the player goes first for the next full flood fill
 };
-static struct floodtile *floodbucket = nullptr;
-static int bucketcounter;
-static UDWORD lastDangerUpdate = 0;
-static int lastDangerPlayer = -1;
+static ThreatMap threatMaps[MAX_PLAYERS];
+
+/// What an object added to the threat maps
+struct ThreatSource
+{
+	std::vector<TILEPOS> tiles;
+	PlayerMask players = 0;   ///< Players it threatens
+	uint8_t mode = 0;         ///< SHOOT_ON_GROUND and/or SHOOT_IN_AIR
+	uint32_t generation = 0;  ///< threatGeneration when the object was last seen
+};
+static std::unordered_map<uint32_t, ThreatSource> threatSources;  ///< By object id
+static uint32_t threatGeneration = 0;
 
 //scroll min and max values
 SDWORD		scrollMinX, scrollMaxX, scrollMinY, scrollMaxY;
@@ -109,6 +127,10 @@ struct GATEWAY_SAVE
 /* The size and contents of the map */
 SDWORD	mapWidth = 0, mapHeight = 0;
 MAPTILE	*psMapTiles = nullptr;
+uint32_t mapChangeCount = 0;
+TileHeights *psTileHeights = nullptr;
+MAPTILE *psTileHeightsTiles = nullptr;
+static std::vector<TileHeights> tileHeights;  ///< Storage of psTileHeights
 uint8_t *psBlockMap[AUX_MAX];
 uint8_t *psAuxMap[MAX_PLAYERS + AUX_MAX];        // yes, we waste one element... eyes wide open... makes API nicer
 
@@ -896,6 +918,8 @@ bool mapLoadFromWzMapData(WzMap::MapData& loadedMap)
 	/* Allocate the memory for the map */
 	psMapTiles = (MAPTILE *)calloc((size_t)width * height, sizeof(MAPTILE));
 	ASSERT(psMapTiles != nullptr, "Out of memory");
+	++mapChangeCount;
+	psTileHeightsTiles = nullptr;  // In case the new map got the memory of an old one.
 
 	mapWidth = width;
 	mapHeight = height;
@@ -956,6 +980,7 @@ bool mapLoadFromWzMapData(WzMap::MapData& loadedMap)
 	{
 		return false;
 	}
+	mapUpdateHeightCache();
 
 	return true;
 }
@@ -1081,18 +1106,18 @@ bool mapShutdown()
 {
 	int x;
 
-	if (dangerThread)
+	if (dangerJob)
 	{
-		wzSemaphoreWait(dangerDoneSemaphore);
-		lastDangerPlayer = -1;
-		wzSemaphorePost(dangerSemaphore);
-		wzThreadJoin(dangerThread);
-		wzSemaphoreDestroy(dangerSemaphore);
-		wzSemaphoreDestroy(dangerDoneSemaphore);
-		dangerThread = nullptr;
-		dangerSemaphore = nullptr;
-		dangerDoneSemaphore = nullptr;
+		wzJobFinish(dangerJob);
+		dangerJob = nullptr;
+		dangerFillPlayer = -1;
 	}
+	dangerEnabled = false;
+	for (ThreatMap &threatMap : threatMaps)
+	{
+		threatMap = ThreatMap();
+	}
+	threatSources.clear();
 
 	free(psMapTiles);
 	delete[] mapDecals;
@@ -1104,7 +1129,6 @@ bool mapShutdown()
 	free(psBlockMap[AUX_ASTARMAP]);
 	psBlockMap[AUX_ASTARMAP] = nullptr;
 	free(psBlockMap[AUX_DANGERMAP]);
-	free(floodbucket);
 	psBlockMap[AUX_DANGERMAP] = nullptr;
 	for (x = 0; x < MAX_PLAYERS + AUX_MAX; x++)
 	{
@@ -1113,11 +1137,14 @@ bool mapShutdown()
 	}
 
 	map = nullptr;
-	floodbucket = nullptr;
 	psGroundTypes = nullptr;
 	mapDecals = nullptr;
 	psMapTiles = nullptr;
 	mapWidth = mapHeight = 0;
+	++mapChangeCount;
+	psTileHeightsTiles = nullptr;
+	tileHeights.clear();
+	psTileHeights = nullptr;
 	numTile_names = 0;
 	Tile_names = nullptr;
 	return true;
@@ -1433,106 +1460,62 @@ unsigned map_LineIntersect(Vector3i src, Vector3i dst, unsigned tMax)
 	}
 }
 
-/// The max height of the terrain and water at the specified world coordinates
-extern int32_t map_Height(int x, int y)
+static TileHeights makeTileHeightsAt(int32_t tileX, int32_t tileY)
 {
-	int tileX, tileY;
-	int i, j;
-	int32_t height[2][2], center;
-	int32_t onTileX, onTileY;
-	int32_t left, right, middle;
-	int32_t onBottom, result;
-	int towardsCenter, towardsRight;
-
-	// Clamp x and y values to actual ones
-	// Give one tile worth of leeway before asserting, for units/transporters coming in from off-map.
-	ASSERT(x >= -TILE_UNITS, "map_Height: x value is too small (%d,%d) in %dx%d", map_coord(x), map_coord(y), mapWidth, mapHeight);
-	ASSERT(y >= -TILE_UNITS, "map_Height: y value is too small (%d,%d) in %dx%d", map_coord(x), map_coord(y), mapWidth, mapHeight);
-	x = MAX(x, 0);
-	y = MAX(y, 0);
-	ASSERT(x < world_coord(mapWidth) + TILE_UNITS, "map_Height: x value is too big (%d,%d) in %dx%d", map_coord(x), map_coord(y), mapWidth, mapHeight);
-	ASSERT(y < world_coord(mapHeight) + TILE_UNITS, "map_Height: y value is too big (%d,%d) in %dx%d", map_coord(x), map_coord(y), mapWidth, mapHeight);
-	x = MIN(x, world_coord(mapWidth) - 1);
-	y = MIN(y, world_coord(mapHeight) - 1);
-
-	// on which tile are these coords?
-	tileX = map_coord(x);
-	tileY = map_coord(y);
-
-	// where on the tile? (scale to (0,1))
-	onTileX = x - world_coord(tileX);
-	onTileY = y - world_coord(tileY);
+	return makeTileHeights(map_TileHeightSurface(tileX, tileY), map_TileHeightSurface(tileX + 1, tileY),
+	                       map_TileHeightSurface(tileX, tileY + 1), map_TileHeightSurface(tileX + 1, tileY + 1));
+}
 
-	// get the height for the corners and center
-	center = 0;
-	for (i = 0; i < 2; i++)
+void mapUpdateHeightCache()
+{
+	if (psTileHeightsTiles == psMapTiles && psMapTiles != nullptr)
 	{
-		for (j = 0; j < 2; j++)
+		return;
+	}
+	psTileHeightsTiles = nullptr;
+	tileHeights.resize((size_t)mapWidth * mapHeight);
+	psTileHeights = tileHeights.data();
+	for (int y = 0; y < mapHeight; ++y)
+	{
+		for (int x = 0; x < mapWidth; ++x)
 		{
-			height[i][j] = map_TileHeightSurface(tileX + i, tileY + j);
-			center += height[i][j];
+			psTileHeights[x + y * mapWidth] = makeTileHeightsAt(x, y);
 		}
 	}
-	center /= 4;
-
-	// we have:
-	//   x ->
-	// y 0,0--D--1,0
-	// | |  \    / |
-	// V A  centre C
-	//   | /     \ |
-	//   0,1--B--1,1
+	psTileHeightsTiles = psMapTiles;
+}
 
-	// get heights for left and right corners and the distances
-	if (onTileY > onTileX)
+void mapHeightChanged(int32_t x, int32_t y)
+{
+	if (psTileHeightsTiles != psMapTiles)
 	{
-		if (onTileY < TILE_UNITS - onTileX)
-		{
-			// A
-			right = height[0][0];
-			left  = height[0][1];
-			towardsCenter = onTileX;
-			towardsRight  = TILE_UNITS - onTileY;
-		}
-		else
-		{
-			// B
-			right = height[0][1];
-			left  = height[1][1];
-			towardsCenter = TILE_UNITS - onTileY;
-			towardsRight  = TILE_UNITS - onTileX;
-		}
+		return;  // Gets rebuilt anyway.
 	}
-	else
+	// The corner is shared by up to four tiles.
+	for (int tileY = MAX(y - 1, 0); tileY <= MIN(y, mapHeight - 1); ++tileY)
 	{
-		if (onTileX > TILE_UNITS - onTileY)
-		{
-			// C
-			right = height[1][1];
-			left  = height[1][0];
-			towardsCenter = TILE_UNITS - onTileX;
-			towardsRight  = onTileY;
-		}
-		else
+		for (int tileX = MAX(x - 1, 0); tileX <= MIN(x, mapWidth - 1); ++tileX)
 		{
-			// D
-			right = height[1][0];
-			left  = height[0][0];
-			towardsCenter = onTileY;
-			towardsRight  = onTileX;
+			psTileHeights[tileX + tileY * mapWidth] = makeTileHeightsAt(tileX, tileY);
 		}
 	}
-	ASSERT(towardsCenter <= TILE_UNITS / 2, "towardsCenter is too high");
-
-	// now we have:
-	//    left   m    right
-	//         center
+}
 
-	middle = (left + right) / 2;
-	onBottom = left * (TILE_UNITS - towardsRight) + right * towardsRight;
-	result = onBottom + (center - middle) * towardsCenter * 2;
+/// The max height of the terrain and water at the specified world coordinates
+extern int32_t map_Height(int x, int y)
+{
+	// Clamp x and y values to actual ones
+	// Give one tile worth of leeway before asserting, for units/transporters coming in from off-map.
+	ASSERT(x >= -TILE_UNITS, "map_Height: x value is too small (%d,%d) in %dx%d", map_coord(x), map_coord(y), mapWidth, mapHeight);
+	ASSERT(y >= -TILE_UNITS, "map_Height: y value is too small (%d,%d) in %dx%d", map_coord(x), map_coord(y), mapWidth, mapHeight);
+	x = MAX(x, 0);
+	y = MAX(y, 0);
+	ASSERT(x < world_coord(mapWidth) + TILE_UNITS, "map_Height: x value is too big (%d,%d) in %dx%d", map_coord(x), map_coord(y), mapWidth, mapHeight);
+	ASSERT(y < world_coord(mapHeight) + TILE_UNITS, "map_Height: y value is too big (%d,%d) in %dx%d", map_coord(x), map_coord(y), mapWidth, mapHeight);
+	x = MIN(x, world_coord(mapWidth) - 1);
+	y = MIN(y, world_coord(mapHeight) - 1);
 
-	return (result + TILE_UNITS / 2) / TILE_UNITS;
+	return map_HeightUnchecked(x, y);
 }
 
 /* returns true if object is above ground */
@@ -1841,203 +1824,308 @@ bool fireOnLocation(unsigned int x, unsigned int y)
 	return psTile != nullptr && TileIsBurning(psTile);
 }
 
-// This function runs in a separate thread!
-static int dangerFloodFill(int player)
+/// Whether the AI would go through a tile, rather than just next to it.
+static inline bool dangerPassable(uint8_t const *aux, uint8_t const *block, int tile)
 {
-	int i;
-	Vector2i pos = getPlayerStartPosition(player);
-	Vector2i npos(0, 0);
-	uint8_t aux, block;
-	int x, y;
-	bool start = true;	// hack to disregard the blocking status of any building exactly on the starting position
-
-	// Set our danger bits
-	for (y = 0; y < mapHeight; y++)
-	{
-		for (x = 0; x < mapWidth; x++)
-		{
-			auxSet(x, y, MAX_PLAYERS + AUX_DANGERMAP, AUXBITS_DANGER);
-			auxClear(x, y, MAX_PLAYERS + AUX_DANGERMAP, AUXBITS_TEMPORARY);
-		}
-	}
+	// Note that we do not consider water to be a blocker here. This may or may not be a feature...
+	return !(block[tile] & FEATURE_BLOCKED) && !(aux[tile] & AUXBITS_NONPASSABLE);
+}
 
-	pos.x = map_coord(pos.x);
-	pos.y = map_coord(pos.y);
-	bucketcounter = 0;
+static int dangerStartTile(int player)
+{
+	const Vector2i pos = map_coord(getPlayerStartPosition(player));
+	return tileOnMap(pos) ? pos.x + pos.y * mapWidth : -1;
+}
 
-	do
+/// Clear the danger bits of the unthreatened tiles reachable from the tiles in bucket, which must be safe already.
+static void dangerSpread(uint8_t *aux, uint8_t const *block, std::vector<int> &bucket)
+{
+	while (!bucket.empty())
 	{
-		// Add accessible neighbouring tiles to the open list
-		for (i = 0; i < NUM_DIR; i++)
+		const int tile = bucket.back();
+		bucket.pop_back();
+		const int x = tile % mapWidth;
+		const int y = tile / mapWidth;
+		for (int i = 0; i < NUM_DIR; i++)
 		{
-			npos.x = pos.x + aDirOffset[i].x;
-			npos.y = pos.y + aDirOffset[i].y;
-			if (!tileOnMap(npos.x, npos.y))
+			if (!tileOnMap(x + aDirOffset[i].x, y + aDirOffset[i].y))
 			{
 				continue;
 			}
-			aux = auxTile(npos.x, npos.y, MAX_PLAYERS + AUX_DANGERMAP);
-			block = blockTile(pos.x, pos.y, AUX_DANGERMAP);
-			if (!(aux & AUXBITS_TEMPORARY) && !(aux & AUXBITS_THREAT) && (aux & AUXBITS_DANGER))
+			const int next = tile + aDirOffset[i].x + aDirOffset[i].y * mapWidth;
+			if ((aux[next] & (AUXBITS_DANGER | AUXBITS_THREAT)) == AUXBITS_DANGER)
 			{
-				// Note that we do not consider water to be a blocker here. This may or may not be a feature...
-				if (!(block & FEATURE_BLOCKED) && (!(aux & AUXBITS_NONPASSABLE) || start))
-				{
-					floodbucket[bucketcounter].x = npos.x;
-					floodbucket[bucketcounter].y = npos.y;
-					bucketcounter++;
-					if (start && !(aux & AUXBITS_NONPASSABLE))
-					{
-						start = false;
-					}
-				}
-				else
+				aux[next] &= ~AUXBITS_DANGER;
+				if (dangerPassable(aux, block, next))
 				{
-					auxClear(npos.x, npos.y, MAX_PLAYERS + AUX_DANGERMAP, AUXBITS_DANGER);
+					bucket.push_back(next);  // Otherwise it's only safe to be next to.
 				}
-				auxSet(npos.x, npos.y, MAX_PLAYERS + AUX_DANGERMAP, AUXBITS_TEMPORARY); // make sure we do not process it more than once
 			}
 		}
+	}
+}
+
+// This function runs in a separate thread!
+static void dangerFloodFill(int player, uint8_t *aux, uint8_t const *block, std::vector<int> &bucket)
+{
+	for (int i = 0; i < mapWidth * mapHeight; ++i)
+	{
+		aux[i] |= AUXBITS_DANGER;
+	}
+	const int start = dangerStartTile(player);
+	if (start >= 0)
+	{
+		// Go on from the start position even if a building is sitting on it.
+		aux[start] &= ~AUXBITS_DANGER;
+		bucket.push_back(start);
+		dangerSpread(aux, block, bucket);
+	}
+}
+
+// This function runs on the job pool!
+static void dangerJobFunc()
+{
+	dangerFloodFill(dangerFillPlayer, psAuxMap[MAX_PLAYERS + AUX_DANGERMAP], psBlockMap[AUX_DANGERMAP], dangerJobBucket);
+}
 
-		// Clear danger
-		auxClear(pos.x, pos.y, MAX_PLAYERS + AUX_DANGERMAP, AUXBITS_DANGER);
+static uint8_t threatMode(DROID const *psDroid)
+{
+	uint8_t mode = 0;
 
-		// Pop the last open node off the bucket list for the next iteration
-		if (bucketcounter)
-		{
-			bucketcounter--;
-			pos.x = floodbucket[bucketcounter].x;
-			pos.y = floodbucket[bucketcounter].y;
-		}
+	if (psDroid->droidType == DROID_CONSTRUCT || psDroid->droidType == DROID_CYBORG_CONSTRUCT
+	    || psDroid->droidType == DROID_REPAIR || psDroid->droidType == DROID_CYBORG_REPAIR)
+	{
+		return 0;	// hack that really should not be needed, but is -- trucks can SHOOT_ON_GROUND...!
 	}
-	while (bucketcounter);
-	return 0;
+	for (int weapon = 0; weapon < psDroid->numWeaps; weapon++)
+	{
+		mode |= asWeaponStats[psDroid->asWeaps[weapon].nStat].surfaceToAir;
+	}
+	if (psDroid->droidType == DROID_SENSOR)	// special treatment for sensor turrets, no multiweapon support
+	{
+		mode |= SHOOT_ON_GROUND;		// assume it only shoots at ground targets for now
+	}
+	return mode;
 }
 
-// This function runs in a separate thread!
-static int dangerThreadFunc(WZ_DECL_UNUSED void *data)
+static uint8_t threatMode(STRUCTURE const *psStruct)
 {
-	while (lastDangerPlayer != -1)
+	uint8_t mode = 0;
+
+	for (int weapon = 0; weapon < psStruct->numWeaps; weapon++)
+	{
+		mode |= asWeaponStats[psStruct->asWeaps[weapon].nStat].surfaceToAir;
+	}
+	if (psStruct->pStructureType->pSensor && psStruct->pStructureType->pSensor->location == LOC_TURRET)	// special treatment for sensor turrets
 	{
-		dangerFloodFill(lastDangerPlayer);	// Do the actual work
-		wzSemaphorePost(dangerDoneSemaphore);   // Signal that we are done
-		wzSemaphoreWait(dangerSemaphore);	// Go to sleep until needed.
+		mode |= SHOOT_ON_GROUND;		// assume it only shoots at ground targets for now
 	}
-	return 0;
+	return mode;
 }
 
-static inline void threatUpdateTarget(int player, BASE_OBJECT *psObj, bool ground, bool air)
+static inline void threatCount(ThreatMap &threatMap, std::vector<uint16_t> &counts, int tile, int delta)
 {
-	if (psObj->visible[player] || psObj->born == 2)
+	const bool wasThreat = counts[tile] != 0;
+	counts[tile] += delta;
+	if (wasThreat != (counts[tile] != 0))
 	{
-		for (TILEPOS pos : psObj->watchedTiles)
+		threatMap.changed.push_back(tile);
+	}
+}
+
+/// Add (delta 1) or remove (delta -1) what an object does to the threat maps.
+static void threatCountSource(ThreatSource const &source, int delta)
+{
+	for (int player = 0; player < MAX_PLAYERS; ++player)
+	{
+		if (!(source.players & (PlayerMask(1) << player)))
 		{
-			if (ground)
+			continue;
+		}
+		ThreatMap &threatMap = threatMaps[player];
+		for (TILEPOS pos : source.tiles)
+		{
+			const int tile = pos.x + pos.y * mapWidth;
+			if (source.mode & SHOOT_ON_GROUND)
 			{
-				auxSet(pos.x, pos.y, MAX_PLAYERS + AUX_DANGERMAP, AUXBITS_THREAT);	// set ground threat for this tile
+				threatCount(threatMap, threatMap.ground, tile, delta);
 			}
-			if (air)
+			if (source.mode & SHOOT_IN_AIR)
 			{
-				auxSet(pos.x, pos.y, MAX_PLAYERS + AUX_DANGERMAP, AUXBITS_AATHREAT);	// set air threat for this tile
+				threatCount(threatMap, threatMap.air, tile, delta);
 			}
 		}
 	}
 }
 
-static void threatUpdate(int player)
+static void threatUpdateSource(BASE_OBJECT const *psObj, uint8_t mode)
 {
-	int i, weapon, x, y;
+	PlayerMask players = 0;
 
-	// Step 1: Clear our threat bits
-	for (y = 0; y < mapHeight; y++)
+	if (mode != 0)
 	{
-		for (x = 0; x < mapWidth; x++)
+		for (int player = 0; player < game.maxPlayers; ++player)
 		{
-			auxClear(x, y, MAX_PLAYERS + AUX_DANGERMAP, AUXBITS_THREAT | AUXBITS_AATHREAT);
+			if (!aiCheckAlliances(player, psObj->player) && (psObj->visible[player] || psObj->born == 2))
+			{
+				players |= PlayerMask(1) << player;
+			}
 		}
 	}
 
-	// Step 2: Set threat bits
-	for (i = 0; i < MAX_PLAYERS; i++)
+	auto found = threatSources.find(psObj->id);
+	if (found == threatSources.end())
 	{
-		DROID *psDroid;
-		STRUCTURE *psStruct;
-
-		if (aiCheckAlliances(player, i))
+		if (players == 0)
 		{
-			// No need to iterate friendly objects
-			continue;
+			return;  // Harmless, and always was.
 		}
+		found = threatSources.emplace(psObj->id, ThreatSource()).first;
+	}
+	ThreatSource &source = found->second;
+	source.generation = threatGeneration;
+	if (source.players == players && source.mode == mode && source.tiles.size() == psObj->watchedTiles.size()
+	    && std::equal(source.tiles.begin(), source.tiles.end(), psObj->watchedTiles.begin(), [](TILEPOS a, TILEPOS b) {
+		return a.x == b.x && a.y == b.y;
+	}))
+	{
+		return;  // Nothing moved.
+	}
+	threatCountSource(source, -1);
+	source.players = players;
+	source.mode = mode;
+	source.tiles = psObj->watchedTiles;
+	threatCountSource(source, 1);
+}
 
-		for (psDroid = apsDroidLists[i]; psDroid; psDroid = psDroid->psNext)
+/// Update the threat counts of the objects that appeared, moved, changed sides, were spotted or were destroyed since the last call.
+static void threatUpdate()
+{
+	++threatGeneration;
+	for (int owner = 0; owner < MAX_PLAYERS; owner++)
+	{
+		for (DROID *psDroid = apsDroidLists[owner]; psDroid; psDroid = psDroid->psNext)
 		{
-			UBYTE mode = 0;
-
-			if (psDroid->droidType == DROID_CONSTRUCT || psDroid->droidType == DROID_CYBORG_CONSTRUCT
-			    || psDroid->droidType == DROID_REPAIR || psDroid->droidType == DROID_CYBORG_REPAIR)
-			{
-				continue;	// hack that really should not be needed, but is -- trucks can SHOOT_ON_GROUND...!
-			}
-			for (weapon = 0; weapon < psDroid->numWeaps; weapon++)
-			{
-				mode |= asWeaponStats[psDroid->asWeaps[weapon].nStat].surfaceToAir;
-			}
-			if (psDroid->droidType == DROID_SENSOR)	// special treatment for sensor turrets, no multiweapon support
-			{
-				mode |= SHOOT_ON_GROUND;		// assume it only shoots at ground targets for now
-			}
-			if (mode > 0)
-			{
-				threatUpdateTarget(player, (BASE_OBJECT *)psDroid, mode & SHOOT_ON_GROUND, mode & SHOOT_IN_AIR);
-			}
+			threatUpdateSource(psDroid, threatMode(psDroid));
+		}
+		for (STRUCTURE *psStruct = apsStructLists[owner]; psStruct; psStruct = psStruct->psNext)
+		{
+			threatUpdateSource(psStruct, threatMode(psStruct));
+		}
+	}
+	for (auto i = threatSources.begin(); i != threatSources.end();)
+	{
+		if (i->second.generation != threatGeneration)
+		{
+			threatCountSource(i->second, -1);  // Gone.
+			i = threatSources.erase(i);
+		}
+		else
+		{
+			++i;
 		}
+	}
+}
 
-		for (psStruct = apsStructLists[i]; psStruct; psStruct = psStruct->psNext)
+/// Whether the AI can get to a tile next to this one.
+static bool dangerNextToReachable(uint8_t const *aux, uint8_t const *block, int tile, int start)
+{
+	const int x = tile % mapWidth;
+	const int y = tile / mapWidth;
+	for (int i = 0; i < NUM_DIR; i++)
+	{
+		if (!tileOnMap(x + aDirOffset[i].x, y + aDirOffset[i].y))
 		{
-			UBYTE mode = 0;
+			continue;
+		}
+		const int next = tile + aDirOffset[i].x + aDirOffset[i].y * mapWidth;
+		if (!(aux[next] & AUXBITS_DANGER) && (next == start || dangerPassable(aux, block, next)))
+		{
+			return true;
+		}
+	}
+	return false;
+}
 
-			for (weapon = 0; weapon < psStruct->numWeaps; weapon++)
-			{
-				mode |= asWeaponStats[psStruct->asWeaps[weapon].nStat].surfaceToAir;
-			}
-			if (psStruct->pStructureType->pSensor && psStruct->pStructureType->pSensor->location == LOC_TURRET)	// special treatment for sensor turrets
-			{
-				mode |= SHOOT_ON_GROUND;		// assume it only shoots at ground targets for now
-			}
-			if (mode > 0)
+/** Bring the threat bits of a player up to date with the counts, and the danger bits as far as that can be done without a full flood fill.
+ *  That is only an approximation: tiles that became threatened are dangerous, and tiles that stopped being threatened are safe if they
+ *  can be reached. But places cut off by a new threat stay safe until the player's next full fill. One player gets one of those every
+ *  GAME_TICKS_FOR_DANGER, players with a refill pending first, so that can be up to game.maxPlayers times that away.
+ */
+static void dangerUpdate(int player)
+{
+	ThreatMap &threatMap = threatMaps[player];
+	uint8_t *aux = psAuxMap[player];
+	uint8_t const *block = psBlockMap[AUX_MAP];
+
+	if (threatMap.changed.empty())
+	{
+		return;
+	}
+	for (int tile : threatMap.changed)
+	{
+		const uint8_t old = aux[tile];
+		uint8_t now = old & ~(AUXBITS_THREAT | AUXBITS_AATHREAT);
+		now |= threatMap.ground[tile] != 0 ? AUXBITS_THREAT : 0;
+		now |= threatMap.air[tile] != 0 ? AUXBITS_AATHREAT : 0;
+		if ((now & AUXBITS_THREAT) && !(old & AUXBITS_DANGER))
+		{
+			now |= AUXBITS_DANGER;
+			// If this was the way somewhere, that place may be out of reach now.
+			threatMap.refill = threatMap.refill || dangerPassable(aux, block, tile);
+		}
+		aux[tile] = now;
+	}
+	// Tiles that are no longer threatened are safe if they can be reached, and so is whatever they lead to.
+	const int start = dangerStartTile(player);
+	for (int tile : threatMap.changed)
+	{
+		if ((aux[tile] & (AUXBITS_DANGER | AUXBITS_THREAT)) == AUXBITS_DANGER && dangerNextToReachable(aux, block, tile, start))
+		{
+			aux[tile] &= ~AUXBITS_DANGER;
+			if (dangerPassable(aux, block, tile))
 			{
-				threatUpdateTarget(player, (BASE_OBJECT *)psStruct, mode & SHOOT_ON_GROUND, mode & SHOOT_IN_AIR);
+				dangerBucket.push_back(tile);
 			}
 		}
 	}
+	dangerSpread(aux, block, dangerBucket);
+	threatMap.changed.clear();
 }
 
 void mapInit()
 {
-	int player;
-
-	free(floodbucket);
-	floodbucket = (struct floodtile *)malloc(mapWidth * mapHeight * sizeof(*floodbucket));
-
 	lastDangerUpdate = 0;
 	lastDangerPlayer = -1;
+	dangerFillPlayer = -1;
 
-	// Start danger thread (not used for campaign for now - mission map swaps too icky)
-	ASSERT(dangerSemaphore == nullptr && dangerThread == nullptr, "Map data not cleaned up before starting!");
+	// Start danger maps (not used for campaign for now - mission map swaps too icky)
+	ASSERT(!dangerEnabled && dangerJob == nullptr, "Map data not cleaned up before starting!");
 	if (game.type == LEVEL_TYPE::SKIRMISH)
 	{
-		for (player = 0; player < MAX_PLAYERS; player++)
+		threatSources.clear();
+		for (int player = 0; player < MAX_PLAYERS; player++)
+		{
+			threatMaps[player] = ThreatMap();
+		}
+		// Only the players in the game get threat and danger maps, and only they are counted as threatened in threatUpdateSource().
+		for (int player = 0; player < game.maxPlayers; player++)
+		{
+			threatMaps[player].ground.assign(mapWidth * mapHeight, 0);
+			threatMaps[player].air.assign(mapWidth * mapHeight, 0);
+			for (int i = 0; i < mapWidth * mapHeight; ++i)
+			{
+				psAuxMap[player][i] &= ~(AUXBITS_THREAT | AUXBITS_AATHREAT);
+			}
+		}
+		threatUpdate();
+		for (int player = 0; player < game.maxPlayers; player++)
 		{
-			auxMapStore(player, AUX_DANGERMAP);
-			threatUpdate(player);
-			dangerFloodFill(player);
-			auxMapRestore(player, AUX_DANGERMAP, AUXBITS_DANGER | AUXBITS_THREAT | AUXBITS_AATHREAT);
+			dangerUpdate(player);
+			dangerFloodFill(player, psAuxMap[player], psBlockMap[AUX_MAP], dangerBucket);
+			threatMaps[player].refill = false;
 		}
-		lastDangerPlayer = 0;
-		dangerSemaphore = wzSemaphoreCreate(0);
-		dangerDoneSemaphore = wzSemaphoreCreate(0);
-		dangerThread = wzThreadCreate(dangerThreadFunc, nullptr);
-		wzThreadStart(dangerThread);
+		dangerEnabled = true;
 	}
 }
 
@@ -2046,6 +2134,8 @@ void mapUpdate()
 	const uint16_t currentTime = gameTime / GAME_TICKS_PER_UPDATE;
 	int posX, posY;
 
+	mapUpdateHeightCache();  // In case a mission swapped the map.
+
 	for (posY = 0; posY < mapHeight; ++posY)
 		for (posX = 0; posX < mapWidth; ++posX)
 		{
@@ -2060,18 +2150,47 @@ void mapUpdate()
 			}
 		}
 
-	if (gameTime > lastDangerUpdate + GAME_TICKS_FOR_DANGER && game.type == LEVEL_TYPE::SKIRMISH)
+	if (!dangerEnabled)
 	{
-		syncDebug("Do danger maps.");
-		lastDangerUpdate = gameTime;
+		return;
+	}
+
+	if (dangerJob)
+	{
+		// Wait if previous job not done yet
+		wzJobFinish(dangerJob);
+		dangerJob = nullptr;
+		auxMapRestore(dangerFillPlayer, AUX_DANGERMAP, AUXBITS_DANGER);
+		dangerFillPlayer = -1;
+	}
+
+	threatUpdate();
+	for (int player = 0; player < game.maxPlayers; player++)
+	{
+		dangerUpdate(player);
+	}
 
-		// Lock if previous job not done yet
-		wzSemaphoreWait(dangerDoneSemaphore);
+	// One full flood fill every GAME_TICKS_FOR_DANGER, as before, since in a battle some player needs a refill nearly every tick.
+	// It goes to someone who may have been cut off from somewhere, else to the next player, for the buildings and features that came or went.
+	if (gameTime > lastDangerUpdate + GAME_TICKS_FOR_DANGER)
+	{
+		int fillPlayer = (lastDangerPlayer + 1) % game.maxPlayers;
+		for (int i = 1; i <= game.maxPlayers; i++)
+		{
+			const int player = (lastDangerPlayer + i) % game.maxPlayers;
+			if (threatMaps[player].refill)
+			{
+				fillPlayer = player;
+				break;
+			}
+		}
 
-		auxMapRestore(lastDangerPlayer, AUX_DANGERMAP, AUXBITS_THREAT | AUXBITS_AATHREAT | AUXBITS_DANGER);
-		lastDangerPlayer = (lastDangerPlayer + 1) % game.maxPlayers;
-		auxMapStore(lastDangerPlayer, AUX_DANGERMAP);
-		threatUpdate(lastDangerPlayer);
-		wzSemaphorePost(dangerSemaphore);
+		syncDebug("Do danger map %d.", fillPlayer);
+		lastDangerUpdate = gameTime;
+		lastDangerPlayer = fillPlayer;
+		threatMaps[fillPlayer].refill = false;
+		auxMapStore(fillPlayer, AUX_DANGERMAP);
+		dangerFillPlayer = fillPlayer;
+		dangerJob = wzJobStart("danger map", dangerJobFunc);
 	}
 }
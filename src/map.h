@@ -30,6 +30,7 @@
 #include <wzmaplib/terrain_type.h>
 #include "objects.h"
 #include "terrain.h"
+#include "mapheight.h"
 #include "multiplay.h"
 #include "display.h"
 #include "ai.h"
@@ -86,6 +87,9 @@ struct MAPTILE
 /* The size and contents of the map */
 extern SDWORD	mapWidth, mapHeight;
 extern MAPTILE *psMapTiles;
+extern uint32_t mapChangeCount;  ///< Incremented whenever the map, a tile height or the object on a tile changes, for caches of map queries.
+extern TileHeights *psTileHeights;        ///< Corner and centre heights of every tile, for map_Height()
+extern MAPTILE *psTileHeightsTiles;       ///< The psMapTiles that psTileHeights was built for, psTileHeights is only valid if these match
 extern float waterLevel;
 extern GROUND_TYPE *psGroundTypes;
 extern int numGroundTypes;
@@ -434,6 +438,12 @@ static inline WZ_DECL_PURE int32_t map_TileHeightSurface(int32_t x, int32_t y)
 }
 
 
+/// Rebuild psTileHeights if it doesn't belong to the current map; only call from the main thread.
+void mapUpdateHeightCache();
+
+/// Update psTileHeights after the height or water level of the top-left corner of tile x,y changed.
+void mapHeightChanged(int32_t x, int32_t y);
+
 /*sets the tile height */
 static inline void setTileHeight(int32_t x, int32_t y, int32_t height)
 {
@@ -441,6 +451,8 @@ static inline void setTileHeight(int32_t x, int32_t y, int32_t height)
 	ASSERT_OR_RETURN(, y < mapHeight && x >= 0, "y coordinate %d bigger than map height %u", y, mapHeight);
 
 	psMapTiles[x + (y * mapWidth)].height = height;
+	++mapChangeCount;
+	mapHeightChanged(x, y);
 	markTileDirty(x, y);
 }
 
@@ -484,6 +496,23 @@ unsigned map_LineIntersect(Vector3i src, Vector3i dst, unsigned tMax);
 /// The max height of the terrain and water at the specified world coordinates
 int32_t map_Height(int x, int y);
 
+/// map_Height() for world coordinates known to be on the map, without clamping or asserts.
+static inline int32_t map_HeightUnchecked(int32_t x, int32_t y)
+{
+	const int32_t tileX = map_coord(x);
+	const int32_t tileY = map_coord(y);
+	const int32_t onTileX = x - world_coord(tileX);
+	const int32_t onTileY = y - world_coord(tileY);
+
+	if (psTileHeightsTiles == psMapTiles)
+	{
+		return tileHeightAt(psTileHeights[tileX + tileY * mapWidth], onTileX, onTileY);
+	}
+	// Map changed since the last mapUpdateHeightCache(), look the corners up directly.
+	return tileHeightAt(makeTileHeights(map_TileHeightSurface(tileX, tileY), map_TileHeightSurface(tileX + 1, tileY),
+	                                    map_TileHeightSurface(tileX, tileY + 1), map_TileHeightSurface(tileX + 1, tileY + 1)), onTileX, onTileY);
+}
+
 static inline int32_t map_Height(Vector2i const &v)
 {
 	return map_Height(v.x, v.y);
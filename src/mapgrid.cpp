@@ -36,6 +36,18 @@ static PointTree *gridPointTree = nullptr;  // A quad-tree-like object.
 static PointTree::Filter *gridFiltersUnseen;
 static PointTree::Filter *gridFiltersDroidsByPlayer;
 
+#define GRID_BATCH_CELL (TILE_UNITS * 2)  ///< Size of the squares of map sharing a search in gridStartIterateBatched().
+
+/// The objects near a GRID_BATCH_CELL square of map, shared by all gridStartIterateBatched() searches in the square.
+struct GridBatchArea
+{
+	uint32_t generation = 0;  ///< Only valid if equal to gridGeneration.
+	PointTree::Area area;
+};
+static std::vector<GridBatchArea> gridBatchAreas;
+static int gridBatchWidth = 0, gridBatchHeight = 0;
+static uint32_t gridGeneration = 0;  ///< Incremented by gridReset(), since the point tree then changes.
+
 // initialise the grid system
 bool gridInitialise()
 {
@@ -74,6 +86,16 @@ void gridReset()
 
 	gridPointTree->sort();
 
+	++gridGeneration;
+	int batchWidth = (world_coord(mapWidth) + GRID_BATCH_CELL - 1) / GRID_BATCH_CELL;
+	int batchHeight = (world_coord(mapHeight) + GRID_BATCH_CELL - 1) / GRID_BATCH_CELL;
+	if (batchWidth != gridBatchWidth || batchHeight != gridBatchHeight)
+	{
+		gridBatchWidth = batchWidth;
+		gridBatchHeight = batchHeight;
+		gridBatchAreas.assign(batchWidth * batchHeight, GridBatchArea());
+	}
+
 	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
 	{
 		gridFiltersUnseen[player].reset(*gridPointTree);
@@ -90,6 +112,9 @@ void gridShutDown()
 	gridFiltersUnseen = nullptr;
 	delete[] gridFiltersDroidsByPlayer;
 	gridFiltersDroidsByPlayer = nullptr;
+	gridBatchAreas.clear();
+	gridBatchWidth = 0;
+	gridBatchHeight = 0;
 }
 
 static bool isInRadius(int32_t x, int32_t y, uint32_t radius)
@@ -166,6 +191,54 @@ GridList const &gridStartIterate(int32_t x, int32_t y, uint32_t radius)
 	return gridStartIterateFiltered(x, y, radius, nullptr, ConditionTrue());
 }
 
+void gridStartIterate(GridList &gridList, int32_t x, int32_t y, uint32_t radius)
+{
+	thread_local PointTree::ResultVector results;
+	gridPointTree->query(results, x, y, radius);
+	gridList.clear();
+	for (void *point : results)
+	{
+		BASE_OBJECT *obj = static_cast<BASE_OBJECT *>(point);
+		if (isInRadius(obj->pos.x - x, obj->pos.y - y, radius))  // Check that search result is less than radius (since they can be up to a factor of sqrt(2) more).
+		{
+			gridList.push_back(obj);
+		}
+	}
+}
+
+GridList const &gridStartIterateBatched(int32_t x, int32_t y, uint32_t radius)
+{
+	if (radius > GRID_BATCH_RADIUS || x < 0 || y < 0 || x >= gridBatchWidth * GRID_BATCH_CELL || y >= gridBatchHeight * GRID_BATCH_CELL)
+	{
+		return gridStartIterate(x, y, radius);
+	}
+
+	int cellX = x / GRID_BATCH_CELL;
+	int cellY = y / GRID_BATCH_CELL;
+	GridBatchArea &batch = gridBatchAreas[cellX + cellY * gridBatchWidth];
+	if (batch.generation != gridGeneration)
+	{
+		// Everything any search centred in this cell could find.
+		batch.generation = gridGeneration;
+		gridPointTree->queryArea(batch.area, cellX * GRID_BATCH_CELL + GRID_BATCH_CELL / 2, cellY * GRID_BATCH_CELL + GRID_BATCH_CELL / 2, GRID_BATCH_CELL / 2 + GRID_BATCH_RADIUS);
+	}
+
+	static PointTree::ResultVector results;
+	PointTree::query(results, batch.area, x, y, radius);
+
+	static GridList gridList;
+	gridList.clear();
+	for (void *point : results)
+	{
+		BASE_OBJECT *obj = static_cast<BASE_OBJECT *>(point);
+		if (isInRadius(obj->pos.x - x, obj->pos.y - y, radius))  // Check that search result is less than radius (since they can be up to a factor of sqrt(2) more).
+		{
+			gridList.push_back(obj);
+		}
+	}
+	return gridList;
+}
+
 GridList const &gridStartIterateArea(int32_t x, int32_t y, uint32_t x2, uint32_t y2)
 {
 	return gridStartIterateFilteredArea(x, y, x2, y2, ConditionTrue());
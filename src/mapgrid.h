@@ -39,6 +39,14 @@ void gridReset();
 
 /// Find all objects within radius.
 GridList const &gridStartIterate(int32_t x, int32_t y, uint32_t radius);
+/// Find all objects within radius, into gridList. Unlike the other searches, several threads can do this at once, as long as nothing calls gridReset() meanwhile.
+void gridStartIterate(GridList &gridList, int32_t x, int32_t y, uint32_t radius);
+
+#define GRID_BATCH_RADIUS (TILE_UNITS * 4)  ///< Largest search gridStartIterateBatched() can share, larger ones just search the grid.
+
+/// Find all objects within radius, same as gridStartIterate(x, y, radius), for many searches close together such as those for projectiles.
+/// The first search near a spot after gridReset() looks for everything any search nearby could find, later ones only look through that.
+GridList const &gridStartIterateBatched(int32_t x, int32_t y, uint32_t radius);
 
 /// Find all objects within radius.
 GridList const &gridStartIterateArea(int32_t x, int32_t y, uint32_t x2, uint32_t y2);
@@ -0,0 +1,113 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2005-2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file
+ *  The ground height within one tile, as used by map_Height().
+ *  Kept apart from map.h, so that tests can check it without the rest of the game.
+ */
+
+#ifndef __INCLUDED_SRC_MAPHEIGHT_H__
+#define __INCLUDED_SRC_MAPHEIGHT_H__
+
+#include <stdint.h>
+#include <wzmaplib/map.h>
+
+/// The corner and centre heights of a tile, cached by map.cpp so map_Height() doesn't have to look them up every time.
+struct TileHeights
+{
+	int32_t height[2][2];  ///< max(ground, water) height of the corners, indexed [x][y]
+	int32_t center;        ///< Average of the corners
+};
+
+static inline TileHeights makeTileHeights(int32_t topLeft, int32_t topRight, int32_t bottomLeft, int32_t bottomRight)
+{
+	TileHeights tile;
+	tile.height[0][0] = topLeft;
+	tile.height[1][0] = topRight;
+	tile.height[0][1] = bottomLeft;
+	tile.height[1][1] = bottomRight;
+	tile.center = (topLeft + topRight + bottomLeft + bottomRight) / 4;
+	return tile;
+}
+
+/// Height at (onTileX, onTileY) within a tile, each 0 to TILE_UNITS - 1.
+static inline int32_t tileHeightAt(TileHeights const &tile, int32_t onTileX, int32_t onTileY)
+{
+	int32_t left, right;
+	int towardsCenter, towardsRight;
+
+	// we have:
+	//   x ->
+	// y 0,0--D--1,0
+	// | |  \    / |
+	// V A  centre C
+	//   | /     \ |
+	//   0,1--B--1,1
+
+	// get heights for left and right corners and the distances
+	if (onTileY > onTileX)
+	{
+		if (onTileY < TILE_UNITS - onTileX)
+		{
+			// A
+			right = tile.height[0][0];
+			left  = tile.height[0][1];
+			towardsCenter = onTileX;
+			towardsRight  = TILE_UNITS - onTileY;
+		}
+		else
+		{
+			// B
+			right = tile.height[0][1];
+			left  = tile.height[1][1];
+			towardsCenter = TILE_UNITS - onTileY;
+			towardsRight  = TILE_UNITS - onTileX;
+		}
+	}
+	else
+	{
+		if (onTileX > TILE_UNITS - onTileY)
+		{
+			// C
+			right = tile.height[1][1];
+			left  = tile.height[1][0];
+			towardsCenter = TILE_UNITS - onTileX;
+			towardsRight  = onTileY;
+		}
+		else
+		{
+			// D
+			right = tile.height[1][0];
+			left  = tile.height[0][0];
+			towardsCenter = onTileY;
+			towardsRight  = onTileX;
+		}
+	}
+
+	// now we have:
+	//    left   m    right
+	//         center
+
+	int32_t middle = (left + right) / 2;
+	int32_t onBottom = left * (TILE_UNITS - towardsRight) + right * towardsRight;
+	int32_t result = onBottom + (tile.center - middle) * towardsCenter * 2;
+
+	return (result + TILE_UNITS / 2) / TILE_UNITS;
+}
+
+#endif // __INCLUDED_SRC_MAPHEIGHT_H__
@@ -1323,7 +1323,9 @@ void swapMissionPointers()
 {
 	debug(LOG_SAVE, "called");
 
+	visUpdatePendingTiles();  // Requested for the map being swapped out.
 	std::swap(psMapTiles, mission.psMapTiles);
+	++mapChangeCount;
 	std::swap(mapWidth,   mission.mapWidth);
 	std::swap(mapHeight,  mission.mapHeight);
 	for (int i = 0; i < ARRAY_SIZE(mission.psBlockMap); ++i)
@@ -27,6 +27,7 @@
 
 #include "lib/framework/trig.h"
 #include "lib/framework/math_ext.h"
+#include "lib/framework/wzjobs.h"
 #include "lib/gamelib/gtime.h"
 #include "lib/netplay/netplay.h"
 #include "lib/sound/audio.h"
@@ -39,6 +40,7 @@
 #include "objects.h"
 #include "visibility.h"
 #include "map.h"
+#include "raycast.h"
 #include "fpath.h"
 #include "loop.h"
 #include "geometry.h"
@@ -56,6 +58,8 @@
 #include "mission.h"
 #include "qtscript.h"
 
+#include <unordered_map>
+
 /* max and min vtol heights above terrain */
 #define	VTOL_HEIGHT_MIN				250
 #define	VTOL_HEIGHT_LEVEL			300
@@ -100,8 +104,28 @@
 #define EXTRA_PRECISION                         (1 << EXTRA_BITS)
 
 
+/// A droid to steer around, as seen by moveFindObstacles().
+struct MoveObstacle
+{
+	Vector2i diff;  ///< Guessed position of the obstacle relative to us when we get close.
+	int totalRadius;
+};
+
+/// The obstacles near a droid, found by moveFindObstacles() for moveGetObstacleVector() to steer around.
+struct MoveObstacleList
+{
+	DROID *psDroid;
+	std::vector<MoveObstacle> obstacles;
+	GridList gridList;  ///< Kept between ticks to reuse the memory.
+};
+static std::vector<MoveObstacleList> moveObstacleLists;
+static size_t numMoveObstacleLists = 0;  ///< Entries of moveObstacleLists in use this tick.
+static uint32_t moveObstacleTime = 0;    ///< gameTime the lists were made at, they are only used during that tick.
+static std::unordered_map<uint32_t, size_t> moveObstacleIndex;  ///< Index into moveObstacleLists by droid id.
+
 /* Function prototypes */
 static void	moveUpdatePersonModel(DROID *psDroid, SDWORD speed, uint16_t direction);
+static void moveFindDroidObstacles(DROID *psDroid, GridList &gridList, std::vector<MoveObstacle> &obstacles);
 
 const char *moveDescription(MOVE_STATUS status)
 {
@@ -440,9 +464,8 @@ struct BLOCKING_CALLBACK_DATA
 	Vector2i dst;
 };
 
-static bool moveBlockingTileCallback(Vector2i pos, int32_t dist, void *data_)
+static inline bool moveBlockingTileCallback(Vector2i pos, BLOCKING_CALLBACK_DATA *data)
 {
-	BLOCKING_CALLBACK_DATA *data = (BLOCKING_CALLBACK_DATA *)data_;
 	data->blocking |= pos != data->src && pos != data->dst && fpathBlockingTile(map_coord(pos.x), map_coord(pos.y), data->propulsionType);
 	return !data->blocking;
 }
@@ -459,7 +482,9 @@ static int32_t moveDirectPathToWaypoint(DROID *psDroid, unsigned positionIndex)
 	data.blocking = false;
 	data.src = src;
 	data.dst = dst;
-	rayCast(src, dst, &moveBlockingTileCallback, &data);
+	rayCast(src, dst, [&data](Vector2i pos, int32_t) {
+		return moveBlockingTileCallback(pos, &data);
+	});
 	return data.blocking ? -1 - dist : dist;
 }
 
@@ -699,6 +724,32 @@ static bool moveBlocked(DROID *psDroid)
 }
 
 
+// Same as moveBlocked(), but only looks, so that other droids can ask, even from the job pool
+static bool moveLooksBlocked(DROID const *psDroid)
+{
+	if (psDroid->sMove.bumpTime == 0 || psDroid->sMove.bumpTime > gameTime)
+	{
+		return false;
+	}
+	if (abs(angleDelta(psDroid->rot.direction - psDroid->sMove.bumpDir)) > DEG(BLOCK_DIR))
+	{
+		return false;
+	}
+	SDWORD xdiff = (SDWORD)psDroid->pos.x - (SDWORD)psDroid->sMove.bumpPos.x;
+	SDWORD ydiff = (SDWORD)psDroid->pos.y - (SDWORD)psDroid->sMove.bumpPos.y;
+	if (xdiff * xdiff + ydiff * ydiff > BLOCK_DIST * BLOCK_DIST)
+	{
+		return false;
+	}
+	UDWORD blockTime = psDroid->sMove.Status == MOVESHUFFLE ? SHUFFLE_BLOCK_TIME : BLOCK_TIME;
+	if (gameTime - psDroid->sMove.bumpTime > blockTime)
+	{
+		// moveBlocked() reroutes instead, if it can.
+		return !((bMultiPlayer || psDroid->player == selectedPlayer || psDroid->lastFrustratedTime == gameTime) && psDroid->sMove.pathIndex != (int)psDroid->sMove.asPath.size());
+	}
+	return false;
+}
+
 // Calculate the actual movement to slide around
 static void moveCalcSlideVector(DROID *psDroid, int32_t objX, int32_t objY, int32_t *pMx, int32_t *pMy)
 {
@@ -1147,24 +1198,22 @@ static void moveCalcDroidSlide(DROID *psDroid, int *pmx, int *pmy)
 	CHECK_DROID(psDroid);
 }
 
-// get an obstacle avoidance vector
-static Vector2i moveGetObstacleVector(DROID *psDroid, Vector2i dest)
+// Find the droids a droid should steer around, and where they will probably be when we get close.
+// Only reads the game state, so this may run on the job pool.
+static void moveFindDroidObstacles(DROID *psDroid, GridList &gridList, std::vector<MoveObstacle> &obstacles)
 {
-	int32_t                 numObst = 0, distTot = 0;
-	Vector2i                dir(0, 0);
-	PROPULSION_STATS       *psPropStats = asPropulsionStats + psDroid->asBits[COMP_PROPULSION];
-	ASSERT_OR_RETURN(dir, psPropStats, "invalid propulsion stats pointer");
+	obstacles.clear();
 
+	PROPULSION_STATS       *psPropStats = asPropulsionStats + psDroid->asBits[COMP_PROPULSION];
 	int ourMaxSpeed = psPropStats->maxSpeed;
 	int ourRadius = moveObjRadius(psDroid);
 	if (ourMaxSpeed == 0)
 	{
-		return dest;  // No point deciding which way to go, if we can't move...
+		return;  // No point deciding which way to go, if we can't move...
 	}
 
 	// scan the neighbours for obstacles
-	static GridList gridList;  // static to avoid allocations.
-	gridList = gridStartIterate(psDroid->pos.x, psDroid->pos.y, AVOID_DIST);
+	gridStartIterate(gridList, psDroid->pos.x, psDroid->pos.y, AVOID_DIST);
 	for (GridIterator gi = gridList.begin(); gi != gridList.end(); ++gi)
 	{
 		if (*gi == psDroid)
@@ -1204,7 +1253,7 @@ static Vector2i moveGetObstacleVector(DROID *psDroid, Vector2i dest)
 		// Velocity guess 2: Guess the velocity the droid wants to move at.
 		Vector2i obstTargetDiff = psObstacle->sMove.target - psObstacle->pos.xy();
 		Vector2i obstVelocityGuess2 = iSinCosR(iAtan2(obstTargetDiff), obstacleMaxSpeed * std::min(iHypot(obstTargetDiff), AVOID_DIST) / AVOID_DIST);
-		if (moveBlocked(psObstacle))
+		if (moveLooksBlocked(psObstacle))
 		{
 			obstVelocityGuess2 = Vector2i(0, 0);  // This obstacle isn't going anywhere, even if it wants to.
 			//obstVelocityGuess2 = -obstVelocityGuess2;
@@ -1226,16 +1275,55 @@ static Vector2i moveGetObstacleVector(DROID *psDroid, Vector2i dest)
 			diff += deltaDiff;
 		}
 
-		if (dot(diff, dest) < 0)
+		obstacles.push_back({diff, totalRadius});
+	}
+}
+
+// get an obstacle avoidance vector
+static Vector2i moveGetObstacleVector(DROID *psDroid, Vector2i dest)
+{
+	int32_t                 numObst = 0, distTot = 0;
+	Vector2i                dir(0, 0);
+	PROPULSION_STATS       *psPropStats = asPropulsionStats + psDroid->asBits[COMP_PROPULSION];
+	ASSERT_OR_RETURN(dir, psPropStats, "invalid propulsion stats pointer");
+
+	int ourMaxSpeed = psPropStats->maxSpeed;
+	int ourRadius = moveObjRadius(psDroid);
+	if (ourMaxSpeed == 0)
+	{
+		return dest;  // No point deciding which way to go, if we can't move...
+	}
+
+	// Use the obstacles moveFindObstacles() found at the start of the tick, if it looked for this droid.
+	std::vector<MoveObstacle> const *obstacles = nullptr;
+	if (moveObstacleTime == gameTime)
+	{
+		auto i = moveObstacleIndex.find(psDroid->id);
+		if (i != moveObstacleIndex.end() && moveObstacleLists[i->second].psDroid == psDroid)
+		{
+			obstacles = &moveObstacleLists[i->second].obstacles;
+		}
+	}
+	if (obstacles == nullptr)
+	{
+		static GridList gridList;  // static to avoid allocations.
+		static std::vector<MoveObstacle> liveObstacles;
+		moveFindDroidObstacles(psDroid, gridList, liveObstacles);
+		obstacles = &liveObstacles;
+	}
+
+	for (MoveObstacle const &obstacle : *obstacles)
+	{
+		if (dot(obstacle.diff, dest) < 0)
 		{
 			// object behind
 			continue;
 		}
 
-		int centreDist = std::max(iHypot(diff), 1);
-		int dist = std::max(centreDist - totalRadius, 1);
+		int centreDist = std::max(iHypot(obstacle.diff), 1);
+		int dist = std::max(centreDist - obstacle.totalRadius, 1);
 
-		dir += diff * 65536 / (centreDist * dist);
+		dir += obstacle.diff * 65536 / (centreDist * dist);
 		distTot += 65536 / dist;
 		numObst += 1;
 	}
@@ -2259,7 +2347,7 @@ void moveUpdateDroid(DROID *psDroid)
 	if (map_coord(oldx) != map_coord(psDroid->pos.x)
 	    || map_coord(oldy) != map_coord(psDroid->pos.y))
 	{
-		visTilesUpdate((BASE_OBJECT *)psDroid);
+		visTilesUpdateLater((BASE_OBJECT *)psDroid);
 
 		// object moved from one tile to next, check to see if droid is near stuff.(oil)
 		checkLocalFeatures(psDroid);
@@ -2318,3 +2406,65 @@ void moveUpdateDroid(DROID *psDroid)
 	ASSERT(droidOnMap(psDroid), "%s moved off map (%u, %u)->(%u, %u)", droidGetName(psDroid), oldx, oldy, (UDWORD)psDroid->pos.x, (UDWORD)psDroid->pos.y);
 	CHECK_DROID(psDroid);
 }
+
+static void findObstacleList(MoveObstacleList &list)
+{
+	moveFindDroidObstacles(list.psDroid, list.gridList, list.obstacles);
+}
+
+void moveShutdown()
+{
+	moveObstacleLists.clear();
+	moveObstacleIndex.clear();
+	numMoveObstacleLists = 0;
+}
+
+/* Find the obstacles around every droid that will steer this tick, spread over the job pool and this thread.
+ * Nothing moves here, the droids still move one at a time in droidUpdate(), so every client gets the same result. */
+void moveFindObstacles()
+{
+	numMoveObstacleLists = 0;
+	moveObstacleIndex.clear();
+	moveObstacleTime = gameTime;
+
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		for (DROID *psDroid = apsDroidLists[player]; psDroid != nullptr; psDroid = psDroid->psNext)
+		{
+			// Only the droids moveUpdateDroid() will call moveGetDirection() for.
+			switch (psDroid->sMove.Status)
+			{
+			case MOVESHUFFLE:
+			case MOVEWAITROUTE:
+			case MOVENAVIGATE:
+			case MOVEPOINTTOPOINT:
+			case MOVEPAUSE:
+				break;
+			default:
+				continue;
+			}
+			if (psDroid->died || isTransporter(psDroid)
+			    || (psDroid->lastHitWeapon == WSC_EMP && gameTime - psDroid->timeLastHit < EMP_DISABLE_TIME))
+			{
+				continue;
+			}
+
+			if (numMoveObstacleLists == moveObstacleLists.size())
+			{
+				moveObstacleLists.emplace_back();
+			}
+			moveObstacleLists[numMoveObstacleLists].psDroid = psDroid;
+			moveObstacleIndex[psDroid->id] = numMoveObstacleLists;
+			++numMoveObstacleLists;
+		}
+	}
+
+	const size_t count = numMoveObstacleLists;
+	if (count == 0)
+	{
+		return;
+	}
+	wzParallelFor("move obstacles", count, [](size_t i) {
+		findObstacleList(moveObstacleLists[i]);
+	});
+}
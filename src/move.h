@@ -46,6 +46,12 @@ void moveStopDroid(DROID *psDroid);
 /*Stops a droid dead in its tracks - doesn't allow for any little skidding bits*/
 void moveReallyStopDroid(DROID *psDroid);
 
+/// Free the obstacle lists moveFindObstacles() keeps between ticks
+void moveShutdown();
+
+/// Find the obstacles every moving droid will steer around this tick, in parallel, before any of them move.
+void moveFindObstacles();
+
 /* Get a droid to do a frame's worth of moving */
 void moveUpdateDroid(DROID *psDroid);
 
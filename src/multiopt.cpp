@@ -220,7 +220,8 @@ void recvOptions(NETQUEUE queue)
 	}
 
 	bool haveData = true;
-	auto requestFile = [&haveData](Sha256 &hash, char const *filename) {
+	bool copiedData = false;
+	auto requestFile = [&haveData, &copiedData](Sha256 &hash, char const *filename) {
 		if (std::any_of(NetPlay.wzFiles.begin(), NetPlay.wzFiles.end(), [&hash](WZFile const &file) { return file.hash == hash; }))
 		{
 			debug(LOG_INFO, "Already requested file, continue waiting.");
@@ -228,34 +229,46 @@ void recvOptions(NETQUEUE queue)
 			return false;  // Downloading the file already
 		}
 
-		if (!PHYSFS_exists(filename))
+		if (PHYSFS_exists(filename) && findHashOfFile(filename) == hash)
 		{
-			debug(LOG_INFO, "Creating new file %s", filename);
+			pal_Init(); // Palette could be modded.
+			return false;  // Have the file already.
 		}
-		else if (findHashOfFile(filename) != hash)
+
+		std::string const knownFile = findFileWithHash(hash);
+		if (!knownFile.empty())
 		{
-			debug(LOG_INFO, "Overwriting old incomplete or corrupt file %s", filename);
+			// Downloaded or loaded before, under another name.
+			char *fileData = nullptr;
+			uint32_t fileSize = 0;
+			if (loadFile(knownFile.c_str(), &fileData, &fileSize))
+			{
+				bool saved = saveFile(filename, fileData, fileSize);
+				free(fileData);
+				if (saved)
+				{
+					debug(LOG_INFO, "Copied %s from %s instead of downloading it", filename, knownFile.c_str());
+					copiedData = true;
+					pal_Init(); // Palette could be modded.
+					return false;  // Have the file now.
+				}
+			}
+		}
+
+		if (!PHYSFS_exists(filename))
+		{
+			debug(LOG_INFO, "Creating new file %s", filename);
 		}
 		else
 		{
-			pal_Init(); // Palette could be modded.
-			return false;  // Have the file already.
+			debug(LOG_INFO, "Resuming or overwriting old incomplete or corrupt file %s", filename);
 		}
 
-		PHYSFS_file *pFileHandle = PHYSFS_openWrite(filename);
-		if (pFileHandle == nullptr)
+		if (!NETrequestFile(hash, filename))
 		{
-			debug(LOG_ERROR, "Failed to open %s for writing: %s", filename, WZ_PHYSFS_getLastError());
 			return false;
 		}
 
-		NetPlay.wzFiles.emplace_back(pFileHandle, filename, hash);
-
-		// Request the map/mod from the host
-		NETbeginEncode(NETnetQueue(NET_HOST_ONLY), NET_FILE_REQUESTED);
-		NETbin(hash.bytes, hash.Bytes);
-		NETend();
-
 		haveData = false;
 		return true;  // Starting download now.
 	};
@@ -282,8 +295,20 @@ void recvOptions(NETQUEUE queue)
 		}
 		else
 		{
-			debug(LOG_FATAL, "Can't load map %s, even though we downloaded %s", game.map, filename);
-			abort();
+			if (copiedData)
+			{
+				// We had the map under another name, so load the copy.
+				levShutDown();
+				levInitialise();
+				rebuildSearchPath(mod_multiplay, true);
+				buildMapList();
+				mapData = levFindDataSet(game.map, &game.hash);
+			}
+			if (mapData == nullptr)
+			{
+				debug(LOG_FATAL, "Can't load map %s, even though we downloaded %s", game.map, filename);
+				abort();
+			}
 		}
 	}
 
@@ -1320,8 +1320,12 @@ bool recvMapFileRequested(NETQUEUE queue)
 
 	Sha256 hash;
 	hash.setZero();
+	uint32_t resumePos = 0;  // Older clients don't send these, and always want the whole file.
+	uint32_t resumeCrc = 0;
 	NETbeginDecode(queue, NET_FILE_REQUESTED);
 	NETbin(hash.bytes, hash.Bytes);
+	NETuint32_t(&resumePos);
+	NETuint32_t(&resumeCrc);
 	NETend();
 
 	auto &files = NetPlay.players[player].wzFiles;
@@ -1374,52 +1378,73 @@ bool recvMapFileRequested(NETQUEUE queue)
 	uint32_t fileSize_u32 = (uint32_t)fileSize_64;
 	ASSERT_OR_RETURN(false, fileSize_u32 <= MAX_NET_TRANSFERRABLE_FILE_SIZE, "Filesize is too large; (size: %" PRIu32")", fileSize_u32);
 
+	// Continue where an interrupted download stopped, if what the client has matches the start of our file.
+	uint32_t startPos = 0;
+	uint32_t crc = 0;
+	if (resumePos != 0 && resumePos < fileSize_u32 && NETfilePrefixCrc(pFileHandle, resumePos, &crc) && crc == resumeCrc)
+	{
+		startPos = resumePos;
+	}
+	else if (PHYSFS_seek(pFileHandle, 0) == 0)
+	{
+		debug(LOG_ERROR, "Failed to seek in %s: %s", filename.c_str(), WZ_PHYSFS_getLastError());
+		PHYSFS_close(pFileHandle);
+		return false;
+	}
+
 	// Schedule file to be sent.
-	debug(LOG_INFO, "File is valid, sending [directory: %s] %s to client %u", WZ_PHYSFS_getRealDir_String(filename.c_str()).c_str(), filename.c_str(), player);
+	debug(LOG_INFO, "File is valid, sending [directory: %s] %s to client %u from byte %" PRIu32, WZ_PHYSFS_getRealDir_String(filename.c_str()).c_str(), filename.c_str(), player, startPos);
 	files.emplace_back(pFileHandle, filename, hash, fileSize_u32);
+	files.back().pos = startPos;
 
 	return true;
 }
 
-// Continue sending maps and mods.
+// Continue sending maps and mods, a chunk to each file in turn, so that all joining players download at the same time.
 void sendMap()
 {
 	// maximum "budget" in time per call to sendMap
 	// (at 60fps, total frame budget is ~16ms - allocate 4ms max for each call to sendMap)
 	const uint64_t maxMicroSecondsPerSendMapCall = (4 * 1000);
-
-	// calculate the time budget per file
-	uint64_t totalFilesToSend = 0;
-	for (int i = 0; i < MAX_PLAYERS; ++i)
-	{
-		totalFilesToSend += NetPlay.players[i].wzFiles.size();
-	}
-	const uint64_t maxMicroSecondsPerFile = maxMicroSecondsPerSendMapCall / std::max((uint64_t)1, totalFilesToSend);
+	const uint64_t maxBytesPerSecond = MAP_UPLOAD_BYTES_PER_SECOND;
+	static uint64_t byteBudget = 0;
+	static auto lastBudgetTime = std::chrono::steady_clock::now();
 
 	using microDuration = std::chrono::duration<uint64_t, std::micro>;
-	auto file_startTime = std::chrono::high_resolution_clock::now();
-	microDuration file_currentDuration;
+	auto startTime = std::chrono::steady_clock::now();
+	uint64_t elapsedMicroSeconds = std::chrono::duration_cast<microDuration>(startTime - lastBudgetTime).count();
+	lastBudgetTime = startTime;
+	byteBudget = std::min(byteBudget + elapsedMicroSeconds * maxBytesPerSecond / 1000000, maxBytesPerSecond / 4);  // Don't save up more than a quarter second.
 
-	for (int i = 0; i < MAX_PLAYERS; ++i)
+	bool sentChunk = true;
+	while (sentChunk && byteBudget > 0 && std::chrono::duration_cast<microDuration>(std::chrono::steady_clock::now() - startTime).count() < maxMicroSecondsPerSendMapCall)
 	{
-		auto &files = NetPlay.players[i].wzFiles;
-		for (auto &file : files)
+		sentChunk = false;
+		for (int i = 0; i < MAX_PLAYERS && byteBudget > 0; ++i)
 		{
-			int done = 0;
-			file_startTime = std::chrono::high_resolution_clock::now();
-			do
+			for (auto &file : NetPlay.players[i].wzFiles)
 			{
-				done = NETsendFile(file, i);
-				file_currentDuration = std::chrono::duration_cast<microDuration>(std::chrono::high_resolution_clock::now() - file_startTime);
-			}
-			while (done < 100 && (file_currentDuration.count() < maxMicroSecondsPerFile));
-			if (done == 100)
-			{
-				netPlayersUpdated = true;  // Remove download icon from player.
-				addConsoleMessage(_("FILE SENT!"), DEFAULT_JUSTIFY, SYSTEM_MESSAGE);
-				debug(LOG_INFO, "=== File has been sent to player %d ===", i);
+				if (file.handle == nullptr || byteBudget == 0)
+				{
+					continue;
+				}
+				uint32_t oldPos = file.pos;
+				int done = NETsendFile(file, i);
+				byteBudget -= std::min<uint64_t>(byteBudget, file.pos - oldPos);
+				sentChunk = true;
+				if (done == 100)
+				{
+					netPlayersUpdated = true;  // Remove download icon from player.
+					addConsoleMessage(_("FILE SENT!"), DEFAULT_JUSTIFY, SYSTEM_MESSAGE);
+					debug(LOG_INFO, "=== File has been sent to player %d ===", i);
+				}
 			}
 		}
+	}
+
+	for (int i = 0; i < MAX_PLAYERS; ++i)
+	{
+		auto &files = NetPlay.players[i].wzFiles;
 		files.erase(std::remove_if(files.begin(), files.end(), [](WZFile const &file) { return file.handle == nullptr; }), files.end());
 	}
 }
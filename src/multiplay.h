@@ -164,6 +164,7 @@ extern UBYTE bDisplayMultiJoiningStatus;	// draw load progress?
 #define CAMP_WALLS				2
 
 #define PING_LIMIT				4000		// If ping is bigger than this, then worry and panic, and don't even try showing the ping.
+#define MAP_UPLOAD_BYTES_PER_SECOND	(2 * 1024 * 1024)	// Upload rate shared by all map and mod downloads from this host, so the lobby stays responsive.
 
 #define LEV_LOW					0
 #define LEV_MED					1
@@ -129,7 +129,7 @@ static unsigned current(std::vector<unsigned> &filterData, unsigned i)
 }
 
 template<bool IsFiltered>
-PointTree::ResultVector &PointTree::queryMaybeFilter(Filter &filter, int32_t minXo, int32_t minYo, int32_t maxXo, int32_t maxYo)
+void PointTree::queryMaybeFilter(ResultVector &results, IndexVector *indices, Filter &filter, int32_t minXo, int32_t minYo, int32_t maxXo, int32_t maxYo) const
 {
 	uint64_t minX = expandX(minXo);
 	uint64_t maxX = expandX(maxXo);
@@ -225,10 +225,10 @@ PointTree::ResultVector &PointTree::queryMaybeFilter(Filter &filter, int32_t min
 		--numRanges;
 	}
 
-	lastQueryResults.clear();
-	if (IsFiltered)
+	results.clear();
+	if (indices != nullptr)
 	{
-		lastFilteredQueryIndices.clear();
+		indices->clear();
 	}
 	for (int r = 0; r != numRanges; ++r)
 	{
@@ -242,10 +242,10 @@ PointTree::ResultVector &PointTree::queryMaybeFilter(Filter &filter, int32_t min
 			uint64_t py = points[i].first & 0x5555555555555555ULL;
 			if (px >= minX && px <= maxX && py >= minY && py <= maxY)  // Only add point if it's at least in the desired square.
 			{
-				lastQueryResults.push_back(points[i].second);
-				if (IsFiltered)
+				results.push_back(points[i].second);
+				if (indices != nullptr)
 				{
-					lastFilteredQueryIndices.push_back(i);
+					indices->push_back(i);
 				}
 #ifdef DUMP_IMAGE
 				if (doDump)
@@ -266,14 +266,13 @@ PointTree::ResultVector &PointTree::queryMaybeFilter(Filter &filter, int32_t min
 		fclose(f);
 	}
 #endif //DUMP_IMAGE
-
-	return lastQueryResults;
 }
 
 PointTree::ResultVector &PointTree::query(int32_t x, int32_t y, uint32_t x2, uint32_t y2)
 {
 	Filter unused;
-	return queryMaybeFilter<false>(unused, x, y, x2, y2);
+	queryMaybeFilter<false>(lastQueryResults, nullptr, unused, x, y, x2, y2);
+	return lastQueryResults;
 }
 
 PointTree::ResultVector &PointTree::query(int32_t x, int32_t y, uint32_t radius)
@@ -283,7 +282,8 @@ PointTree::ResultVector &PointTree::query(int32_t x, int32_t y, uint32_t radius)
 	int32_t maxXo = x + radius;
 	int32_t minYo = y - radius;
 	int32_t maxYo = y + radius;
-	return queryMaybeFilter<false>(unused, minXo, minYo, maxXo, maxYo);
+	queryMaybeFilter<false>(lastQueryResults, nullptr, unused, minXo, minYo, maxXo, maxYo);
+	return lastQueryResults;
 }
 
 PointTree::ResultVector &PointTree::query(Filter &filter, int32_t x, int32_t y, uint32_t radius)
@@ -292,5 +292,55 @@ PointTree::ResultVector &PointTree::query(Filter &filter, int32_t x, int32_t y,
 	int32_t maxXo = x + radius;
 	int32_t minYo = y - radius;
 	int32_t maxYo = y + radius;
-	return queryMaybeFilter<true>(filter, minXo, minYo, maxXo, maxYo);
+	queryMaybeFilter<true>(lastQueryResults, &lastFilteredQueryIndices, filter, minXo, minYo, maxXo, maxYo);
+	return lastQueryResults;
+}
+
+void PointTree::query(ResultVector &results, int32_t x, int32_t y, uint32_t radius) const
+{
+	Filter unused;
+	int32_t minXo = x - radius;
+	int32_t maxXo = x + radius;
+	int32_t minYo = y - radius;
+	int32_t maxYo = y + radius;
+	queryMaybeFilter<false>(results, nullptr, unused, minXo, minYo, maxXo, maxYo);
+}
+
+void PointTree::queryArea(Area &area, int32_t x, int32_t y, uint32_t radius)
+{
+	Filter unused;
+	int32_t minXo = x - radius;
+	int32_t maxXo = x + radius;
+	int32_t minYo = y - radius;
+	int32_t maxYo = y + radius;
+	queryMaybeFilter<false>(lastQueryResults, &lastFilteredQueryIndices, unused, minXo, minYo, maxXo, maxYo);
+	area.clear();
+	for (unsigned i : lastFilteredQueryIndices)
+	{
+		area.push_back(points[i]);
+	}
+}
+
+void PointTree::query(ResultVector &results, Area const &area, int32_t x, int32_t y, uint32_t radius)
+{
+	int32_t minXo = x - radius;
+	int32_t maxXo = x + radius;
+	int32_t minYo = y - radius;
+	int32_t maxYo = y + radius;
+	uint64_t minX = expandX(minXo);
+	uint64_t maxX = expandX(maxXo);
+	uint64_t minY = expandY(minYo);
+	uint64_t maxY = expandY(maxYo);
+
+	// The points in area are in the same order as in the whole PointTree, so this gives the same results in the same order as searching the whole tree.
+	results.clear();
+	for (Point const &point : area)
+	{
+		uint64_t px = point.first & 0xAAAAAAAAAAAAAAAAULL;
+		uint64_t py = point.first & 0x5555555555555555ULL;
+		if (px >= minX && px <= maxX && py >= minY && py <= maxY)
+		{
+			results.push_back(point.second);
+		}
+	}
 }
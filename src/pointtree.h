@@ -30,6 +30,7 @@ class PointTree
 public:
 	typedef std::vector<void *> ResultVector;
 	typedef std::vector<unsigned> IndexVector;
+	typedef std::vector<std::pair<uint64_t, void *>> Area;  ///< Points found by queryArea(), which can be searched again without searching the whole PointTree.
 	class Filter  ///< Filters are invalidated when modifying the PointTree.
 	{
 	public:
@@ -65,6 +66,12 @@ public:
 	ResultVector &query(Filter &filter, int32_t x, int32_t y, uint32_t radius);
 	/// Returns all points which have not been filtered away within given rectangle. See function above on thread safety.
 	ResultVector &query(int32_t x, int32_t y, uint32_t x2, uint32_t y2);
+	/// Same as query(x, y, radius), but into results instead of lastQueryResults, so several threads can query at once as long as nobody modifies the PointTree.
+	void query(ResultVector &results, int32_t x, int32_t y, uint32_t radius) const;
+	/// Finds all points in a square with edge length 2*radius, to search through again with the function below. Not thread safe, like query().
+	void queryArea(Area &area, int32_t x, int32_t y, uint32_t radius);
+	/// Same as query(results, x, y, radius), but only looks through area, which must have been found with queryArea() using a square containing this one.
+	static void query(ResultVector &results, Area const &area, int32_t x, int32_t y, uint32_t radius);
 
 	ResultVector lastQueryResults;
 	IndexVector lastFilteredQueryIndices;
@@ -74,7 +81,7 @@ private:
 	typedef std::vector<Point> Vector;
 
 	template<bool IsFiltered>
-	ResultVector &queryMaybeFilter(Filter &filter, int32_t minXo, int32_t maxXo, int32_t minYo, int32_t maxYo);
+	void queryMaybeFilter(ResultVector &results, IndexVector *indices, Filter &filter, int32_t minXo, int32_t maxXo, int32_t minYo, int32_t maxYo) const;
 
 	Vector points;
 };
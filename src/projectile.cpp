@@ -802,7 +802,7 @@ static void proj_InFlightFunc(PROJECTILE *psProj)
 
 	/* Check nearby objects for possible collisions */
 	static GridList gridList;  // static to avoid allocations.
-	gridList = gridStartIterate(psProj->pos.x, psProj->pos.y, PROJ_NEIGHBOUR_RANGE);
+	gridList = gridStartIterateBatched(psProj->pos.x, psProj->pos.y, PROJ_NEIGHBOUR_RANGE);
 	for (GridIterator gi = gridList.begin(); gi != gridList.end(); ++gi)
 	{
 		BASE_OBJECT *psTempObj = *gi;
@@ -1180,7 +1180,7 @@ static void proj_ImpactFunc(PROJECTILE *psObj)
 		Vector3i targetPos = (destDroid != nullptr) ? destDroid->pos : psObj->pos;
 
 		static GridList gridList;  // static to avoid allocations.
-		gridList = gridStartIterate(targetPos.x, targetPos.y, psStats->upgrade[psObj->player].radius);
+		gridList = gridStartIterateBatched(targetPos.x, targetPos.y, psStats->upgrade[psObj->player].radius);
 
 		for (GridIterator gi = gridList.begin(); gi != gridList.end(); ++gi)
 		{
@@ -1381,7 +1381,7 @@ static void proj_checkPeriodicalDamage(PROJECTILE *psProj)
 	WEAPON_STATS *psStats = psProj->psWStats;
 
 	static GridList gridList;  // static to avoid allocations.
-	gridList = gridStartIterate(psProj->pos.x, psProj->pos.y, psStats->upgrade[psProj->player].periodicalDamageRadius);
+	gridList = gridStartIterateBatched(psProj->pos.x, psProj->pos.y, psStats->upgrade[psProj->player].periodicalDamageRadius);
 	for (GridIterator gi = gridList.begin(); gi != gridList.end(); ++gi)
 	{
 		BASE_OBJECT *psCurr = *gi;
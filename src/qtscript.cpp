@@ -51,6 +51,7 @@
 #include "multiplay.h"
 #include "levels.h"
 #include "map.h"
+#include "terrain.h"
 #include "difficulty.h"
 #include "console.h"
 #include "clparse.h"
@@ -1703,6 +1704,7 @@ void clearMarks()
 			psTile->tileInfoBits &= ~BITS_MARKED;
 		}
 	}
+	markLightmapDirty();
 }
 
 void scripting_engine::markAllLabels(bool only_active)
@@ -1807,6 +1809,7 @@ void scripting_engine::showLabel(const std::string &key, bool clear_old, bool ju
 			}
 		}
 	}
+	markLightmapDirty();
 }
 
 // The bool return value is true when an object callback needs to be called.
@@ -2709,6 +2712,7 @@ wzapi::no_return_value scripting_engine::hackMarkTiles_ByLabel(WZAPI_PARAMS(cons
 		}
 	}
 
+	markLightmapDirty();
 	return {};
 }
 
@@ -117,6 +117,18 @@ static float RadarZoomMultiplier = 1.0f;
 static size_t radarBufferSize = 0;
 static int frameSkip = 0;
 
+/// Everything appliedRadarColour() looks at for a tile, so the tile is only recoloured when this changes
+static std::vector<uint64_t> radarTileKeys;
+/// The tile layer of the radar, without any objects drawn on top
+static std::vector<uint32_t> radarTileLayer;
+/// Radar texels that objects were drawn on in the last refresh
+static std::vector<size_t> radarObjectTexels;
+/// Whether radarTileKeys and radarTileLayer are up to date for the current mode, reveal status and player
+static bool radarTilesValid = false;
+static RADAR_DRAW_MODE radarTilesMode = RADAR_MODE_DEFAULT;
+static bool radarTilesRevealed = false;
+static unsigned radarTilesPlayer = 0;
+
 static void DrawRadarTiles();
 static void DrawRadarObjects();
 static void DrawRadarExtras(const glm::mat4 &modelViewProjectionMatrix);
@@ -172,6 +184,10 @@ bool resizeRadar()
 	radarBufferSize = radarTexWidth * radarTexHeight * sizeof(UDWORD);
 	radarBuffer = (uint32_t *)malloc(radarBufferSize);
 	memset(radarBuffer, 0, radarBufferSize);
+	radarTileKeys.assign(radarTexWidth * radarTexHeight, 0);
+	radarTileLayer.assign(radarTexWidth * radarTexHeight, 0);
+	radarObjectTexels.clear();
+	radarTilesValid = false;
 	frameSkip = 0;
 	if (rotateRadar)
 	{
@@ -192,6 +208,10 @@ bool ShutdownRadar()
 {
 	free(radarBuffer);
 	radarBuffer = nullptr;
+	radarTileKeys.clear();
+	radarTileLayer.clear();
+	radarObjectTexels.clear();
+	radarTilesValid = false;
 	frameSkip = 0;
 	return true;
 }
@@ -390,10 +410,24 @@ static PIELIGHT appliedRadarColour(RADAR_DRAW_MODE drawMode, MAPTILE *WTile)
 	return WScr;
 }
 
-/** Draw the map tiles on the radar. */
+/** Pack everything that the radar colour of a tile depends on. */
+static inline uint64_t radarTileKey(MAPTILE *psTile)
+{
+	return (uint64_t)(uint32_t)psTile->height << 32
+	       | (uint64_t)hasSensorOnTile(psTile, selectedPlayer) << 25
+	       | (uint64_t)TEST_TILE_VISIBLE(selectedPlayer, psTile) << 24
+	       | (uint64_t)psTile->illumination << 16
+	       | psTile->texture;
+}
+
+/** Draw the map tiles on the radar. Only tiles that changed since the last refresh are recoloured. */
 static void DrawRadarTiles()
 {
 	SDWORD	x, y;
+	const bool revealed = getRevealStatus();
+	const bool rebuild = !radarTilesValid || radarTilesMode != radarDrawMode || radarTilesRevealed != revealed || radarTilesPlayer != selectedPlayer;
+
+	ASSERT_OR_RETURN(, radarTileKeys.size() == radarTexWidth * radarTexHeight, "Radar tile cache not allocated");
 
 	for (x = scrollMinX; x < scrollMaxX; x++)
 	{
@@ -405,124 +439,124 @@ static void DrawRadarTiles()
 			ASSERT(pos * sizeof(*radarBuffer) < radarBufferSize, "Buffer overrun");
 			if (y == scrollMinY || x == scrollMinX || y == scrollMaxY - 1 || x == scrollMaxX - 1)
 			{
-				radarBuffer[pos] = WZCOL_BLACK.rgba;
+				if (rebuild)
+				{
+					radarTileLayer[pos] = radarBuffer[pos] = WZCOL_BLACK.rgba;
+				}
 				continue;
 			}
-			radarBuffer[pos] = appliedRadarColour(radarDrawMode, psTile).rgba;
+			const uint64_t key = radarTileKey(psTile);
+			if (rebuild || key != radarTileKeys[pos])
+			{
+				radarTileKeys[pos] = key;
+				radarTileLayer[pos] = radarBuffer[pos] = appliedRadarColour(radarDrawMode, psTile).rgba;
+			}
 		}
 	}
+
+	radarTilesValid = true;
+	radarTilesMode = radarDrawMode;
+	radarTilesRevealed = revealed;
+	radarTilesPlayer = selectedPlayer;
 }
 
-/** Draw the droids and structure positions on the radar. */
-static void DrawRadarObjects()
+/** The colour an object of the given player has on the radar. */
+static PIELIGHT radarObjectColour(unsigned clan, bool flash)
 {
-	UBYTE				clan;
-	PIELIGHT			playerCol;
-	PIELIGHT			flashCol;
-
-	/* Show droids on map - go through all players */
-	for (clan = 0; clan < MAX_PLAYERS; clan++)
+	if (flash)
 	{
-		DROID		*psDroid;
-
-		//see if have to draw enemy/ally color
-		if (bEnemyAllyRadarColor)
-		{
-			if (clan == selectedPlayer)
-			{
-				playerCol = colRadarMe;
-			}
-			else
-			{
-				playerCol = (aiCheckAlliances(selectedPlayer, clan) ? colRadarAlly : colRadarEnemy);
-			}
-		}
-		else
+		STATIC_ASSERT(MAX_PLAYERS <= ARRAY_SIZE(flashColours));
+		return flashColours[getPlayerColour(clan)];
+	}
+	//see if have to draw enemy/ally color
+	if (bEnemyAllyRadarColor)
+	{
+		if (clan == selectedPlayer)
 		{
-			//original 8-color mode
-			STATIC_ASSERT(MAX_PLAYERS <= ARRAY_SIZE(clanColours));
-			playerCol = clanColours[getPlayerColour(clan)];
+			return colRadarMe;
 		}
+		return aiCheckAlliances(selectedPlayer, clan) ? colRadarAlly : colRadarEnemy;
+	}
+	//original 8-color mode
+	STATIC_ASSERT(MAX_PLAYERS <= ARRAY_SIZE(clanColours));
+	return clanColours[getPlayerColour(clan)];
+}
 
-		STATIC_ASSERT(MAX_PLAYERS <= ARRAY_SIZE(flashColours));
-		flashCol = flashColours[getPlayerColour(clan)];
+/** Whether the selected player gets to see this object on the radar. */
+static bool radarObjectVisible(const BASE_OBJECT *psObj)
+{
+	return psObj->visible[selectedPlayer]
+	       || (bMultiPlayer && alliancesSharedVision(game.alliance)
+	           && aiCheckAlliances(selectedPlayer, psObj->player));
+}
 
+/** Whether a recently hit object of the selected player should flash on the radar. */
+static bool radarObjectFlash(unsigned clan, unsigned timeLastHit)
+{
+	return clan == selectedPlayer && gameTime > HIT_NOTIFICATION && gameTime - timeLastHit < HIT_NOTIFICATION;
+}
+
+/**
+ * Draw the droids and structure positions on the radar.
+ * Texels that had objects on them in the last refresh are restored from the tile layer first,
+ * so only the texels that objects moved off or onto are touched.
+ */
+static void DrawRadarObjects()
+{
+	for (size_t pos : radarObjectTexels)
+	{
+		radarBuffer[pos] = radarTileLayer[pos];
+	}
+	radarObjectTexels.clear();
+
+	/* Show droids on map - go through all players */
+	for (unsigned clan = 0; clan < MAX_PLAYERS; clan++)
+	{
 		/* Go through all droids */
-		for (psDroid = apsDroidLists[clan]; psDroid != nullptr; psDroid = psDroid->psNext)
+		for (DROID *psDroid = apsDroidLists[clan]; psDroid != nullptr; psDroid = psDroid->psNext)
 		{
 			if (psDroid->pos.x < world_coord(scrollMinX) || psDroid->pos.y < world_coord(scrollMinY)
 			    || psDroid->pos.x >= world_coord(scrollMaxX) || psDroid->pos.y >= world_coord(scrollMaxY))
 			{
 				continue;
 			}
-			if (psDroid->visible[selectedPlayer]
-			    || (bMultiPlayer && alliancesSharedVision(game.alliance)
-			        && aiCheckAlliances(selectedPlayer, psDroid->player)))
+			if (radarObjectVisible(psDroid))
 			{
 				int	x = psDroid->pos.x / TILE_UNITS;
 				int	y = psDroid->pos.y / TILE_UNITS;
 				size_t	pos = (x - scrollMinX) + (y - scrollMinY) * radarTexWidth;
 
 				ASSERT(pos * sizeof(*radarBuffer) < radarBufferSize, "Buffer overrun");
-				if (clan == selectedPlayer && gameTime > HIT_NOTIFICATION && gameTime - psDroid->timeLastHit < HIT_NOTIFICATION)
-				{
-					radarBuffer[pos] = flashCol.rgba;
-				}
-				else
-				{
-					radarBuffer[pos] = playerCol.rgba;
-				}
+				radarBuffer[pos] = radarObjectColour(clan, radarObjectFlash(clan, psDroid->timeLastHit)).rgba;
+				radarObjectTexels.push_back(pos);
 			}
 		}
 	}
 
-	/* Do the same for structures */
-	for (SDWORD x = scrollMinX; x < scrollMaxX; x++)
+	/* Do the same for structures, which cover every tile of their footprint */
+	for (unsigned clan = 0; clan < MAX_PLAYERS; clan++)
 	{
-		for (SDWORD y = scrollMinY; y < scrollMaxY; y++)
+		for (STRUCTURE *psStruct = apsStructLists[clan]; psStruct != nullptr; psStruct = psStruct->psNext)
 		{
-			MAPTILE		*psTile = mapTile(x, y);
-			STRUCTURE	*psStruct;
-			size_t		pos = (x - scrollMinX) + (y - scrollMinY) * radarTexWidth;
-
-			ASSERT(pos * sizeof(*radarBuffer) < radarBufferSize, "Buffer overrun");
-			if (!TileHasStructure(psTile))
+			if (!radarObjectVisible(psStruct))
 			{
 				continue;
 			}
-			psStruct = (STRUCTURE *)psTile->psObject;
-			clan = psStruct->player;
-
-			//see if have to draw enemy/ally color
-			if (bEnemyAllyRadarColor)
-			{
-				if (clan == selectedPlayer)
-				{
-					playerCol = colRadarMe;
-				}
-				else
-				{
-					playerCol = (aiCheckAlliances(selectedPlayer, clan) ? colRadarAlly : colRadarEnemy);
-				}
-			}
-			else
+			const uint32_t colour = radarObjectColour(clan, radarObjectFlash(clan, psStruct->timeLastHit)).rgba;
+			const StructureBounds b = getStructureBounds(psStruct);
+			for (int y = std::max(b.map.y, scrollMinY); y < std::min(b.map.y + b.size.y, scrollMaxY); ++y)
 			{
-				//original 8-color mode
-				playerCol = clanColours[getPlayerColour(clan)];
-			}
-			flashCol = flashColours[getPlayerColour(clan)];
-
-			if (psStruct->visible[selectedPlayer]
-			    || (bMultiPlayer && alliancesSharedVision(game.alliance)
-			        && aiCheckAlliances(selectedPlayer, psStruct->player)))
-			{
-				if (clan == selectedPlayer && gameTime > HIT_NOTIFICATION && gameTime - psStruct->timeLastHit < HIT_NOTIFICATION)
-				{
-					radarBuffer[pos] = flashCol.rgba;
-				}
-				else
+				for (int x = std::max(b.map.x, scrollMinX); x < std::min(b.map.x + b.size.x, scrollMaxX); ++x)
 				{
-					radarBuffer[pos] = playerCol.rgba;
+					if (mapTile(x, y)->psObject != psStruct)
+					{
+						continue;
+					}
+					size_t	pos = (x - scrollMinX) + (y - scrollMinY) * radarTexWidth;
+
+					ASSERT(pos * sizeof(*radarBuffer) < radarBufferSize, "Buffer overrun");
+					radarBuffer[pos] = colour;
+					radarObjectTexels.push_back(pos);
 				}
 			}
 		}
@@ -674,4 +708,5 @@ void radarColour(UDWORD tileNumber, uint8_t r, uint8_t g, uint8_t b)
 	tileColours[tileNumber].byte.g = g;
 	tileColours[tileNumber].byte.b = b;
 	tileColours[tileNumber].byte.a = 255;
+	radarTilesValid = false;
 }
@@ -25,27 +25,106 @@
 #define __INCLUDED_SRC_RAYCAST_H__
 
 #include "lib/framework/vector.h"
+#include "map.h"
 
+#include <algorithm>
 
-/*!
- * The raycast intersection callback.
- * \param pos Current position
- * \param dist Current distance from start
- * \param data Payload (store intermediate results here)
- * \return true if ore points are required, false otherwise
- */
-typedef bool (*RAY_CALLBACK)(Vector2i pos, int32_t dist, void *data);
+static inline void rayInitSteps(int32_t srcM, int32_t dstM, int32_t &tile, int32_t &step, int32_t &cur, int32_t &end)
+{
+	int increasing = srcM < dstM;
+	step = -1 + 2 * increasing;
+	tile = srcM - step;
+	cur = srcM + increasing;
+	end = dstM + increasing;
+}
+
+// Finds the next intersection of the line with a vertical grid line (or with a horizontal grid line, if called with x and y swapped).
+static inline bool rayTryStep(int32_t &tile, int32_t step, int32_t &cur, int32_t end, int32_t &px, int32_t &py, int32_t sx, int32_t sy, int32_t dx, int32_t dy)
+{
+	tile += step;
+
+	if (cur == end)
+	{
+		return false;  // No more vertical grid lines to cross before reaching the endpoint.
+	}
 
+	// Find the point on the line with the x coordinate world_coord(cur).
+	px = world_coord(cur);
+	py = sy + int64_t(px - sx) * (dy - sy) / (dx - sx);
+
+	cur += step;
+	return true;
+}
 
 /*!
  * Cast a ray from a position into a certain direction
  * \param src Position to cast from
  * \param dst Position to cast to (casts to end of map, if dst is off the map)
- * \param callback Callback to call for each passed tile
- * \param data Data to pass through to the callback
+ * \param callback Called as bool callback(Vector2i pos, int32_t dist) for each passed tile, returning true if more
+ *                 points are required. Can be any function object, so that it gets inlined.
  */
-void rayCast(Vector2i src, Vector2i dst, RAY_CALLBACK callback, void *data);
+template <typename Callback>
+inline void rayCast(Vector2i src, Vector2i dst, Callback &&callback)
+{
+	if (!callback(src, 0) || src == dst)  // Start at src.
+	{
+		return;  // Callback gave up after the first point, or there are no other points.
+	}
+
+	Vector2i srcM(map_coord(src.x), map_coord(src.y));
+	Vector2i dstM(map_coord(dst.x), map_coord(dst.y));
+
+	Vector2i step(0, 0), tile(0, 0), cur(0, 0), end(0, 0);
+	rayInitSteps(srcM.x, dstM.x, tile.x, step.x, cur.x, end.x);
+	rayInitSteps(srcM.y, dstM.y, tile.y, step.y, cur.y, end.y);
+
+	Vector2i prev(0, 0);  // Dummy initialisation.
+	bool first = true;
+	Vector2i nextX(0, 0), nextY(0, 0);  // Dummy initialisations.
+	bool canX = rayTryStep(tile.x, step.x, cur.x, end.x, nextX.x, nextX.y, src.x, src.y, dst.x, dst.y);
+	bool canY = rayTryStep(tile.y, step.y, cur.y, end.y, nextY.y, nextY.x, src.y, src.x, dst.y, dst.x);
+	while (canX || canY)
+	{
+		int32_t xDist = abs(nextX.x - src.x) + abs(nextX.y - src.y);
+		int32_t yDist = abs(nextY.x - src.x) + abs(nextY.y - src.y);
+		Vector2i sel;
+		Vector2i selTile;
+		if (canX && (!canY || xDist < yDist))  // The line crosses a vertical grid line next.
+		{
+			sel = nextX;
+			selTile = tile;
+			canX = rayTryStep(tile.x, step.x, cur.x, end.x, nextX.x, nextX.y, src.x, src.y, dst.x, dst.y);
+		}
+		else  // The line crosses a horizontal grid line next.
+		{
+			assert(canY);
+			sel = nextY;
+			selTile = tile;
+			canY = rayTryStep(tile.y, step.y, cur.y, end.y, nextY.y, nextY.x, src.y, src.x, dst.y, dst.x);
+		}
+		if (!first)
+		{
+			// Find midpoint.
+			Vector2i avg = (prev + sel) / 2;
+			// But make sure it's on the right tile, since it could be off-by-one if the line passes exactly through a grid intersection.
+			avg.x = std::min(std::max(avg.x, world_coord(selTile.x)), world_coord(selTile.x + 1) - 1);
+			avg.y = std::min(std::max(avg.y, world_coord(selTile.y)), world_coord(selTile.y + 1) - 1);
+			if (!worldOnMap(avg) || !callback(avg, iHypot(avg)))
+			{
+				return;  // Callback doesn't want any more points, or we reached the edge of the map, so return.
+			}
+		}
+		prev = sel;
+		first = false;
+	}
 
+	// Include the endpoint.
+	if (!worldOnMap(dst))
+	{
+		return;  // Stop, since reached the edge of the map.
+	}
+	callback(dst, iHypot(dst));
+}
 
 // Calculates the maximum height and distance found along a line from any
 // point to the edge of the grid
@@ -1429,6 +1429,7 @@ STRUCTURE *buildStructureDir(STRUCTURE_STATS *pStructureType, UDWORD x, UDWORD y
 				// We now know the previous loop didn't return early, so it is safe to save references to psBuilding now.
 				MAPTILE *psTile = mapTile(tileX, tileY);
 				psTile->psObject = psBuilding;
+				++mapChangeCount;
 
 				// if it's a tall structure then flag it in the map.
 				if (psBuilding->sDisplay.imd->max.y > TALLOBJECT_YMAX)
@@ -3565,7 +3566,7 @@ void structureUpdate(STRUCTURE *psBuilding, bool bMission)
 
 	if (psBuilding->flags.test(OBJECT_FLAG_DIRTY) && !bMission)
 	{
-		visTilesUpdate(psBuilding);
+		visTilesUpdateLater(psBuilding);
 		psBuilding->flags.set(OBJECT_FLAG_DIRTY, false);
 	}
 
@@ -4280,6 +4281,7 @@ static void removeStructFromMap(STRUCTURE *psStruct)
 		{
 			MAPTILE *psTile = mapTile(b.map.x + i, b.map.y + j);
 			psTile->psObject = nullptr;
+			++mapChangeCount;
 			auxClearBlocking(b.map.x + i, b.map.y + j, AIR_BLOCKED);
 		}
 	}
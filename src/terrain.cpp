@@ -32,6 +32,7 @@
 #include <string.h>
 
 #include "lib/framework/frame.h"
+#include "lib/framework/wzjobs.h"
 #include "lib/framework/opengl.h"
 #include "lib/ivis_opengl/ivisdef.h"
 #include "lib/ivis_opengl/imd.h"
@@ -108,6 +109,50 @@ static gfx_api::gfxUByte *lightmapPixmap;
 /// Ticks per lightmap refresh
 static const unsigned int LIGHTMAP_REFRESH = 80;
 
+/// A rectangle of lightmap tiles, upper bounds exclusive
+struct LightmapRect
+{
+	int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+	bool empty() const
+	{
+		return x0 >= x1 || y0 >= y1;
+	}
+
+	void add(int ax0, int ay0, int ax1, int ay1)
+	{
+		if (ax0 >= ax1 || ay0 >= ay1)
+		{
+			return;
+		}
+		if (empty())
+		{
+			x0 = ax0; y0 = ay0; x1 = ax1; y1 = ay1;
+			return;
+		}
+		x0 = std::min(x0, ax0); y0 = std::min(y0, ay0);
+		x1 = std::max(x1, ax1); y1 = std::max(y1, ay1);
+	}
+
+	void add(const LightmapRect &r)
+	{
+		add(r.x0, r.y0, r.x1, r.y1);
+	}
+};
+/// Tiles that changed since the last lightmap refresh
+static LightmapRect lightmapDirty;
+/// Tiles which are marked, and so blink on every refresh
+static LightmapRect lightmapMarked;
+/// The tiles that were inside the visible area, with the edge fade, on the last refresh
+static LightmapRect lightmapFadeArea;
+/// The state the lightmap was last computed with - when any of it changes, more tiles have to be recomputed
+static float lightmapFadeX, lightmapFadeY;
+static bool lightmapFog, lightmapGateways;
+/// Packs the changed part of the lightmap for uploading
+static std::vector<gfx_api::gfxUByte> lightmapUploadBuffer;
+/// Edge fade factor of each changed column, and of each byte of the current row
+static std::vector<float> lightmapColumnFade, lightmapRowFade;
+
 /// VBOs
 static gfx_api::buffer *geometryVBO = nullptr, *geometryIndexVBO = nullptr, *textureVBO = nullptr, *textureIndexVBO = nullptr, *decalVBO = nullptr;
 /// VBOs
@@ -120,6 +165,20 @@ static int32_t GLmaxElementsVertices, GLmaxElementsIndices;
 
 /// The sectors are stored here
 static Sector *sectors;
+
+/// The vertex data of a dirty sector, built on the job pool and uploaded on the render thread
+struct SectorRebuild
+{
+	int x = 0, y = 0;
+	std::vector<RenderVertex> geometry;
+	std::vector<RenderVertex> water;
+	std::vector<DecalVertex> decals;
+};
+
+/// How many dirty sectors are rebuilt per frame at most, the rest are left for the next frames
+static const size_t MAX_SECTOR_REBUILDS_PER_FRAME = 32;
+/// The sectors being rebuilt this frame
+static std::vector<SectorRebuild> sectorRebuilds;
 /// The default sector size (a sector is sectorSize x sectorSize)
 static int sectorSize = 15;
 /// What is the distance we can see
@@ -216,7 +275,18 @@ void setTileColour(int x, int y, PIELIGHT colour)
 {
 	MAPTILE *psTile = mapTile(x, y);
 
-	psTile->colour = colour;
+	if (psTile->colour.rgba != colour.rgba)
+	{
+		psTile->colour = colour;
+		lightmapDirty.add(x, y, x + 1, y + 1);
+	}
+}
+
+/// Recompute the whole lightmap on the next refresh
+void markLightmapDirty()
+{
+	lightmapDirty.add(0, 0, mapWidth, mapHeight);
+	lightmapMarked = LightmapRect();
 }
 
 // NOTE:  The current (max) texture size of a tile is 128x128.  We allow up to a user defined texture size
@@ -488,54 +558,79 @@ static void setSectorDecals(int x, int y, DecalVertex *decaldata, int *decalSize
 }
 
 /**
- * Update the sector for when the terrain is changed.
+ * Build the new vertex data of a sector for when the terrain is changed.
+ * Only reads the map, so this is safe to run on the job pool.
  */
-static void updateSectorGeometry(int x, int y)
+static void buildSectorGeometry(SectorRebuild &rebuild)
 {
-	RenderVertex *geometry;
-	RenderVertex *water;
-	DecalVertex *decaldata;
+	const Sector &sector = sectors[rebuild.x * ySectors + rebuild.y];
 	int geometrySize = 0;
 	int waterSize = 0;
 	int decalSize = 0;
 
-	geometry  = (RenderVertex *)malloc(sizeof(RenderVertex) * sectors[x * ySectors + y].geometrySize);
-	water     = (RenderVertex *)malloc(sizeof(RenderVertex) * sectors[x * ySectors + y].waterSize);
+	rebuild.geometry.resize(sector.geometrySize);
+	rebuild.water.resize(sector.waterSize);
+	setSectorGeometry(rebuild.x, rebuild.y, rebuild.geometry.data(), rebuild.water.data(), &geometrySize, &waterSize);
+	ASSERT(geometrySize == sector.geometrySize, "something went seriously wrong updating the terrain");
+	ASSERT(waterSize    == sector.waterSize   , "something went seriously wrong updating the terrain");
 
-	setSectorGeometry(x, y, geometry, water, &geometrySize, &waterSize);
-	ASSERT(geometrySize == sectors[x * ySectors + y].geometrySize, "something went seriously wrong updating the terrain");
-	ASSERT(waterSize    == sectors[x * ySectors + y].waterSize   , "something went seriously wrong updating the terrain");
+	rebuild.decals.resize(std::max(sector.decalSize, 0));
+	if (sector.decalSize > 0)
+	{
+		setSectorDecals(rebuild.x, rebuild.y, rebuild.decals.data(), &decalSize);
+		ASSERT(decalSize == sector.decalSize   , "the amount of decals has changed");
+	}
+}
+
+/**
+ * Upload the rebuilt vertex data of a sector. Must be called on the render thread.
+ */
+static void commitSectorGeometry(const SectorRebuild &rebuild)
+{
+	const Sector &sector = sectors[rebuild.x * ySectors + rebuild.y];
 
-	geometryVBO->update(sizeof(RenderVertex)*sectors[x * ySectors + y].geometryOffset,
-	                    sizeof(RenderVertex)*sectors[x * ySectors + y].geometrySize, geometry,
+	geometryVBO->update(sizeof(RenderVertex)*sector.geometryOffset,
+	                    sizeof(RenderVertex)*sector.geometrySize, rebuild.geometry.data(),
 						gfx_api::buffer::update_flag::non_overlapping_updates_promise);
-	waterVBO->update(sizeof(RenderVertex)*sectors[x * ySectors + y].waterOffset,
-	                 sizeof(RenderVertex)*sectors[x * ySectors + y].waterSize, water,
+	waterVBO->update(sizeof(RenderVertex)*sector.waterOffset,
+	                 sizeof(RenderVertex)*sector.waterSize, rebuild.water.data(),
 					 gfx_api::buffer::update_flag::non_overlapping_updates_promise);
 
-	free(geometry);
-	free(water);
-
-	if (sectors[x * ySectors + y].decalSize <= 0)
+	if (sector.decalSize <= 0)
 	{
 		// Nothing to do here, and glBufferSubData(GL_ARRAY_BUFFER, 0, 0, *) crashes in my graphics driver. Probably shouldn't crash...
 		return;
 	}
 
-	decaldata = (DecalVertex *)malloc(sizeof(DecalVertex) * sectors[x * ySectors + y].decalSize);
-	setSectorDecals(x, y, decaldata, &decalSize);
-	ASSERT(decalSize == sectors[x * ySectors + y].decalSize   , "the amount of decals has changed");
-
-	decalVBO->update(sizeof(DecalVertex)*sectors[x * ySectors + y].decalOffset,
-	                 sizeof(DecalVertex)*sectors[x * ySectors + y].decalSize, decaldata,
+	decalVBO->update(sizeof(DecalVertex)*sector.decalOffset,
+	                 sizeof(DecalVertex)*sector.decalSize, rebuild.decals.data(),
 					 gfx_api::buffer::update_flag::non_overlapping_updates_promise);
+}
 
-	free(decaldata);
+/**
+ * Rebuild the first count entries of sectorRebuilds, spread over the job pool and this thread,
+ * then upload the results.
+ */
+static void rebuildSectors(size_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	wzParallelFor("terrain sectors", count, [](size_t i) {
+		buildSectorGeometry(sectorRebuilds[i]);
+	});
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		commitSectorGeometry(sectorRebuilds[i]);
+	}
 }
 
 /**
  * Mark all tiles that are influenced by this grid point as dirty.
- * Dirty sectors will later get updated by updateSectorGeometry.
+ * Dirty sectors will later get rebuilt by cullTerrain.
  */
 void markTileDirty(int i, int j)
 {
@@ -954,6 +1049,12 @@ bool initTerrain()
 	lightmap_tex_num = gfx_api::context::get().create_texture(1, lightmapWidth, lightmapHeight, gfx_api::pixel_format::FORMAT_RGB8_UNORM_PACK8);
 
 	lightmap_tex_num->upload(0, 0, 0, lightmapWidth, lightmapHeight, gfx_api::pixel_format::FORMAT_RGB8_UNORM_PACK8, lightmapPixmap);
+	markLightmapDirty();
+	lightmapFadeArea = LightmapRect();
+	lightmapFog = pie_GetFogStatus();
+	lightmapGateways = showGateways;
+
+	sectorRebuilds.resize(MAX_SECTOR_REBUILDS_PER_FRAME);
 
 	terrainInitialised = true;
 
@@ -969,6 +1070,7 @@ void shutdownTerrain()
 		debug(LOG_ERROR, "Trying to shutdown terrain when we did not need to!");
 		return;
 	}
+	sectorRebuilds.clear();
 	delete geometryVBO;
 	geometryVBO = nullptr;
 	delete geometryIndexVBO;
@@ -1004,13 +1106,82 @@ void shutdownTerrain()
 	terrainInitialised = false;
 }
 
-static void updateLightMap()
+/// Work out which tiles have to be recomputed on this lightmap refresh
+static LightmapRect lightmapChangedArea()
 {
-	for (int j = 0; j < mapHeight; ++j)
+	const bool fog = pie_GetFogStatus();
+	if (fog != lightmapFog || showGateways != lightmapGateways)
 	{
-		for (int i = 0; i < mapWidth; ++i)
+		lightmapFog = fog;
+		lightmapGateways = showGateways;
+		markLightmapDirty();
+	}
+
+	LightmapRect area = lightmapDirty;
+	area.add(lightmapMarked);
+
+	if (!fog)
+	{
+		// everything outside the visible terrain area is black, so when it moves, only the old and new areas change
+		const float playerX = map_coordf(playerPos.p.x);
+		const float playerY = map_coordf(playerPos.p.z);
+		if (playerX != lightmapFadeX || playerY != lightmapFadeY || lightmapFadeArea.empty())
+		{
+			LightmapRect fadeArea;
+			fadeArea.add(static_cast<int>(playerX - visibleTiles.x / 2) - 1, static_cast<int>(playerY - visibleTiles.y / 2) - 1,
+			             static_cast<int>(playerX + visibleTiles.x / 2) + 2, static_cast<int>(playerY + visibleTiles.y / 2) + 2);
+			area.add(lightmapFadeArea);
+			area.add(fadeArea);
+			lightmapFadeArea = fadeArea;
+			lightmapFadeX = playerX;
+			lightmapFadeY = playerY;
+		}
+	}
+
+	area.x0 = std::max(area.x0, 0);
+	area.y0 = std::max(area.y0, 0);
+	area.x1 = std::min(area.x1, mapWidth);
+	area.y1 = std::min(area.y1, mapHeight);
+	lightmapDirty = LightmapRect();
+	return area;
+}
+
+/// Recompute the changed part of the lightmap. Returns the changed area.
+static LightmapRect updateLightMap()
+{
+	const LightmapRect area = lightmapChangedArea();
+	if (area.empty())
+	{
+		return area;
+	}
+
+	const bool fade = !pie_GetFogStatus();
+	const float playerX = map_coordf(playerPos.p.x);
+	const float playerY = map_coordf(playerPos.p.z);
+	const int width = area.x1 - area.x0;
+	const bool fullScan = area.x0 == 0 && area.y0 == 0 && area.x1 == mapWidth && area.y1 == mapHeight;
+	LightmapRect marked;
+
+	if (fade)
+	{
+		// fade to black at the edges of the visible terrain area - the horizontal distance to the edge only depends on the column
+		lightmapColumnFade.resize(width);
+		lightmapRowFade.resize(width * 3);
+		for (int i = area.x0; i < area.x1; ++i)
+		{
+			const float distA = i - (playerX - visibleTiles.x / 2);
+			const float distB = (playerX + visibleTiles.x / 2) - i;
+			lightmapColumnFade[i - area.x0] = std::min(distA, distB);
+		}
+	}
+
+	for (int j = area.y0; j < area.y1; ++j)
+	{
+		gfx_api::gfxUByte *row = &lightmapPixmap[(area.x0 + j * lightmapWidth) * 3];
+		const MAPTILE *psTile = mapTile(area.x0, j);
+
+		for (int i = 0; i < width; ++i, ++psTile)
 		{
-			MAPTILE *psTile = mapTile(i, j);
 			PIELIGHT colour = psTile->colour;
 
 			if (psTile->tileInfoBits & BITS_GATEWAY && showGateways)
@@ -1021,60 +1192,78 @@ static void updateLightMap()
 			{
 				int m = getModularScaledGraphicsTime(2048, 255);
 				colour.byte.r = MAX(m, 255 - m);
+				marked.add(area.x0 + i, j, area.x0 + i + 1, j + 1);
 			}
 
-			lightmapPixmap[(i + j * lightmapWidth) * 3 + 0] = colour.byte.r;
-			lightmapPixmap[(i + j * lightmapWidth) * 3 + 1] = colour.byte.g;
-			lightmapPixmap[(i + j * lightmapWidth) * 3 + 2] = colour.byte.b;
+			row[i * 3 + 0] = colour.byte.r;
+			row[i * 3 + 1] = colour.byte.g;
+			row[i * 3 + 2] = colour.byte.b;
+		}
 
-			if (!pie_GetFogStatus())
+		if (fade)
+		{
+			const float distC = j - (playerY - visibleTiles.y / 2);
+			const float distD = (playerY + visibleTiles.y / 2) - j;
+			const float rowDist = std::min(distC, distD);
+			const float *columnFade = lightmapColumnFade.data();
+			float *rowFade = lightmapRowFade.data();
+
+			// darken is the distance to the closest edge of the visible map, halved, and clamped to [0, 1]
+			for (int i = 0; i < width; ++i)
 			{
-				// fade to black at the edges of the visible terrain area
-				const float playerX = map_coordf(playerPos.p.x);
-				const float playerY = map_coordf(playerPos.p.z);
-
-				const float distA = i - (playerX - visibleTiles.x / 2);
-				const float distB = (playerX + visibleTiles.x / 2) - i;
-				const float distC = j - (playerY - visibleTiles.y / 2);
-				const float distD = (playerY + visibleTiles.y / 2) - j;
-				float darken, distToEdge;
-
-				// calculate the distance to the closest edge of the visible map
-				// determine the smallest distance
-				distToEdge = distA;
-				if (distB < distToEdge)
-				{
-					distToEdge = distB;
-				}
-				if (distC < distToEdge)
-				{
-					distToEdge = distC;
-				}
-				if (distD < distToEdge)
-				{
-					distToEdge = distD;
-				}
-
-				darken = (distToEdge) / 2.0f;
-				if (darken <= 0)
-				{
-					lightmapPixmap[(i + j * lightmapWidth) * 3 + 0] = 0;
-					lightmapPixmap[(i + j * lightmapWidth) * 3 + 1] = 0;
-					lightmapPixmap[(i + j * lightmapWidth) * 3 + 2] = 0;
-				}
-				else if (darken < 1)
-				{
-					lightmapPixmap[(i + j * lightmapWidth) * 3 + 0] *= darken;
-					lightmapPixmap[(i + j * lightmapWidth) * 3 + 1] *= darken;
-					lightmapPixmap[(i + j * lightmapWidth) * 3 + 2] *= darken;
-				}
+				const float darken = std::max(0.f, std::min(1.f, std::min(columnFade[i], rowDist) / 2.0f));
+				rowFade[i * 3 + 0] = darken;
+				rowFade[i * 3 + 1] = darken;
+				rowFade[i * 3 + 2] = darken;
+			}
+			for (int k = 0; k < width * 3; ++k)
+			{
+				row[k] = static_cast<gfx_api::gfxUByte>(row[k] * rowFade[k]);
 			}
 		}
 	}
+
+	if (fullScan)
+	{
+		lightmapMarked = marked;
+	}
+	else
+	{
+		lightmapMarked.add(marked);
+	}
+
+	return area;
+}
+
+/// Upload the part of the lightmap pixmap that changed
+static void uploadLightMap(const LightmapRect &area)
+{
+	// keep rows a multiple of 4 bytes long, which is the default unpack alignment
+	const size_t x0 = static_cast<size_t>(area.x0) & ~static_cast<size_t>(3);
+	const size_t x1 = std::min((static_cast<size_t>(area.x1) + 3) & ~static_cast<size_t>(3), lightmapWidth);
+	const size_t y0 = area.y0;
+	const size_t width = x1 - x0;
+	const size_t height = area.y1 - area.y0;
+
+	if (width == lightmapWidth)
+	{
+		// whole rows are contiguous in the pixmap already
+		lightmap_tex_num->upload(0, 0, y0, width, height, gfx_api::pixel_format::FORMAT_RGB8_UNORM_PACK8, &lightmapPixmap[y0 * lightmapWidth * 3]);
+		return;
+	}
+
+	lightmapUploadBuffer.resize(width * height * 3);
+	for (size_t j = 0; j < height; ++j)
+	{
+		memcpy(&lightmapUploadBuffer[j * width * 3], &lightmapPixmap[(x0 + (y0 + j) * lightmapWidth) * 3], width * 3);
+	}
+	lightmap_tex_num->upload(0, x0, y0, width, height, gfx_api::pixel_format::FORMAT_RGB8_UNORM_PACK8, lightmapUploadBuffer.data());
 }
 
 static void cullTerrain()
 {
+	size_t numRebuilds = 0;
+
 	for (int x = 0; x < xSectors; x++)
 	{
 		for (int y = 0; y < ySectors; y++)
@@ -1090,14 +1279,18 @@ static void cullTerrain()
 			else
 			{
 				sectors[x * ySectors + y].draw = true;
-				if (sectors[x * ySectors + y].dirty)
+				if (sectors[x * ySectors + y].dirty && numRebuilds < sectorRebuilds.size())
 				{
-					updateSectorGeometry(x, y);
+					sectorRebuilds[numRebuilds].x = x;
+					sectorRebuilds[numRebuilds].y = y;
+					++numRebuilds;
 					sectors[x * ySectors + y].dirty = false;
 				}
 			}
 		}
 	}
+
+	rebuildSectors(numRebuilds);
 }
 
 static void drawDepthOnly(const glm::mat4 &ModelViewProjection, const glm::vec4 &paramsXLight, const glm::vec4 &paramsYLight)
@@ -1252,9 +1445,11 @@ void drawTerrain(const glm::mat4 &mvp)
 	if (realTime - lightmapLastUpdate >= LIGHTMAP_REFRESH)
 	{
 		lightmapLastUpdate = realTime;
-		updateLightMap();
-
-		lightmap_tex_num->upload(0, 0, 0, lightmapWidth, lightmapHeight, gfx_api::pixel_format::FORMAT_RGB8_UNORM_PACK8, lightmapPixmap);
+		const LightmapRect changed = updateLightMap();
+		if (!changed.empty())
+		{
+			uploadLightMap(changed);
+		}
 	}
 
 	///////////////////////////////////
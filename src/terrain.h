@@ -34,6 +34,7 @@ void drawWater(const glm::mat4 &viewMatrix);
 
 PIELIGHT getTileColour(int x, int y);
 void setTileColour(int x, int y, PIELIGHT colour);
+void markLightmapDirty();
 
 void markTileDirty(int i, int j);
 
@@ -24,6 +24,7 @@
  */
 #include "lib/framework/frame.h"
 #include "lib/framework/fixedpoint.h"
+#include "lib/framework/wzjobs.h"
 
 #include "lib/gamelib/gtime.h"
 #include "lib/sound/audio.h"
@@ -97,18 +98,73 @@ struct VisibleObjectHelp_t
 static int *gNumWalls = nullptr;
 static Vector2i *gWall = nullptr;
 
+#define FIRE_LINE_CACHE_SIZE 4096  // Must be a power of 2.
+
+/// A checkFireLine() result, valid for the rest of the game tick unless the map changes.
+struct FireLineCacheEntry
+{
+	uint32_t generation = 0;  ///< Only valid if equal to fireLineGeneration.
+	Vector3i muzzle;
+	Vector3i dest;
+	const BASE_OBJECT *psTarget;
+	uint32_t targetId;
+	bool wallsBlock;
+	bool direct;
+	int result;
+};
+static std::vector<FireLineCacheEntry> fireLineCache;
+static uint32_t fireLineGeneration = 0;
+static uint32_t fireLineTime = 0;       ///< gameTime the entries of fireLineGeneration were made at.
+static uint32_t fireLineMapChanges = 0; ///< mapChangeCount the entries of fireLineGeneration were made with.
+
+static VisibilityStats visStats;
+static std::vector<TILEPOS> visSeenTiles;  ///< Tiles seen by the latest wavecast, before diffing against the watchedTiles of the object.
+static std::vector<uint32_t> visTileMark;  ///< Per map tile, visTileGeneration * 4 + 1 + type if in visSeenTiles, + 3 if also in watchedTiles.
+static uint32_t visTileGeneration = 0;
+
+/// A visTilesUpdateLater() request, resolved by visUpdatePendingTiles().
+struct VisibilityRequest
+{
+	BASE_OBJECT *psObj;              ///< nullptr if cancelled by visRemoveVisibility()
+	const WavecastTile *tiles;       ///< nullptr if the object confers no visibility
+	size_t numTiles;
+	std::vector<TILEPOS> seenTiles;  ///< Memory for the result of the wavecast, kept between ticks.
+};
+static std::vector<VisibilityRequest> visRequests;
+static size_t numVisRequests = 0;    ///< Entries of visRequests in use this tick, in the order requested.
+
 // forward declarations
 static void setSeenBy(BASE_OBJECT *psObj, unsigned viewer, int val);
+static void doWaveTerrain(BASE_OBJECT const *psObj, const WavecastTile *tiles, size_t size, std::vector<TILEPOS> &seenTiles);
+
+static std::vector<TILEPOS> castVisibilityRequest(VisibilityRequest &request)
+{
+	std::vector<TILEPOS> seenTiles = std::move(request.seenTiles);  // Reuse the memory.
+	if (request.tiles != nullptr)
+	{
+		doWaveTerrain(request.psObj, request.tiles, request.numTiles, seenTiles);
+	}
+	return seenTiles;
+}
 
 // initialise the visibility stuff
 bool visInitialise()
 {
 	visLevelInc = 1;
 	visLevelDec = 0;
+	visStats = VisibilityStats();
+	numVisRequests = 0;
+	fireLineCache.clear();
 
 	return true;
 }
 
+void visShutdown()
+{
+	visRequests.clear();
+	numVisRequests = 0;
+}
+
 // update the visibility change levels
 void visUpdateLevel()
 {
@@ -224,22 +280,17 @@ SPOTTER::~SPOTTER()
 	free(watchedTiles);
 }
 
-/* Record all tiles that some object confers visibility to. Only record each tile
+/* Record a tile that some object confers visibility to. Only record each tile
  * once. Note that there is both a limit to how many objects can watch any given
  * tile. Strange but non fatal things will happen if these limits are exceeded. */
-static inline void visMarkTile(const BASE_OBJECT *psObj, int mapX, int mapY, MAPTILE *psTile, std::vector<TILEPOS> &watchedTiles)
+static inline void visAddTile(BASE_OBJECT *psObj, TILEPOS pos)
 {
 	const int rayPlayer = psObj->player;
-	const int xdiff = map_coord(psObj->pos.x) - mapX;
-	const int ydiff = map_coord(psObj->pos.y) - mapY;
-	const int distSq = xdiff * xdiff + ydiff * ydiff;
-	const bool inRange = (distSq < 16);
-	uint8_t *visionType = inRange ? psTile->watchers : psTile->sensors;
+	MAPTILE *psTile = mapTile(pos.x, pos.y);
+	uint8_t *visionType = (pos.type == 0) ? psTile->sensors : psTile->watchers;
 
 	if (visionType[rayPlayer] < UBYTE_MAX)
 	{
-		TILEPOS tilePos = {uint8_t(mapX), uint8_t(mapY), uint8_t(inRange)};
-
 		visionType[rayPlayer]++;                        // we observe this tile
 		if (psObj->flags.test(OBJECT_FLAG_JAMMED_TILES))   // we are a jammer object
 		{
@@ -247,20 +298,95 @@ static inline void visMarkTile(const BASE_OBJECT *psObj, int mapX, int mapY, MAP
 			psTile->jammerBits |= (1 << rayPlayer); // mark it as being jammed
 		}
 		updateTileVis(psTile);
-		watchedTiles.push_back(tilePos);  // record having seen it
+		psObj->watchedTiles.push_back(pos);  // record having seen it
+		++visStats.tileWrites;
+	}
+}
+
+/* Undo visAddTile */
+static inline void visRemoveTile(BASE_OBJECT *psObj, TILEPOS pos)
+{
+	// FIXME: the mapTile might have been swapped out, see swapMissionPointers()
+	MAPTILE *psTile = mapTile(pos.x, pos.y);
+
+	ASSERT(pos.type < 2, "Invalid visibility type %d", (int)pos.type);
+	uint8_t *visionType = (pos.type == 0) ? psTile->sensors : psTile->watchers;
+	if (visionType[psObj->player] == 0 && game.type == LEVEL_TYPE::CAMPAIGN)	// hack
+	{
+		return;
+	}
+	ASSERT(visionType[psObj->player] > 0, "No %s on watched tile (%d, %d)", pos.type ? "radar" : "vision", (int)pos.x, (int)pos.y);
+	visionType[psObj->player]--;
+	if (psObj->flags.test(OBJECT_FLAG_JAMMED_TILES))  // we are a jammer object — we cannot check objJammerPower(psObj) > 0 directly here, we may be in the BASE_OBJECT destructor).
+	{
+		// No jammers in campaign, no need for special hack
+		ASSERT(psTile->jammers[psObj->player] > 0, "Not jamming watched tile (%d, %d)", (int)pos.x, (int)pos.y);
+		psTile->jammers[psObj->player]--;
+		if (psTile->jammers[psObj->player] == 0)
+		{
+			psTile->jammerBits &= ~(1 << psObj->player);
+		}
+	}
+	updateTileVis(psTile);
+	++visStats.tileWrites;
+}
+
+/* Change the watchedTiles of an object to seenTiles, only touching the tiles which came into or went out of view */
+static void visApplyTiles(BASE_OBJECT *psObj, std::vector<TILEPOS> const &seenTiles)
+{
+	const size_t numTiles = (size_t)mapWidth * mapHeight;
+	if (visTileMark.size() != numTiles || ++visTileGeneration >= 0x3FFFFFFF)
+	{
+		visTileMark.assign(numTiles, 0);
+		visTileGeneration = 1;
+	}
+	const uint32_t mark = visTileGeneration * 4;
+
+	for (TILEPOS pos : seenTiles)
+	{
+		visTileMark[pos.x + pos.y * mapWidth] = mark + 1 + pos.type;
+		mapTile(pos.x, pos.y)->tileExploredBits |= alliancebits[psObj->player];  // Share exploration with allies too
+	}
+
+	// Keep the tiles still in view, and let go of the rest.
+	size_t numKept = 0;
+	for (TILEPOS pos : psObj->watchedTiles)
+	{
+		if (pos.x < mapWidth && pos.y < mapHeight && visTileMark[pos.x + pos.y * mapWidth] == mark + 1 + pos.type)
+		{
+			visTileMark[pos.x + pos.y * mapWidth] = mark + 3;
+			psObj->watchedTiles[numKept++] = pos;
+			MAPTILE *psTile = mapTile(pos.x, pos.y);
+			if (psTile->jammerBits != 0)
+			{
+				updateTileVis(psTile);  // Alliances might have changed since, which matters for jammed tiles.
+			}
+		}
+		else
+		{
+			visRemoveTile(psObj, pos);
+		}
+	}
+	psObj->watchedTiles.resize(numKept);
+	visStats.tilesUnchanged += numKept;
+
+	// Add the tiles which came into view.
+	for (TILEPOS pos : seenTiles)
+	{
+		if (visTileMark[pos.x + pos.y * mapWidth] != mark + 3)
+		{
+			visAddTile(psObj, pos);
+		}
 	}
 }
 
-/* The terrain revealing ray callback */
-static void doWaveTerrain(BASE_OBJECT *psObj)
+/* The terrain revealing ray callback, listing the tiles seen in seenTiles.
+ * Only reads the map, so several can run at once; tiles and size are from getWavecastTable(objSensorRange(psObj)). */
+static void doWaveTerrain(BASE_OBJECT const *psObj, const WavecastTile *tiles, size_t size, std::vector<TILEPOS> &seenTiles)
 {
 	const int sx = psObj->pos.x;
 	const int sy = psObj->pos.y;
 	const int sz = psObj->pos.z + MAX(MIN_VIS_HEIGHT, psObj->sDisplay.imd->max.y);
-	const unsigned radius = objSensorRange(psObj);
-	const int rayPlayer = psObj->player;
-	size_t size;
-	const WavecastTile *tiles = getWavecastTable(radius, &size);
 #define MAX_WAVECAST_LIST_SIZE 1360  // Trivial upper bound to what a fully upgraded WSS can use (its number of angles). Should probably be some factor times the maximum possible radius. Is probably a lot more than needed. Tested to need at least 180.
 	int heights[2][MAX_WAVECAST_LIST_SIZE];
 	size_t angles[2][MAX_WAVECAST_LIST_SIZE + 1];
@@ -274,7 +400,7 @@ static void doWaveTerrain(BASE_OBJECT *psObj)
 	angles[!readList][writeListPos] = 0;               // Smallest angle.
 	++writeListPos;
 
-	psObj->watchedTiles.clear();
+	seenTiles.clear();
 	for (size_t i = 0; i < size; ++i)
 	{
 		const int mapX = map_coord(sx) + tiles[i].dx;
@@ -284,7 +410,7 @@ static void doWaveTerrain(BASE_OBJECT *psObj)
 			continue;
 		}
 
-		MAPTILE *psTile = mapTile(mapX, mapY);
+		const MAPTILE *psTile = mapTile(mapX, mapY);
 		int tileHeight = std::max(psTile->height, psTile->waterLevel);  // If we can see the water surface, then let us see water-covered tiles too.
 		int perspectiveHeight = (tileHeight - sz) * tiles[i].invRadius;
 		int perspectiveHeightLeeway = (tileHeight - sz + MIN_VIS_HEIGHT) * tiles[i].invRadius;
@@ -329,17 +455,16 @@ static void doWaveTerrain(BASE_OBJECT *psObj)
 		if (seen)
 		{
 			// Can see this tile.
-			psTile->tileExploredBits |= alliancebits[rayPlayer];                        // Share exploration with allies too
-			visMarkTile(psObj, mapX, mapY, psTile, psObj->watchedTiles);   // Mark this tile as seen by our sensor
+			const bool inRange = tiles[i].dx * tiles[i].dx + tiles[i].dy * tiles[i].dy < 16;  // Close tiles are watched, further ones only sensed.
+			TILEPOS tilePos = {uint8_t(mapX), uint8_t(mapY), uint8_t(inRange)};
+			seenTiles.push_back(tilePos);
 		}
 	}
 }
 
 /* The los ray callback */
-static bool rayLOSCallback(Vector2i pos, int32_t dist, void *data)
+static inline bool rayLOSCallback(Vector2i pos, int32_t dist, VisibleObjectHelp_t *help)
 {
-	VisibleObjectHelp_t *help = (VisibleObjectHelp_t *)data;
-
 	ASSERT(pos.x >= 0 && pos.x < world_coord(mapWidth) && pos.y >= 0 && pos.y < world_coord(mapHeight), "rayLOSCallback: coords off map");
 
 	if (help->rayStart)
@@ -357,7 +482,7 @@ static bool rayLOSCallback(Vector2i pos, int32_t dist, void *data)
 	}
 
 	help->lastDist = dist;
-	help->lastHeight = map_Height(pos.x, pos.y);
+	help->lastHeight = map_HeightUnchecked(pos.x, pos.y);  // rayCast() stays on the map
 
 	if (help->wallsBlock)
 	{
@@ -384,35 +509,32 @@ static bool rayLOSCallback(Vector2i pos, int32_t dist, void *data)
 }
 
 
+/* Forget a visTilesUpdateLater() request which hasn't been resolved yet */
+static void visCancelRequest(BASE_OBJECT *psObj)
+{
+	if (!psObj->flags.test(OBJECT_FLAG_VISIBILITY_PENDING))
+	{
+		return;
+	}
+	for (size_t i = 0; i < numVisRequests; ++i)
+	{
+		if (visRequests[i].psObj == psObj)
+		{
+			visRequests[i].psObj = nullptr;
+		}
+	}
+	psObj->flags.set(OBJECT_FLAG_VISIBILITY_PENDING, false);
+}
+
 /* Remove tile visibility from object */
 void visRemoveVisibility(BASE_OBJECT *psObj)
 {
+	visCancelRequest(psObj);
 	if (mapWidth && mapHeight)
 	{
 		for (TILEPOS pos : psObj->watchedTiles)
 		{
-			// FIXME: the mapTile might have been swapped out, see swapMissionPointers()
-			MAPTILE *psTile = mapTile(pos.x, pos.y);
-
-			ASSERT(pos.type < 2, "Invalid visibility type %d", (int)pos.type);
-			uint8_t *visionType = (pos.type == 0) ? psTile->sensors : psTile->watchers;
-			if (visionType[psObj->player] == 0 && game.type == LEVEL_TYPE::CAMPAIGN)	// hack
-			{
-				continue;
-			}
-			ASSERT(visionType[psObj->player] > 0, "No %s on watched tile (%d, %d)", pos.type ? "radar" : "vision", (int)pos.x, (int)pos.y);
-			visionType[psObj->player]--;
-			if (psObj->flags.test(OBJECT_FLAG_JAMMED_TILES))  // we are a jammer object — we cannot check objJammerPower(psObj) > 0 directly here, we may be in the BASE_OBJECT destructor).
-			{
-				// No jammers in campaign, no need for special hack
-				ASSERT(psTile->jammers[psObj->player] > 0, "Not jamming watched tile (%d, %d)", (int)pos.x, (int)pos.y);
-				psTile->jammers[psObj->player]--;
-				if (psTile->jammers[psObj->player] == 0)
-				{
-					psTile->jammerBits &= ~(1 << psObj->player);
-				}
-			}
-			updateTileVis(psTile);
+			visRemoveTile(psObj, pos);
 		}
 	}
 	psObj->watchedTiles.clear();
@@ -421,31 +543,130 @@ void visRemoveVisibility(BASE_OBJECT *psObj)
 
 void visRemoveVisibilityOffWorld(BASE_OBJECT *psObj)
 {
+	visCancelRequest(psObj);
 	psObj->watchedTiles.clear();
 }
 
+/* Unbuilt structures and walls do not confer visibility */
+static bool visConfersVisibility(BASE_OBJECT const *psObj)
+{
+	if (psObj->type == OBJ_STRUCTURE)
+	{
+		const STRUCTURE *psStruct = (const STRUCTURE *)psObj;
+		return psStruct->status == SS_BUILT &&
+		       psStruct->pStructureType->type != REF_WALL && psStruct->pStructureType->type != REF_WALLCORNER && psStruct->pStructureType->type != REF_GATE;
+	}
+	return true;
+}
+
+/* Make the tiles listed by doWaveTerrain() the ones the object watches */
+static void visSetSeenTiles(BASE_OBJECT *psObj, std::vector<TILEPOS> const &seenTiles)
+{
+	const bool jammer = objJammerPower(psObj) > 0;
+	if (jammer != psObj->flags.test(OBJECT_FLAG_JAMMED_TILES))
+	{
+		// Jamming all tiles or none of them, so start over.
+		visRemoveVisibility(psObj);
+		psObj->flags.set(OBJECT_FLAG_JAMMED_TILES, jammer);
+	}
+	++visStats.wavecasts;
+
+	// Only touch the tiles which came into or went out of view, most stay the same when moving a tile.
+	visApplyTiles(psObj, seenTiles);
+}
+
 /* Check which tiles can be seen by an object */
 void visTilesUpdate(BASE_OBJECT *psObj)
 {
 	ASSERT(psObj->type != OBJ_FEATURE, "visTilesUpdate: visibility updates are not for features!");
 
-	// Remove previous map visibility provided by object
-	visRemoveVisibility(psObj);
+	visCancelRequest(psObj);  // Done now, no need to do it again at the end of the tick.
+	if (!visConfersVisibility(psObj))
+	{
+		visRemoveVisibility(psObj);
+		return;
+	}
 
-	if (psObj->type == OBJ_STRUCTURE)
+	// Do the whole circle in ∞ steps. No more pretty moiré patterns.
+	size_t size;
+	const WavecastTile *tiles = getWavecastTable(objSensorRange(psObj), &size);
+	doWaveTerrain(psObj, tiles, size, visSeenTiles);
+	visSetSeenTiles(psObj, visSeenTiles);
+}
+
+/* Check which tiles can be seen by an object, at the end of the tick */
+void visTilesUpdateLater(BASE_OBJECT *psObj)
+{
+	ASSERT(psObj->type != OBJ_FEATURE, "visTilesUpdateLater: visibility updates are not for features!");
+
+	++visStats.requests;
+	if (psObj->flags.test(OBJECT_FLAG_VISIBILITY_PENDING))
 	{
-		STRUCTURE *psStruct = (STRUCTURE *)psObj;
-		if (psStruct->status != SS_BUILT ||
-		    psStruct->pStructureType->type == REF_WALL || psStruct->pStructureType->type == REF_WALLCORNER || psStruct->pStructureType->type == REF_GATE)
+		++visStats.requestsCollapsed;  // Moved twice this tick, only the last position matters.
+		return;
+	}
+	psObj->flags.set(OBJECT_FLAG_VISIBILITY_PENDING);
+
+	if (numVisRequests == visRequests.size())
+	{
+		visRequests.emplace_back();
+	}
+	visRequests[numVisRequests++].psObj = psObj;
+}
+
+static void applyVisibilityRequest(VisibilityRequest &request, std::vector<TILEPOS> seenTiles)
+{
+	request.seenTiles = std::move(seenTiles);
+	BASE_OBJECT *psObj = request.psObj;
+	if (psObj == nullptr)
+	{
+		return;  // Cancelled.
+	}
+	psObj->flags.set(OBJECT_FLAG_VISIBILITY_PENDING, false);
+	if (psObj->died)
+	{
+		return;
+	}
+	if (request.tiles == nullptr)
+	{
+		visRemoveVisibility(psObj);
+		return;
+	}
+	visSetSeenTiles(psObj, request.seenTiles);
+}
+
+/* Resolve the visTilesUpdateLater() requests: the wavecasts are spread over the job pool and
+ * this thread, then applied to the map here, in the order requested, so every client gets the same result. */
+void visUpdatePendingTiles()
+{
+	const size_t count = numVisRequests;
+	if (count == 0)
+	{
+		return;
+	}
+
+	// Look everything up here, getWavecastTable() generates missing tables and isn't safe to call from the workers.
+	for (size_t i = 0; i < count; ++i)
+	{
+		VisibilityRequest &request = visRequests[i];
+		request.tiles = nullptr;
+		if (request.psObj != nullptr && !request.psObj->died && visConfersVisibility(request.psObj))
 		{
-			// unbuilt structures and walls do not confer visibility.
-			return;
+			request.tiles = getWavecastTable(objSensorRange(request.psObj), &request.numTiles);
 		}
 	}
 
-	// Do the whole circle in ∞ steps. No more pretty moiré patterns.
-	psObj->flags.set(OBJECT_FLAG_JAMMED_TILES, objJammerPower(psObj) > 0);
-	doWaveTerrain(psObj);
+	wzParallelForOrdered<std::vector<TILEPOS>>("visibility", count, [](size_t i) {
+		return castVisibilityRequest(visRequests[i]);
+	}, [](size_t i, std::vector<TILEPOS> seenTiles) {
+		applyVisibilityRequest(visRequests[i], std::move(seenTiles));
+	});
+	numVisRequests = 0;
+}
+
+VisibilityStats const &visGetStats()
+{
+	return visStats;
 }
 
 /*reveals all the terrain in the map*/
@@ -556,24 +777,26 @@ int visibleObject(const BASE_OBJECT *psViewer, const BASE_OBJECT *psTarget, bool
 		return UBYTE_MAX;
 	}
 
-	// initialise the callback variables
-	VisibleObjectHelp_t help = {
-		true,
-		wallsBlock,
-		psViewer->pos.z + map_Height(psViewer->pos.x, psViewer->pos.y),
-		map_coord(psTarget->pos.xy()),
-		0,
-		0,
-		-UBYTE_MAX * GRAD_MUL * ELEVATION_SCALE,
-		0,
-		Vector2i(0, 0)
-	};
-
-	// Cast a ray from the viewer to the target
-	rayCast(psViewer->pos.xy(), psTarget->pos.xy(), rayLOSCallback, &help);
-
 	if (gWall != nullptr && gNumWalls != nullptr) // Out globals are set
 	{
+		// initialise the callback variables
+		VisibleObjectHelp_t help = {
+			true,
+			wallsBlock,
+			psViewer->pos.z + map_Height(psViewer->pos.x, psViewer->pos.y),
+			map_coord(psTarget->pos.xy()),
+			0,
+			0,
+			-UBYTE_MAX * GRAD_MUL * ELEVATION_SCALE,
+			0,
+			Vector2i(0, 0)
+		};
+
+		// Cast a ray from the viewer to the target, only needed for finding walls since the tile visibility decides the rest.
+		rayCast(psViewer->pos.xy(), psTarget->pos.xy(), [&help](Vector2i pos, int32_t dist) {
+			return rayLOSCallback(pos, dist, &help);
+		});
+
 		*gWall = help.wall;
 		*gNumWalls = help.numWalls;
 	}
@@ -1022,38 +1245,15 @@ static inline void angle_check(int64_t *angletan, int positionSq, int height, in
 }
 
 /**
- * Check fire line from psViewer to psTarget
- * psTarget can be any type of BASE_OBJECT (e.g. a tree).
+ * Trace the fire line from muzzle to psTarget, for checkFireLine.
  */
-static int checkFireLine(const SIMPLE_OBJECT *psViewer, const BASE_OBJECT *psTarget, int weapon_slot, bool wallsBlock, bool direct)
+static int traceFireLine(Vector3i muzzle, const BASE_OBJECT *psTarget, bool wallsBlock, bool direct)
 {
 	Vector3i pos(0, 0, 0), dest(0, 0, 0);
 	Vector2i start(0, 0), diff(0, 0), current(0, 0), halfway(0, 0), next(0, 0), part(0, 0);
-	Vector3i muzzle(0, 0, 0);
 	int distSq, partSq, oldPartSq;
 	int64_t angletan;
 
-	ASSERT(psViewer != nullptr, "Invalid shooter pointer!");
-	ASSERT(psTarget != nullptr, "Invalid target pointer!");
-	if (!psViewer || !psTarget)
-	{
-		return -1;
-	}
-
-	/* CorvusCorax: get muzzle offset (code from projectile.c)*/
-	if (psViewer->type == OBJ_DROID && weapon_slot >= 0)
-	{
-		calcDroidMuzzleBaseLocation((const DROID *)psViewer, &muzzle, weapon_slot);
-	}
-	else if (psViewer->type == OBJ_STRUCTURE && weapon_slot >= 0)
-	{
-		calcStructureMuzzleBaseLocation((const STRUCTURE *)psViewer, &muzzle, weapon_slot);
-	}
-	else // incase anything wants a projectile
-	{
-		muzzle = psViewer->pos;
-	}
-
 	pos = muzzle;
 	dest = psTarget->pos;
 	diff = (dest - pos).xy();
@@ -1149,3 +1349,77 @@ static int checkFireLine(const SIMPLE_OBJECT *psViewer, const BASE_OBJECT *psTar
 	}
 
 }
+
+/**
+ * Check fire line from psViewer to psTarget
+ * psTarget can be any type of BASE_OBJECT (e.g. a tree).
+ * The same shots get checked over and over by the target selection, so the results are kept until the next game tick,
+ * or until a tile height or structure changes. The exact positions are part of the key, so the result is always the same as tracing again.
+ */
+static int checkFireLine(const SIMPLE_OBJECT *psViewer, const BASE_OBJECT *psTarget, int weapon_slot, bool wallsBlock, bool direct)
+{
+	Vector3i muzzle(0, 0, 0);
+
+	ASSERT(psViewer != nullptr, "Invalid shooter pointer!");
+	ASSERT(psTarget != nullptr, "Invalid target pointer!");
+	if (!psViewer || !psTarget)
+	{
+		return -1;
+	}
+
+	/* CorvusCorax: get muzzle offset (code from projectile.c)*/
+	if (psViewer->type == OBJ_DROID && weapon_slot >= 0)
+	{
+		calcDroidMuzzleBaseLocation((const DROID *)psViewer, &muzzle, weapon_slot);
+	}
+	else if (psViewer->type == OBJ_STRUCTURE && weapon_slot >= 0)
+	{
+		calcStructureMuzzleBaseLocation((const STRUCTURE *)psViewer, &muzzle, weapon_slot);
+	}
+	else // incase anything wants a projectile
+	{
+		muzzle = psViewer->pos;
+	}
+
+	if (fireLineCache.empty())
+	{
+		fireLineCache.resize(FIRE_LINE_CACHE_SIZE);
+	}
+	if (fireLineTime != gameTime || fireLineMapChanges != mapChangeCount)
+	{
+		// New tick or changed map, so forget everything.
+		fireLineTime = gameTime;
+		fireLineMapChanges = mapChangeCount;
+		if (++fireLineGeneration == 0)
+		{
+			std::fill(fireLineCache.begin(), fireLineCache.end(), FireLineCacheEntry());
+			fireLineGeneration = 1;
+		}
+	}
+
+	const Vector3i dest = psTarget->pos;
+	uint32_t hash = psTarget->id * 2 + direct;
+	hash = (hash * 31 + wallsBlock) * 0x9E3779B1u;
+	hash ^= (uint32_t)(muzzle.x * 73856093 ^ muzzle.y * 19349663 ^ muzzle.z * 83492791);
+	hash ^= (uint32_t)(dest.x * 50331653 ^ dest.y * 12582917 ^ dest.z * 3145739);
+	hash ^= hash >> 16;
+	FireLineCacheEntry &entry = fireLineCache[hash & (FIRE_LINE_CACHE_SIZE - 1)];
+
+	++visStats.fireLineChecks;
+	if (entry.generation == fireLineGeneration && entry.psTarget == psTarget && entry.targetId == psTarget->id &&
+	    entry.muzzle == muzzle && entry.dest == dest && entry.wallsBlock == wallsBlock && entry.direct == direct)
+	{
+		++visStats.fireLineCacheHits;
+		return entry.result;
+	}
+
+	entry.generation = fireLineGeneration;
+	entry.muzzle = muzzle;
+	entry.dest = dest;
+	entry.psTarget = psTarget;
+	entry.targetId = psTarget->id;
+	entry.wallsBlock = wallsBlock;
+	entry.direct = direct;
+	entry.result = traceFireLine(muzzle, psTarget, wallsBlock, direct);
+	return entry.result;
+}
@@ -22,16 +22,20 @@
 #define __INCLUDED_SRC_VISIBILITY__
 
 #include "objectdef.h"
-#include "raycast.h"
 #include "stats.h"
 
 #define LINE_OF_FIRE_MINIMUM 5
 
 // initialise the visibility stuff
 bool visInitialise();
+void visShutdown();
 
 /* Check which tiles can be seen by an object */
 void visTilesUpdate(BASE_OBJECT *psObj);
+/* Same as visTilesUpdate, but only once visUpdatePendingTiles() is called; requesting it again before then does nothing */
+void visTilesUpdateLater(BASE_OBJECT *psObj);
+/// Do the updates requested by visTilesUpdateLater(), once per game tick.
+void visUpdatePendingTiles();
 
 void revealAll(UBYTE player);
 
@@ -112,6 +116,19 @@ static inline int objJammerPower(const BASE_OBJECT *psObj)
 	return 0;
 }
 
+/// Counters for profiling visibility updates, since visInitialise().
+struct VisibilityStats
+{
+	uint64_t wavecasts = 0;       ///< Calls to visTilesUpdate() which cast rays.
+	uint64_t requests = 0;        ///< Calls to visTilesUpdateLater().
+	uint64_t requestsCollapsed = 0;  ///< Calls to visTilesUpdateLater() for an object already waiting for its update.
+	uint64_t fireLineChecks = 0;     ///< Line of fire checks by lineOfFire(), areaOfFire() and arcOfFire().
+	uint64_t fireLineCacheHits = 0;  ///< Line of fire checks answered without tracing the line again.
+	uint64_t tileWrites = 0;      ///< Tiles whose watcher or sensor count was changed.
+	uint64_t tilesUnchanged = 0;  ///< Tiles which stayed in view of a moving object, so weren't touched.
+};
+VisibilityStats const &visGetStats();
+
 void removeSpotters();
 bool removeSpotter(uint32_t id);
 uint32_t addSpotter(int x, int y, int player, int radius, bool radar, uint32_t expiry = 0);
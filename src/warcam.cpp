@@ -47,6 +47,7 @@
 #include "console.h"
 #include "effects.h"
 #include "map.h"
+#include "raycast.h"
 #include "geometry.h"
 #include "oprint.h"
 #include "miscimd.h"
@@ -60,6 +60,8 @@ static UBYTE    scriptWinLoseVideo = PLAY_NONE;
 static HostLaunch hostlaunch = HostLaunch::Normal;  // used to detect if we are hosting a game via command line option.
 static bool bHeadlessAutoGameModeCLIOption = false;
 static bool bActualHeadlessAutoGameMode = false;
+static bool bHeadlessFastForward = false;
+static unsigned headlessFastForwardTickRate = 0;
 
 static uint32_t lastTick = 0;
 static int barLeftX, barLeftY, barRightX, barRightY, boxWidth, boxHeight, starsNum, starHeight;
@@ -137,6 +139,22 @@ bool headlessGameMode()
 	return bActualHeadlessAutoGameMode;
 }
 
+void setHeadlessFastForward(bool enabled, unsigned maxTicksPerSecond)
+{
+	bHeadlessFastForward = enabled;
+	headlessFastForwardTickRate = maxTicksPerSecond;
+}
+
+bool headlessFastForward()
+{
+	return bHeadlessFastForward && bActualHeadlessAutoGameMode;
+}
+
+unsigned headlessFastForwardMaxTickRate()
+{
+	return headlessFastForwardTickRate;
+}
+
 
 // //////////////////////////////////////////////////////////////////
 // Initialise frontend globals and statics.
@@ -49,6 +49,11 @@ HostLaunch getHostLaunch();
 void setHeadlessGameMode(bool enabled);
 bool headlessGameMode();
 
+/// Run the game state back to back without any presentation, at most maxTicksPerSecond ticks per second (0 = no limit). Only effective in headless mode.
+void setHeadlessFastForward(bool enabled, unsigned maxTicksPerSecond);
+bool headlessFastForward();
+unsigned headlessFastForwardMaxTickRate();
+
 bool frontendInitVars();
 TITLECODE titleLoop();
 
@@ -40,6 +40,7 @@
 #include "design.h"
 #include "display3d.h"
 #include "map.h"
+#include "terrain.h"
 #include "mission.h"
 #include "move.h"
 #include "order.h"
@@ -882,6 +883,7 @@ wzapi::no_return_value wzapi::hackMarkTiles(WZAPI_PARAMS(optional<wzapi::label_o
 	{
 		clearMarks();
 	}
+	markLightmapDirty();
 	return {};
 }
 
@@ -0,0 +1,265 @@
+// Decodes every sound sample in the data directory with the OggVorbis decoder alone, checking that
+// whole-file decoding (as for samples) and chunked decoding (as for streams) agree, and reports how
+// much faster than realtime decoding runs. Then checks that the decode thread, both streaming and
+// decoding whole files, gives the same bytes as decoding the file directly.
+// Usage: audiodecodetest [list of files under data/, default audiolist.txt]
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "lib/framework/frame.h"
+#include "lib/framework/wzapp.h"
+#include "lib/sound/oggvorbis.h"
+#include "lib/sound/decodethread.h"
+
+static const size_t streamBufferSize = 16 * 1024;
+// Few enough that the reader below regularly finds nothing ready and has to wait for the decode thread
+static const unsigned int streamQueueDepth = 2;
+
+// The threading functions normally come from the SDL backend, which this test doesn't link
+
+struct WZ_THREAD
+{
+	std::thread thread;
+	int (*threadFunc)(void *);
+	void *data;
+};
+
+struct WZ_MUTEX
+{
+	std::mutex mutex;
+};
+
+struct WZ_SEMAPHORE
+{
+	std::mutex mutex;
+	std::condition_variable condition;
+	int value;
+};
+
+WZ_THREAD *wzThreadCreate(int (*threadFunc)(void *), void *data)
+{
+	return new WZ_THREAD{std::thread(), threadFunc, data};
+}
+
+void wzThreadStart(WZ_THREAD *thread)
+{
+	thread->thread = std::thread(thread->threadFunc, thread->data);
+}
+
+int wzThreadJoin(WZ_THREAD *thread)
+{
+	thread->thread.join();
+	delete thread;
+	return 0;
+}
+
+WZ_MUTEX *wzMutexCreate()
+{
+	return new WZ_MUTEX;
+}
+
+void wzMutexDestroy(WZ_MUTEX *mutex)
+{
+	delete mutex;
+}
+
+void wzMutexLock(WZ_MUTEX *mutex)
+{
+	mutex->mutex.lock();
+}
+
+void wzMutexUnlock(WZ_MUTEX *mutex)
+{
+	mutex->mutex.unlock();
+}
+
+WZ_SEMAPHORE *wzSemaphoreCreate(int startValue)
+{
+	WZ_SEMAPHORE *semaphore = new WZ_SEMAPHORE;
+	semaphore->value = startValue;
+	return semaphore;
+}
+
+void wzSemaphoreDestroy(WZ_SEMAPHORE *semaphore)
+{
+	delete semaphore;
+}
+
+void wzSemaphoreWait(WZ_SEMAPHORE *semaphore)
+{
+	std::unique_lock<std::mutex> lock(semaphore->mutex);
+	semaphore->condition.wait(lock, [semaphore] { return semaphore->value > 0; });
+	--semaphore->value;
+}
+
+void wzSemaphorePost(WZ_SEMAPHORE *semaphore)
+{
+	std::lock_guard<std::mutex> lock(semaphore->mutex);
+	++semaphore->value;
+	semaphore->condition.notify_one();
+}
+
+static bool sameFormat(const soundDataBuffer *a, const soundDataBuffer *b)
+{
+	return a->bitsPerSample == b->bitsPerSample && a->channelCount == b->channelCount && a->frequency == b->frequency;
+}
+
+/// Stream a file through the decode thread, as sound_UpdateStream() does, and compare it with the whole decode.
+static bool checkThreadedStream(const char *filename, const soundDataBuffer *whole)
+{
+	PHYSFS_file *fileHandle = PHYSFS_openRead(filename);
+	struct OggVorbisDecoderState *decoder = fileHandle ? sound_CreateOggVorbisDecoder(fileHandle, false) : NULL;
+	if (!decoder)
+	{
+		fprintf(stderr, "audiodecodetest: Failed to open \"%s\" for streaming\n", filename);
+		return false;
+	}
+	SoundStreamQueue *queue = sound_CreateStreamQueue(decoder, streamBufferSize, streamQueueDepth);
+
+	size_t streamed = 0;
+	bool finished = false, same = true;
+	while (!finished && same)
+	{
+		soundDataBuffer *chunk = sound_TakeStreamBuffer(queue, &finished);
+		if (!chunk)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		if (!sameFormat(chunk, whole) || chunk->size > whole->size - streamed
+		    || memcmp(chunk->data, (const char *)whole->data + streamed, chunk->size) != 0)
+		{
+			fprintf(stderr, "audiodecodetest: \"%s\" streamed through the decode thread differs at byte %zu\n", filename, streamed);
+			same = false;
+		}
+		streamed += chunk->size;
+		free(chunk);
+	}
+
+	sound_DestroyStreamQueue(queue);
+	sound_DestroyOggVorbisDecoder(decoder);
+	PHYSFS_close(fileHandle);
+
+	if (same && streamed != whole->size)
+	{
+		fprintf(stderr, "audiodecodetest: \"%s\" decodes to %zu bytes whole but %zu bytes through the decode thread\n", filename, whole->size, streamed);
+		same = false;
+	}
+	return same;
+}
+
+/// Get the result of a whole file decode queued on the decode thread and compare it with the direct decode.
+static bool checkDecodeJob(const char *filename, SoundDecodeJob *job, const soundDataBuffer *whole)
+{
+	soundDataBuffer *decoded = sound_FinishDecodeJob(job);
+	bool same = decoded && sameFormat(decoded, whole) && decoded->size == whole->size
+	            && memcmp(decoded->data, whole->data, whole->size) == 0;
+	if (!same)
+	{
+		fprintf(stderr, "audiodecodetest: \"%s\" decoded on the decode thread differs from the direct decode\n", filename);
+	}
+	free(decoded);
+	return same;
+}
+
+int main(int argc, char **argv)
+{
+	char datapath[PATH_MAX];
+	const char *listFile = argc > 1 ? argv[1] : "audiolist.txt";
+	FILE *fp = fopen(listFile, "r");
+	double decodeSeconds = 0, audioSeconds = 0;
+	int files = 0;
+
+	if (!fp)
+	{
+		fprintf(stderr, "%s: Failed to open list file \"%s\"\n", argv[0], listFile);
+		return -1;
+	}
+	PHYSFS_init(argv[0]);
+	strcpy(datapath, getenv("srcdir"));
+	strcat(datapath, "/../data");
+	PHYSFS_mount(datapath, NULL, 1);
+	sound_StartDecodeThread();
+
+	while (!feof(fp))
+	{
+		char filename[PATH_MAX];
+
+		if (fscanf(fp, "%254s\n", filename) != 1)
+		{
+			fprintf(stderr, "audiodecodetest: Couldn't fscanf %s.\n", listFile);
+			return -1;
+		}
+
+		// queued first, so that it decodes on the thread while the direct decodes below run
+		SoundDecodeJob *decodeJob = sound_DecodeFileAsync(PHYSFS_openRead(filename));
+
+		const auto start = std::chrono::steady_clock::now();
+
+		// whole file at once
+		PHYSFS_file *fileHandle = PHYSFS_openRead(filename);
+		struct OggVorbisDecoderState *decoder = fileHandle ? sound_CreateOggVorbisDecoder(fileHandle, true) : NULL;
+		if (!decoder)
+		{
+			fprintf(stderr, "audiodecodetest: Failed to open \"%s\"\n", filename);
+			return -1;
+		}
+		soundDataBuffer *whole = sound_DecodeOggVorbis(decoder, 0);
+		sound_DestroyOggVorbisDecoder(decoder);
+		PHYSFS_close(fileHandle);
+		if (!whole)
+		{
+			fprintf(stderr, "audiodecodetest: Failed to decode \"%s\"\n", filename);
+			return -1;
+		}
+
+		// in stream sized chunks, without seeking
+		size_t streamed = 0;
+		fileHandle = PHYSFS_openRead(filename);
+		decoder = sound_CreateOggVorbisDecoder(fileHandle, false);
+		for (;;)
+		{
+			soundDataBuffer *chunk = sound_DecodeOggVorbis(decoder, streamBufferSize);
+			const size_t size = chunk ? chunk->size : 0;
+			free(chunk);
+			if (size == 0)
+			{
+				break;
+			}
+			streamed += size;
+		}
+		sound_DestroyOggVorbisDecoder(decoder);
+		PHYSFS_close(fileHandle);
+
+		decodeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (streamed != whole->size)
+		{
+			fprintf(stderr, "audiodecodetest: \"%s\" decodes to %zu bytes whole but %zu bytes streamed\n", filename, whole->size, streamed);
+			return -1;
+		}
+		// both decodes count
+		audioSeconds += 2.0 * whole->size / (whole->channelCount * (whole->bitsPerSample / 8) * whole->frequency);
+
+		if (!checkThreadedStream(filename, whole) || !checkDecodeJob(filename, decodeJob, whole))
+		{
+			return -1;
+		}
+		free(whole);
+		files++;
+	}
+	fclose(fp);
+	sound_StopDecodeThread();
+
+	printf("Decoded %d files, %.1f s of audio in %.3f s (%.0fx realtime)\n", files, audioSeconds, decodeSeconds,
+	       decodeSeconds > 0 ? audioSeconds / decodeSeconds : 0.0);
+
+	return 0;
+}
@@ -0,0 +1,194 @@
+// Checks that map_Height() through the per tile TileHeights cache gives exactly what the old map_Height(),
+// which looked up the four corners on every call, gave for every world coordinate of a random map with
+// water, and compares their speed on random coordinates.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "src/mapheight.h"
+
+static int mapWidth, mapHeight;
+static std::vector<int32_t> groundHeights, waterHeights;
+static std::vector<TileHeights> tileHeights;
+
+static const unsigned numLookups = 4000000;
+
+static int32_t tileHeightSurface(int32_t x, int32_t y)
+{
+	if (x >= mapWidth || y >= mapHeight || x < 0 || y < 0)
+	{
+		return 0;
+	}
+	return std::max(groundHeights[x + y * mapWidth], waterHeights[x + y * mapWidth]);
+}
+
+static void makeMap(std::mt19937 &rng, int width, int height)
+{
+	mapWidth = width;
+	mapHeight = height;
+	groundHeights.resize(width * height);
+	waterHeights.resize(width * height);
+	for (int i = 0; i < width * height; ++i)
+	{
+		groundHeights[i] = rng() % 511;
+		waterHeights[i] = rng() % 4 == 0 ? 255 : groundHeights[i] - world_coord(1) / 3;  // some lakes
+	}
+	tileHeights.resize(width * height);
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			tileHeights[x + y * width] = makeTileHeights(tileHeightSurface(x, y), tileHeightSurface(x + 1, y),
+			                                             tileHeightSurface(x, y + 1), tileHeightSurface(x + 1, y + 1));
+		}
+	}
+}
+
+// map_Height() as it was, without the asserts.
+static int32_t oldHeight(int x, int y)
+{
+	int tileX, tileY;
+	int32_t height[2][2], center;
+	int32_t onTileX, onTileY;
+	int32_t left, right, middle;
+	int32_t onBottom, result;
+	int towardsCenter, towardsRight;
+
+	x = std::min(std::max(x, 0), world_coord(mapWidth) - 1);
+	y = std::min(std::max(y, 0), world_coord(mapHeight) - 1);
+	tileX = map_coord(x);
+	tileY = map_coord(y);
+	onTileX = x - world_coord(tileX);
+	onTileY = y - world_coord(tileY);
+
+	center = 0;
+	for (int i = 0; i < 2; i++)
+	{
+		for (int j = 0; j < 2; j++)
+		{
+			height[i][j] = tileHeightSurface(tileX + i, tileY + j);
+			center += height[i][j];
+		}
+	}
+	center /= 4;
+
+	if (onTileY > onTileX)
+	{
+		if (onTileY < TILE_UNITS - onTileX)
+		{
+			right = height[0][0];
+			left  = height[0][1];
+			towardsCenter = onTileX;
+			towardsRight  = TILE_UNITS - onTileY;
+		}
+		else
+		{
+			right = height[0][1];
+			left  = height[1][1];
+			towardsCenter = TILE_UNITS - onTileY;
+			towardsRight  = TILE_UNITS - onTileX;
+		}
+	}
+	else
+	{
+		if (onTileX > TILE_UNITS - onTileY)
+		{
+			right = height[1][1];
+			left  = height[1][0];
+			towardsCenter = TILE_UNITS - onTileX;
+			towardsRight  = onTileY;
+		}
+		else
+		{
+			right = height[1][0];
+			left  = height[0][0];
+			towardsCenter = onTileY;
+			towardsRight  = onTileX;
+		}
+	}
+
+	middle = (left + right) / 2;
+	onBottom = left * (TILE_UNITS - towardsRight) + right * towardsRight;
+	result = onBottom + (center - middle) * towardsCenter * 2;
+
+	return (result + TILE_UNITS / 2) / TILE_UNITS;
+}
+
+// What map_Height() does now, also without the asserts.
+static inline int32_t newHeight(int x, int y)
+{
+	x = std::min(std::max(x, 0), world_coord(mapWidth) - 1);
+	y = std::min(std::max(y, 0), world_coord(mapHeight) - 1);
+	const int32_t tileX = map_coord(x);
+	const int32_t tileY = map_coord(y);
+	return tileHeightAt(tileHeights[tileX + tileY * mapWidth], x - world_coord(tileX), y - world_coord(tileY));
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+	std::mt19937 rng(2100);
+
+	// Every world coordinate of a small map, and a tile past each edge for the clamping.
+	makeMap(rng, 24, 17);
+	for (int y = -TILE_UNITS; y < world_coord(mapHeight) + TILE_UNITS; ++y)
+	{
+		for (int x = -TILE_UNITS; x < world_coord(mapWidth) + TILE_UNITS; ++x)
+		{
+			if (oldHeight(x, y) != newHeight(x, y))
+			{
+				fprintf(stderr, "heightbench: height at (%d, %d) is %d, should be %d\n", x, y, newHeight(x, y), oldHeight(x, y));
+				return -1;
+			}
+		}
+	}
+
+	makeMap(rng, 256, 256);
+	std::vector<int> coords(2 * numLookups);
+	for (unsigned n = 0; n < numLookups; ++n)
+	{
+		coords[2 * n] = rng() % world_coord(mapWidth);
+		coords[2 * n + 1] = rng() % world_coord(mapHeight);
+	}
+
+	double oldMs = 1e9, newMs = 1e9;
+	long oldSum = 0, newSum = 0;
+
+	// Best of a few alternating rounds, so that neither gets an advantage from warming up the caches.
+	for (int round = 0; round < 5; ++round)
+	{
+		oldSum = newSum = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned n = 0; n < numLookups; ++n)
+		{
+			oldSum += oldHeight(coords[2 * n], coords[2 * n + 1]);
+		}
+		oldMs = std::min(oldMs, elapsedMs(start));
+
+		start = std::chrono::steady_clock::now();
+		for (unsigned n = 0; n < numLookups; ++n)
+		{
+			newSum += newHeight(coords[2 * n], coords[2 * n + 1]);
+		}
+		newMs = std::min(newMs, elapsedMs(start));
+	}
+	if (oldSum != newSum)
+	{
+		fprintf(stderr, "heightbench: random lookups differ\n");
+		return -1;
+	}
+
+	printf("%u lookups\n", numLookups);
+	printf("corners: %.1f ms (%.1f ns/lookup)\n", oldMs, 1e6 * oldMs / numLookups);
+	printf("cached: %.1f ms (%.1f ns/lookup)\n", newMs, 1e6 * newMs / numLookups);
+
+	return 0;
+}
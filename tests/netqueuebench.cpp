@@ -0,0 +1,119 @@
+// Checks that messages survive NetQueue serialisation and deserialisation unchanged however the byte
+// stream is split up by the network, and reports the message throughput of a send and receive queue.
+// Usage: netqueuebench [number of messages]
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+#include "lib/framework/frame.h"
+#include "lib/netplay/netqueue.h"
+
+static const unsigned defaultNumMessages = 200000;
+
+/// Mostly small messages, like orders, with the odd large one, like a map chunk.
+static NetMessage makeMessage(unsigned n)
+{
+	NetMessage message(n % 200 + 10);
+	size_t size = n % 97 == 0 ? 20000 + n % 5000 : n % 60;
+	message.data.resize(size);
+	for (size_t i = 0; i < size; ++i)
+	{
+		message.data[i] = static_cast<uint8_t>(n * 31 + i);
+	}
+	return message;
+}
+
+int main(int argc, char **argv)
+{
+	const unsigned numMessages = argc > 1 ? strtoul(argv[1], nullptr, 10) : defaultNumMessages;
+	if (numMessages == 0)
+	{
+		fprintf(stderr, "Usage: %s [number of messages]\n", argv[0]);
+		return -1;
+	}
+
+	// An empty message, such as NET_HOST_DROPPED, has to come out as soon as its header is complete, even if that was split.
+	{
+		NetQueuePair sender, receiver;
+		sender.send.pushMessage(NetMessage(42));
+		NetMessageView view = sender.send.getMessageForNet();
+		uint8_t *rawData = view.rawDataDup();
+		for (size_t i = 0; i < view.rawLen(); ++i)
+		{
+			receiver.receive.writeRawData(rawData + i, 1);
+			if (receiver.receive.haveMessage() != (i + 1 == view.rawLen()))
+			{
+				fprintf(stderr, "%s: Empty message split after %zu bytes %s\n", argv[0], i + 1, i + 1 == view.rawLen() ? "not received" : "received early");
+				return -1;
+			}
+		}
+		delete[] rawData;
+		if (receiver.receive.getMessage().type != 42 || receiver.receive.getMessage().size != 0)
+		{
+			fprintf(stderr, "%s: Empty message changed by the queues\n", argv[0]);
+			return -1;
+		}
+	}
+
+	std::vector<NetMessage> messages;
+	for (unsigned n = 0; n < numMessages; ++n)
+	{
+		messages.push_back(makeMessage(n));
+	}
+
+	NetQueuePair sender, receiver;
+	std::vector<uint8_t> stream;
+	size_t payload = 0;
+
+	const auto startSend = std::chrono::steady_clock::now();
+	for (const NetMessage &message : messages)
+	{
+		sender.send.pushMessage(message);
+		NetMessageView view = sender.send.getMessageForNet();
+		uint8_t *rawData = view.rawDataDup();
+		stream.insert(stream.end(), rawData, rawData + view.rawLen());
+		delete[] rawData;
+		sender.send.popMessageForNet();
+		payload += message.data.size();
+	}
+	const double sendSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startSend).count();
+
+	// Feed the stream in pieces of varying size, so message headers and data get split everywhere.
+	unsigned received = 0;
+	size_t pos = 0;
+	const auto startReceive = std::chrono::steady_clock::now();
+	for (unsigned piece = 0; pos < stream.size(); ++piece)
+	{
+		size_t size = std::min<size_t>(piece % 7 == 0 ? piece % 5 + 1 : piece % 3000 + 1, stream.size() - pos);
+		receiver.receive.writeRawData(&stream[pos], size);
+		pos += size;
+
+		while (receiver.receive.haveMessage())
+		{
+			NetMessageView view = receiver.receive.getMessage();
+			const NetMessage &expected = messages[received];
+			if (view.type != expected.type || view.size != expected.data.size() || !std::equal(expected.data.begin(), expected.data.end(), view.data))
+			{
+				fprintf(stderr, "%s: Message %u changed by the queues\n", argv[0], received);
+				return -1;
+			}
+			receiver.receive.popMessage();
+			++received;
+		}
+	}
+	const double receiveSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startReceive).count();
+
+	if (received != numMessages)
+	{
+		fprintf(stderr, "%s: Received %u of %u messages\n", argv[0], received, numMessages);
+		return -1;
+	}
+
+	printf("%u messages, %.1f MiB of data, %.1f MiB on the wire\n", numMessages, payload / 1048576.0, stream.size() / 1048576.0);
+	printf("send: %.0f messages/s\n", numMessages / sendSeconds);
+	printf("receive: %.0f messages/s\n", numMessages / receiveSeconds);
+
+	return 0;
+}
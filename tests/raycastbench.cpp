@@ -0,0 +1,216 @@
+// Checks that the templated rayCast() visits the same points as the old out of line RAY_CALLBACK version,
+// and compares their speed on line of sight checks like the ones visibleObject() does, over a random height map.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "lib/framework/frame.h"
+#include "src/raycast.h"
+
+SDWORD mapWidth = 256, mapHeight = 256;
+
+static const unsigned numRays = 200000;
+
+static std::vector<int> heights;
+
+struct LOSHelp
+{
+	bool rayStart;
+	int startHeight;
+	int lastHeight, lastDist;
+	int currGrad;
+	unsigned points;
+};
+
+static inline bool losCallback(Vector2i pos, int32_t dist, LOSHelp *help)
+{
+	if (help->rayStart)
+	{
+		help->rayStart = false;
+	}
+	else
+	{
+		int newGrad = (help->lastHeight - help->startHeight) * 10000 / std::max(1, help->lastDist);
+		help->currGrad = std::max(help->currGrad, newGrad);
+	}
+	help->lastDist = dist;
+	help->lastHeight = heights[map_coord(pos.x) + map_coord(pos.y) * mapWidth];
+	++help->points;
+	return true;
+}
+
+// The callback type the old rayCast() took.
+typedef bool (*RAY_CALLBACK)(Vector2i pos, int32_t dist, void *data);
+
+static bool losCallbackC(Vector2i pos, int32_t dist, void *data)
+{
+	return losCallback(pos, dist, (LOSHelp *)data);
+}
+
+// Like the old out of line rayCast(), which couldn't see which callback it was calling.
+static RAY_CALLBACK volatile losCallbackPtr = losCallbackC;
+
+// initSteps(), tryStep() and rayCast() from raycast.cpp as they were.
+static void oldInitSteps(int32_t srcM, int32_t dstM, int32_t &tile, int32_t &step, int32_t &cur, int32_t &end)
+{
+	int increasing = srcM < dstM;
+	step = -1 + 2 * increasing;
+	tile = srcM - step;
+	cur = srcM + increasing;
+	end = dstM + increasing;
+}
+
+// Finds the next intersection of the line with a vertical grid line (or with a horizontal grid line, if called with x and y swapped).
+static bool oldTryStep(int32_t &tile, int32_t step, int32_t &cur, int32_t end, int32_t &px, int32_t &py, int32_t sx, int32_t sy, int32_t dx, int32_t dy)
+{
+	tile += step;
+
+	if (cur == end)
+	{
+		return false;  // No more vertical grid lines to cross before reaching the endpoint.
+	}
+
+	// Find the point on the line with the x coordinate world_coord(cur).
+	px = world_coord(cur);
+	py = sy + int64_t(px - sx) * (dy - sy) / (dx - sx);
+
+	cur += step;
+	return true;
+}
+
+static void oldRayCast(Vector2i src, Vector2i dst, RAY_CALLBACK callback, void *data)
+{
+	if (!callback(src, 0, data) || src == dst)  // Start at src.
+	{
+		return;  // Callback gave up after the first point, or there are no other points.
+	}
+
+	Vector2i srcM(map_coord(src.x), map_coord(src.y));  // map_coord(Vector2i) is in map.h too
+	Vector2i dstM(map_coord(dst.x), map_coord(dst.y));
+
+	Vector2i step(0, 0), tile(0, 0), cur(0, 0), end(0, 0);
+	oldInitSteps(srcM.x, dstM.x, tile.x, step.x, cur.x, end.x);
+	oldInitSteps(srcM.y, dstM.y, tile.y, step.y, cur.y, end.y);
+
+	Vector2i prev(0, 0);  // Dummy initialisation.
+	bool first = true;
+	Vector2i nextX(0, 0), nextY(0, 0);  // Dummy initialisations.
+	bool canX = oldTryStep(tile.x, step.x, cur.x, end.x, nextX.x, nextX.y, src.x, src.y, dst.x, dst.y);
+	bool canY = oldTryStep(tile.y, step.y, cur.y, end.y, nextY.y, nextY.x, src.y, src.x, dst.y, dst.x);
+	while (canX || canY)
+	{
+		int32_t xDist = abs(nextX.x - src.x) + abs(nextX.y - src.y);
+		int32_t yDist = abs(nextY.x - src.x) + abs(nextY.y - src.y);
+		Vector2i sel;
+		Vector2i selTile;
+		if (canX && (!canY || xDist < yDist))  // The line crosses a vertical grid line next.
+		{
+			sel = nextX;
+			selTile = tile;
+			canX = oldTryStep(tile.x, step.x, cur.x, end.x, nextX.x, nextX.y, src.x, src.y, dst.x, dst.y);
+		}
+		else  // The line crosses a horizontal grid line next.
+		{
+			assert(canY);
+			sel = nextY;
+			selTile = tile;
+			canY = oldTryStep(tile.y, step.y, cur.y, end.y, nextY.y, nextY.x, src.y, src.x, dst.y, dst.x);
+		}
+		if (!first)
+		{
+			// Find midpoint.
+			Vector2i avg = (prev + sel) / 2;
+			// But make sure it's on the right tile, since it could be off-by-one if the line passes exactly through a grid intersection.
+			avg.x = std::min(std::max(avg.x, world_coord(selTile.x)), world_coord(selTile.x + 1) - 1);
+			avg.y = std::min(std::max(avg.y, world_coord(selTile.y)), world_coord(selTile.y + 1) - 1);
+			if (!worldOnMap(avg) || !callback(avg, iHypot(avg), data))
+			{
+				return;  // Callback doesn't want any more points, or we reached the edge of the map, so return.
+			}
+		}
+		prev = sel;
+		first = false;
+	}
+
+	// Include the endpoint.
+	if (!worldOnMap(dst))
+	{
+		return;  // Stop, since reached the edge of the map.
+	}
+	callback(dst, iHypot(dst), data);
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+	std::mt19937 rng(2100);
+	heights.resize(mapWidth * mapHeight);
+	for (int &height : heights)
+	{
+		height = rng() % 512;
+	}
+
+	// Mostly sensor sized rays, anywhere on the map.
+	std::vector<Vector2i> ends;
+	for (unsigned n = 0; n < numRays; ++n)
+	{
+		Vector2i src(rng() % world_coord(mapWidth), rng() % world_coord(mapHeight));
+		Vector2i dst(src.x + int(rng() % 3000) - 1500, src.y + int(rng() % 3000) - 1500);
+		dst.x = std::min(std::max(dst.x, 0), world_coord(mapWidth) - 1);
+		dst.y = std::min(std::max(dst.y, 0), world_coord(mapHeight) - 1);
+		ends.push_back(src);
+		ends.push_back(dst);
+	}
+
+	std::vector<LOSHelp> resultsOld(numRays), resultsTemplate(numRays);
+	double oldMs = 1e9, templateMs = 1e9;
+
+	// Best of a few alternating rounds, so that neither gets an advantage from warming up the caches.
+	for (int round = 0; round < 5; ++round)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned n = 0; n < numRays; ++n)
+		{
+			LOSHelp &help = resultsOld[n];
+			help = {true, heights[map_coord(ends[2 * n].x) + map_coord(ends[2 * n].y) * mapWidth] + 80, 0, 0, -255 * 10000, 0};
+			oldRayCast(ends[2 * n], ends[2 * n + 1], losCallbackPtr, &help);
+		}
+		oldMs = std::min(oldMs, elapsedMs(start));
+
+		start = std::chrono::steady_clock::now();
+		for (unsigned n = 0; n < numRays; ++n)
+		{
+			LOSHelp &help = resultsTemplate[n];
+			help = {true, heights[map_coord(ends[2 * n].x) + map_coord(ends[2 * n].y) * mapWidth] + 80, 0, 0, -255 * 10000, 0};
+			rayCast(ends[2 * n], ends[2 * n + 1], [&help](Vector2i pos, int32_t dist) {
+				return losCallback(pos, dist, &help);
+			});
+		}
+		templateMs = std::min(templateMs, elapsedMs(start));
+	}
+
+	unsigned long points = 0;
+	for (unsigned n = 0; n < numRays; ++n)
+	{
+		const LOSHelp &a = resultsOld[n], &b = resultsTemplate[n];
+		if (a.points != b.points || a.currGrad != b.currGrad || a.lastHeight != b.lastHeight || a.lastDist != b.lastDist)
+		{
+			fprintf(stderr, "raycastbench: ray %u differs between the old and templated rayCast\n", n);
+			return -1;
+		}
+		points += a.points;
+	}
+
+	printf("%u rays, %lu points\n", numRays, points);
+	printf("old RAY_CALLBACK: %.1f ms (%.1f ns/point)\n", oldMs, 1e6 * oldMs / points);
+	printf("template: %.1f ms (%.1f ns/point)\n", templateMs, 1e6 * templateMs / points);
+
+	return 0;
+}
@@ -0,0 +1,163 @@
+// Headless video decode benchmark: decodes every Theora frame of an .ogg file and times
+// the decode and the YUV to RGBA conversion, comparing the SIMD path against the scalar one.
+//
+// Usage: videobench <file.ogg> [scanline mode 0-2]
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include <theora/theora.h>
+
+#include "lib/sequence/yuv.h"
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool readPage(FILE *fp, ogg_sync_state *oy, ogg_page *og)
+{
+	while (ogg_sync_pageout(oy, og) <= 0)
+	{
+		char *buffer = ogg_sync_buffer(oy, 65536);
+		size_t bytes = fread(buffer, 1, 65536, fp);
+		if (bytes == 0)
+		{
+			return false;
+		}
+		ogg_sync_wrote(oy, static_cast<long>(bytes));
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <file.ogg> [scanline mode 0-2]\n", argv[0]);
+		return -1;
+	}
+	const SCANLINE_MODE scanMode = argc > 2 ? static_cast<SCANLINE_MODE>(atoi(argv[2]) % 3) : SCANLINES_OFF;
+
+	FILE *fp = fopen(argv[1], "rb");
+	if (!fp)
+	{
+		fprintf(stderr, "videobench: Failed to open \"%s\"\n", argv[1]);
+		return -1;
+	}
+
+	ogg_sync_state oy;
+	ogg_page og;
+	ogg_packet op;
+	ogg_stream_state to;
+	theora_info ti;
+	theora_comment tc;
+	theora_state td;
+	int theoraHeaders = 0;
+
+	ogg_sync_init(&oy);
+	theora_info_init(&ti);
+	theora_comment_init(&tc);
+
+	// find the theora stream and its three header packets
+	while (theoraHeaders < 3 && readPage(fp, &oy, &og))
+	{
+		if (ogg_page_bos(&og))
+		{
+			ogg_stream_state test;
+			ogg_stream_init(&test, ogg_page_serialno(&og));
+			ogg_stream_pagein(&test, &og);
+			if (!theoraHeaders && ogg_stream_packetout(&test, &op) > 0 && theora_decode_header(&ti, &tc, &op) >= 0)
+			{
+				memcpy(&to, &test, sizeof(test));
+				theoraHeaders = 1;
+			}
+			else
+			{
+				ogg_stream_clear(&test);
+			}
+			continue;
+		}
+		if (!theoraHeaders)
+		{
+			continue;
+		}
+		ogg_stream_pagein(&to, &og);
+		while (theoraHeaders < 3 && ogg_stream_packetout(&to, &op) > 0)
+		{
+			if (theora_decode_header(&ti, &tc, &op) != 0)
+			{
+				fprintf(stderr, "videobench: Corrupt Theora headers in \"%s\"\n", argv[1]);
+				return -1;
+			}
+			theoraHeaders++;
+		}
+	}
+	if (theoraHeaders < 3 || ti.pixelformat != OC_PF_420)
+	{
+		fprintf(stderr, "videobench: No YUV420 Theora stream in \"%s\"\n", argv[1]);
+		return -1;
+	}
+	theora_decode_init(&td, &ti);
+
+	const int width = ti.frame_width;
+	const int height = ti.frame_height;
+	const size_t pixels = static_cast<size_t>(width) * height * (scanMode != SCANLINES_OFF ? 2 : 1);
+	std::vector<uint32_t> simdFrame(pixels), scalarFrame(pixels);
+	double decodeMs = 0, simdMs = 0, scalarMs = 0;
+	int frames = 0;
+
+	printf("Decoding %dx%d video with the %s converter\n", width, height, yuv420ToRGBAImplementation());
+	for (;;)
+	{
+		while (ogg_stream_packetout(&to, &op) > 0)
+		{
+			yuv_buffer yuv;
+			auto start = std::chrono::steady_clock::now();
+			theora_decode_packetin(&td, &op);
+			theora_decode_YUVout(&td, &yuv);
+			decodeMs += elapsedMs(start);
+
+			start = std::chrono::steady_clock::now();
+			yuv420ToRGBA(yuv.y, yuv.y_stride, yuv.u, yuv.v, yuv.uv_stride, width, height, simdFrame.data(), scanMode);
+			simdMs += elapsedMs(start);
+
+			start = std::chrono::steady_clock::now();
+			yuv420ToRGBAScalar(yuv.y, yuv.y_stride, yuv.u, yuv.v, yuv.uv_stride, width, height, scalarFrame.data(), scanMode);
+			scalarMs += elapsedMs(start);
+
+			if (simdFrame != scalarFrame)
+			{
+				fprintf(stderr, "videobench: %s and scalar conversion differ in frame %d\n", yuv420ToRGBAImplementation(), frames);
+				return -1;
+			}
+			frames++;
+		}
+		if (!readPage(fp, &oy, &og))
+		{
+			break;
+		}
+		ogg_stream_pagein(&to, &og);
+	}
+
+	if (frames > 0)
+	{
+		printf("%d frames\n", frames);
+		printf("decode: %.3f ms/frame\n", decodeMs / frames);
+		printf("convert (%s): %.3f ms/frame\n", yuv420ToRGBAImplementation(), simdMs / frames);
+		printf("convert (scalar): %.3f ms/frame\n", scalarMs / frames);
+		printf("decode + convert: %.1f frames/s\n", 1000.0 * frames / (decodeMs + simdMs));
+	}
+
+	theora_clear(&td);
+	theora_comment_clear(&tc);
+	theora_info_clear(&ti);
+	ogg_stream_clear(&to);
+	ogg_sync_clear(&oy);
+	fclose(fp);
+
+	return frames > 0 ? 0 : -1;
+}